@@ -282,11 +282,13 @@ export class AriannaLungWASM {
     this.d = config.dModel;
     this.ctx = config.ctx;
     this.nHeads = config.nHeads;
+    this.nKVHeads = config.nKVHeads ?? config.nHeads;
     this.headDim = Math.floor(config.dModel / config.nHeads);
 
     // Buffers for passing data to WASM
     this._contextPtr = null;
     this._topKPtr = null;
+    this._rngPtr = null;
 
     // Cache for JS-side access
     this.lastLogits = null;
@@ -298,6 +300,10 @@ export class AriannaLungWASM {
     this.attendSpread = 0.20;
     this.temporalAlpha = 0.5;
     this.useRTLPositions = false;
+    this.maskPadding = false;
+    this.attnWindow = 0;
+    this.attnAnchors = 0;
+    this.shortlistProbe = 0;
     this.temporalMode = 'symmetric';
 
     // Presence decay (for API compatibility)
@@ -312,24 +318,40 @@ export class AriannaLungWASM {
   // STATIC FACTORY — async creation
   // ─────────────────────────────────────────────────────────────────────────────
 
-  static async create({ vocabSize, dModel = 32, ctx = 16, nHeads = 2, seed = null }) {
+  // nKVHeads < nHeads shares each key/value head across a group of query
+  // heads (grouped-query; 1 = multi-query). Must divide nHeads.
+  static async create({ vocabSize, dModel = 32, ctx = 16, nHeads = 2, nKVHeads = null, seed = null }) {
     const module = await loadWASM();
     if (!module) {
       throw new Error('WASM module not available');
     }
 
-    // Seed random if provided
-    if (seed !== null) {
-      module._lung_seed(seed);
-    }
-
-    // Create lung instance in WASM
-    const ptr = module._lung_create(vocabSize, dModel, ctx, nHeads);
+    // Create lung instance in WASM (a seed gives the lung its own stream)
+    const ptr = seed !== null
+      ? module._lung_create_seeded(vocabSize, dModel, ctx, nHeads, nKVHeads ?? nHeads, seed)
+      : module._lung_create_gqa(vocabSize, dModel, ctx, nHeads, nKVHeads ?? nHeads);
     if (!ptr) {
       throw new Error('Failed to create AriannaLung in WASM');
     }
 
-    return new AriannaLungWASM(ptr, module, { vocabSize, dModel, ctx, nHeads });
+    return new AriannaLungWASM(ptr, module, {
+      vocabSize, dModel, ctx, nHeads, nKVHeads: nKVHeads ?? nHeads,
+    });
+  }
+
+  // Another lung on the same weights: its own presence, caches and settings,
+  // one shared copy of E, Wo and Q/K/V. Weight writes (loads, merges,
+  // quantize) give the writing lung a private copy first.
+  newSession() {
+    const w = this._module._lung_share_weights(this._ptr);
+    const ptr = w ? this._module._lung_session_new(w) : 0;
+    if (!ptr) {
+      throw new Error('Failed to create AriannaLung session in WASM');
+    }
+    return new AriannaLungWASM(ptr, this._module, {
+      vocabSize: this.vocabSize, dModel: this.d, ctx: this.ctx,
+      nHeads: this.nHeads, nKVHeads: this.nKVHeads,
+    });
   }
 
   // ─────────────────────────────────────────────────────────────────────────────
@@ -345,6 +367,10 @@ export class AriannaLungWASM {
       this._module._free(this._topKPtr);
       this._topKPtr = null;
     }
+    if (this._rngPtr) {
+      this._module._free(this._rngPtr);
+      this._rngPtr = null;
+    }
     if (this._ptr) {
       this._module._lung_destroy(this._ptr);
       this._ptr = null;
@@ -491,6 +517,26 @@ export class AriannaLungWASM {
     return this._module._lung_get_argmax(this._ptr);
   }
 
+  // Estimated probability left outside the shortlist (0 with the full vocab)
+  getTailMass() {
+    if (!this._ptr) return 0;
+    return this._module._lung_get_tail_mass(this._ptr);
+  }
+
+  // Draw the next token in C from the cached logits (no distribution copy).
+  // temperature: AMK effective_temp (am_copy_state slot 15); destiny: chance
+  // of taking the argmax outright, as sampleWithDestiny does
+  sample(temperature = 1.0, { topK = 0, topP = 1.0, minP = 0.0, destiny = 0.0 } = {}) {
+    if (!this._ptr) return 0;
+    if (destiny > 0 && Math.random() < destiny) return this.getArgmax();
+
+    if (!this._rngPtr) {
+      this._rngPtr = this._module._malloc(4);  // uint32 LCG state
+      this._module.setValue(this._rngPtr, (Math.random() * 0xffffffff) >>> 0, 'i32');
+    }
+    return this._module._lung_sample(this._ptr, temperature, topK, topP, minP, this._rngPtr);
+  }
+
   getTokenProb(tokenId) {
     if (!this._ptr) return 0;
     if (tokenId < 0 || tokenId >= this.vocabSize) return 0;
@@ -525,6 +571,33 @@ export class AriannaLungWASM {
     }
   }
 
+  // Length-aware attention: short contexts skip their padding entirely
+  setMaskPadding(enabled) {
+    this.maskPadding = enabled;
+    if (this._ptr) {
+      this._module._lung_set_mask_padding(this._ptr, enabled ? 1 : 0);
+    }
+  }
+
+  // Sparse attention for long contexts: sliding window plus prime anchors
+  // (CHORDLOCK positions 2, 3, 5, ...); window 0 = dense
+  setSparseAttention(window, anchors = 15) {
+    this.attnWindow = window;
+    if (this._ptr) {
+      this.attnAnchors = this._module._lung_set_sparse_attention(this._ptr, window, anchors);
+    }
+  }
+
+  // Candidate-shortlist logits: only tokens of the best `probe` output
+  // clusters, plus presence-active and high-resonance ones, are scored;
+  // the rest read as -Infinity (see getTailMass). probe 0 = full vocab
+  setShortlist(probe) {
+    this.shortlistProbe = probe > 0 ? probe : 0;
+    if (this._ptr) {
+      this._module._lung_set_shortlist(this._ptr, this.shortlistProbe);
+    }
+  }
+
   setTemporalAlpha(alpha) {
     this.temporalAlpha = Math.max(0, Math.min(1, alpha));
     if (this._ptr) {
@@ -582,30 +655,77 @@ export class AriannaLungWASM {
   // PROPHECY — multi-step forward
   // ─────────────────────────────────────────────────────────────────────────────
 
-  prophecyForward(startContext, steps = 3) {
-    const results = [];
-    let ctx = [...startContext];
+  // One native call: the rollout runs on the lung's streaming cache, so no
+  // per-step forward or distribution copy crosses the JS↔WASM boundary.
+  // The lung's stream window and presence are restored afterwards, so a
+  // live streaming session continues from its own window.
+  // destiny = 1 and wormhole = 0 give the greedy argmax rollout.
+  prophecyForward(startContext, steps = 3,
+                  { temperature = 1.0, destiny = 1.0, wormhole = 0.0, skipMax = 0 } = {}) {
+    if (!this._ptr) throw new Error('Lung destroyed');
+    if (steps <= 0) return [];
 
-    for (let i = 0; i < steps; i++) {
-      this.forward(ctx);
-      const token = this.getArgmax();
-      const prob = this.getTokenProb(token);
+    const m = this._module;
+    const ids = this._padOrTrim(startContext, this.ctx);
+    const ctxPtr = m._malloc(this.ctx * 4);
+    const outPtr = m._malloc(steps * 16);  // tokens, entropies, probs, skipped
+    const tokPtr = outPtr, entPtr = outPtr + steps * 4;
+    const probPtr = outPtr + steps * 8, skipPtr = outPtr + steps * 12;
 
+    for (let i = 0; i < this.ctx; i++) {
+      m.setValue(ctxPtr + i * 4, ids[i], 'i32');
+    }
+
+    const n = m._lung_prophecy(this._ptr, ctxPtr, this.ctx, steps, temperature, destiny,
+                               wormhole, skipMax, 0, tokPtr, entPtr, probPtr, skipPtr);
+
+    const results = [];
+    for (let i = 0; i < n; i++) {
       results.push({
         step: i + 1,
-        token,
-        prob,
-        entropy: -Math.log(prob + 1e-12)
+        token: m.getValue(tokPtr + i * 4, 'i32'),
+        prob: m.getValue(probPtr + i * 4, 'float'),
+        entropy: m.getValue(entPtr + i * 4, 'float'),
+        wormhole: m.getValue(skipPtr + i * 4, 'i32') !== 0
       });
+    }
 
-      // Append predicted token for next step
-      ctx = [...ctx, token];
-      if (ctx.length > this.ctx) {
-        ctx = ctx.slice(-this.ctx);
+    m._free(outPtr);
+    m._free(ctxPtr);
+    return results;
+  }
+
+  // Best `beam` futures of `steps` tokens, best first: [{ tokens, logProb }].
+  // Branches share their prefix inside the lung; one native call in total.
+  prophecyBeam(startContext, beam = 4, steps = 3) {
+    if (!this._ptr) throw new Error('Lung destroyed');
+    if (beam <= 0 || steps <= 0) return [];
+
+    const m = this._module;
+    const ids = this._padOrTrim(startContext, this.ctx);
+    const ctxPtr = m._malloc(this.ctx * 4);
+    const tokPtr = m._malloc(beam * steps * 4);
+    const scorePtr = m._malloc(beam * 4);
+
+    for (let i = 0; i < this.ctx; i++) {
+      m.setValue(ctxPtr + i * 4, ids[i], 'i32');
+    }
+
+    const n = m._lung_beam_search(this._ptr, ctxPtr, this.ctx, beam, steps, tokPtr, scorePtr);
+
+    const futures = [];
+    for (let b = 0; b < n; b++) {
+      const tokens = [];
+      for (let s = 0; s < steps; s++) {
+        tokens.push(m.getValue(tokPtr + (b * steps + s) * 4, 'i32'));
       }
+      futures.push({ tokens, logProb: m.getValue(scorePtr + b * 4, 'float') });
     }
 
-    return results;
+    m._free(scorePtr);
+    m._free(tokPtr);
+    m._free(ctxPtr);
+    return futures;
   }
 
   // ─────────────────────────────────────────────────────────────────────────────
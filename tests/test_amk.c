@@ -1,7 +1,7 @@
 // test_amk.c — Brutal AMK Kernel Tests (Stanley-style)
 // "make it hurt"
 //
-// Build: gcc -O2 -std=c99 -I../wasm ../wasm/arianna_method.c test_amk.c -lm -o test_amk
+// Build: gcc -O2 -std=gnu99 -I../wasm test_amk.c -lm -lpthread -o test_amk
 // Run:   ./test_amk
 //
 // ═══════════════════════════════════════════════════════════════════════════════
@@ -10,6 +10,10 @@
 // - Pack boundaries are respected
 // - No regressions from split
 // - Safety under garbage input
+// - Independent fields (contexts) never touch each other, on any thread
+// - Compiled programs (am_compile + am_run) do exactly what am_exec does
+// - am_exec_n runs scripts in place from read-only, unterminated buffers
+// - Batches (struct of arrays) step and execute exactly like single fields
 // הרזוננס לא נשבר. המשך הדרך.
 // ═══════════════════════════════════════════════════════════════════════════════
 
@@ -17,10 +21,18 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <limits.h>
 #include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Batches as on wasm32: a column block beyond 32 bits of size_t is refused
+#define AM_BATCH_MAX_BYTES ((size_t)UINT32_MAX)
 
 // Include the kernel directly for testing
 #include "../wasm/arianna_method.c"
+#include "../wasm/schumann.c"
 
 // ═══════════════════════════════════════════════════════════════════════════════
 // TEST FRAMEWORK — minimal, brutal
@@ -52,6 +64,24 @@ static int tests_failed = 0;
 #define ASSERT_FLOAT_EQ(a, b, eps) ASSERT(fabsf((a) - (b)) < (eps))
 #define ASSERT_IN_RANGE(x, lo, hi) ASSERT((x) >= (lo) && (x) <= (hi))
 
+// am_exec as the kernel tests see it. The kernel sections run once per
+// path, so every case covers the interpreter, compiled programs and
+// length-delimited scripts.
+enum { PATH_EXEC, PATH_PROGRAM, PATH_EXEC_N };
+static int exec_path = PATH_EXEC;
+
+static int exec_under_test(const char* script) {
+  if (exec_path == PATH_EXEC_N) return am_exec_n(script, script ? strlen(script) : 0);
+  if (exec_path == PATH_EXEC) return am_exec(script);
+  AM_Program* prog = am_compile(script);
+  if (!prog) return 2;
+  int result = am_run(prog);
+  am_program_free(prog);
+  return result;
+}
+
+#define am_exec exec_under_test
+
 // ═══════════════════════════════════════════════════════════════════════════════
 // SECTION A: AMK KERNEL TESTS — parse/trim/comment handling
 // ═══════════════════════════════════════════════════════════════════════════════
@@ -243,7 +273,7 @@ TEST(determinism_basic) {
     "VELOCITY RUN\n"
     "PAIN 0.33";
 
-  float state1[20], state2[20];
+  float state1[24], state2[24];
 
   am_init();
   am_exec(script);
@@ -377,7 +407,7 @@ TEST(idempotence_empty) {
   am_init();
   am_exec("PROPHECY 42\nDESTINY 0.77");
 
-  float before[20], after[20];
+  float before[24], after[24];
   am_copy_state(before);
 
   am_exec("");
@@ -675,7 +705,7 @@ TEST(copy_state_api) {
   am_init();
   am_exec("PROPHECY 17\nDESTINY 0.42\nVELOCITY RUN\nMODE CODES_RIC\nCHORDLOCK ON");
 
-  float out[20];
+  float out[24];
   int result = am_copy_state(out);
   ASSERT_EQ(result, 0);
 
@@ -749,18 +779,630 @@ TEST(unknown_commands_ignored) {
 }
 
 // ═══════════════════════════════════════════════════════════════════════════════
-// MAIN — run all tests
+// SECTION D: CONTEXTS — independent fields
 // ═══════════════════════════════════════════════════════════════════════════════
 
-int main(void) {
-  srand((unsigned)time(NULL));
+static const char* ctx_scripts[] = {
+  "PROPHECY 17\nDESTINY 0.42\nVELOCITY RUN\nPAIN 0.33\nJUMP 4",
+  "VELOCITY BACKWARD\nBASE_TEMP 1.7\nTENSION 0.8\nDISSONANCE 0.6\nLAW DEBT_DECAY 0.95",
+  "MODE CODES_RIC\nCHORDLOCK ON\nTEMPO 11\nCOSMIC_COHERENCE 0.9\nTENSION 0.5",
+  "IMPORT DARKMATTER\nGRAVITY DARK 0.8\nANTIDOTE HARD\nJUMP -3\nRESET_FIELD\nWORMHOLE 0.3",
+};
+#define N_CTX_SCRIPTS ((int)(sizeof(ctx_scripts) / sizeof(ctx_scripts[0])))
 
-  printf("\n");
-  printf("═══════════════════════════════════════════════════════════════════════════════\n");
-  printf(" AMK KERNEL TESTS — brutal, Stanley-style\n");
-  printf(" \"make it hurt\"\n");
-  printf("═══════════════════════════════════════════════════════════════════════════════\n\n");
+TEST(ctx_new_matches_init) {
+  am_init();
+  AM_State* ctx = am_ctx_new();
+  ASSERT(ctx != NULL && ctx != am_get_state());
+  ASSERT(memcmp(ctx, am_get_state(), sizeof(AM_State)) == 0);
+  am_ctx_free(ctx);
+  am_ctx_free(am_get_state());  // the default field is never freed
+  ASSERT_EQ(am_get_state()->prophecy, 7);
+}
+
+TEST(ctx_fields_are_independent) {
+  am_init();
+  AM_State* a = am_ctx_new();
+  AM_State* b = am_ctx_new();
+  ASSERT(a && b);
+
+  am_exec_ctx(a, "PROPHECY 30\nVELOCITY BACKWARD\nJUMP 5\nMODE CODES_RIC");
+  am_exec_ctx(b, "PROPHECY 2\nVELOCITY RUN");
+  am_exec("PROPHECY 12");
+  ASSERT_EQ(a->prophecy, 30);
+  ASSERT_EQ(b->prophecy, 2);
+  ASSERT_EQ(am_get_state()->prophecy, 12);
+  ASSERT(am_pack_enabled_ctx(a, AM_PACK_CODES_RIC) && !am_pack_enabled_ctx(b, AM_PACK_CODES_RIC));
+  ASSERT(!am_pack_enabled(AM_PACK_CODES_RIC));
+
+  for (int i = 0; i < 100; i++) am_step_ctx(a, 0.1f);
+  ASSERT(a->temporal_debt > 0.0f);
+  ASSERT_FLOAT_EQ(b->temporal_debt, 0.0f, 1e-9f);
+  ASSERT_FLOAT_EQ(am_get_state()->temporal_debt, 0.0f, 1e-9f);
+  ASSERT_EQ(am_take_jump_ctx(a), 5);
+  ASSERT_EQ(am_take_jump_ctx(a), 0);
+
+  // NULL fields are refused, not dereferenced
+  ASSERT(am_exec_ctx(NULL, "PROPHECY 3") != 0);
+  ASSERT(am_copy_state_ctx(NULL, (float[24]){0}) != 0);
+  am_step_ctx(NULL, 1.0f);
+  am_init_ctx(NULL);
+  ASSERT_EQ(am_take_jump_ctx(NULL), 0);
+
+  am_ctx_free(a);
+  am_ctx_free(b);
+}
+
+TEST(ctx_matches_default_field) {
+  AM_State* ctx = am_ctx_new();
+  ASSERT(ctx != NULL);
+  for (int i = 0; i < N_CTX_SCRIPTS; i++) {
+    am_init();
+    am_init_ctx(ctx);
+    am_exec(ctx_scripts[i]);
+    am_exec_ctx(ctx, ctx_scripts[i]);
+    for (int t = 0; t < 50; t++) {
+      am_step(0.05f);
+      am_step_ctx(ctx, 0.05f);
+    }
+    float s1[24], s2[24];
+    am_copy_state(s1);
+    am_copy_state_ctx(ctx, s2);
+    ASSERT(memcmp(s1, s2, sizeof(s1)) == 0);
+    ASSERT(memcmp(ctx, am_get_state(), sizeof(AM_State)) == 0);
+  }
+  am_ctx_free(ctx);
+}
+
+// One thread drives every n-th field through its script and steps
+typedef struct {
+  AM_State** fields;
+  int n_fields;
+  int first;
+  int stride;
+} CtxJob;
+
+static void ctx_drive(AM_State* f, int i) {
+  am_exec_ctx(f, ctx_scripts[i % N_CTX_SCRIPTS]);
+  char line[32];
+  snprintf(line, sizeof(line), "PAIN 0.%03d", i % 1000);
+  am_exec_ctx(f, line);
+  for (int t = 0; t < 20 + i % 7; t++) am_step_ctx(f, 0.02f * (float)(1 + i % 3));
+}
+
+static void* ctx_job(void* arg) {
+  CtxJob* job = (CtxJob*)arg;
+  for (int i = job->first; i < job->n_fields; i += job->stride) ctx_drive(job->fields[i], i);
+  return NULL;
+}
+
+TEST(ctx_thousands_of_fields_on_threads) {
+  enum { FIELDS = 2048, THREADS = 8 };
+  AM_State** fields = (AM_State**)malloc(FIELDS * sizeof(AM_State*));
+  AM_State* ref = am_ctx_new();
+  ASSERT(fields && ref);
+  for (int i = 0; i < FIELDS; i++) {
+    fields[i] = am_ctx_new();
+    ASSERT(fields[i] != NULL);
+  }
+
+  pthread_t tid[THREADS];
+  CtxJob job[THREADS];
+  for (int t = 0; t < THREADS; t++) {
+    job[t] = (CtxJob){ fields, FIELDS, t, THREADS };
+    ASSERT(pthread_create(&tid[t], NULL, ctx_job, &job[t]) == 0);
+  }
+  for (int t = 0; t < THREADS; t++) pthread_join(tid[t], NULL);
+
+  // every field ends exactly where a serial run of its own script ends
+  for (int i = 0; i < FIELDS; i++) {
+    am_init_ctx(ref);
+    ctx_drive(ref, i);
+    ASSERT(memcmp(ref, fields[i], sizeof(AM_State)) == 0);
+    am_ctx_free(fields[i]);
+  }
+  am_ctx_free(ref);
+  free(fields);
+}
+
+TEST(schumann_ctx_matches_default) {
+  schumann_init();
+  Schumann_State* a = schumann_ctx_new();
+  Schumann_State* b = schumann_ctx_new();
+  ASSERT(a && b);
+
+  schumann_set_hz(7.81f);
+  schumann_set_hz_ctx(a, 7.81f);
+  schumann_set_hz_ctx(b, 8.2f);
+  schumann_set_modulation_ctx(b, 0.9f);
+  for (int t = 0; t < 40; t++) {
+    schumann_step(0.013f);
+    schumann_step_ctx(a, 0.013f);
+    schumann_step_ctx(b, 0.5f);
+  }
+  float s0[8], sa[8], sb[8];
+  schumann_copy_state(s0);
+  ASSERT_EQ(schumann_copy_state_ctx(a, sa), 0);
+  ASSERT_EQ(schumann_copy_state_ctx(b, sb), 0);
+  ASSERT(memcmp(s0, sa, sizeof(s0)) == 0);
+  ASSERT(sb[0] != sa[0] && sb[2] != sa[2]);
+  ASSERT_FLOAT_EQ(schumann_modulate_ctx(a, 1.0f), schumann_modulate(1.0f), 1e-9f);
+  ASSERT(schumann_copy_state_ctx(NULL, sb) != 0);
+
+  schumann_ctx_free(a);
+  schumann_ctx_free(b);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// SECTION E: PROGRAMS — am_compile + am_run against the interpreter
+// ═══════════════════════════════════════════════════════════════════════════════
+
+static const char* prog_words[] = {
+  "PROPHECY", "DESTINY", "WORMHOLE", "CALENDAR_DRIFT", "ATTEND_FOCUS", "ATTEND_SPREAD",
+  "TUNNEL_THRESHOLD", "TUNNEL_CHANCE", "TUNNEL_SKIP_MAX", "PAIN", "TENSION", "DISSONANCE",
+  "JUMP", "VELOCITY", "BASE_TEMP", "RESET_FIELD", "RESET_DEBT", "LAW", "MODE", "IMPORT",
+  "DISABLE", "CHORDLOCK", "TEMPOLOCK", "CHIRALITY", "TEMPO", "PAS_THRESHOLD", "ANCHOR",
+  "GRAVITY", "ANTIDOTE", "COSMIC_COHERENCE", "CODES.CHORDLOCK", "RIC.TEMPO",
+  "CODES.PAS_THRESHOLD", "RIC.NOPE", "CODES.", "PROPHECYX", "JUM", "#PAIN", "LAW_",
+};
+
+static const char* prog_args[] = {
+  "", "0", "1", "-3", "7", "64", "65", "0.5", "0.99", "1.5", "-0.2", "nan", "inf",
+  "2147483647", "-2147483648", "abc", "ON", "on", "OFF", "1", "RUN", "walk", "NoMove",
+  "BACKWARD", "2", "CODES_RIC", "codes/ric", "DARKMATTER", "dark_matter", "NOTORCH",
+  "ENTROPY_FLOOR 1.5", "RESONANCE_CEILING 2", "debt_decay 0.5", "EMERGENCE_THRESHOLD 0.7",
+  "UNKNOWN_LAW 3", "DEBT_DECAY", "DARK 0.8", "DARK", "dark 2.5", "LIGHT 0.3", "PRIME",
+  "prime", "AUTO", "HARD", "ON trailing", "  0.25  ", "0.1 0.2",
+};
+
+#define N_PROG_WORDS ((int)(sizeof(prog_words) / sizeof(prog_words[0])))
+#define N_PROG_ARGS ((int)(sizeof(prog_args) / sizeof(prog_args[0])))
+
+// A random script over the kernel's vocabulary: mixed case, odd spacing,
+// comments and blank lines, gated commands before and after their packs
+static void prog_script(char* out, size_t cap, unsigned* seed) {
+  size_t len = 0;
+  int lines = 1 + (int)(*seed % 24);
+  out[0] = 0;
+  for (int l = 0; l < lines && len + 128 < cap; l++) {
+    *seed = *seed * 1103515245u + 12345u;
+    unsigned r = *seed >> 8;
+    char word[32];
+    snprintf(word, sizeof(word), "%s", prog_words[r % N_PROG_WORDS]);
+    if (r & 0x100) {
+      for (char* c = word; *c; c++) *c = (char)tolower((unsigned char)*c);
+    }
+    const char* pad = (r & 0x200) ? " \t " : " ";
+    if ((r & 0x7000) == 0x7000) {
+      len += (size_t)snprintf(out + len, cap - len, "\n# note\n");
+    }
+    len += (size_t)snprintf(out + len, cap - len, "%s%s%s%s\n", (r & 0x400) ? "  " : "",
+                            word, pad, prog_args[(r >> 12) % N_PROG_ARGS]);
+  }
+}
+
+TEST(program_matches_exec_fuzz) {
+  AM_State* a = am_ctx_new();
+  AM_State* b = am_ctx_new();
+  ASSERT(a && b);
+  char script[4096];
+  unsigned seed = 2024;
+  for (int trial = 0; trial < 5000; trial++) {
+    prog_script(script, sizeof(script), &seed);
+
+    // start from the same field: sometimes with packs on, mid-movement
+    am_init_ctx(a);
+    if (trial & 1) am_exec_ctx(a, "MODE CODES_RIC\nVELOCITY BACKWARD\nJUMP 3");
+    if (trial & 2) am_enable_pack_ctx(a, AM_PACK_DARKMATTER);
+    memcpy(b, a, sizeof(AM_State));
+
+    AM_Program* prog = am_compile(script);
+    ASSERT(prog != NULL);
+    ASSERT_EQ(am_exec_ctx(a, script), am_run_ctx(b, prog));
+    ASSERT(memcmp(a, b, sizeof(AM_State)) == 0);
+    am_program_free(prog);
+  }
+  am_ctx_free(a);
+  am_ctx_free(b);
+}
+
+TEST(program_reuse_across_runs_and_fields) {
+  const char* script =
+    "JUMP 7\n"
+    "velocity backward\n"
+    "TENSION 0.4\n"
+    "tempo 13\n"            // ignored until the pack is on
+    "RIC.CHIRALITY on\n"
+    "TEMPO 13\n"
+    "LAW DEBT_DECAY 0.95";
+  AM_Program* prog = am_compile(script);
+  ASSERT(prog != NULL);
+
+  // one program, many runs: state carries over exactly as with am_exec
+  AM_State* ref = am_ctx_new();
+  AM_State* f[3] = { am_ctx_new(), am_ctx_new(), am_ctx_new() };
+  ASSERT(ref && f[0] && f[1] && f[2]);
+  for (int r = 0; r < 200; r++) {
+    am_exec_ctx(ref, script);
+    am_step_ctx(ref, 0.1f);
+    for (int i = 0; i < 3; i++) {
+      ASSERT_EQ(am_run_ctx(f[i], prog), 0);
+      am_step_ctx(f[i], 0.1f);
+    }
+  }
+  for (int i = 0; i < 3; i++) ASSERT(memcmp(ref, f[i], sizeof(AM_State)) == 0);
+  ASSERT_EQ(ref->pending_jump, 1000);
+  ASSERT_EQ(ref->tempo, 13);
+
+  // the default field through am_run
+  am_init();
+  am_init_ctx(ref);
+  ASSERT_EQ(am_run(prog), 0);
+  am_exec_ctx(ref, script);
+  ASSERT(memcmp(ref, am_get_state(), sizeof(AM_State)) == 0);
+
+  ASSERT(am_run_ctx(NULL, prog) != 0 && am_run_ctx(ref, NULL) != 0);
+  for (int i = 0; i < 3; i++) am_ctx_free(f[i]);
+  am_ctx_free(ref);
+  am_program_free(prog);
+}
 
+TEST(program_is_compact) {
+  AM_Program* prog = am_compile(
+    "# header\n\n"
+    "PROPHECY 9\n"
+    "UNKNOWN 1\n"
+    "LAW NOPE 3\n"
+    "MODE NOTHING\n"
+    "CODES.TEMPO 5\n"        // pack on + tempo
+    "ANCHOR LOOSE\n"
+    "GRAVITY LIGHT 0.2\n");
+  ASSERT(prog != NULL);
+  ASSERT_EQ(am_program_len(prog), 3);
+  am_program_free(prog);
+
+  AM_Program* empty[3] = { am_compile(NULL), am_compile(""), am_compile(" \n# x\n\n") };
+  for (int i = 0; i < 3; i++) {
+    ASSERT(empty[i] != NULL);
+    ASSERT_EQ(am_program_len(empty[i]), 0);
+    am_program_free(empty[i]);
+  }
+  ASSERT_EQ(am_program_len(NULL), 0);
+  am_program_free(NULL);
+}
+
+TEST(command_hash_is_perfect) {
+  int seen = 0;
+  for (int slot = 0; slot < (1 << AM_CMD_HASH_BITS); slot++) {
+    const char* name = am_cmd_table[slot].name;
+    if (!name) continue;
+    seen++;
+    ASSERT_EQ((int)am_cmd_hash(name), slot);
+    ASSERT_EQ(am_cmd_lookup(name), am_cmd_table[slot].cmd);
+  }
+  ASSERT_EQ(seen, AM_CMD_COUNT);
+
+  // the table holds exactly the AM_COMMANDS list, each under its own id
+  static const char* names[AM_CMD_COUNT] = {
+#define AM_CMD_NAME(name) #name,
+    AM_COMMANDS(AM_CMD_NAME)
+#undef AM_CMD_NAME
+  };
+  for (int c = 0; c < AM_CMD_COUNT; c++) ASSERT_EQ(am_cmd_lookup(names[c]), c);
+
+  // near misses miss (lookups see upcased words)
+  const char* misses[] = { "", "PROPHEC", "PROPHECYY", "prophecy", "CODES.TEMPO", "TEMP", "LAWS" };
+  for (size_t i = 0; i < sizeof(misses) / sizeof(misses[0]); i++) {
+    ASSERT_EQ(am_cmd_lookup(misses[i]), -1);
+  }
+}
+
+// Informational: per-frame cost of a typical snippet, interpreter vs program
+static void report_program_speed(void) {
+  const char* script =
+    "VELOCITY RUN\nDESTINY 0.42\nWORMHOLE 0.19\nPAIN 0.33\nTENSION 0.2\n"
+    "ATTEND_FOCUS 0.8\nJUMP 1\nLAW ENTROPY_FLOOR 0.2\nCODES.TEMPO 11\nCHORDLOCK ON";
+  enum { FRAMES = 200000 };
+  AM_State* f = am_ctx_new();
+  AM_Program* prog = am_compile(script);
+  if (!f || !prog) return;
+
+  size_t len = strlen(script);
+  clock_t t0 = clock();
+  for (int i = 0; i < FRAMES; i++) am_exec_ctx(f, script);
+  clock_t t1 = clock();
+  for (int i = 0; i < FRAMES; i++) am_run_ctx(f, prog);
+  clock_t t2 = clock();
+  for (int i = 0; i < FRAMES; i++) am_exec_n_ctx(f, script, len);
+  clock_t t3 = clock();
+
+  double exec_ns = 1e9 * (double)(t1 - t0) / CLOCKS_PER_SEC / FRAMES;
+  double run_ns = 1e9 * (double)(t2 - t1) / CLOCKS_PER_SEC / FRAMES;
+  double exec_n_ns = 1e9 * (double)(t3 - t2) / CLOCKS_PER_SEC / FRAMES;
+  printf("  10-line snippet: am_exec %.0f ns, am_exec_n %.0f ns, am_run %.0f ns (%.0fx)\n",
+         exec_ns, exec_n_ns, run_ns, run_ns > 0.0 ? exec_ns / run_ns : 0.0);
+  am_program_free(prog);
+  am_ctx_free(f);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// SECTION F: EXEC_N — length-delimited scripts, read in place
+// ═══════════════════════════════════════════════════════════════════════════════
+
+TEST(exec_n_matches_exec_on_windows) {
+  AM_State* a = am_ctx_new();
+  AM_State* b = am_ctx_new();
+  ASSERT(a && b);
+  char script[4096], window[4096];
+  unsigned seed = 4242;
+  for (int trial = 0; trial < 3000; trial++) {
+    prog_script(script, sizeof(script), &seed);
+    size_t n = strlen(script);
+
+    // any window of the text, cut mid-line or mid-word as a ring buffer would
+    size_t lo = (trial & 1) ? (seed >> 4) % (n + 1) : 0;
+    size_t hi = lo + (seed >> 12) % (n - lo + 1);
+    memcpy(window, script + lo, hi - lo);
+    window[hi - lo] = 0;
+
+    am_init_ctx(a);
+    if (trial & 2) am_exec_ctx(a, "MODE CODES_RIC\nIMPORT DARKMATTER\nVELOCITY BACKWARD");
+    memcpy(b, a, sizeof(AM_State));
+    ASSERT_EQ(am_exec_ctx(a, window), am_exec_n_ctx(b, script + lo, hi - lo));
+    ASSERT(memcmp(a, b, sizeof(AM_State)) == 0);
+  }
+
+  // a NUL inside the span ends the script, as for a C string
+  am_init_ctx(a);
+  am_init_ctx(b);
+  am_exec_ctx(a, "PROPHECY 9");
+  ASSERT_EQ(am_exec_n_ctx(b, "PROPHECY 9\0DESTINY 0.9", 22), 0);
+  ASSERT(memcmp(a, b, sizeof(AM_State)) == 0);
+
+  ASSERT_EQ(am_exec_n_ctx(b, NULL, 5), 0);
+  ASSERT_EQ(am_exec_n_ctx(b, "PROPHECY 3", 0), 0);
+  ASSERT_EQ(b->prophecy, 9);
+  ASSERT(am_exec_n_ctx(NULL, "PROPHECY 3", 10) != 0);
+  am_ctx_free(a);
+  am_ctx_free(b);
+}
+
+// The script ends exactly at a read-only page followed by an inaccessible
+// one: a write to the input or a read past len faults
+TEST(exec_n_reads_in_place) {
+  long page = sysconf(_SC_PAGESIZE);
+  char* mem = (char*)mmap(NULL, (size_t)page * 2, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  ASSERT(mem != MAP_FAILED);
+  const char* script =
+    "  prophecy 21\n"
+    "# comment\n"
+    "\tVELOCITY run \r\n"
+    "CODES.TEMPO 13\n"
+    "LAW ENTROPY_FLOOR 0.4\n"
+    "JUMP 6";                      // no newline, no terminator
+  size_t n = strlen(script);
+  char* buf = mem + page - n;
+  memcpy(buf, script, n);
+  ASSERT(mprotect(mem, (size_t)page, PROT_READ) == 0);
+  ASSERT(mprotect(mem + page, (size_t)page, PROT_NONE) == 0);
+
+  AM_State* ref = am_ctx_new();
+  AM_State* f = am_ctx_new();
+  ASSERT(ref && f);
+  am_exec_ctx(ref, script);
+  for (int r = 0; r < 3; r++) ASSERT_EQ(am_exec_n_ctx(f, buf, n), 0);
+  am_exec_ctx(ref, script);
+  am_exec_ctx(ref, script);
+  ASSERT(memcmp(ref, f, sizeof(AM_State)) == 0);
+  ASSERT_EQ(f->prophecy, 21);
+  ASSERT_EQ(f->tempo, 13);
+  ASSERT_EQ(f->pending_jump, 18);
+
+  // the default field, and a window ending mid-number ("JUMP " with no digit)
+  am_init();
+  ASSERT_EQ(am_exec_n(buf, n - 1), 0);
+  ASSERT_EQ(am_get_state()->pending_jump, 0);
+  ASSERT_EQ(am_get_state()->velocity_mode, AM_VEL_RUN);
+
+  am_ctx_free(ref);
+  am_ctx_free(f);
+  munmap(mem, (size_t)page * 2);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// SECTION G: BATCHES — many fields as a struct of arrays
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// A field somewhere along its life: script, packs, steps, odd coherence
+static void batch_field(AM_State* f, int i, unsigned* seed) {
+  char script[4096];
+  am_init_ctx(f);
+  if (i % 3 == 0) am_exec_ctx(f, "VELOCITY BACKWARD\nMODE CODES_RIC");
+  if (i % 5 == 0) am_exec_ctx(f, "IMPORT DARKMATTER\nLAW DEBT_DECAY 0.93");
+  prog_script(script, sizeof(script), seed);
+  am_exec_ctx(f, script);
+  f->debt = (float)(i % 37) * 3.5f;             // some above the cap
+  f->temporal_debt = (float)(i % 13) * 0.9f;
+  f->cosmic_coherence_ref = (float)(i % 9) * 0.25f - 0.5f;  // ≤ 0 skips healing
+  f->tension = 0.05f * (float)(i % 20);
+  f->dissonance = 0.9f - 0.04f * (float)(i % 20);
+}
+
+// Every lane of b equals its twin in f[]
+static int batch_matches(const AM_Batch* b, const AM_State* f, int n) {
+  for (int i = 0; i < n; i++) {
+    AM_State s;
+    if (am_batch_get(b, i, &s) != 0 || memcmp(&s, &f[i], sizeof(AM_State)) != 0) return 0;
+  }
+  return 1;
+}
+
+TEST(batch_defaults_and_roundtrip) {
+  enum { N = 13 };
+  AM_Batch* b = am_batch_new(N);
+  ASSERT(b != NULL && am_batch_size(b) == N);
+  AM_State d, s;
+  am_init_ctx(&d);
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(am_batch_get(b, i, &s), 0);
+    ASSERT(memcmp(&s, &d, sizeof(AM_State)) == 0);
+  }
+
+  unsigned seed = 77;
+  AM_State f[N];
+  for (int i = 0; i < N; i++) {
+    batch_field(&f[i], i, &seed);
+    ASSERT_EQ(am_batch_set(b, i, &f[i]), 0);
+  }
+  ASSERT(batch_matches(b, f, N));
+
+  ASSERT(am_batch_set(b, N, &d) != 0 && am_batch_get(b, -1, &s) != 0);
+  ASSERT(am_batch_set(NULL, 0, &d) != 0 && am_batch_get(b, 0, NULL) != 0);
+  ASSERT(am_batch_new(0) == NULL && am_batch_size(NULL) == 0);
+
+  // the column block would overflow a 32-bit size_t: refused, not wrapped
+  size_t lane_bytes = AM_STATE_WORDS * sizeof(uint32_t);
+  int too_many = (int)(((size_t)UINT32_MAX / lane_bytes + 8) & ~(size_t)7);
+  ASSERT(am_batch_new(too_many) == NULL && am_batch_new(INT_MAX) == NULL);
+  am_batch_free(b);
+  am_batch_free(NULL);
+}
+
+TEST(batch_step_matches_single) {
+  enum { N = 1003 };  // not a multiple of the vector width
+  static AM_State f[N];
+  static const float dts[] = { 0.016f, 0.5f, 0.0f, -0.1f, 0.016f, 3.0f };
+  for (int simd = 0; simd <= 1; simd++) {
+    AM_Batch* b = am_batch_new(N);
+    ASSERT(b != NULL);
+    if (!simd) b->avx2 = 0;   // scalar loop, then whatever the CPU has
+    unsigned seed = 91;
+    for (int i = 0; i < N; i++) {
+      batch_field(&f[i], i, &seed);
+      am_batch_set(b, i, &f[i]);
+    }
+    for (int t = 0; t < 300; t++) {
+      float dt = dts[t % 6];
+      am_step_batch(b, dt);
+      for (int i = 0; i < N; i++) am_step_ctx(&f[i], dt);
+    }
+    ASSERT(batch_matches(b, f, N));
+    am_batch_free(b);
+  }
+}
+
+TEST(batch_exec_matches_single) {
+  enum { N = 257 };
+  static AM_State f[N];
+  AM_Batch* b = am_batch_new(N);
+  ASSERT(b != NULL);
+  unsigned seed = 131;
+  for (int i = 0; i < N; i++) {
+    batch_field(&f[i], i, &seed);
+    am_batch_set(b, i, &f[i]);
+  }
+
+  // one script for every field; gates differ per field
+  char script[4096];
+  for (int trial = 0; trial < 200; trial++) {
+    prog_script(script, sizeof(script), &seed);
+    ASSERT_EQ(am_exec_batch(b, script), 0);
+    for (int i = 0; i < N; i++) am_exec_ctx(&f[i], script);
+    am_step_batch(b, 0.05f);
+    for (int i = 0; i < N; i++) am_step_ctx(&f[i], 0.05f);
+    ASSERT(batch_matches(b, f, N));
+  }
+
+  AM_Program* prog = am_compile("JUMP 2\nCHORDLOCK ON\nRESET_DEBT");
+  ASSERT(prog != NULL);
+  ASSERT_EQ(am_run_batch(b, prog), 0);
+  for (int i = 0; i < N; i++) am_run_ctx(&f[i], prog);
+  ASSERT(batch_matches(b, f, N));
+  ASSERT(am_run_batch(b, NULL) != 0 && am_run_batch(NULL, prog) != 0);
+  ASSERT(am_exec_batch(NULL, "JUMP 1") != 0);
+  am_program_free(prog);
+  am_batch_free(b);
+}
+
+// One thread creates, fills and steps its own batch
+typedef struct {
+  AM_State* fields;
+  int n;
+  AM_Batch* batch;
+} BatchJob;
+
+static void* batch_job(void* arg) {
+  BatchJob* job = (BatchJob*)arg;
+  job->batch = am_batch_new(job->n);
+  if (!job->batch) return NULL;
+  for (int i = 0; i < job->n; i++) am_batch_set(job->batch, i, &job->fields[i]);
+  for (int t = 0; t < 200; t++) am_step_batch(job->batch, 0.02f * (float)(1 + t % 3));
+  return NULL;
+}
+
+TEST(batch_step_on_threads) {
+  enum { T = 8, N = 301 };
+  static AM_State f[T][N];
+  BatchJob job[T];
+  unsigned seed = 171;
+  for (int j = 0; j < T; j++) {
+    for (int i = 0; i < N; i++) batch_field(&f[j][i], i, &seed);
+    job[j] = (BatchJob){ f[j], N, NULL };
+  }
+
+  // batches on different threads share no state, the CPU check included
+  pthread_t tid[T];
+  for (int j = 0; j < T; j++) ASSERT(pthread_create(&tid[j], NULL, batch_job, &job[j]) == 0);
+  for (int j = 0; j < T; j++) pthread_join(tid[j], NULL);
+
+  for (int j = 0; j < T; j++) {
+    ASSERT(job[j].batch != NULL);
+    for (int i = 0; i < N; i++) {
+      for (int t = 0; t < 200; t++) am_step_ctx(&f[j][i], 0.02f * (float)(1 + t % 3));
+    }
+    ASSERT(batch_matches(job[j].batch, f[j], N));
+    am_batch_free(job[j].batch);
+  }
+}
+
+// Informational: 10k fields per frame, one struct at a time vs the batch
+static void report_batch_speed(void) {
+  enum { N = 10000, FRAMES = 200 };
+  AM_State* f = (AM_State*)malloc(N * sizeof(AM_State));
+  AM_Batch* b = am_batch_new(N);
+  if (!f || !b) {
+    free(f);
+    am_batch_free(b);
+    return;
+  }
+  unsigned seed = 5;
+  for (int i = 0; i < N; i++) {
+    batch_field(&f[i], i, &seed);
+    am_batch_set(b, i, &f[i]);
+  }
+
+  clock_t t0 = clock();
+  for (int t = 0; t < FRAMES; t++) {
+    for (int i = 0; i < N; i++) am_step_ctx(&f[i], 0.016f);
+  }
+  clock_t t1 = clock();
+  for (int t = 0; t < FRAMES; t++) am_step_batch(b, 0.016f);
+  clock_t t2 = clock();
+
+  double single_us = 1e6 * (double)(t1 - t0) / CLOCKS_PER_SEC / FRAMES;
+  double batch_us = 1e6 * (double)(t2 - t1) / CLOCKS_PER_SEC / FRAMES;
+  printf("  step %d fields: am_step_ctx loop %.1f us, am_step_batch %.1f us (%.1fx)\n",
+         N, single_us, batch_us, batch_us > 0.0 ? single_us / batch_us : 0.0);
+  free(f);
+  am_batch_free(b);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// MAIN — run all tests
+// ═══════════════════════════════════════════════════════════════════════════════
+
+static void run_kernel_sections(void) {
   printf("SECTION A: Kernel Tests\n");
   printf("───────────────────────────────────────────────────────────────────────────────\n");
 
@@ -838,6 +1480,60 @@ int main(void) {
   RUN(api_function_pointers);
   RUN(kernel_usable_without_packs);
   RUN(unknown_commands_ignored);
+}
+
+int main(void) {
+  srand((unsigned)time(NULL));
+
+  printf("\n");
+  printf("═══════════════════════════════════════════════════════════════════════════════\n");
+  printf(" AMK KERNEL TESTS — brutal, Stanley-style\n");
+  printf(" \"make it hurt\"\n");
+  printf("═══════════════════════════════════════════════════════════════════════════════\n\n");
+
+  run_kernel_sections();
+
+  printf("\nSECTIONS A-C AGAIN: every case through am_compile + am_run\n");
+  exec_path = PATH_PROGRAM;
+  run_kernel_sections();
+
+  printf("\nSECTIONS A-C AGAIN: every case through am_exec_n\n");
+  exec_path = PATH_EXEC_N;
+  run_kernel_sections();
+  exec_path = PATH_EXEC;
+
+  printf("\nSECTION D: Contexts\n");
+  printf("───────────────────────────────────────────────────────────────────────────────\n");
+
+  RUN(ctx_new_matches_init);
+  RUN(ctx_fields_are_independent);
+  RUN(ctx_matches_default_field);
+  RUN(ctx_thousands_of_fields_on_threads);
+  RUN(schumann_ctx_matches_default);
+
+  printf("\nSECTION E: Programs\n");
+  printf("───────────────────────────────────────────────────────────────────────────────\n");
+
+  RUN(program_matches_exec_fuzz);
+  RUN(program_reuse_across_runs_and_fields);
+  RUN(program_is_compact);
+  RUN(command_hash_is_perfect);
+  report_program_speed();
+
+  printf("\nSECTION F: Length-delimited Scripts\n");
+  printf("───────────────────────────────────────────────────────────────────────────────\n");
+
+  RUN(exec_n_matches_exec_on_windows);
+  RUN(exec_n_reads_in_place);
+
+  printf("\nSECTION G: Batches\n");
+  printf("───────────────────────────────────────────────────────────────────────────────\n");
+
+  RUN(batch_defaults_and_roundtrip);
+  RUN(batch_step_matches_single);
+  RUN(batch_exec_matches_single);
+  RUN(batch_step_on_threads);
+  report_batch_speed();
 
   // Summary
   printf("\n");
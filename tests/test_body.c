@@ -0,0 +1,3207 @@
+// test_body.c — native AriannaLung tests (body.c)
+// "the lung must breathe the same, however it is folded"
+//
+// Build: gcc -O2 -std=gnu99 tests/test_body.c -lm -lpthread -o test_body
+// Run:   ./test_body
+// TSan:  gcc -O1 -g -fsanitize=thread -std=gnu99 tests/test_body.c -lm -lpthread
+//
+// ═══════════════════════════════════════════════════════════════════════════════
+// These tests prove:
+// - Optimized forward paths match the reference path within float tolerance
+// - Inference state stays sane (probs sum to 1, entropy bounded)
+// - Batched forward leaves the single-context state alone
+// - Threaded forward is bit-identical to serial
+// - Quantized weights stay within a KL bound of the float lung
+// - Native sampling draws from the exact filtered, tempered distribution
+// - Prophecy rollouts and beam search match full forwards step for step
+// - Lazy presence decay matches the eager per-forward sweep
+// - Length-aware attention equals the lung cut to the real context
+// - Sparse attention equals dense attention under the same mask
+// - Grouped-query attention equals multi-head with repeated K/V heads
+// - Shortlist logits keep the top tokens and estimate the mass left out
+// - Sessions on shared weights breathe exactly like private lungs
+// - Lungs created on many threads get exactly the weights of serial creation
+// הרזוננס לא נשבר. המשך הדרך.
+// ═══════════════════════════════════════════════════════════════════════════════
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+// calloc failure injection: the n-th body.c calloc from now fails when
+// calloc_fail_in is set to n (0 = off)
+static int calloc_fail_in = 0;
+
+static void* test_calloc(size_t n, size_t size) {
+  if (calloc_fail_in > 0 && --calloc_fail_in == 0) return NULL;
+  return calloc(n, size);
+}
+
+// Include the body directly for testing (static helpers visible)
+#define calloc test_calloc
+#include "../wasm/body.c"
+#undef calloc
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// TEST FRAMEWORK — minimal, brutal (same as test_amk.c)
+// ═══════════════════════════════════════════════════════════════════════════════
+
+static int tests_run = 0;
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) static void test_##name(void)
+#define RUN(name) do { \
+  printf("  [%03d] %-50s ", ++tests_run, #name); \
+  fflush(stdout); \
+  int before_failed = tests_failed; \
+  test_##name(); \
+  if (tests_failed == before_failed) { printf("✓\n"); tests_passed++; } \
+} while(0)
+
+#define ASSERT(cond) do { \
+  if (!(cond)) { \
+    printf("✗ FAILED at line %d: %s\n", __LINE__, #cond); \
+    tests_failed++; \
+    return; \
+  } \
+} while(0)
+
+#define ASSERT_FLOAT_EQ(a, b, eps) ASSERT(fabsf((a) - (b)) < (eps))
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// HELPERS
+// ═══════════════════════════════════════════════════════════════════════════════
+
+static float max_abs_diff(const float* a, const float* b, int n) {
+  float m = 0.0f;
+  for (int i = 0; i < n; i++) {
+    float d = fabsf(a[i] - b[i]);
+    if (d > m) m = d;
+  }
+  return m;
+}
+
+static void fill_context(int* ctx, int n, int vocab, unsigned int seed) {
+  for (int i = 0; i < n; i++) {
+    seed = seed * 1103515245u + 12345u;
+    ctx[i] = (int)((seed >> 8) % (unsigned int)vocab);
+  }
+}
+
+// Current presence equals p exactly (lazy storage materialized)
+static int presence_matches(AriannaLung* lung, const float* p) {
+  float* now = (float*)malloc(lung->vocab_size * sizeof(float));
+  lung_copy_presence(lung, now);
+  int ok = memcmp(now, p, lung->vocab_size * sizeof(float)) == 0;
+  free(now);
+  return ok;
+}
+
+// Run one forward in the given attention mode, snapshotting the outputs.
+// Presence is restored afterwards so both modes see the same state.
+static float forward_snapshot(AriannaLung* lung, int fold, const int* context, int len,
+                              float* logits, float* probs, float* att) {
+  float* presence = (float*)malloc(lung->vocab_size * sizeof(float));
+  lung_copy_presence(lung, presence);
+
+  lung_set_folded_attention(lung, fold);
+  float entropy = lung_forward(lung, context, len);
+  memcpy(logits, lung_get_logits(lung), lung->vocab_size * sizeof(float));
+  memcpy(probs, lung_get_probs(lung), lung->vocab_size * sizeof(float));
+  memcpy(att, lung_get_attention(lung), lung->ctx_len * sizeof(float));
+
+  lung_load_presence(lung, presence);
+  free(presence);
+  return entropy;
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// SECTION A: LIFECYCLE & SANITY
+// ═══════════════════════════════════════════════════════════════════════════════
+
+TEST(create_destroy) {
+  lung_seed(42);
+  AriannaLung* lung = lung_create(64, 32, 16, 4);
+  ASSERT(lung != NULL);
+  ASSERT(lung_get_vocab_size(lung) == 64);
+  ASSERT(lung_get_d_model(lung) == 32);
+  ASSERT(lung_get_ctx_len(lung) == 16);
+  ASSERT(lung->fold_attention == 1);
+  lung_destroy(lung);
+}
+
+TEST(probs_normalized) {
+  lung_seed(7);
+  AriannaLung* lung = lung_create(128, 32, 12, 2);
+  ASSERT(lung != NULL);
+  int context[12];
+  fill_context(context, 12, 128, 3);
+
+  float entropy = lung_forward(lung, context, 12);
+  float sum = 0.0f;
+  for (int i = 0; i < 128; i++) sum += lung_get_probs(lung)[i];
+  ASSERT_FLOAT_EQ(sum, 1.0f, 1e-4f);
+  ASSERT(entropy > 0.0f && entropy <= logf(128.0f) + 1e-3f);
+
+  float att = 0.0f;
+  for (int t = 0; t < 12; t++) att += lung_get_attention(lung)[t];
+  ASSERT_FLOAT_EQ(att, 1.0f, 1e-4f);
+  lung_destroy(lung);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// SECTION B: FOLDED ATTENTION ≡ PER-POSITION K/V
+// ═══════════════════════════════════════════════════════════════════════════════
+
+static int folded_matches_unfolded(int vocab, int d, int ctx, int heads, int len,
+                                   int rtl, float alpha, unsigned int seed) {
+  lung_seed(seed);
+  AriannaLung* lung = lung_create(vocab, d, ctx, heads);
+  if (!lung) return 0;
+  lung_set_rtl(lung, rtl);
+  lung_set_temporal_alpha(lung, alpha);
+
+  int* context = (int*)malloc(ctx * sizeof(int));
+  fill_context(context, ctx, vocab, seed + 1);
+
+  float* la = (float*)malloc(vocab * sizeof(float));
+  float* pa = (float*)malloc(vocab * sizeof(float));
+  float* aa = (float*)malloc(ctx * sizeof(float));
+  float* lb = (float*)malloc(vocab * sizeof(float));
+  float* pb = (float*)malloc(vocab * sizeof(float));
+  float* ab = (float*)malloc(ctx * sizeof(float));
+
+  int ok = 1;
+  for (int step = 0; step < 3 && ok; step++) {
+    float ea = forward_snapshot(lung, 0, context, len, la, pa, aa);
+    float eb = forward_snapshot(lung, 1, context, len, lb, pb, ab);
+    if (fabsf(ea - eb) > 1e-4f) ok = 0;
+    if (max_abs_diff(la, lb, vocab) > 1e-4f) ok = 0;
+    if (max_abs_diff(pa, pb, vocab) > 1e-5f) ok = 0;
+    if (max_abs_diff(aa, ab, ctx) > 1e-5f) ok = 0;
+    // accumulate real presence between steps
+    lung_forward(lung, context, len);
+  }
+
+  free(context);
+  free(la); free(pa); free(aa);
+  free(lb); free(pb); free(ab);
+  lung_destroy(lung);
+  return ok;
+}
+
+TEST(folded_equiv_basic) {
+  ASSERT(folded_matches_unfolded(64, 32, 16, 4, 16, 0, 0.5f, 11));
+}
+
+TEST(folded_equiv_padded_context) {
+  ASSERT(folded_matches_unfolded(64, 32, 16, 4, 5, 0, 0.5f, 12));
+}
+
+TEST(folded_equiv_rtl_prophecy) {
+  ASSERT(folded_matches_unfolded(96, 48, 10, 3, 10, 1, 0.8f, 13));
+}
+
+TEST(folded_equiv_retrodiction) {
+  ASSERT(folded_matches_unfolded(50, 24, 7, 2, 7, 0, 0.1f, 14));
+}
+
+TEST(folded_equiv_wide) {
+  ASSERT(folded_matches_unfolded(500, 64, 32, 8, 32, 0, 0.6f, 15));
+}
+
+TEST(folded_equiv_focus_spread) {
+  lung_seed(21);
+  AriannaLung* lung = lung_create(80, 32, 12, 4);
+  ASSERT(lung != NULL);
+  lung_set_focus(lung, 1.0f);
+  lung_set_spread(lung, 0.0f);
+
+  int context[12];
+  fill_context(context, 12, 80, 22);
+  float la[80], pa[80], aa[12], lb[80], pb[80], ab[12];
+  float ea = forward_snapshot(lung, 0, context, 12, la, pa, aa);
+  float eb = forward_snapshot(lung, 1, context, 12, lb, pb, ab);
+  ASSERT_FLOAT_EQ(ea, eb, 1e-4f);
+  ASSERT(max_abs_diff(pa, pb, 80) < 1e-5f);
+  ASSERT(max_abs_diff(aa, ab, 12) < 1e-5f);
+  lung_destroy(lung);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// SECTION C: STREAMING CACHE ≡ FULL RECOMPUTE
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// Push n tokens one at a time; after each push the cached forward must match
+// lung_forward over the same window (presence restored between the two).
+static int stream_matches_full(int vocab, int d, int ctx, int heads, int n,
+                               int rtl, float alpha, unsigned int seed, int masked) {
+  lung_seed(seed);
+  AriannaLung* lung = lung_create(vocab, d, ctx, heads);
+  if (!lung) return 0;
+  lung_set_mask_padding(lung, masked);
+  lung_set_rtl(lung, rtl);
+  lung_set_temporal_alpha(lung, alpha);
+
+  int* tokens = (int*)malloc(n * sizeof(int));
+  fill_context(tokens, n, vocab, seed + 1);
+
+  float* presence = (float*)malloc(vocab * sizeof(float));
+  float* logits = (float*)malloc(vocab * sizeof(float));
+  float* probs = (float*)malloc(vocab * sizeof(float));
+  float* att = (float*)malloc(ctx * sizeof(float));
+
+  int ok = 1;
+  for (int i = 0; i < n && ok; i++) {
+    int len = lung_push_token(lung, tokens[i]);
+    int start = (i + 1 > ctx) ? i + 1 - ctx : 0;
+    if (len != i + 1 - start) { ok = 0; break; }
+
+    lung_copy_presence(lung, presence);
+    float ef = lung_forward(lung, tokens + start, len);
+    memcpy(logits, lung_get_logits(lung), vocab * sizeof(float));
+    memcpy(probs, lung_get_probs(lung), vocab * sizeof(float));
+    memcpy(att, lung_get_attention(lung), ctx * sizeof(float));
+    lung_load_presence(lung, presence);
+
+    float ec = lung_forward_cached(lung);
+    if (fabsf(ef - ec) > 1e-4f) ok = 0;
+    if (max_abs_diff(logits, lung_get_logits(lung), vocab) > 1e-4f) ok = 0;
+    if (max_abs_diff(probs, lung_get_probs(lung), vocab) > 1e-5f) ok = 0;
+    if (max_abs_diff(att, lung_get_attention(lung), ctx) > 1e-5f) ok = 0;
+  }
+
+  free(tokens); free(presence); free(logits); free(probs); free(att);
+  lung_destroy(lung);
+  return ok;
+}
+
+TEST(stream_equiv_fill) {
+  ASSERT(stream_matches_full(64, 32, 16, 4, 16, 0, 0.5f, 31, 0));
+}
+
+TEST(stream_equiv_sliding_ltr) {
+  ASSERT(stream_matches_full(64, 32, 8, 4, 40, 0, 0.7f, 32, 0));
+}
+
+TEST(stream_equiv_sliding_rtl) {
+  ASSERT(stream_matches_full(64, 32, 8, 4, 40, 1, 0.7f, 33, 0));
+}
+
+TEST(stream_equiv_uneven_heads) {
+  // d_model not divisible by n_heads: trailing dims stay unused
+  ASSERT(stream_matches_full(50, 30, 6, 4, 20, 0, 0.3f, 34, 0));
+}
+
+TEST(stream_rtl_toggle_midstream) {
+  lung_seed(35);
+  AriannaLung* lung = lung_create(40, 16, 6, 2);
+  ASSERT(lung != NULL);
+  int tokens[10];
+  fill_context(tokens, 10, 40, 36);
+  for (int i = 0; i < 10; i++) lung_push_token(lung, tokens[i]);
+
+  // positional tables exist for both directions, switching is free
+  lung_set_rtl(lung, 1);
+  float presence[40];
+  lung_copy_presence(lung, presence);
+  float ef = lung_forward(lung, tokens + 4, 6);
+  lung_load_presence(lung, presence);
+  float ec = lung_forward_cached(lung);
+  ASSERT_FLOAT_EQ(ef, ec, 1e-4f);
+  lung_destroy(lung);
+}
+
+TEST(stream_reset_clears_window) {
+  lung_seed(37);
+  AriannaLung* lung = lung_create(32, 16, 4, 2);
+  ASSERT(lung != NULL);
+  ASSERT(lung_forward_cached(lung) == 0.0f);  // nothing pushed yet
+  lung_push_token(lung, 3);
+  lung_push_token(lung, 5);
+  ASSERT(lung_get_stream_len(lung) == 2);
+  lung_stream_reset(lung);
+  ASSERT(lung_get_stream_len(lung) == 0);
+  ASSERT(lung_push_token(lung, 7) == 1);
+  ASSERT(lung->stream_tokens[0] == 7);
+  lung_destroy(lung);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// SECTION D: PACKED OUTPUT PROJECTION (WoT)
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// logits must equal Wo^T · y computed by the scalar column walk, before presence
+static int logits_match_wo(AriannaLung* lung, const int* context, int len) {
+  int vocab = lung->vocab_size;
+  lung_load_presence(lung, NULL);
+  lung_forward(lung, context, len);
+
+  float* ref = (float*)malloc(vocab * sizeof(float));
+  kern_mat_vec_t_scalar(ref, lung->Wo, lung->y, lung->d_model, vocab);
+  int ok = max_abs_diff(ref, lung_get_logits(lung), vocab) < 1e-4f;
+  free(ref);
+  return ok;
+}
+
+TEST(wo_packed_matches_column_walk) {
+  lung_seed(41);
+  AriannaLung* lung = lung_create(1000, 32, 8, 4);
+  ASSERT(lung != NULL);
+  int context[8];
+  fill_context(context, 8, 1000, 42);
+  ASSERT(logits_match_wo(lung, context, 8));
+  lung_destroy(lung);
+}
+
+TEST(wo_sync_after_raw_write) {
+  lung_seed(43);
+  AriannaLung* lung = lung_create(300, 24, 6, 2);
+  ASSERT(lung != NULL);
+  int context[6];
+  fill_context(context, 6, 300, 44);
+
+  // JS-style write through the accessor
+  float* Wo = lung_get_output_weights(lung);
+  for (int i = 0; i < 24 * 300; i++) Wo[i] = sinf((float)i * 0.37f) * 0.1f;
+  lung_sync_output_weights(lung);
+  ASSERT(logits_match_wo(lung, context, 6));
+  ASSERT(lung->WoT[5 * 24 + 3] == Wo[3 * 300 + 5]);
+  lung_destroy(lung);
+}
+
+TEST(wo_merge_output_lora) {
+  lung_seed(45);
+  AriannaLung* lung = lung_create(200, 16, 6, 2);
+  ASSERT(lung != NULL);
+  int context[6];
+  fill_context(context, 6, 200, 46);
+
+  enum { RANK = 3 };
+  float A[16 * RANK], B[RANK * 200];
+  for (int i = 0; i < 16 * RANK; i++) A[i] = cosf((float)i) * 0.2f;
+  for (int i = 0; i < RANK * 200; i++) B[i] = sinf((float)i * 0.11f) * 0.2f;
+
+  float before = lung->Wo[7 * 200 + 9];
+  float delta = 0.0f;
+  for (int r = 0; r < RANK; r++) delta += A[7 * RANK + r] * B[r * 200 + 9];
+
+  lung_merge_output_lora(lung, A, B, RANK, 0.5f);
+  ASSERT_FLOAT_EQ(lung->Wo[7 * 200 + 9], before + 0.5f * delta, 1e-5f);
+  ASSERT(lung->WoT[9 * 16 + 7] == lung->Wo[7 * 200 + 9]);
+  ASSERT(logits_match_wo(lung, context, 6));
+  lung_destroy(lung);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// SECTION E: PACKED FUSED QKV
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// Same lung, same context: packed and separate layouts must agree in both
+// attention modes
+static int packed_matches_separate(int vocab, int d, int ctx, int heads, unsigned int seed) {
+  lung_seed(seed);
+  AriannaLung* lung = lung_create(vocab, d, ctx, heads);
+  if (!lung) return 0;
+  int* context = (int*)malloc(ctx * sizeof(int));
+  fill_context(context, ctx, vocab, seed + 1);
+
+  float* l0 = (float*)malloc(vocab * sizeof(float));
+  float* p0 = (float*)malloc(vocab * sizeof(float));
+  float* a0 = (float*)malloc(ctx * sizeof(float));
+  float* l1 = (float*)malloc(vocab * sizeof(float));
+  float* p1 = (float*)malloc(vocab * sizeof(float));
+  float* a1 = (float*)malloc(ctx * sizeof(float));
+
+  int ok = 1;
+  for (int fold = 0; fold <= 1 && ok; fold++) {
+    lung_set_packed_qkv(lung, 0);
+    float e0 = forward_snapshot(lung, fold, context, ctx, l0, p0, a0);
+    if (!lung_set_packed_qkv(lung, 1) || !lung->packed_qkv) ok = 0;
+    float e1 = forward_snapshot(lung, fold, context, ctx, l1, p1, a1);
+    if (fabsf(e0 - e1) > 1e-4f) ok = 0;
+    if (max_abs_diff(p0, p1, vocab) > 1e-5f) ok = 0;
+    if (max_abs_diff(a0, a1, ctx) > 1e-5f) ok = 0;
+  }
+
+  free(context);
+  free(l0); free(p0); free(a0); free(l1); free(p1); free(a1);
+  lung_destroy(lung);
+  return ok;
+}
+
+TEST(packed_qkv_equiv) {
+  ASSERT(packed_matches_separate(64, 32, 12, 4, 51));
+}
+
+TEST(packed_qkv_equiv_unaligned_dim) {
+  // d_model = 30 pads rows to 32; 4 heads leave trailing dims unused
+  ASSERT(packed_matches_separate(50, 30, 7, 4, 52));
+}
+
+TEST(packed_qkv_layout_and_roundtrip) {
+  lung_seed(53);
+  AriannaLung* lung = lung_create(40, 20, 6, 2);
+  ASSERT(lung != NULL);
+  float before[3][20 * 20], after[3][20 * 20];
+  for (int m = 0; m < 3; m++) ASSERT(lung_copy_qkv_weights(lung, m, before[m]));
+
+  ASSERT(lung_set_packed_qkv(lung, 1));
+  ASSERT(lung->Wq == NULL && lung->Wqkv != NULL);
+  ASSERT(((uintptr_t)lung->Wqkv % 64) == 0);
+  ASSERT(lung->qkv_stride == 32);
+  // head 1, row 2: q, k, v rows sit next to each other
+  ASSERT(lung->Wqkv[((10 + 2) * 3 + 1) * 32 + 5] == before[1][12 * 20 + 5]);
+
+  for (int m = 0; m < 3; m++) {
+    ASSERT(lung_copy_qkv_weights(lung, m, after[m]));
+    ASSERT(memcmp(before[m], after[m], sizeof(before[m])) == 0);
+  }
+
+  ASSERT(lung_set_packed_qkv(lung, 0));
+  ASSERT(lung->Wqkv == NULL && lung->Wq != NULL);
+  ASSERT(memcmp(before[2], lung->Wv, sizeof(before[2])) == 0);
+  ASSERT(lung_copy_qkv_weights(lung, 3, after[0]) == 0);
+  lung_destroy(lung);
+}
+
+TEST(packed_qkv_stream_and_reload) {
+  lung_seed(54);
+  AriannaLung* lung = lung_create(60, 32, 8, 4);
+  ASSERT(lung != NULL);
+  ASSERT(lung_set_packed_qkv(lung, 1));
+  int tokens[12];
+  fill_context(tokens, 12, 60, 55);
+  for (int i = 0; i < 12; i++) lung_push_token(lung, tokens[i]);
+
+  // new Wk through the accessor: cached rows must be re-projected
+  float wk[32 * 32];
+  for (int i = 0; i < 32 * 32; i++) wk[i] = cosf((float)i * 0.7f) * 0.08f;
+  ASSERT(lung_load_qkv_weights(lung, 1, wk));
+
+  float presence[60];
+  lung_copy_presence(lung, presence);
+  float ef = lung_forward(lung, tokens + 4, 8);
+  lung_load_presence(lung, presence);
+  float ec = lung_forward_cached(lung);
+  ASSERT_FLOAT_EQ(ef, ec, 1e-4f);
+  lung_destroy(lung);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// SECTION F: BATCHED FORWARD ≡ ONE CONTEXT AT A TIME
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// B contexts (mixed lengths) through lung_forward_batch_ex vs lung_forward
+// one by one with presence restored; last_* and presence must be untouched
+static int batch_matches_single(AriannaLung* lung, int B) {
+  int vocab = lung->vocab_size, ctx = lung->ctx_len;
+  int* contexts = (int*)malloc((size_t)B * ctx * sizeof(int));
+  int* lens = (int*)malloc(B * sizeof(int));
+  float* logits = (float*)malloc((size_t)B * vocab * sizeof(float));
+  float* probs = (float*)malloc((size_t)B * vocab * sizeof(float));
+  float* att = (float*)malloc((size_t)B * ctx * sizeof(float));
+  float* ent = (float*)malloc(B * sizeof(float));
+  float* l1 = (float*)malloc(vocab * sizeof(float));
+  float* p1 = (float*)malloc(vocab * sizeof(float));
+  float* a1 = (float*)malloc(ctx * sizeof(float));
+  float* last_probs = (float*)malloc(vocab * sizeof(float));
+  float* presence = (float*)malloc(vocab * sizeof(float));
+
+  fill_context(contexts, B * ctx, vocab, 71u + B);
+  for (int b = 0; b < B; b++) lens[b] = (b * 5) % (ctx + 1);
+
+  // prime presence so the logit modulation is exercised
+  lung_forward(lung, contexts, ctx);
+  memcpy(last_probs, lung->last_probs, vocab * sizeof(float));
+  lung_copy_presence(lung, presence);
+
+  int ok = lung_forward_batch_ex(lung, contexts, lens, B, logits, probs, att, ent) == B;
+  if (memcmp(last_probs, lung->last_probs, vocab * sizeof(float)) != 0) ok = 0;
+  if (!presence_matches(lung, presence)) ok = 0;
+
+  for (int b = 0; b < B && ok; b++) {
+    float e1 = forward_snapshot(lung, 1, contexts + (size_t)b * ctx, lens[b], l1, p1, a1);
+    if (fabsf(e1 - ent[b]) > 1e-4f) ok = 0;
+    if (max_abs_diff(l1, logits + (size_t)b * vocab, vocab) > 1e-4f) ok = 0;
+    if (max_abs_diff(p1, probs + (size_t)b * vocab, vocab) > 1e-5f) ok = 0;
+    if (max_abs_diff(a1, att + (size_t)b * ctx, ctx) > 1e-5f) ok = 0;
+  }
+
+  free(contexts); free(lens); free(logits); free(probs); free(att); free(ent);
+  free(l1); free(p1); free(a1); free(last_probs); free(presence);
+  return ok;
+}
+
+TEST(batch_equiv_small) {
+  lung_seed(61);
+  AriannaLung* lung = lung_create(64, 32, 12, 4);
+  ASSERT(lung != NULL);
+  ASSERT(batch_matches_single(lung, 1));
+  ASSERT(batch_matches_single(lung, 5));
+  lung_destroy(lung);
+}
+
+TEST(batch_equiv_multi_tile) {
+  // 37 contexts = two full tiles plus a remainder; odd dims, RTL prophecy
+  lung_seed(62);
+  AriannaLung* lung = lung_create(101, 30, 9, 4);
+  ASSERT(lung != NULL);
+  lung_set_rtl(lung, 1);
+  lung_set_temporal_alpha(lung, 0.8f);
+  ASSERT(batch_matches_single(lung, 37));
+  lung_destroy(lung);
+}
+
+TEST(batch_equiv_packed_qkv) {
+  lung_seed(63);
+  AriannaLung* lung = lung_create(80, 48, 10, 6);
+  ASSERT(lung != NULL);
+  ASSERT(lung_set_packed_qkv(lung, 1));
+  ASSERT(batch_matches_single(lung, 20));
+  lung_destroy(lung);
+}
+
+TEST(batch_optional_outputs) {
+  lung_seed(64);
+  AriannaLung* lung = lung_create(40, 16, 6, 2);
+  ASSERT(lung != NULL);
+  int contexts[3 * 6];
+  fill_context(contexts, 3 * 6, 40, 65);
+  float probs[3 * 40], ent[3], ent2[3];
+
+  // lens NULL = full rows; probs only, entropy only
+  ASSERT(lung_forward_batch(lung, contexts, NULL, 3, probs, NULL) == 3);
+  for (int b = 0; b < 3; b++) {
+    float sum = 0.0f;
+    for (int i = 0; i < 40; i++) sum += probs[b * 40 + i];
+    ASSERT_FLOAT_EQ(sum, 1.0f, 1e-4f);
+  }
+  ASSERT(lung_forward_batch(lung, contexts, NULL, 3, NULL, ent) == 3);
+  ASSERT(lung_forward_batch_ex(lung, contexts, NULL, 3, NULL, NULL, NULL, ent2) == 3);
+  for (int b = 0; b < 3; b++) ASSERT(ent[b] == ent2[b]);
+
+  ASSERT(lung_forward_batch(lung, contexts, NULL, 0, probs, ent) == 0);
+  ASSERT(lung_forward_batch(NULL, contexts, NULL, 3, probs, ent) == 0);
+  lung_destroy(lung);
+}
+
+// A failed workspace allocation leaves nothing behind (LeakSanitizer checks
+// at exit) and the next call allocates afresh
+TEST(batch_alloc_failure_recovers) {
+  lung_seed(66);
+  AriannaLung* lung = lung_create(40, 16, 6, 2);
+  ASSERT(lung != NULL);
+  int contexts[2 * 6];
+  fill_context(contexts, 2 * 6, 40, 67);
+  float ent[2], ent2[2];
+
+  for (int fail = 1; fail <= 10; fail++) {
+    calloc_fail_in = fail;
+    int got = lung_forward_batch(lung, contexts, NULL, 2, NULL, ent);
+    calloc_fail_in = 0;
+    ASSERT(got == 0);
+    ASSERT(!lung->batch_X && !lung->batch_x_last && !lung->batch_q && !lung->batch_kq &&
+           !lung->batch_xbar && !lung->batch_head && !lung->batch_y &&
+           !lung->batch_logits && !lung->batch_probs && !lung->batch_pos);
+  }
+
+  lung_seed(66);
+  AriannaLung* ref = lung_create(40, 16, 6, 2);
+  ASSERT(ref != NULL);
+  ASSERT(lung_forward_batch(lung, contexts, NULL, 2, NULL, ent) == 2);
+  ASSERT(lung_forward_batch(ref, contexts, NULL, 2, NULL, ent2) == 2);
+  ASSERT(ent[0] == ent2[0] && ent[1] == ent2[1]);
+  lung_destroy(ref);
+  lung_destroy(lung);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// SECTION G: THREADED FORWARD ≡ SERIAL (bit for bit)
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// Forward once serial and once on the pool; everything must be identical
+static int threaded_matches_serial(int vocab, int d, int ctx, int heads, int fold) {
+  lung_seed(81);
+  AriannaLung* lung = lung_create(vocab, d, ctx, heads);
+  if (!lung) return 0;
+  int* context = (int*)malloc(ctx * sizeof(int));
+  fill_context(context, ctx, vocab, 82);
+
+  float* l0 = (float*)malloc(vocab * sizeof(float));
+  float* p0 = (float*)malloc(vocab * sizeof(float));
+  float* a0 = (float*)malloc(ctx * sizeof(float));
+  float* l1 = (float*)malloc(vocab * sizeof(float));
+  float* p1 = (float*)malloc(vocab * sizeof(float));
+  float* a1 = (float*)malloc(ctx * sizeof(float));
+
+  lung_forward(lung, context, ctx - 1);  // non-zero presence
+
+  lung_set_threads(1);
+  float e0 = forward_snapshot(lung, fold, context, ctx - 2, l0, p0, a0);
+  TopKEntry top0[LUNG_TOPK_CACHE];
+  memcpy(top0, lung->top, sizeof(top0));
+  lung_set_threads(4);
+  float e1 = forward_snapshot(lung, fold, context, ctx - 2, l1, p1, a1);
+  lung_set_threads(1);
+
+  int ok = e0 == e1 &&
+           memcmp(top0, lung->top, sizeof(top0)) == 0 &&
+           memcmp(l0, l1, vocab * sizeof(float)) == 0 &&
+           memcmp(p0, p1, vocab * sizeof(float)) == 0 &&
+           memcmp(a0, a1, ctx * sizeof(float)) == 0;
+
+  free(context);
+  free(l0); free(p0); free(a0); free(l1); free(p1); free(a1);
+  lung_destroy(lung);
+  return ok;
+}
+
+TEST(threads_start_pool) {
+  ASSERT(lung_get_threads() == 1);
+  int n = lung_set_threads(4);
+  ASSERT(n >= 1 && n <= 4);
+  ASSERT(lung_get_threads() == n);
+  ASSERT(lung_set_threads(0) == 1);
+  ASSERT(lung_get_threads() == 1);
+}
+
+TEST(threads_equiv_folded) {
+  // 3000 tokens = three vocab tiles, the last one partial
+  ASSERT(threaded_matches_serial(3000, 64, 12, 8, 1));
+}
+
+TEST(threads_equiv_unfolded) {
+  ASSERT(threaded_matches_serial(2100, 30, 9, 4, 0));
+}
+
+TEST(threads_equiv_single_tile_single_head) {
+  ASSERT(threaded_matches_serial(100, 16, 6, 1, 1));
+}
+
+TEST(threads_stream_cached) {
+  lung_seed(83);
+  AriannaLung* lung = lung_create(2500, 32, 8, 4);
+  ASSERT(lung != NULL);
+  int tokens[10];
+  fill_context(tokens, 10, 2500, 84);
+  for (int i = 0; i < 10; i++) lung_push_token(lung, tokens[i]);
+
+  float presence[2500];
+  lung_copy_presence(lung, presence);
+  float e0 = lung_forward_cached(lung);
+  lung_load_presence(lung, presence);
+  lung_set_threads(4);
+  float e1 = lung_forward_cached(lung);
+  lung_set_threads(1);
+  ASSERT(e0 == e1);
+  lung_destroy(lung);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// SECTION H: QUANTIZED WEIGHTS (int8 / int4)
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// KL(p || q) in nats
+static double kl_div(const float* p, const float* q, int n) {
+  double kl = 0.0;
+  for (int i = 0; i < n; i++) {
+    if (p[i] > 1e-12f) kl += (double)p[i] * log((double)p[i] / ((double)q[i] + 1e-30));
+  }
+  return kl;
+}
+
+// Float lung vs the same lung compressed: mean / max KL of probs over contexts
+// bits: 8 / 4 (lung_quantize) or 16 (lung_create_ex with the given precision)
+static void quant_kl(int bits, int precision, int vocab, int d, int ctx, int heads, int n_ctx,
+                     double* mean_kl, double* max_kl) {
+  lung_seed(91);
+  AriannaLung* ref = lung_create(vocab, d, ctx, heads);
+  lung_seed(91);
+  AriannaLung* q;
+  if (bits == 16) {
+    q = lung_create_ex(vocab, d, ctx, heads, precision);
+  } else {
+    q = lung_create(vocab, d, ctx, heads);
+    lung_quantize(q, bits);
+  }
+
+  int* context = (int*)malloc(ctx * sizeof(int));
+  *mean_kl = 0.0;
+  *max_kl = 0.0;
+  for (int c = 0; c < n_ctx; c++) {
+    fill_context(context, ctx, vocab, 92u + c);
+    lung_forward(ref, context, ctx - c % 3);
+    lung_forward(q, context, ctx - c % 3);
+    double kl = kl_div(ref->last_probs, q->last_probs, vocab);
+    *mean_kl += kl / n_ctx;
+    if (kl > *max_kl) *max_kl = kl;
+  }
+
+  free(context);
+  lung_destroy(ref);
+  lung_destroy(q);
+}
+
+TEST(quant_int8_kl_bound) {
+  double mean_kl, max_kl;
+  quant_kl(8, LUNG_FP32, 512, 64, 16, 4, 20, &mean_kl, &max_kl);
+  printf("(KL mean %.2e max %.2e) ", mean_kl, max_kl);
+  ASSERT(max_kl < 1e-5);
+}
+
+TEST(quant_int4_kl_bound) {
+  double mean_kl, max_kl;
+  quant_kl(4, LUNG_FP32, 512, 64, 16, 4, 20, &mean_kl, &max_kl);
+  printf("(KL mean %.2e max %.2e) ", mean_kl, max_kl);
+  ASSERT(max_kl < 1e-3);
+}
+
+TEST(quant_storage_and_access) {
+  lung_seed(93);
+  AriannaLung* lung = lung_create(300, 40, 8, 4);
+  ASSERT(lung != NULL);
+  ASSERT(lung_set_packed_qkv(lung, 1));  // quantize unpacks first
+  float wk[40 * 40];
+  ASSERT(lung_copy_qkv_weights(lung, 1, wk));
+  size_t fbytes = lung_weight_bytes(lung);
+
+  ASSERT(lung_quantize(lung, 3) == 0);
+  ASSERT(lung_quantize(lung, 8));
+  ASSERT(lung_get_quant_bits(lung) == 8);
+  ASSERT(lung_quantize(lung, 4) == 0);  // one-way, once
+  ASSERT(lung_weight_bytes(lung) * 3 < fbytes);
+
+  ASSERT(lung_get_embeddings(lung) == NULL);
+  ASSERT(lung_get_output_weights(lung) == NULL);
+  ASSERT(lung_load_qkv_weights(lung, 1, wk));  // re-encodes the same rows
+  ASSERT(lung_set_packed_qkv(lung, 1) == 0);
+
+  // copy-out is dequantized: within half a step of the original
+  float wk_q[40 * 40];
+  ASSERT(lung_copy_qkv_weights(lung, 1, wk_q));
+  for (int i = 0; i < 40; i++) {
+    float step = lung->qW[1].scale[i];
+    for (int j = 0; j < 40; j++) {
+      ASSERT(fabsf(wk_q[i * 40 + j] - wk[i * 40 + j]) <= 0.5f * step + 1e-7f);
+    }
+  }
+  lung_destroy(lung);
+
+  lung_seed(93);
+  lung = lung_create(300, 40, 8, 4);
+  ASSERT(lung_quantize(lung, 4));
+  ASSERT(lung_weight_bytes(lung) * 5 < fbytes);
+  ASSERT(lung->qE.groups == 2 && lung->qE.row_bytes == 20);
+  lung_destroy(lung);
+}
+
+TEST(quant_paths_agree) {
+  // every forward path over the quantized lung agrees with lung_forward
+  for (int bits = 8; bits >= 4; bits -= 4) {
+    lung_seed(94);
+    AriannaLung* lung = lung_create(150, 36, 8, 3);  // d % group != 0 for int4
+    ASSERT(lung != NULL);
+    int tokens[11];
+    fill_context(tokens, 11, 150, 95);
+    for (int i = 0; i < 11; i++) lung_push_token(lung, tokens[i]);
+    ASSERT(lung_quantize(lung, bits));  // stream rebuilt from quantized rows
+
+    float l0[150], p0[150], a0[8], l1[150], p1[150], a1[8];
+    float e0 = forward_snapshot(lung, 1, tokens + 3, 8, l0, p0, a0);
+    float e1 = forward_snapshot(lung, 0, tokens + 3, 8, l1, p1, a1);
+    ASSERT_FLOAT_EQ(e0, e1, 1e-4f);
+    ASSERT(max_abs_diff(p0, p1, 150) < 1e-5f);
+
+    float presence[150];
+    lung_copy_presence(lung, presence);
+    float ec = lung_forward_cached(lung);
+    lung_load_presence(lung, presence);
+    ASSERT_FLOAT_EQ(e0, ec, 1e-4f);
+
+    ASSERT(batch_matches_single(lung, 6));
+    lung_destroy(lung);
+  }
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// SECTION I: HALF-PRECISION STORAGE (fp16 / bf16)
+// ═══════════════════════════════════════════════════════════════════════════════
+
+TEST(half_fp16_kl_bound) {
+  double mean_kl, max_kl;
+  quant_kl(16, LUNG_FP16, 512, 64, 16, 4, 20, &mean_kl, &max_kl);
+  printf("(KL mean %.2e max %.2e) ", mean_kl, max_kl);
+  ASSERT(max_kl < 1e-5);  // float probs put the KL floor near 1e-6
+}
+
+TEST(half_bf16_kl_bound) {
+  double mean_kl, max_kl;
+  quant_kl(16, LUNG_BF16, 512, 64, 16, 4, 20, &mean_kl, &max_kl);
+  printf("(KL mean %.2e max %.2e) ", mean_kl, max_kl);
+  ASSERT(max_kl < 1e-5);
+}
+
+TEST(half_create_and_footprint) {
+  ASSERT(lung_create_ex(64, 16, 8, 2, 3) == NULL);
+  ASSERT(lung_create_ex(64, 16, 8, 2, -1) == NULL);
+
+  lung_seed(96);
+  AriannaLung* f = lung_create_ex(300, 40, 8, 4, LUNG_FP32);
+  ASSERT(f != NULL && lung_get_precision(f) == LUNG_FP32 && lung_get_quant_bits(f) == 0);
+  ASSERT(lung_get_embeddings(f) != NULL);
+
+  for (int prec = LUNG_FP16; prec <= LUNG_BF16; prec++) {
+    AriannaLung* h = lung_create_ex(300, 40, 8, 4, prec);
+    ASSERT(h != NULL);
+    ASSERT(lung_get_precision(h) == prec);
+    ASSERT(lung_get_quant_bits(h) == 16);
+    ASSERT(h->qE.groups == 0 && h->qE.scale == NULL && h->qE.row_bytes == 80);
+    // half the bytes per value and one vocab-major copy of Wo instead of two
+    ASSERT(lung_weight_bytes(h) * 2 < lung_weight_bytes(f));
+    ASSERT(lung_get_embeddings(h) == NULL);
+    ASSERT(lung_get_output_weights(h) == NULL);
+    ASSERT(lung_quantize(h, 8) == 0);
+    lung_destroy(h);
+  }
+
+  AriannaLung* q = lung_create(300, 40, 8, 4);
+  ASSERT(lung_quantize(q, 8));
+  ASSERT(lung_get_precision(q) == LUNG_FP32);
+  lung_destroy(q);
+  lung_destroy(f);
+}
+
+TEST(half_loaders_match_float) {
+  // weights from a float lung loaded into half lungs built from another seed
+  enum { V = 200, D = 32, CTX = 8, H = 4 };
+  lung_seed(97);
+  AriannaLung* ref = lung_create(V, D, CTX, H);
+  static float wq[3][D * D];
+  for (int m = 0; m < 3; m++) ASSERT(lung_copy_qkv_weights(ref, m, wq[m]));
+
+  int context[CTX];
+  fill_context(context, CTX, V, 98);
+  lung_forward(ref, context, CTX);
+
+  for (int prec = LUNG_FP16; prec <= LUNG_BF16; prec++) {
+    lung_seed(99);
+    AriannaLung* h = lung_create_ex(V, D, CTX, H, prec);
+    ASSERT(h != NULL);
+    memcpy(h->resonance, ref->resonance, V * sizeof(float));
+    ASSERT(lung_load_embeddings(h, lung_get_embeddings(ref)));
+    ASSERT(lung_load_output_weights(h, lung_get_output_weights(ref)));
+    for (int m = 0; m < 3; m++) ASSERT(lung_load_qkv_weights(h, m, wq[m]));
+
+    lung_forward(h, context, CTX);
+    // logits track the float lung to the storage precision
+    float tol = (prec == LUNG_FP16) ? 2e-4f : 2e-3f;
+    ASSERT(max_abs_diff(ref->last_logits, h->last_logits, V) < tol);
+
+    // copy-out decodes: within half a unit in the last place
+    static float back[D * D];
+    ASSERT(lung_copy_qkv_weights(h, 2, back));
+    float ulp = (prec == LUNG_FP16) ? 1.0f / 2048.0f : 1.0f / 256.0f;
+    for (int i = 0; i < D * D; i++) {
+      ASSERT(fabsf(back[i] - wq[2][i]) <= fabsf(wq[2][i]) * ulp + 1e-7f);
+    }
+    lung_destroy(h);
+  }
+
+  // float lungs load by copy: bit-identical forward
+  lung_seed(99);
+  AriannaLung* f = lung_create(V, D, CTX, H);
+  memcpy(f->resonance, ref->resonance, V * sizeof(float));
+  ASSERT(lung_load_embeddings(f, lung_get_embeddings(ref)));
+  ASSERT(lung_load_output_weights(f, lung_get_output_weights(ref)));
+  for (int m = 0; m < 3; m++) ASSERT(lung_load_qkv_weights(f, m, wq[m]));
+  lung_load_presence(ref, NULL);
+  lung_forward(ref, context, CTX);
+  lung_forward(f, context, CTX);
+  ASSERT(memcmp(ref->last_probs, f->last_probs, V * sizeof(float)) == 0);
+
+  lung_destroy(f);
+  lung_destroy(ref);
+}
+
+TEST(half_merge_output_lora) {
+  enum { V = 180, D = 24, CTX = 6, H = 3, R = 2 };
+  float A[D * R], B[R * V];
+  uint32_t rng = 100;
+  for (int i = 0; i < D * R; i++) A[i] = 0.3f * (_randf(&rng) - 0.5f);
+  for (int i = 0; i < R * V; i++) B[i] = 0.3f * (_randf(&rng) - 0.5f);
+  int context[CTX];
+  fill_context(context, CTX, V, 101);
+
+  lung_seed(102);
+  AriannaLung* f = lung_create(V, D, CTX, H);
+  lung_seed(102);
+  AriannaLung* h = lung_create_ex(V, D, CTX, H, LUNG_FP16);
+  lung_merge_output_lora(f, A, B, R, 0.5f);
+  lung_merge_output_lora(h, A, B, R, 0.5f);
+
+  lung_forward(f, context, CTX);
+  lung_forward(h, context, CTX);
+  ASSERT(max_abs_diff(f->last_logits, h->last_logits, V) < 2e-4f);
+
+  // the merge really moved the half lung's output projection
+  lung_seed(102);
+  AriannaLung* h0 = lung_create_ex(V, D, CTX, H, LUNG_FP16);
+  lung_forward(h0, context, CTX);
+  ASSERT(max_abs_diff(h0->last_logits, h->last_logits, V) > 1e-3f);
+
+  lung_destroy(h0);
+  lung_destroy(h);
+  lung_destroy(f);
+}
+
+TEST(half_paths_agree) {
+  for (int prec = LUNG_FP16; prec <= LUNG_BF16; prec++) {
+    lung_seed(103);
+    AriannaLung* lung = lung_create_ex(150, 36, 8, 3, prec);
+    ASSERT(lung != NULL);
+    int tokens[11];
+    fill_context(tokens, 11, 150, 104);
+    for (int i = 0; i < 11; i++) lung_push_token(lung, tokens[i]);
+
+    float l0[150], p0[150], a0[8], l1[150], p1[150], a1[8];
+    float e0 = forward_snapshot(lung, 1, tokens + 3, 8, l0, p0, a0);
+    float e1 = forward_snapshot(lung, 0, tokens + 3, 8, l1, p1, a1);
+    ASSERT_FLOAT_EQ(e0, e1, 1e-4f);
+    ASSERT(max_abs_diff(p0, p1, 150) < 1e-5f);
+
+    float presence[150];
+    lung_copy_presence(lung, presence);
+    float ec = lung_forward_cached(lung);
+    lung_load_presence(lung, presence);
+    ASSERT_FLOAT_EQ(e0, ec, 1e-4f);
+
+    ASSERT(batch_matches_single(lung, 6));
+    lung_destroy(lung);
+  }
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// SECTION J: CHECKPOINTS (lung_save / lung_open_mmap)
+// ═══════════════════════════════════════════════════════════════════════════════
+
+#define CKPT_PATH "/tmp/arianna_test_body.ckpt"
+
+// kind: 0 float, 1 float packed, 2 fp16, 3 bf16, 4 int8, 5 int4
+static AriannaLung* ckpt_lung(int kind, int vocab, int d, int ctx, int heads) {
+  lung_seed(110 + kind);
+  AriannaLung* lung = (kind == 2 || kind == 3)
+      ? lung_create_ex(vocab, d, ctx, heads, kind == 2 ? LUNG_FP16 : LUNG_BF16)
+      : lung_create(vocab, d, ctx, heads);
+  if (!lung) return NULL;
+  if (kind == 1) lung_set_packed_qkv(lung, 1);
+  if (kind >= 4) lung_quantize(lung, kind == 4 ? 8 : 4);
+  lung_boost_resonance(lung, 3, 0.25f);
+  return lung;
+}
+
+static long file_size(const char* path) {
+  FILE* f = fopen(path, "rb");
+  if (!f) return -1;
+  fseek(f, 0, SEEK_END);
+  long n = ftell(f);
+  fclose(f);
+  return n;
+}
+
+// Overwrite bytes at offset (or truncate to offset when bytes == NULL)
+static void patch_file(const char* path, long offset, const void* bytes, size_t n) {
+  FILE* f = fopen(path, "rb");
+  long size = file_size(path);
+  uint8_t* buf = (uint8_t*)malloc(size);
+  if (fread(buf, 1, size, f) != (size_t)size) size = 0;
+  fclose(f);
+  if (bytes) memcpy(buf + offset, bytes, n);
+  else size = offset;
+  f = fopen(path, "wb");
+  fwrite(buf, 1, size, f);
+  fclose(f);
+  free(buf);
+}
+
+TEST(ckpt_roundtrip_all_storage) {
+  enum { V = 150, D = 36, CTX = 8, H = 3 };
+  int context[CTX];
+  fill_context(context, CTX, V, 111);
+
+  for (int kind = 0; kind <= 5; kind++) {
+    AriannaLung* src = ckpt_lung(kind, V, D, CTX, H);
+    ASSERT(src != NULL);
+    ASSERT(lung_save(src, CKPT_PATH));
+
+    AriannaLung* a = lung_open_mmap(CKPT_PATH);
+    AriannaLung* b = lung_open_mmap(CKPT_PATH);  // a second reader of the same file
+    ASSERT(a != NULL && b != NULL);
+    ASSERT(lung_is_mapped(a) && !lung_is_mapped(src));
+    ASSERT(lung_get_vocab_size(a) == V && lung_get_d_model(a) == D && lung_get_ctx_len(a) == CTX);
+    ASSERT(a->n_heads == H);
+    ASSERT(lung_get_quant_bits(a) == lung_get_quant_bits(src));
+    ASSERT(lung_get_precision(a) == lung_get_precision(src));
+    ASSERT(lung_get_resonance(a, 3) == lung_get_resonance(src, 3));
+
+    // weights are borrowed from the mapping, on LUNG_ALIGN boundaries
+    const void* w = a->quant_bits ? (const void*)a->qE.data : (const void*)a->E;
+    ASSERT(weight_borrowed(a, w));
+    ASSERT((uintptr_t)w % LUNG_ALIGN == 0);
+    ASSERT(lung_verify_checkpoint(CKPT_PATH));
+
+    lung_forward(src, context, CTX);
+    lung_forward(a, context, CTX);
+    lung_forward(b, context, CTX);
+    ASSERT(memcmp(a->last_probs, b->last_probs, V * sizeof(float)) == 0);
+    if (kind == 1) {
+      ASSERT(max_abs_diff(src->last_probs, a->last_probs, V) < 1e-6f);  // packed → separate
+    } else {
+      ASSERT(memcmp(src->last_probs, a->last_probs, V * sizeof(float)) == 0);
+    }
+
+    lung_destroy(b);
+    lung_destroy(a);
+    lung_destroy(src);
+  }
+  remove(CKPT_PATH);
+}
+
+TEST(ckpt_mapped_lung_is_copy_on_write) {
+  enum { V = 120, D = 32, CTX = 6, H = 4 };
+  int context[CTX];
+  fill_context(context, CTX, V, 112);
+  AriannaLung* src = ckpt_lung(0, V, D, CTX, H);
+  ASSERT(lung_save(src, CKPT_PATH));
+  lung_forward(src, context, CTX);
+
+  // edits through every writer stay private to the lung that made them
+  AriannaLung* a = lung_open_mmap(CKPT_PATH);
+  ASSERT(a != NULL);
+  static float wv[D * D];
+  ASSERT(lung_copy_qkv_weights(a, 2, wv));
+  for (int i = 0; i < D * D; i++) wv[i] *= -1.0f;
+  ASSERT(lung_load_qkv_weights(a, 2, wv));
+  float A[D], B[V];
+  for (int i = 0; i < D; i++) A[i] = 0.1f;
+  for (int i = 0; i < V; i++) B[i] = (i % 7) * 0.05f;
+  lung_merge_output_lora(a, A, B, 1, 1.0f);
+  lung_get_embeddings(a)[0] += 1.0f;
+  lung_forward(a, context, CTX);
+  ASSERT(max_abs_diff(src->last_probs, a->last_probs, V) > 1e-5f);
+
+  AriannaLung* b = lung_open_mmap(CKPT_PATH);
+  ASSERT(b != NULL);
+  lung_forward(b, context, CTX);
+  ASSERT(memcmp(src->last_probs, b->last_probs, V * sizeof(float)) == 0);
+  ASSERT(lung_verify_checkpoint(CKPT_PATH));
+
+  // layout changes release borrowed arrays without freeing them
+  ASSERT(lung_set_packed_qkv(b, 1));
+  ASSERT(b->Wq == NULL && b->Wqkv != NULL);
+  ASSERT(lung_quantize(a, 8));
+  ASSERT(a->E == NULL && !weight_borrowed(a, a->qE.data));
+
+  lung_destroy(a);
+  lung_destroy(b);
+  lung_destroy(src);
+  remove(CKPT_PATH);
+}
+
+TEST(ckpt_rejects_damaged_files) {
+  AriannaLung* src = ckpt_lung(4, 100, 32, 6, 2);  // int8: scale sections too
+  ASSERT(lung_open_mmap("/nonexistent/lung.ckpt") == NULL);
+  ASSERT(lung_verify_checkpoint("/nonexistent/lung.ckpt") == 0);
+  ASSERT(lung_save(src, "/nonexistent/lung.ckpt") == 0);
+
+  ASSERT(lung_save(src, CKPT_PATH));
+  long size = file_size(CKPT_PATH);
+  ASSERT(size > 1000);
+
+  // any header byte (CRC-covered)
+  uint8_t byte = 0x5A;
+  patch_file(CKPT_PATH, 20, &byte, 1);
+  ASSERT(lung_open_mmap(CKPT_PATH) == NULL);
+  ASSERT(lung_verify_checkpoint(CKPT_PATH) == 0);
+
+  // another version, even with a valid header CRC
+  ASSERT(lung_save(src, CKPT_PATH));
+  LungCkptTable t;
+  FILE* f = fopen(CKPT_PATH, "rb");
+  ASSERT(fread(&t, 1, sizeof(t), f) > sizeof(t.h));
+  fclose(f);
+  uint32_t table[256];
+  crc32_init(table);
+  t.h.version = LUNG_CKPT_VERSION + 1;
+  t.h.header_crc = ckpt_header_crc(table, &t);
+  patch_file(CKPT_PATH, 0, &t.h, sizeof(t.h));
+  ASSERT(lung_open_mmap(CKPT_PATH) == NULL);
+
+  // truncated
+  ASSERT(lung_save(src, CKPT_PATH));
+  patch_file(CKPT_PATH, size - 1, NULL, 0);
+  ASSERT(lung_open_mmap(CKPT_PATH) == NULL);
+  patch_file(CKPT_PATH, 40, NULL, 0);
+  ASSERT(lung_open_mmap(CKPT_PATH) == NULL);
+
+  // weight bytes: opening skips section CRCs, verification catches them
+  ASSERT(lung_save(src, CKPT_PATH));
+  ASSERT(lung_verify_checkpoint(CKPT_PATH));
+  patch_file(CKPT_PATH, size - 1000, &byte, 1);
+  AriannaLung* lung = lung_open_mmap(CKPT_PATH);
+  ASSERT(lung != NULL);
+  ASSERT(lung_verify_checkpoint(CKPT_PATH) == 0);
+
+  lung_destroy(lung);
+  lung_destroy(src);
+  remove(CKPT_PATH);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// SECTION K: FUSED VOCAB EPILOGUE (log-sum-exp, entropy, top-k cache)
+// ═══════════════════════════════════════════════════════════════════════════════
+
+TEST(topk_heap_order_and_ties) {
+  // values with ties, pushed in a scrambled order
+  enum { N = 200, K = 12 };
+  float vals[N];
+  for (int i = 0; i < N; i++) vals[i] = (float)((i * 37) % 23);
+  TopKEntry store[K];
+  TopK h;
+  topk_init(&h, store, K);
+  for (int j = 0; j < N; j++) {
+    int i = (j * 71) % N;  // 71 is coprime with 200: a permutation
+    topk_push(&h, vals[i], i);
+  }
+  ASSERT(topk_sort(&h) == K);
+
+  // reference: repeated forward scans with a strict >
+  int used[N] = { 0 };
+  for (int r = 0; r < K; r++) {
+    int best = -1;
+    for (int i = 0; i < N; i++) {
+      if (!used[i] && (best < 0 || vals[i] > vals[best])) best = i;
+    }
+    used[best] = 1;
+    ASSERT(store[r].idx == best && store[r].val == vals[best]);
+  }
+
+  topk_init(&h, store, K);
+  topk_push(&h, 1.0f, 5);
+  topk_push(&h, 2.0f, 3);
+  ASSERT(topk_sort(&h) == 2 && store[0].idx == 3 && store[1].idx == 5);
+}
+
+TEST(topk_select_excluding) {
+  float x[6] = { 0.1f, 0.4f, 0.2f, 0.4f, 0.9f, 0.0f };
+  TopKEntry scratch[8];
+  int idx[8];
+  ASSERT(topk_select(x, 6, 4, 3, scratch, idx) == 3);
+  ASSERT(idx[0] == 1 && idx[1] == 3 && idx[2] == 2);  // tie → lower index first
+  ASSERT(topk_select(x, 6, -1, 8, scratch, idx) == 6);
+  ASSERT(idx[0] == 4 && idx[5] == 5 && idx[6] == -1 && idx[7] == -1);
+  ASSERT(topk_select(x, 6, 0, 0, scratch, idx) == 0);
+}
+
+TEST(top_k_large_k_and_vocab) {
+  // vocab far beyond any stack budget, k beyond the cache
+  enum { V = 1 << 20, K = 300 };
+  lung_seed(126);
+  AriannaLung* lung = lung_create(V, 8, 4, 1);
+  ASSERT(lung != NULL);
+  int context[4] = { 1, 2, 3, 4 };
+  lung_forward(lung, context, 4);
+
+  int* idx = (int*)malloc(K * sizeof(int));
+  ASSERT(lung_get_top_k(lung, idx, K) == K);
+  for (int i = 0; i < LUNG_TOPK_CACHE; i++) ASSERT(idx[i] == lung->top[i].idx);
+  for (int i = 1; i < K; i++) {
+    float a = lung->last_logits[idx[i - 1]], b = lung->last_logits[idx[i]];
+    ASSERT(a > b || (a == b && idx[i - 1] < idx[i]));
+  }
+  // nothing outside the selection beats its last entry
+  float kth = lung->last_logits[idx[K - 1]];
+  int above = 0;
+  for (int i = 0; i < V; i++) above += lung->last_logits[i] > kth;
+  ASSERT(above == K - 1);
+  free(idx);
+  lung_destroy(lung);
+}
+
+// Reference epilogue on the lung's last logits, in double
+static int epilogue_matches_reference(AriannaLung* lung, float entropy) {
+  int vocab = lung->vocab_size;
+  const float* l = lung->last_logits;
+  double m = l[0];
+  for (int i = 1; i < vocab; i++) if (l[i] > m) m = l[i];
+  double sum = 0.0;
+  for (int i = 0; i < vocab; i++) sum += exp(l[i] - m);
+  double h = 0.0;
+  int ok = 1;
+  for (int i = 0; i < vocab; i++) {
+    double p = exp(l[i] - m) / sum;
+    if (p > 0.0) h -= p * log(p);
+    if (fabs(lung->last_probs[i] - p) > 1e-6 * p + 1e-9) ok = 0;
+  }
+  if (fabs(entropy - h) > 1e-4 * h + 1e-5) ok = 0;
+
+  // argmax and the whole cache against a strict-> scan
+  char* used = (char*)calloc((unsigned)vocab, 1);
+  for (int r = 0; r < LUNG_TOPK_CACHE && r < vocab && ok; r++) {
+    int best = -1;
+    for (int i = 0; i < vocab; i++) {
+      if (!used[i] && (best < 0 || l[i] > l[best])) best = i;
+    }
+    used[best] = 1;
+    ok = lung->top[r].idx == best;
+  }
+  free(used);
+  return ok && lung->n_top == (vocab < LUNG_TOPK_CACHE ? vocab : LUNG_TOPK_CACHE) &&
+         lung_get_argmax(lung) == lung->top[0].idx;
+}
+
+TEST(epilogue_matches_reference_multi_tile) {
+  lung_seed(120);
+  AriannaLung* lung = lung_create(2600, 32, 8, 4);  // three tiles, ragged last
+  ASSERT(lung != NULL);
+  int context[8];
+  for (int c = 0; c < 4; c++) {
+    fill_context(context, 8, 2600, 121 + c);
+    float e = lung_forward(lung, context, 8 - c);  // presence builds up
+    ASSERT(epilogue_matches_reference(lung, e));
+  }
+
+  // sharp distribution: boost a few logits through presence
+  float* boost = (float*)malloc(2600 * sizeof(float));
+  lung_copy_presence(lung, boost);
+  for (int i = 0; i < 2600; i += 97) boost[i] = 1.0f;
+  lung_load_presence(lung, boost);
+  free(boost);
+  lung_set_temporal_alpha(lung, 0.9f);
+  float e = lung_forward(lung, context, 8);
+  ASSERT(epilogue_matches_reference(lung, e));
+  lung_destroy(lung);
+}
+
+TEST(epilogue_small_vocab) {
+  lung_seed(122);
+  AriannaLung* lung = lung_create(20, 16, 6, 2);  // vocab below the cache size
+  ASSERT(lung != NULL);
+  ASSERT(lung->n_top == 0 && lung_get_argmax(lung) == 0);  // before any forward
+  int context[6] = { 1, 2, 3, 4, 5, 6 };
+  float e = lung_forward(lung, context, 6);
+  ASSERT(epilogue_matches_reference(lung, e));
+  int idx[20];
+  ASSERT(lung_get_top_k(lung, idx, 50) == 20);
+  for (int i = 0; i < 20; i++) ASSERT(idx[i] == lung->top[i].idx);
+  lung_destroy(lung);
+}
+
+TEST(epilogue_presence_and_getters) {
+  enum { V = 1500 };
+  lung_seed(123);
+  AriannaLung* lung = lung_create(V, 24, 8, 3);
+  ASSERT(lung != NULL);
+  int context[8];
+  fill_context(context, 8, V, 124);
+  lung_forward(lung, context, 8);
+
+  // presence: decay every token, then bump the context (clamped at 1)
+  float before[V], expect[V];
+  lung_copy_presence(lung, before);
+  for (int i = 0; i < V; i++) expect[i] = before[i] * lung->presence_decay;
+  context[3] = context[5];  // a repeated token
+  for (int t = 0; t < 8; t++) {
+    float v = expect[context[t]] + PRESENCE_INCREMENT;
+    expect[context[t]] = v > 1.0f ? 1.0f : v;
+  }
+  lung_forward(lung, context, 8);
+  float after[V];
+  lung_copy_presence(lung, after);
+  ASSERT(max_abs_diff(expect, after, V) < 1e-5f);
+
+  // top-k getter: cached prefix, then the scan beyond the cache
+  int idx[48];
+  ASSERT(lung_get_top_k(lung, idx, 5) == 5);
+  for (int i = 0; i < 5; i++) ASSERT(idx[i] == lung->top[i].idx);
+  ASSERT(lung_get_top_k(lung, idx, 48) == 48);
+  for (int i = 0; i < LUNG_TOPK_CACHE; i++) ASSERT(idx[i] == lung->top[i].idx);
+  for (int i = 1; i < 48; i++) {
+    ASSERT(lung->last_logits[idx[i]] <= lung->last_logits[idx[i - 1]]);
+  }
+
+  // batch forward leaves presence and the cache alone
+  TopKEntry top[LUNG_TOPK_CACHE];
+  memcpy(top, lung->top, sizeof(top));
+  lung_copy_presence(lung, before);
+  float probs[2 * V], ent[2];
+  int ctxs[16];
+  fill_context(ctxs, 16, V, 125);
+  ASSERT(lung_forward_batch(lung, ctxs, NULL, 2, probs, ent) == 2);
+  ASSERT(presence_matches(lung, before));
+  ASSERT(memcmp(top, lung->top, sizeof(top)) == 0);
+  lung_destroy(lung);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// SECTION L: NATIVE SAMPLING (temperature, top-k, top-p, min-p, destiny)
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// Install logits as if a forward had produced them (cache included)
+static void set_logits(AriannaLung* lung, const float* l) {
+  memcpy(lung->last_logits, l, (size_t)lung->vocab_size * sizeof(float));
+  TopK h;
+  topk_init(&h, lung->top, LUNG_TOPK_CACHE);
+  for (int i = 0; i < lung->vocab_size; i++) topk_push(&h, l[i], i);
+  lung->n_top = topk_sort(&h);
+}
+
+// Exact filtered distribution, in double; returns the support size
+static int sample_reference(const AriannaLung* lung, float temp, int top_k,
+                            float top_p, float min_p, double* q) {
+  int vocab = lung->vocab_size;
+  const float* l = lung->last_logits;
+  TopKEntry* order = (TopKEntry*)malloc((size_t)vocab * sizeof(TopKEntry));
+  TopK h;
+  topk_init(&h, order, vocab);
+  for (int i = 0; i < vocab; i++) topk_push(&h, l[i], i);
+  topk_sort(&h);
+
+  double lmax = order[0].val;
+  double floor_l = min_p > 0.0f ? lmax + temp * log(min_p) : -INFINITY;
+  int n = (top_k > 0 && top_k < vocab) ? top_k : vocab;
+  while (n > 0 && order[n - 1].val < floor_l) n--;
+  double z = 0.0;
+  for (int j = 0; j < n; j++) z += exp((order[j].val - lmax) / temp);
+  if (top_p > 0.0f && top_p < 1.0f) {
+    double mass = 0.0;
+    int m = 0;
+    while (m < n && mass < top_p * z) mass += exp((order[m++].val - lmax) / temp);
+    n = m;
+    z = mass;
+  }
+
+  memset(q, 0, (size_t)vocab * sizeof(double));
+  for (int j = 0; j < n; j++) q[order[j].idx] = exp((order[j].val - lmax) / temp) / z;
+  free(order);
+  return n;
+}
+
+// Empirical frequencies of lung_sample against the reference
+static int sample_matches(AriannaLung* lung, float temp, int top_k, float top_p,
+                          float min_p, int draws, int min_support) {
+  int vocab = lung->vocab_size;
+  double* q = (double*)malloc((size_t)vocab * sizeof(double));
+  int* count = (int*)calloc((size_t)vocab, sizeof(int));
+  int support = sample_reference(lung, temp, top_k, top_p, min_p, q);
+  int ok = support >= min_support;
+
+  uint32_t rng = 2024;
+  for (int d = 0; d < draws && ok; d++) {
+    int tok = lung_sample(lung, temp, top_k, top_p, min_p, &rng);
+    ok = tok >= 0 && tok < vocab && q[tok] > 0.0;
+    if (ok) count[tok]++;
+  }
+  for (int i = 0; i < vocab && ok; i++) {
+    ok = fabs((double)count[i] / draws - q[i]) < 0.015;
+  }
+  free(q);
+  free(count);
+  return ok;
+}
+
+static AriannaLung* sample_lung(int vocab, float spread, unsigned int seed) {
+  lung_seed(seed);
+  AriannaLung* lung = lung_create(vocab, 8, 4, 1);
+  if (!lung) return NULL;
+  float* l = (float*)malloc((size_t)vocab * sizeof(float));
+  for (int i = 0; i < vocab; i++) {
+    seed = seed * 1103515245u + 12345u;
+    l[i] = spread * ((float)(seed >> 8) / 16777216.0f - 0.5f);
+  }
+  set_logits(lung, l);
+  free(l);
+  return lung;
+}
+
+TEST(sample_greedy_and_degenerate) {
+  AriannaLung* lung = sample_lung(500, 8.0f, 130);
+  ASSERT(lung != NULL);
+  int argmax = lung_get_argmax(lung);
+  uint32_t rng = 1;
+  for (int d = 0; d < 50; d++) {
+    ASSERT(lung_sample(lung, 0.0f, 0, 1.0f, 0.0f, &rng) == argmax);
+    ASSERT(lung_sample(lung, 1.0f, 1, 1.0f, 0.0f, &rng) == argmax);
+    ASSERT(lung_sample(lung, 1.0f, 0, 1.0f, 1.0f, &rng) == argmax);
+    ASSERT(lung_sample(lung, 1.0f, 0, 1e-6f, 0.0f, &rng) == argmax);
+  }
+  ASSERT(lung_sample(NULL, 1.0f, 0, 1.0f, 0.0f, &rng) == 0);
+  lung_destroy(lung);
+
+  // before any forward: flat zero logits, empty cache
+  lung_seed(131);
+  lung = lung_create(40, 8, 4, 1);
+  ASSERT(lung != NULL && lung->n_top == 0);
+  for (int d = 0; d < 50; d++) {
+    int tok = lung_sample(lung, 1.0f, 5, 0.5f, 0.0f, &rng);
+    ASSERT(tok >= 0 && tok < 5);
+    tok = lung_sample(lung, 1.0f, 0, 0.5f, 0.0f, &rng);
+    ASSERT(tok >= 0 && tok < 20);
+  }
+  lung_destroy(lung);
+}
+
+TEST(sample_matches_reference_distribution) {
+  AriannaLung* lung = sample_lung(2000, 12.0f, 132);
+  ASSERT(lung != NULL);
+  ASSERT(sample_matches(lung, 0.7f, 0, 1.0f, 0.0f, 20000, 2000));   // whole vocab
+  ASSERT(sample_matches(lung, 1.0f, 10, 1.0f, 0.0f, 20000, 10));    // cached top-k
+  ASSERT(sample_matches(lung, 1.3f, 100, 1.0f, 0.0f, 20000, 100));  // beyond cache
+  ASSERT(sample_matches(lung, 1.0f, 50, 0.8f, 0.0f, 20000, 2));     // top-k then top-p
+  ASSERT(sample_matches(lung, 0.8f, 0, 1.0f, 0.05f, 20000, 2));     // min-p floor
+  ASSERT(sample_matches(lung, 1.1f, 0, 0.95f, 0.01f, 20000, 2));
+  lung_destroy(lung);
+
+  // flat logits: the nucleus grows far past the cache
+  lung = sample_lung(2000, 1.0f, 133);
+  ASSERT(lung != NULL);
+  ASSERT(sample_matches(lung, 0.9f, 0, 0.9f, 0.0f, 20000, 4 * LUNG_TOPK_CACHE));
+  lung_destroy(lung);
+}
+
+TEST(sample_stream_is_reproducible) {
+  lung_seed(134);
+  AriannaLung* lung = lung_create(300, 16, 6, 2);
+  ASSERT(lung != NULL);
+  int context[6];
+  fill_context(context, 6, 300, 135);
+  lung_forward(lung, context, 6);
+
+  int a[64], b[64];
+  uint32_t r1 = 77, r2 = 77;
+  for (int d = 0; d < 64; d++) a[d] = lung_sample(lung, 0.9f, 40, 0.9f, 0.02f, &r1);
+  for (int d = 0; d < 64; d++) b[d] = lung_sample(lung, 0.9f, 40, 0.9f, 0.02f, &r2);
+  ASSERT(memcmp(a, b, sizeof(a)) == 0 && r1 == r2);
+
+  // NULL state: the lung's own stream, set by lung_seed_rng
+  lung_seed_rng(lung, 9);
+  for (int d = 0; d < 64; d++) a[d] = lung_sample(lung, 1.2f, 0, 1.0f, 0.0f, NULL);
+  uint32_t r3 = 9;
+  for (int d = 0; d < 64; d++) b[d] = lung_sample(lung, 1.2f, 0, 1.0f, 0.0f, &r3);
+  ASSERT(memcmp(a, b, sizeof(a)) == 0 && lung->rng == r3);
+  lung_destroy(lung);
+}
+
+TEST(sample_am_state_temperature_and_destiny) {
+  AriannaLung* lung = sample_lung(800, 6.0f, 136);
+  ASSERT(lung != NULL);
+  int argmax = lung_get_argmax(lung);
+
+  AM_State am;
+  memset(&am, 0, sizeof(am));
+  am.effective_temp = 0.85f;  // WALK at base temperature 1
+
+  // no destiny: exactly lung_sample at effective_temp, same stream
+  uint32_t r1 = 5, r2 = 5;
+  for (int d = 0; d < 200; d++) {
+    ASSERT(lung_sample_am(lung, &am, 0, 0.9f, 0.0f, &r1) ==
+           lung_sample(lung, 0.85f, 0, 0.9f, 0.0f, &r2));
+  }
+
+  am.destiny = 1.0f;
+  for (int d = 0; d < 50; d++) ASSERT(lung_sample_am(lung, &am, 0, 1.0f, 0.0f, &r1) == argmax);
+
+  // partial destiny: P(argmax) = destiny + (1 - destiny) · q(argmax)
+  double* q = (double*)malloc(800 * sizeof(double));
+  sample_reference(lung, 2.0f, 0, 1.0f, 0.0f, q);
+  am.destiny = 0.35f;
+  am.effective_temp = 2.0f;
+  int hits = 0;
+  for (int d = 0; d < 20000; d++) hits += lung_sample_am(lung, &am, 0, 1.0f, 0.0f, &r1) == argmax;
+  double expect = 0.35 + 0.65 * q[argmax];
+  free(q);
+  ASSERT(fabs(hits / 20000.0 - expect) < 0.015);
+  lung_destroy(lung);
+}
+
+// Draws with the lung's own stream (rng_state NULL), for a thread
+typedef struct {
+  AriannaLung* lung;
+  int* out;
+  int n;
+} SampleJob;
+
+static void* sample_job(void* arg) {
+  SampleJob* job = (SampleJob*)arg;
+  for (int d = 0; d < job->n; d++) job->out[d] = lung_sample(job->lung, 1.1f, 0, 0.95f, 0.0f, NULL);
+  return NULL;
+}
+
+TEST(sample_streams_are_per_lung) {
+  enum { N = 4, DRAWS = 3000 };
+  AriannaLung* lung[N];
+  static int got[N][DRAWS], want[N][DRAWS];
+  for (int i = 0; i < N; i++) {
+    lung[i] = sample_lung(500, 5.0f, 137 + i);
+    ASSERT(lung[i] != NULL);
+  }
+  ASSERT(lung[0]->rng != lung[1]->rng);  // distinct lungs start apart
+
+  // reference: each lung on its own, explicit state
+  for (int i = 0; i < N; i++) {
+    uint32_t r = 300u + i;
+    for (int d = 0; d < DRAWS; d++) want[i][d] = lung_sample(lung[i], 1.1f, 0, 0.95f, 0.0f, &r);
+    lung_seed_rng(lung[i], 300u + i);
+  }
+
+  // all lungs at once: no stream is shared, so nothing interleaves
+  SampleJob job[N];
+  for (int i = 0; i < N; i++) job[i] = (SampleJob){ lung[i], got[i], DRAWS };
+#if POOL_THREADS
+  pthread_t tid[N];
+  for (int i = 0; i < N; i++) ASSERT(pthread_create(&tid[i], NULL, sample_job, &job[i]) == 0);
+  for (int i = 0; i < N; i++) pthread_join(tid[i], NULL);
+#else
+  for (int i = 0; i < N; i++) sample_job(&job[i]);
+#endif
+  for (int i = 0; i < N; i++) {
+    ASSERT(memcmp(got[i], want[i], sizeof(got[i])) == 0);
+    lung_destroy(lung[i]);
+  }
+}
+
+// Creates lungs on a thread: seeded ones and ones from the module stream
+typedef struct {
+  int seed;
+  AriannaLung* seeded;
+  AriannaLung* module;
+} CreateJob;
+
+static void* create_job(void* arg) {
+  CreateJob* job = (CreateJob*)arg;
+  job->seeded = lung_create_seeded(120, 16, 8, 4, 2, (uint32_t)job->seed);
+  job->module = lung_create_gqa(120, 16, 8, 4, 2);
+  lung_seed_rng(job->module, 5u);
+  return NULL;
+}
+
+static int same_weights(const AriannaLung* a, const AriannaLung* b) {
+  size_t d = a->d_model, hw = (size_t)a->head_dim * d;
+  return memcmp(a->E, b->E, a->vocab_size * d * sizeof(float)) == 0 &&
+         memcmp(a->Wo, b->Wo, a->vocab_size * d * sizeof(float)) == 0 &&
+         memcmp(a->Wq, b->Wq, a->n_heads * hw * sizeof(float)) == 0 &&
+         memcmp(a->Wk, b->Wk, a->n_kv_heads * hw * sizeof(float)) == 0 &&
+         memcmp(a->Wv, b->Wv, a->n_kv_heads * hw * sizeof(float)) == 0 &&
+         memcmp(a->resonance, b->resonance, a->vocab_size * sizeof(float)) == 0;
+}
+
+TEST(create_lungs_concurrently) {
+  enum { N = 8 };
+  AriannaLung* serial_seeded[N];
+  AriannaLung* serial_module[N];
+  CreateJob job[N];
+
+  // seeded: equal to lung_seed + lung_create_gqa, and to itself
+  lung_seed(901);
+  AriannaLung* ref = lung_create_gqa(120, 16, 8, 4, 2);
+  AriannaLung* seeded = lung_create_seeded(120, 16, 8, 4, 2, 901);
+  AriannaLung* again = lung_create_seeded(120, 16, 8, 4, 2, 901);
+  ASSERT(ref && seeded && again);
+  ASSERT(same_weights(ref, seeded) && seeded->rng == again->rng);
+  lung_destroy(ref);
+  lung_destroy(seeded);
+  lung_destroy(again);
+
+  lung_seed(77);
+  for (int i = 0; i < N; i++) {
+    serial_seeded[i] = lung_create_seeded(120, 16, 8, 4, 2, 500u + i);
+    serial_module[i] = lung_create_gqa(120, 16, 8, 4, 2);
+    ASSERT(serial_seeded[i] && serial_module[i]);
+  }
+
+  lung_seed(77);
+  for (int i = 0; i < N; i++) job[i] = (CreateJob){ 500 + i, NULL, NULL };
+#if POOL_THREADS
+  pthread_t tid[N];
+  for (int i = 0; i < N; i++) ASSERT(pthread_create(&tid[i], NULL, create_job, &job[i]) == 0);
+  for (int i = 0; i < N; i++) pthread_join(tid[i], NULL);
+#else
+  for (int i = 0; i < N; i++) create_job(&job[i]);
+#endif
+
+  // seeded lungs do not depend on the threads at all; module-stream lungs
+  // each take one whole stretch of the same stream, in some order
+  int used[N] = { 0 };
+  for (int i = 0; i < N; i++) {
+    ASSERT(job[i].seeded && job[i].module);
+    ASSERT(same_weights(job[i].seeded, serial_seeded[i]));
+    ASSERT(job[i].seeded->rng == serial_seeded[i]->rng);
+    int match = -1;
+    for (int k = 0; k < N && match < 0; k++) {
+      if (!used[k] && same_weights(job[i].module, serial_module[k])) match = k;
+    }
+    ASSERT(match >= 0);
+    used[match] = 1;
+  }
+
+  for (int i = 0; i < N; i++) {
+    lung_destroy(serial_seeded[i]);
+    lung_destroy(serial_module[i]);
+    lung_destroy(job[i].seeded);
+    lung_destroy(job[i].module);
+  }
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// SECTION M: PROPHECY (rollout on the streaming cache, beam search)
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// Replay a rollout with full forwards on a twin lung: the window grows to
+// ctx_len, then slides; only non-skipped steps run a forward
+static int prophecy_replay(AriannaLung* ref, const int* context, int n_ctx, int steps,
+                           const int* tokens, const float* entropy, const float* probs,
+                           const int* skipped, int greedy) {
+  int ctx = ref->ctx_len;
+  int window[64], len = 0;
+  for (int t = (n_ctx > ctx ? n_ctx - ctx : 0); t < n_ctx; t++) window[len++] = context[t];
+
+  float e = 0.0f;
+  for (int s = 0; s < steps; s++) {
+    if (!skipped || !skipped[s]) e = lung_forward(ref, window, len);
+    if (greedy && tokens[s] != lung_get_argmax(ref)) return 0;
+    if (fabsf(entropy[s] - e) > 1e-4f) return 0;
+    if (fabsf(probs[s] - ref->last_probs[tokens[s]]) > 1e-5f) return 0;
+    if (len == ctx) {
+      memmove(window, window + 1, (ctx - 1) * sizeof(int));
+      len--;
+    }
+    window[len++] = tokens[s];
+  }
+  return 1;
+}
+
+TEST(prophecy_greedy_matches_forward_loop) {
+  enum { V = 700, STEPS = 24 };
+  lung_seed(140);
+  AriannaLung* lung = lung_create(V, 32, 8, 4);
+  lung_seed(140);
+  AriannaLung* ref = lung_create(V, 32, 8, 4);
+  ASSERT(lung != NULL && ref != NULL);
+
+  int context[5];
+  fill_context(context, 5, V, 141);
+  lung_forward(lung, context, 5);
+  lung_forward(ref, context, 5);
+  float* presence = (float*)malloc(V * sizeof(float));
+  lung_copy_presence(lung, presence);
+
+  int tokens[STEPS], skipped[STEPS];
+  float entropy[STEPS], probs[STEPS];
+  ASSERT(lung_prophecy(lung, context, 5, STEPS, 1.0f, 1.0f, 0.0f, 0, NULL,
+                       tokens, entropy, probs, skipped) == STEPS);
+  for (int s = 0; s < STEPS; s++) ASSERT(skipped[s] == 0);
+  ASSERT(prophecy_replay(ref, context, 5, STEPS, tokens, entropy, probs, NULL, 1));
+  ASSERT(presence_matches(lung, presence));
+
+  // a context longer than the window keeps its tail
+  int long_ctx[13];
+  fill_context(long_ctx, 13, V, 142);
+  lung_copy_presence(lung, presence);
+  lung_load_presence(ref, presence);
+  ASSERT(lung_prophecy(lung, long_ctx, 13, STEPS, 1.0f, 1.0f, 0.0f, 0, NULL,
+                       tokens, entropy, probs, NULL) == STEPS);
+  ASSERT(prophecy_replay(ref, long_ctx, 13, STEPS, tokens, entropy, probs, NULL, 1));
+  free(presence);
+  lung_destroy(lung);
+  lung_destroy(ref);
+}
+
+TEST(prophecy_sampled_with_wormholes) {
+  enum { V = 500, STEPS = 40 };
+  lung_seed(143);
+  AriannaLung* lung = lung_create(V, 24, 6, 2);
+  lung_seed(143);
+  AriannaLung* ref = lung_create(V, 24, 6, 2);
+  ASSERT(lung != NULL && ref != NULL);
+  int context[6];
+  fill_context(context, 6, V, 144);
+
+  int tokens[STEPS], skipped[STEPS], tokens2[STEPS], skipped2[STEPS];
+  float entropy[STEPS], probs[STEPS], entropy2[STEPS], probs2[STEPS];
+  uint32_t r1 = 31, r2 = 31;
+  ASSERT(lung_prophecy(lung, context, 6, STEPS, 0.8f, 0.0f, 0.5f, 3, &r1,
+                       tokens, entropy, probs, skipped) == STEPS);
+  ASSERT(lung_prophecy(lung, context, 6, STEPS, 0.8f, 0.0f, 0.5f, 3, &r2,
+                       tokens2, entropy2, probs2, skipped2) == STEPS);
+  ASSERT(memcmp(tokens, tokens2, sizeof(tokens)) == 0);
+  ASSERT(memcmp(skipped, skipped2, sizeof(skipped)) == 0);
+
+  // skips come in runs of 1..skip_max after a forward, reusing its entropy
+  int n_skipped = 0, run = 0;
+  ASSERT(skipped[0] == 0);
+  for (int s = 0; s < STEPS; s++) {
+    run = skipped[s] ? run + 1 : 0;
+    ASSERT(run <= 3);
+    if (skipped[s]) ASSERT(entropy[s] == entropy[s - 1]);
+    n_skipped += skipped[s];
+  }
+  ASSERT(n_skipped > 0 && n_skipped < STEPS);
+  ASSERT(prophecy_replay(ref, context, 6, STEPS, tokens, entropy, probs, skipped, 0));
+  lung_destroy(lung);
+  lung_destroy(ref);
+}
+
+TEST(prophecy_am_state_and_continuation) {
+  enum { V = 400 };
+  lung_seed(145);
+  AriannaLung* lung = lung_create(V, 16, 8, 2);
+  ASSERT(lung != NULL);
+  int context[8];
+  fill_context(context, 8, V, 146);
+
+  AM_State am;
+  memset(&am, 0, sizeof(am));
+  am.prophecy = 200;  // clamped to the kernel's ceiling
+  am.destiny = 1.0f;
+  am.effective_temp = 0.85f;
+  int tokens[LUNG_PROPHECY_MAX], skipped[LUNG_PROPHECY_MAX];
+  float entropy[LUNG_PROPHECY_MAX], probs[LUNG_PROPHECY_MAX];
+  ASSERT(lung_prophecy_am(lung, &am, context, 8, NULL, tokens, entropy, probs, skipped) ==
+         LUNG_PROPHECY_MAX);
+  for (int s = 0; s < LUNG_PROPHECY_MAX; s++) {
+    ASSERT(!skipped[s] && probs[s] > 0.0f && entropy[s] > 0.0f);
+  }
+
+  // NULL context continues from the live stream window
+  int window[8], a[10], b[10];
+  memcpy(window, tokens + LUNG_PROPHECY_MAX - 8, sizeof(window));
+  for (int t = 0; t < 8; t++) lung_push_token(lung, window[t]);
+  am.prophecy = 10;
+  ASSERT(lung_prophecy_am(lung, &am, NULL, 0, NULL, a, NULL, NULL, NULL) == 10);
+  ASSERT(lung_prophecy_am(lung, &am, window, 8, NULL, b, NULL, NULL, NULL) == 10);
+  ASSERT(memcmp(a, b, sizeof(a)) == 0);
+
+  ASSERT(lung_prophecy(lung, context, 8, 0, 1.0f, 1.0f, 0.0f, 0, NULL, a, NULL, NULL, NULL) == -1);
+  ASSERT(lung_prophecy_am(lung, NULL, context, 8, NULL, a, NULL, NULL, NULL) == -1);
+  lung_destroy(lung);
+}
+
+// A prophecy is not lived: a streaming session keeps its own window
+TEST(prophecy_leaves_stream_window) {
+  enum { V = 300 };
+  // ref lives the same session with no prophecies in between
+  lung_seed(147);
+  AriannaLung* lung = lung_create(V, 16, 8, 2);
+  lung_seed(147);
+  AriannaLung* ref = lung_create(V, 16, 8, 2);
+  ASSERT(lung != NULL && ref != NULL);
+  for (int t = 10; t <= 50; t += 4) {
+    lung_push_token(lung, t);
+    lung_push_token(ref, t);
+  }
+  int len = lung_get_stream_len(lung);
+
+  int context[3] = { 1, 2, 3 }, tokens[12];
+  for (int round = 0; round < 2; round++) {
+    lung_forward_cached(lung);
+    lung_forward_cached(ref);
+    // with a context, then continuing from the window itself
+    ASSERT(lung_prophecy(lung, round ? NULL : context, round ? 0 : 3, 12, 1.0f, 1.0f,
+                         0.0f, 0, NULL, tokens, NULL, NULL, NULL) == 12);
+    ASSERT(lung_get_stream_len(lung) == len);
+    ASSERT(lung_forward_cached(lung) == lung_forward_cached(ref));
+    ASSERT(memcmp(lung->last_logits, ref->last_logits, V * sizeof(float)) == 0);
+    ASSERT(lung_get_argmax(lung) == lung_get_argmax(ref));
+  }
+
+  lung_destroy(lung);
+  lung_destroy(ref);
+}
+
+// Reference beam search: full batched forwards over explicit windows
+static int beam_reference(AriannaLung* lung, const int* context, int n_ctx, int beam,
+                          int steps, int* out_tokens, float* out_scores) {
+  int ctx = lung->ctx_len, vocab = lung->vocab_size;
+  int* futures = (int*)calloc((size_t)beam * steps, sizeof(int));
+  int* next = (int*)calloc((size_t)beam * steps, sizeof(int));
+  int* windows = (int*)calloc((size_t)beam * ctx, sizeof(int));
+  float* logits = (float*)malloc((size_t)beam * vocab * sizeof(float));
+  float* probs = (float*)malloc((size_t)beam * vocab * sizeof(float));
+  int lens[LUNG_BEAM_MAX], cand_tok[LUNG_BEAM_MAX * LUNG_BEAM_MAX];
+  float score[LUNG_BEAM_MAX] = { 0.0f };
+  TopKEntry heap[LUNG_BEAM_MAX], branch[LUNG_BEAM_MAX];
+  int n_live = 1;
+
+  for (int s = 0; s < steps; s++) {
+    for (int b = 0; b < n_live; b++) {
+      int all[256], n = 0;
+      for (int t = 0; t < n_ctx; t++) all[n++] = context[t];
+      for (int t = 0; t < s; t++) all[n++] = futures[b * steps + t];
+      int from = n > ctx ? n - ctx : 0;
+      lens[b] = n - from;
+      memcpy(windows + b * ctx, all + from, lens[b] * sizeof(int));
+    }
+    lung_forward_batch_ex(lung, windows, lens, n_live, logits, probs, NULL, NULL);
+
+    TopK h;
+    topk_init(&h, heap, beam);
+    for (int b = 0; b < n_live; b++) {
+      TopK hb;
+      topk_init(&hb, branch, beam);
+      for (int i = 0; i < vocab; i++) topk_push(&hb, logits[b * vocab + i], i);
+      int found = topk_sort(&hb);
+      for (int j = 0; j < found; j++) {
+        cand_tok[b * beam + j] = branch[j].idx;
+        topk_push(&h, score[b] + logf(probs[b * vocab + branch[j].idx]), b * beam + j);
+      }
+    }
+    int n_next = topk_sort(&h);
+    for (int j = 0; j < n_next; j++) {
+      int b = heap[j].idx / beam;
+      memcpy(next + j * steps, futures + b * steps, s * sizeof(int));
+      next[j * steps + s] = cand_tok[heap[j].idx];
+      score[j] = heap[j].val;
+    }
+    memcpy(futures, next, (size_t)beam * steps * sizeof(int));
+    n_live = n_next;
+  }
+
+  memcpy(out_tokens, futures, (size_t)n_live * steps * sizeof(int));
+  memcpy(out_scores, score, n_live * sizeof(float));
+  free(futures);
+  free(next);
+  free(windows);
+  free(logits);
+  free(probs);
+  return n_live;
+}
+
+static int beam_matches_reference(AriannaLung* lung, const int* context, int n_ctx,
+                                  int beam, int steps) {
+  int tok[LUNG_BEAM_MAX * 32], ref_tok[LUNG_BEAM_MAX * 32];
+  float sc[LUNG_BEAM_MAX], ref_sc[LUNG_BEAM_MAX];
+  int n = lung_beam_search(lung, context, n_ctx, beam, steps, tok, sc);
+  int n_ref = beam_reference(lung, context, n_ctx, beam, steps, ref_tok, ref_sc);
+  if (n != n_ref || n <= 0) return 0;
+  if (memcmp(tok, ref_tok, (size_t)n * steps * sizeof(int)) != 0) return 0;
+  for (int b = 0; b < n; b++) {
+    if (fabsf(sc[b] - ref_sc[b]) > 1e-3f) return 0;
+    if (b > 0 && sc[b] > sc[b - 1]) return 0;
+  }
+  return 1;
+}
+
+TEST(beam_matches_batched_reference) {
+  enum { V = 600 };
+  lung_seed(150);
+  AriannaLung* lung = lung_create(V, 32, 8, 4);
+  ASSERT(lung != NULL);
+  int context[12];
+  fill_context(context, 12, V, 151);
+  float presence[V] = { 0.0f };
+  for (int i = 0; i < V; i += 7) presence[i] = 0.5f;
+  lung_load_presence(lung, presence);
+
+  ASSERT(beam_matches_reference(lung, context, 5, 4, 10));    // window fills up
+  ASSERT(beam_matches_reference(lung, context, 12, 8, 6));    // long context
+  ASSERT(beam_matches_reference(lung, context, 3, 1, 12));    // greedy
+  ASSERT(beam_matches_reference(lung, context, 0, 3, 4));     // empty context
+  ASSERT(beam_matches_reference(lung, context, 8, LUNG_BEAM_MAX, 3));
+  lung_set_rtl(lung, 1);
+  lung_set_temporal_alpha(lung, 0.8f);
+  ASSERT(beam_matches_reference(lung, context, 8, 5, 8));
+  lung_destroy(lung);
+
+  // compressed weights go through the same node projections
+  lung_seed(152);
+  lung = lung_create(V, 32, 8, 4);
+  ASSERT(lung != NULL && lung_quantize(lung, 8));
+  ASSERT(beam_matches_reference(lung, context, 6, 4, 6));
+  lung_destroy(lung);
+}
+
+TEST(beam_small_vocab_and_state_untouched) {
+  lung_seed(153);
+  AriannaLung* lung = lung_create(3, 16, 4, 2);
+  ASSERT(lung != NULL);
+  int context[2] = { 1, 2 };
+  lung_forward(lung, context, 2);
+
+  float logits[3], probs[3], attention[4], presence[3];
+  memcpy(logits, lung->last_logits, sizeof(logits));
+  memcpy(probs, lung->last_probs, sizeof(probs));
+  memcpy(attention, lung->last_attention, sizeof(attention));
+  lung_copy_presence(lung, presence);
+
+  // one step: every token once, scores are its log-probabilities
+  int tok[LUNG_BEAM_MAX * 4];
+  float sc[LUNG_BEAM_MAX];
+  ASSERT(lung_beam_search(lung, context, 2, 5, 1, tok, sc) == 3);
+  ASSERT(tok[0] != tok[1] && tok[1] != tok[2] && tok[0] != tok[2]);
+  float batch_probs[3];
+  int window[4] = { 1, 2, 0, 0 }, len = 2;
+  lung_forward_batch(lung, window, &len, 1, batch_probs, NULL);
+  for (int b = 0; b < 3; b++) ASSERT_FLOAT_EQ(sc[b], logf(batch_probs[tok[b]]), 1e-4f);
+
+  // two steps: 9 futures, the best 5 kept, all distinct
+  ASSERT(lung_beam_search(lung, context, 2, 5, 2, tok, sc) == 5);
+  for (int a = 0; a < 5; a++) {
+    for (int b = a + 1; b < 5; b++) {
+      ASSERT(tok[a * 2] != tok[b * 2] || tok[a * 2 + 1] != tok[b * 2 + 1]);
+    }
+  }
+
+  ASSERT(memcmp(logits, lung->last_logits, sizeof(logits)) == 0);
+  ASSERT(memcmp(probs, lung->last_probs, sizeof(probs)) == 0);
+  ASSERT(memcmp(attention, lung->last_attention, sizeof(attention)) == 0);
+  ASSERT(presence_matches(lung, presence));
+  ASSERT(lung_beam_search(lung, context, 2, 0, 2, tok, sc) == -1);
+  lung_destroy(lung);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// SECTION N: LAZY PRESENCE (epoch stamps, active set)
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// Active set: sorted, and exactly the tokens with stored presence
+static int presence_active_consistent(const AriannaLung* lung) {
+  int n = 0;
+  for (int i = 0; i < lung->vocab_size; i++) n += lung->presence_accum[i] != 0.0f;
+  if (n != lung->n_active) return 0;
+  for (int a = 0; a < lung->n_active; a++) {
+    if (lung->presence_accum[lung->presence_active[a]] == 0.0f) return 0;
+    if (a > 0 && lung->presence_active[a] <= lung->presence_active[a - 1]) return 0;
+  }
+  return 1;
+}
+
+TEST(presence_lazy_matches_eager_sweep) {
+  enum { V = 5000, CTX = 8, STEPS = 900 };
+  lung_seed(160);
+  AriannaLung* lung = lung_create(V, 16, CTX, 2);
+  ASSERT(lung != NULL);
+
+  // eager reference: decay every token, then bump the context
+  float* eager = (float*)calloc(V, sizeof(float));
+  float* lazy = (float*)malloc(V * sizeof(float));
+  int context[CTX];
+  unsigned int seed = 161;
+  for (int s = 0; s < STEPS; s++) {
+    // a few hot tokens recur, the rest wander (and fade out of the set)
+    fill_context(context, CTX, (s % 50 < 25) ? 40 : V, seed++);
+    lung_forward(lung, context, CTX - (s % 3));
+    for (int i = 0; i < V; i++) eager[i] *= lung->presence_decay;
+    for (int t = 0; t < CTX - (s % 3); t++) {
+      float v = eager[context[t]] + PRESENCE_INCREMENT;
+      eager[context[t]] = v > 1.0f ? 1.0f : v;
+    }
+    if (s % 100 == 99) {
+      lung_copy_presence(lung, lazy);
+      ASSERT(max_abs_diff(eager, lazy, V) < 2e-5f);
+      ASSERT(presence_active_consistent(lung));
+      ASSERT_FLOAT_EQ(lung_get_presence(lung, context[0]), eager[context[0]], 2e-5f);
+    }
+  }
+
+  // faded tokens have left: far fewer active than ever touched
+  int touched = 0;
+  for (int i = 0; i < V; i++) touched += eager[i] > 0.0f;
+  ASSERT(lung->n_active < touched);
+  for (int a = 0; a < lung->n_active; a++) {
+    ASSERT(eager[lung->presence_active[a]] >= PRESENCE_EPSILON * 0.5f);
+  }
+  free(eager);
+  free(lazy);
+  lung_destroy(lung);
+}
+
+TEST(presence_load_and_rollout_restore) {
+  enum { V = 300 };
+  lung_seed(162);
+  AriannaLung* lung = lung_create(V, 16, 6, 2);
+  ASSERT(lung != NULL);
+  float p[V] = { 0.0f }, q[V];
+  p[3] = 0.25f;
+  p[299] = 1.0f;
+  p[150] = 1e-7f;  // below epsilon: kept until the next exhale
+  lung_load_presence(lung, p);
+  ASSERT(lung->n_active == 3 && presence_active_consistent(lung));
+  ASSERT(presence_matches(lung, p));
+
+  int context[6] = { 3, 3, 7, 8, 9, 10 };
+  lung_forward(lung, context, 6);
+  ASSERT(presence_active_consistent(lung));
+  ASSERT(lung_get_presence(lung, 150) == 0.0f);
+  ASSERT_FLOAT_EQ(lung_get_presence(lung, 3), 0.25f * PRESENCE_DECAY + 2 * PRESENCE_INCREMENT, 1e-6f);
+  ASSERT_FLOAT_EQ(lung_get_presence(lung, 299), PRESENCE_DECAY, 1e-6f);
+
+  // a rollout restores epochs, values and the set exactly
+  lung_copy_presence(lung, q);
+  int n_active = lung->n_active, tokens[20];
+  ASSERT(lung_prophecy(lung, context, 6, 20, 1.0f, 0.0f, 0.0f, 0, NULL, tokens, NULL, NULL, NULL) == 20);
+  ASSERT(presence_matches(lung, q) && lung->n_active == n_active);
+  ASSERT(presence_active_consistent(lung));
+
+  lung_load_presence(lung, NULL);
+  ASSERT(lung->n_active == 0 && lung_get_presence(lung, 3) == 0.0f);
+  lung_destroy(lung);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// SECTION O: LENGTH-AWARE ATTENTION (padding masked out)
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// A masked lung on a short context is the same lung cut to that length (LTR:
+// positions, weights and resonance do not depend on ctx_len)
+static int masked_matches_short_lung(int len, int fold, unsigned int seed) {
+  enum { V = 90, D = 32, CTX = 16, H = 4 };
+  lung_seed(seed);
+  AriannaLung* big = lung_create(V, D, CTX, H);
+  lung_seed(seed);
+  AriannaLung* small = lung_create(V, D, len, H);
+  if (!big || !small) return 0;
+  lung_set_mask_padding(big, 1);
+  lung_set_temporal_alpha(big, 0.8f);
+  lung_set_temporal_alpha(small, 0.8f);
+
+  int context[CTX];
+  fill_context(context, CTX, V, seed + 1);
+  float lb[V], pb[V], ab[CTX], ls[V], ps[V], as[CTX];
+  float eb = forward_snapshot(big, fold, context, len, lb, pb, ab);
+  float es = forward_snapshot(small, fold, context, len, ls, ps, as);
+
+  int ok = fabsf(eb - es) < 1e-5f && max_abs_diff(pb, ps, V) < 1e-6f &&
+           max_abs_diff(ab, as, len) < 1e-6f;
+  for (int t = len; t < CTX; t++) ok = ok && ab[t] == 0.0f;
+  lung_destroy(big);
+  lung_destroy(small);
+  return ok;
+}
+
+TEST(mask_matches_short_lung) {
+  for (int fold = 0; fold <= 1; fold++) {
+    ASSERT(masked_matches_short_lung(1, fold, 170));
+    ASSERT(masked_matches_short_lung(5, fold, 171));
+    ASSERT(masked_matches_short_lung(16, fold, 172));
+  }
+}
+
+TEST(mask_paths_agree) {
+  // streaming: partial windows, then sliding (LTR and RTL)
+  ASSERT(stream_matches_full(64, 32, 8, 4, 20, 0, 0.7f, 173, 1));
+  ASSERT(stream_matches_full(64, 32, 8, 4, 20, 1, 0.3f, 174, 1));
+
+  lung_seed(175);
+  AriannaLung* lung = lung_create(70, 32, 12, 4);
+  ASSERT(lung != NULL);
+  lung_set_mask_padding(lung, 1);
+  lung_set_temporal_alpha(lung, 0.65f);
+
+  // batch (lengths 0..ctx) against single masked forwards
+  ASSERT(batch_matches_single(lung, 7));
+
+  // threads: same bits as serial
+  int context[12];
+  fill_context(context, 12, 70, 176);
+  float l1[70], p1[70], a1[12], l2[70], p2[70], a2[12];
+  forward_snapshot(lung, 1, context, 5, l1, p1, a1);
+  lung_set_threads(4);
+  forward_snapshot(lung, 1, context, 5, l2, p2, a2);
+  lung_set_threads(1);
+  ASSERT(memcmp(p1, p2, sizeof(p1)) == 0 && memcmp(a1, a2, sizeof(a1)) == 0);
+
+  // beam search over short windows
+  ASSERT(beam_matches_reference(lung, context, 3, 4, 5));
+  lung_destroy(lung);
+}
+
+TEST(mask_explicit_and_empty) {
+  enum { V = 60, CTX = 10 };
+  lung_seed(177);
+  AriannaLung* lung = lung_create(V, 24, CTX, 3);
+  ASSERT(lung != NULL);
+  int context[CTX];
+  fill_context(context, CTX, V, 178);
+  float l1[V], p1[V], a1[CTX];
+
+  // NULL mask ≡ mask_padding mode
+  lung_set_mask_padding(lung, 1);
+  forward_snapshot(lung, 1, context, 6, l1, p1, a1);
+  lung_set_mask_padding(lung, 0);
+  lung_forward_masked(lung, context, 6, NULL);
+  ASSERT(memcmp(p1, lung_get_probs(lung), sizeof(p1)) == 0);
+
+  // an all-ones mask attends to the pads too: the default forward
+  uint8_t mask[CTX];
+  memset(mask, 1, sizeof(mask));
+  forward_snapshot(lung, 1, context, 6, l1, p1, a1);
+  lung_forward_masked(lung, context, 6, mask);
+  ASSERT(memcmp(p1, lung_get_probs(lung), sizeof(p1)) == 0);
+  ASSERT(memcmp(a1, lung_get_attention(lung), sizeof(a1)) == 0);
+
+  // holes and an explicitly kept pad
+  memset(mask, 0, sizeof(mask));
+  mask[0] = mask[1] = mask[3] = mask[4] = mask[8] = 1;
+  lung_forward_masked(lung, context, 6, mask);
+  const float* att = lung_get_attention(lung);
+  float sum = 0.0f;
+  for (int t = 0; t < CTX; t++) {
+    ASSERT((att[t] > 0.0f) == (mask[t] != 0));
+    sum += att[t];
+  }
+  ASSERT_FLOAT_EQ(sum, 1.0f, 1e-5f);
+
+  // nothing to attend: one pad at position 0
+  float entropy = lung_forward_masked(lung, context, 0, NULL);
+  ASSERT(isfinite(entropy));
+  ASSERT_FLOAT_EQ(lung_get_attention(lung)[0], 1.0f, 1e-6f);
+  lung_destroy(lung);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// SECTION P: SPARSE ATTENTION (sliding window + prime anchors)
+// ═══════════════════════════════════════════════════════════════════════════════
+
+TEST(sparse_positions_window_and_primes) {
+  lung_seed(180);
+  AriannaLung* lung = lung_create(40, 16, 32, 2);
+  ASSERT(lung != NULL);
+  ASSERT(lung_set_sparse_attention(lung, 8, 5) == 5);
+  int pos[32];
+
+  // padded: window 24..31, anchors before it
+  int n = attend_positions(lung, 32, 0, NULL, pos);
+  static const int full[] = { 2, 3, 5, 7, 11, 24, 25, 26, 27, 28, 29, 30, 31 };
+  ASSERT(n == 13 && memcmp(pos, full, sizeof(full)) == 0);
+
+  // length-aware: the window ends at the newest real token
+  n = attend_positions(lung, 14, 1, NULL, pos);
+  static const int short14[] = { 2, 3, 5, 6, 7, 8, 9, 10, 11, 12, 13 };
+  ASSERT(n == 11 && memcmp(pos, short14, sizeof(short14)) == 0);
+
+  // explicit mask: holes apply to anchors and window alike
+  uint8_t mask[32] = { 0 };
+  for (int t = 0; t < 20; t++) mask[t] = (t != 3 && t != 15);
+  n = attend_positions(lung, 32, 1, mask, pos);
+  static const int holes[] = { 2, 5, 7, 11, 12, 13, 14, 16, 17, 18, 19 };
+  ASSERT(n == 11 && memcmp(pos, holes, sizeof(holes)) == 0);
+
+  // a window reaching back to 0 is dense; anchors are primes below ctx
+  n = attend_positions(lung, 6, 1, NULL, pos);
+  ASSERT(n == 6 && pos[0] == 0 && pos[5] == 5);
+  ASSERT(lung_set_sparse_attention(lung, 4, 100) == 11 && lung->anchors[10] == 31);
+  ASSERT(lung_set_sparse_attention(lung, 0, 3) == 3);
+  n = attend_positions(lung, 32, 0, NULL, pos);
+  ASSERT(n == 32);
+  lung_destroy(lung);
+}
+
+// Sparse forward ≡ dense forward under the equivalent explicit mask
+TEST(sparse_matches_explicit_mask) {
+  enum { V = 70, CTX = 24 };
+  lung_seed(181);
+  AriannaLung* lung = lung_create_sparse(V, 32, CTX, 4, 6, 4);
+  ASSERT(lung != NULL && lung->attn_window == 6 && lung->n_anchors == 4);
+  lung_set_temporal_alpha(lung, 0.7f);
+  int context[CTX], pos[CTX];
+  fill_context(context, CTX, V, 182);
+  float l1[V], p1[V], a1[CTX];
+
+  for (int fold = 0; fold <= 1; fold++) {
+    for (int masked = 0; masked <= 1; masked++) {
+      int len = masked ? 17 : CTX;
+      lung_set_mask_padding(lung, masked);
+      uint8_t mask[CTX] = { 0 };
+      int n = attend_positions(lung, len, masked, NULL, pos);
+      for (int j = 0; j < n; j++) mask[pos[j]] = 1;
+
+      float e1 = forward_snapshot(lung, fold, context, len, l1, p1, a1);
+      lung_set_sparse_attention(lung, 0, 0);
+      float e2 = lung_forward_masked(lung, context, len, mask);
+      ASSERT(e1 == e2 && memcmp(p1, lung_get_probs(lung), sizeof(p1)) == 0);
+      ASSERT(memcmp(a1, lung_get_attention(lung), sizeof(a1)) == 0);
+      for (int t = 0; t < CTX; t++) ASSERT((a1[t] != 0.0f) == (mask[t] != 0));
+      lung_set_sparse_attention(lung, 6, 4);
+    }
+  }
+  lung_destroy(lung);
+}
+
+TEST(sparse_paths_agree) {
+  enum { V = 64, CTX = 20, N = 36 };
+  lung_seed(183);
+  AriannaLung* lung = lung_create_sparse(V, 32, CTX, 4, 5, 3);
+  ASSERT(lung != NULL);
+  lung_set_mask_padding(lung, 1);
+  lung_set_temporal_alpha(lung, 0.35f);
+
+  // streaming: cached forward over the window ≡ full forward
+  int tokens[N];
+  fill_context(tokens, N, V, 184);
+  float l1[V], p1[V], a1[CTX];
+  for (int i = 0; i < N; i++) {
+    int len = lung_push_token(lung, tokens[i]);
+    int start = i + 1 - len;
+    float ef = forward_snapshot(lung, 1, tokens + start, len, l1, p1, a1);
+    float ec = lung_forward_cached(lung);
+    ASSERT_FLOAT_EQ(ef, ec, 1e-4f);
+    ASSERT(max_abs_diff(p1, lung_get_probs(lung), V) < 1e-5f);
+    ASSERT(max_abs_diff(a1, lung_get_attention(lung), CTX) < 1e-5f);
+  }
+
+  // batch, threads and beam search
+  ASSERT(batch_matches_single(lung, 9));
+  lung_set_threads(4);
+  float l2[V], p2[V], a2[CTX];
+  forward_snapshot(lung, 1, tokens, CTX, l2, p2, a2);
+  lung_set_threads(1);
+  forward_snapshot(lung, 1, tokens, CTX, l1, p1, a1);
+  ASSERT(memcmp(p1, p2, sizeof(p1)) == 0 && memcmp(a1, a2, sizeof(a1)) == 0);
+  ASSERT(beam_matches_reference(lung, tokens, 12, 3, 10));
+  lung_destroy(lung);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// SECTION Q: GROUPED-QUERY ATTENTION (shared key/value heads)
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// A multi-head lung whose K/V blocks repeat each GQA key/value head across
+// its group computes exactly what the GQA lung computes
+static AriannaLung* mha_twin(AriannaLung* gqa) {
+  int V = gqa->vocab_size, D = gqa->d_model, H = gqa->n_heads;
+  int hd = gqa->head_dim, group = H / gqa->n_kv_heads;
+  AriannaLung* mha = lung_create(V, D, gqa->ctx_len, H);
+  float* w = (float*)malloc((size_t)H * hd * D * sizeof(float));
+  float* kv = (float*)malloc((size_t)gqa->kv_dim * D * sizeof(float));
+  if (!mha || !w || !kv) {
+    free(w); free(kv);
+    return mha;
+  }
+  memcpy(mha->E, gqa->E, (size_t)V * D * sizeof(float));
+  memcpy(mha->Wo, gqa->Wo, (size_t)V * D * sizeof(float));
+  lung_sync_output_weights(mha);
+  memcpy(mha->resonance, gqa->resonance, V * sizeof(float));
+  lung_copy_qkv_weights(gqa, QKV_Q, w);
+  lung_load_qkv_weights(mha, QKV_Q, w);
+  for (int m = QKV_K; m <= QKV_V; m++) {
+    lung_copy_qkv_weights(gqa, m, kv);
+    for (int h = 0; h < H; h++) {
+      memcpy(w + (size_t)h * hd * D, kv + (size_t)(h / group) * hd * D, (size_t)hd * D * sizeof(float));
+    }
+    lung_load_qkv_weights(mha, m, w);
+  }
+  free(w); free(kv);
+  return mha;
+}
+
+TEST(gqa_matches_repeated_kv_heads) {
+  enum { V = 80, D = 48, CTX = 10, H = 6 };
+  int context[CTX];
+  fill_context(context, CTX, V, 190);
+  static const int kv_heads[] = { 3, 2, 1 };
+  for (int i = 0; i < 3; i++) {
+    lung_seed(191 + i);
+    AriannaLung* gqa = lung_create_gqa(V, D, CTX, H, kv_heads[i]);
+    ASSERT(gqa != NULL && lung_get_n_kv_heads(gqa) == kv_heads[i] && gqa->kv_dim == kv_heads[i] * 8);
+    AriannaLung* mha = mha_twin(gqa);
+    ASSERT(mha != NULL);
+    lung_set_temporal_alpha(gqa, 0.6f);
+    lung_set_temporal_alpha(mha, 0.6f);
+
+    float l1[V], p1[V], a1[CTX], l2[V], p2[V], a2[CTX];
+    for (int fold = 0; fold <= 1; fold++) {
+      for (int len = 4; len <= CTX; len += CTX - 4) {
+        float e1 = forward_snapshot(gqa, fold, context, len, l1, p1, a1);
+        float e2 = forward_snapshot(mha, fold, context, len, l2, p2, a2);
+        ASSERT_FLOAT_EQ(e1, e2, 1e-5f);
+        ASSERT(max_abs_diff(p1, p2, V) < 1e-6f && max_abs_diff(a1, a2, CTX) < 1e-6f);
+      }
+    }
+    lung_destroy(mha);
+    lung_destroy(gqa);
+  }
+  ASSERT(lung_create_gqa(V, D, CTX, H, 4) == NULL);  // 4 does not divide 6
+  ASSERT(lung_create_gqa(V, D, CTX, H, 0) == NULL);
+}
+
+TEST(gqa_paths_agree) {
+  enum { V = 72, D = 32, CTX = 8, N = 20 };
+  for (int quant = 0; quant <= 1; quant++) {
+    lung_seed(195 + quant);
+    AriannaLung* lung = lung_create_gqa(V, D, CTX, 4, 2);
+    ASSERT(lung != NULL);
+    ASSERT(lung_set_packed_qkv(lung, 1) == 0 && !lung->packed_qkv);
+    if (quant) ASSERT(lung_quantize(lung, 8));
+
+    // streaming cache (kv_dim rows) against full forwards
+    int tokens[N];
+    fill_context(tokens, N, V, 197);
+    float l1[V], p1[V], a1[CTX];
+    for (int i = 0; i < N; i++) {
+      int len = lung_push_token(lung, tokens[i]);
+      float ef = forward_snapshot(lung, 1, tokens + i + 1 - len, len, l1, p1, a1);
+      ASSERT_FLOAT_EQ(ef, lung_forward_cached(lung), 1e-4f);
+      ASSERT(max_abs_diff(p1, lung_get_probs(lung), V) < 1e-5f);
+      ASSERT(max_abs_diff(a1, lung_get_attention(lung), CTX) < 1e-5f);
+    }
+
+    // unfolded reference, batch, threads and beam search
+    float l2[V], p2[V], a2[CTX];
+    forward_snapshot(lung, 0, tokens, CTX, l2, p2, a2);
+    forward_snapshot(lung, 1, tokens, CTX, l1, p1, a1);
+    ASSERT(max_abs_diff(p1, p2, V) < 1e-5f);
+    lung_set_threads(3);
+    forward_snapshot(lung, 1, tokens, CTX, l2, p2, a2);
+    lung_set_threads(1);
+    ASSERT(memcmp(p1, p2, sizeof(p1)) == 0 && memcmp(a1, a2, sizeof(a1)) == 0);
+    ASSERT(batch_matches_single(lung, 6));
+    ASSERT(beam_matches_reference(lung, tokens, CTX, 3, 4));
+    lung_destroy(lung);
+  }
+}
+
+TEST(gqa_storage_and_checkpoint) {
+  enum { V = 90, D = 32, CTX = 6, H = 8 };
+  int context[CTX];
+  fill_context(context, CTX, V, 198);
+  lung_seed(199);
+  AriannaLung* mha = lung_create(V, D, CTX, H);
+  lung_seed(199);
+  AriannaLung* mqa = lung_create_gqa(V, D, CTX, H, 1);
+  ASSERT(mha != NULL && mqa != NULL);
+
+  // Q stays, K and V shrink by n_heads / n_kv_heads
+  size_t qkv_row = (size_t)D * sizeof(float);
+  ASSERT(lung_weight_bytes(mha) - lung_weight_bytes(mqa) == 2 * (size_t)(D - D / H) * qkv_row);
+  ASSERT(mqa->kv_dim == D / H && mha->kv_dim == D);
+
+  for (int kind = 0; kind <= 1; kind++) {
+    if (kind) ASSERT(lung_quantize(mqa, 4));
+    ASSERT(lung_save(mqa, CKPT_PATH));
+    ASSERT(lung_verify_checkpoint(CKPT_PATH));
+    AriannaLung* a = lung_open_mmap(CKPT_PATH);
+    ASSERT(a != NULL);
+    ASSERT(lung_get_n_heads(a) == H && lung_get_n_kv_heads(a) == 1);
+    ASSERT(lung_weight_bytes(a) == lung_weight_bytes(mqa));
+    lung_load_presence(mqa, NULL);
+    lung_forward(mqa, context, CTX);
+    lung_forward(a, context, CTX);
+    ASSERT(memcmp(mqa->last_probs, a->last_probs, V * sizeof(float)) == 0);
+    lung_destroy(a);
+  }
+
+  // a header claiming a head split that does not divide is rejected
+  uint32_t bad = 3;
+  patch_file(CKPT_PATH, offsetof(LungCkptHeader, n_kv_heads), &bad, sizeof(bad));
+  ASSERT(lung_open_mmap(CKPT_PATH) == NULL);
+  remove(CKPT_PATH);
+  lung_destroy(mqa);
+  lung_destroy(mha);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// SECTION R: CANDIDATE SHORTLIST (sparse output projection)
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// Output rows in `groups` tight clusters (trained vocabularies cluster;
+// random rows do not, and no shortlist can find their top tokens)
+static int load_clustered_output(AriannaLung* lung, int groups, float spread, unsigned int seed) {
+  int V = lung->vocab_size, D = lung->d_model;
+  float* centers = (float*)malloc((size_t)groups * D * sizeof(float));
+  float* Wo = (float*)malloc((size_t)D * V * sizeof(float));
+  if (!centers || !Wo) {
+    free(centers); free(Wo);
+    return 0;
+  }
+  for (int i = 0; i < groups * D; i++) {
+    seed = seed * 1103515245u + 12345u;
+    centers[i] = ((float)(seed >> 8) / 16777216.0f - 0.5f) * 4.0f;
+  }
+  for (int j = 0; j < V; j++) {
+    const float* c = centers + (size_t)(j % groups) * D;
+    for (int i = 0; i < D; i++) {
+      seed = seed * 1103515245u + 12345u;
+      Wo[(size_t)i * V + j] = c[i] + ((float)(seed >> 8) / 16777216.0f - 0.5f) * spread;
+    }
+  }
+  int ok = lung_load_output_weights(lung, Wo);
+  free(centers); free(Wo);
+  return ok;
+}
+
+static int in_list(const int* ids, int n, int x) {
+  for (int i = 0; i < n; i++) if (ids[i] == x) return 1;
+  return 0;
+}
+
+TEST(shortlist_all_clusters_is_exact) {
+  enum { V = 300, D = 32, CTX = 8 };
+  int context[CTX], ids[V];
+  fill_context(context, CTX, V, 200);
+  float l1[V], p1[V], a1[CTX], l2[V], p2[V], a2[CTX];
+
+  for (int quant = 0; quant <= 1; quant++) {
+    lung_seed(201 + quant);
+    AriannaLung* lung = lung_create(V, D, CTX, 4);
+    ASSERT(lung != NULL);
+    if (quant) ASSERT(lung_quantize(lung, 8));
+    for (int r = 0; r < 3; r++) lung_forward(lung, context + r, CTX - r);  // live presence
+
+    // every cluster probed = every token scored, nothing in the tail
+    int C = lung_set_shortlist(lung, V);
+    ASSERT(C == 18);
+    float e1 = forward_snapshot(lung, 1, context, CTX, l1, p1, a1);
+    ASSERT(lung_get_shortlist(lung, ids, V) == V && lung_get_tail_mass(lung) == 0.0f);
+    int top1[8], top2[8];
+    lung_get_top_k(lung, top1, 8);
+    lung_set_shortlist(lung, 0);
+    float e2 = forward_snapshot(lung, 1, context, CTX, l2, p2, a2);
+    lung_get_top_k(lung, top2, 8);
+    ASSERT(lung_get_shortlist(lung, ids, V) == 0);
+    ASSERT_FLOAT_EQ(e1, e2, 1e-5f);
+    ASSERT(max_abs_diff(l1, l2, V) < 1e-5f && max_abs_diff(p1, p2, V) < 1e-6f);
+    ASSERT(memcmp(top1, top2, sizeof(top1)) == 0);
+
+    // the cached path goes through the same exhale
+    lung_set_shortlist(lung, C);
+    for (int i = 0; i < CTX; i++) lung_push_token(lung, context[i]);
+    float ec = lung_forward_cached(lung);
+    ASSERT_FLOAT_EQ(ec, e1, 1e-4f);
+    ASSERT(max_abs_diff(p1, lung_get_probs(lung), V) < 1e-5f);
+    lung_destroy(lung);
+  }
+}
+
+TEST(shortlist_finds_top_tokens) {
+  enum { V = 4096, D = 64, CTX = 8, PROBE = 4 };
+  static float full[V];
+  static int ids[V];
+  lung_seed(203);
+  AriannaLung* lung = lung_create(V, D, CTX, 4);
+  ASSERT(lung != NULL && load_clustered_output(lung, 64, 0.4f, 204));
+  ASSERT(lung_set_shortlist(lung, PROBE) == 64);
+
+  float presence[V];
+  int context[CTX];
+  for (int trial = 0; trial < 6; trial++) {
+    fill_context(context, CTX, V, 205 + trial);
+    lung_copy_presence(lung, presence);
+    lung_set_shortlist(lung, 0);
+    lung_forward(lung, context, CTX);
+    memcpy(full, lung_get_probs(lung), sizeof(full));
+    int top_full[8], top_short[8];
+    lung_get_top_k(lung, top_full, 8);
+    lung_load_presence(lung, presence);
+
+    lung_set_shortlist(lung, PROBE);
+    lung_forward(lung, context, CTX);
+    int n = lung_get_shortlist(lung, ids, V);
+    ASSERT(n > 0 && n < V / 4);
+    lung_get_top_k(lung, top_short, 8);
+    ASSERT(memcmp(top_full, top_short, sizeof(top_full)) == 0);
+
+    // candidates + tail = 1; the estimate tracks the true tail mass
+    const float* probs = lung_get_probs(lung);
+    const float* logits = lung_get_logits(lung);
+    double scored = 0.0, true_tail = 1.0;
+    for (int j = 0; j < n; j++) {
+      scored += probs[ids[j]];
+      true_tail -= full[ids[j]];
+    }
+    float tail = lung_get_tail_mass(lung);
+    ASSERT(fabs(scored + tail - 1.0) < 1e-4);
+    ASSERT(fabs(tail - true_tail) < 0.1 * true_tail + 1e-3);
+    for (int i = 0; i < V; i++) {
+      if (!in_list(ids, n, i)) ASSERT(probs[i] == 0.0f && isinf(logits[i]));
+    }
+  }
+  lung_destroy(lung);
+}
+
+TEST(shortlist_candidates_and_refit) {
+  enum { V = 400, D = 32, CTX = 6 };
+  int context[CTX], ids[V];
+  fill_context(context, CTX, V, 210);
+  lung_seed(211);
+  AriannaLung* lung = lung_create(V, D, CTX, 4);
+  ASSERT(lung != NULL && lung_set_shortlist(lung, 1) > 0);
+
+  // presence-active and top-resonance tokens are always scored
+  lung_boost_resonance(lung, 123, 1.0f);
+  lung_forward(lung, context, CTX);
+  lung_forward(lung, context + 1, CTX - 1);
+  int n = lung_get_shortlist(lung, ids, V);
+  ASSERT(in_list(ids, n, 123));
+  for (int t = 0; t < CTX; t++) ASSERT(in_list(ids, n, context[t]));
+  for (int j = 0; j < n; j++) ASSERT(lung_get_token_prob(lung, ids[j]) > 0.0f);
+
+  // new output weights refit the clusters: probing all stays exact
+  ASSERT(load_clustered_output(lung, 20, 0.2f, 212));
+  lung_set_shortlist(lung, V);
+  float l1[V], p1[V], a1[CTX], l2[V], p2[V], a2[CTX];
+  forward_snapshot(lung, 1, context, CTX, l1, p1, a1);
+  lung_set_shortlist(lung, 0);
+  forward_snapshot(lung, 1, context, CTX, l2, p2, a2);
+  ASSERT(max_abs_diff(p1, p2, V) < 1e-6f);
+
+  // back to the full vocab: every logit finite, no tail
+  for (int i = 0; i < V; i++) ASSERT(isfinite(l2[i]));
+  ASSERT(lung_get_tail_mass(lung) == 0.0f);
+  lung_destroy(lung);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// SECTION S: SHARED WEIGHTS (LungWeights + sessions)
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// Full and cached forwards of a session and of a private lung built from the
+// same seed agree bit for bit, step after step
+static int session_tracks_private(AriannaLung* session, AriannaLung* own, unsigned int seed) {
+  enum { STEPS = 12 };
+  int V = own->vocab_size, ctx = own->ctx_len;
+  int tokens[STEPS];
+  fill_context(tokens, STEPS, V, seed);
+  for (int i = 0; i < STEPS; i++) {
+    int len = i + 1 < ctx ? i + 1 : ctx;
+    float e1 = lung_forward(session, tokens + i + 1 - len, len);
+    float e2 = lung_forward(own, tokens + i + 1 - len, len);
+    if (e1 != e2 || memcmp(session->last_probs, own->last_probs, V * sizeof(float)) != 0) return 0;
+    lung_push_token(session, tokens[i]);
+    lung_push_token(own, tokens[i]);
+    e1 = lung_forward_cached(session);
+    e2 = lung_forward_cached(own);
+    if (e1 != e2 || memcmp(session->last_probs, own->last_probs, V * sizeof(float)) != 0) return 0;
+  }
+  return 1;
+}
+
+TEST(sessions_share_one_weight_copy) {
+  enum { V = 96, D = 32, CTX = 8, H = 4, N = 3 };
+  lung_seed(220);
+  AriannaLung* lung = lung_create_gqa(V, D, CTX, H, 2);
+  AriannaLung* own[N];
+  for (int i = 0; i < N; i++) {
+    lung_seed(220);
+    own[i] = lung_create_gqa(V, D, CTX, H, 2);
+    ASSERT(own[i] != NULL);
+  }
+  LungWeights* w = lung_share_weights(lung);
+  ASSERT(w != NULL && lung_share_weights(lung) == w && w->refs == 1);
+
+  LungSession* s[N] = { lung, lung_session_new(w), lung_session_new(w) };
+  ASSERT(s[1] != NULL && s[2] != NULL && w->refs == 3);
+  for (int i = 1; i < N; i++) {
+    ASSERT(s[i]->E == lung->E && s[i]->Wk == lung->Wk && s[i]->WoT == lung->WoT);
+    ASSERT(s[i]->P_ltr == lung->P_ltr && s[i]->X != lung->X);
+    ASSERT(lung_get_n_kv_heads(s[i]) == 2);
+  }
+
+  // interleaved sessions keep separate state
+  lung_set_temporal_alpha(s[1], 0.8f);
+  lung_set_temporal_alpha(own[1], 0.8f);
+  for (int round = 0; round < 2; round++) {
+    for (int i = 0; i < N; i++) ASSERT(session_tracks_private(s[i], own[i], 221 + 7 * i + round));
+  }
+  ASSERT(lung_session_bytes(s[1]) < lung_weight_bytes(s[1]));
+
+  // the creating lung can go first; the weights live on with the sessions
+  lung_destroy(s[0]);
+  ASSERT(w->refs == 2 && session_tracks_private(s[1], own[1], 230));
+  lung_destroy(s[1]);
+  ASSERT(session_tracks_private(s[2], own[2], 231));
+  lung_destroy(s[2]);
+  for (int i = 0; i < N; i++) lung_destroy(own[i]);
+}
+
+TEST(session_writes_copy_on_write) {
+  enum { V = 80, D = 32, CTX = 6, H = 4, R = 2 };
+  lung_seed(232);
+  AriannaLung* lung = lung_create(V, D, CTX, H);
+  lung_seed(232);
+  AriannaLung* ref = lung_create(V, D, CTX, H);
+  LungWeights* w = lung_share_weights(lung);
+  LungSession* a = lung_session_new(w);
+  LungSession* b = lung_session_new(w);
+  ASSERT(a != NULL && b != NULL && w->refs == 3);
+
+  // each writer gives the writing session a private copy
+  static float A[D * R], B[R * V], Wv[D * D];
+  for (int i = 0; i < D * R; i++) A[i] = 0.01f * (float)(i % 7);
+  for (int i = 0; i < R * V; i++) B[i] = 0.02f * (float)(i % 5) - 0.04f;
+  lung_merge_output_lora(a, A, B, R, 1.0f);
+  ASSERT(a->shared == NULL && w->refs == 2 && a->WoT != b->WoT);
+  ASSERT(lung_copy_qkv_weights(b, QKV_V, Wv));
+  Wv[3] += 0.5f;
+  ASSERT(lung_load_qkv_weights(b, QKV_V, Wv) && b->shared == NULL && w->refs == 1);
+  ASSERT(lung_quantize(lung, 8) && lung->shared == NULL);  // the last reference
+
+  // the copies were taken before the edits: other sessions never saw them
+  LungSession* c = lung_session_new(lung_share_weights(ref));
+  lung_merge_output_lora(ref, A, B, R, 1.0f);
+  ASSERT(ref->shared == NULL && c->shared != NULL);
+  int context[CTX];
+  fill_context(context, CTX, V, 233);
+  lung_forward(a, context, CTX);
+  lung_forward(ref, context, CTX);
+  ASSERT(memcmp(a->last_probs, ref->last_probs, V * sizeof(float)) == 0);
+  lung_forward(c, context, CTX);
+  ASSERT(memcmp(a->last_probs, c->last_probs, V * sizeof(float)) != 0);
+  ASSERT(lung_get_embeddings(c) != NULL && c->shared == NULL);
+
+  lung_destroy(a);
+  lung_destroy(b);
+  lung_destroy(c);
+  lung_destroy(ref);
+  lung_destroy(lung);
+}
+
+TEST(sessions_on_mapped_and_quantized_weights) {
+  enum { V = 120, D = 32, CTX = 6, H = 4 };
+  int context[CTX];
+  fill_context(context, CTX, V, 234);
+  for (int bits = 8; bits >= 4; bits -= 4) {
+    AriannaLung* src = ckpt_lung(bits == 8 ? 4 : 5, V, D, CTX, H);
+    ASSERT(src != NULL && lung_save(src, CKPT_PATH));
+    AriannaLung* mapped = lung_open_mmap(CKPT_PATH);
+    AriannaLung* ref = lung_open_mmap(CKPT_PATH);
+    ASSERT(mapped != NULL && ref != NULL);
+    LungWeights* w = lung_share_weights(mapped);
+    LungSession* s = lung_session_new(w);
+    ASSERT(s != NULL && lung_is_mapped(s) && lung_get_quant_bits(s) == bits);
+    ASSERT(s->qE.data == mapped->qE.data && lung_get_resonance(s, 5) == lung_get_resonance(ref, 5));
+
+    lung_destroy(mapped);  // the mapping stays until the last session
+    lung_forward(s, context, CTX);
+    lung_forward(ref, context, CTX);
+    ASSERT(memcmp(s->last_probs, ref->last_probs, V * sizeof(float)) == 0);
+    lung_destroy(s);
+    lung_destroy(ref);
+    lung_destroy(src);
+  }
+  remove(CKPT_PATH);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// THROUGHPUT — informational, never fails
+// ═══════════════════════════════════════════════════════════════════════════════
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void report_batch_throughput(void) {
+  enum { VOCAB = 4096, D = 256, CTX = 32, HEADS = 8, B = 64 };
+  lung_seed(66);
+  AriannaLung* lung = lung_create(VOCAB, D, CTX, HEADS);
+  if (!lung) return;
+  int* contexts = (int*)malloc((size_t)B * CTX * sizeof(int));
+  float* probs = (float*)malloc((size_t)B * VOCAB * sizeof(float));
+  float ent[B];
+  fill_context(contexts, B * CTX, VOCAB, 67);
+
+  printf("\n  forward vocab=%d d=%d ctx=%d heads=%d:\n", VOCAB, D, CTX, HEADS);
+  for (int nb = 1; nb <= B; nb *= 4) {
+    double t0 = now_sec();
+    for (int b = 0; b < nb; b++) lung_forward(lung, contexts + (size_t)b * CTX, CTX);
+    double single = now_sec() - t0;
+    t0 = now_sec();
+    lung_forward_batch(lung, contexts, NULL, nb, probs, ent);
+    double batch = now_sec() - t0;
+    printf("    B=%-3d  loop %8.3f ms   batch %8.3f ms  (%.1fx)\n",
+           nb, single * 1e3, batch * 1e3, single / batch);
+  }
+
+  free(contexts); free(probs);
+  lung_destroy(lung);
+}
+
+static void report_thread_latency(void) {
+  enum { VOCAB = 32768, D = 512, CTX = 64, HEADS = 16, REPS = 20 };
+  lung_seed(85);
+  AriannaLung* lung = lung_create(VOCAB, D, CTX, HEADS);
+  if (!lung) return;
+  int context[CTX];
+  fill_context(context, CTX, VOCAB, 86);
+
+  printf("\n  single forward vocab=%d d=%d ctx=%d heads=%d:\n", VOCAB, D, CTX, HEADS);
+  double base = 0.0;
+  for (int n = 1; n <= 8; n *= 2) {
+    int used = lung_set_threads(n);
+    lung_forward(lung, context, CTX);  // warm up
+    double t0 = now_sec();
+    for (int r = 0; r < REPS; r++) lung_forward(lung, context, CTX);
+    double dt = (now_sec() - t0) / REPS;
+    if (n == 1) base = dt;
+    printf("    threads=%-2d %8.3f ms  (%.1fx)\n", used, dt * 1e3, base / dt);
+  }
+  lung_set_threads(1);
+  lung_destroy(lung);
+}
+
+static void report_quant_latency(void) {
+  enum { VOCAB = 32768, D = 512, CTX = 64, HEADS = 16, REPS = 10 };
+  int context[CTX];
+  fill_context(context, CTX, VOCAB, 87);
+
+  printf("\n  quantized forward vocab=%d d=%d ctx=%d heads=%d:\n", VOCAB, D, CTX, HEADS);
+  static const char* names[] = { "float32", "fp16", "bf16", "int8", "int4" };
+  double base = 0.0;
+  for (int kind = 0; kind < 5; kind++) {
+    lung_seed(88);
+    AriannaLung* lung = (kind <= 2) ? lung_create_ex(VOCAB, D, CTX, HEADS, kind)
+                                    : lung_create(VOCAB, D, CTX, HEADS);
+    if (!lung) return;
+    if (kind >= 3) lung_quantize(lung, kind == 3 ? 8 : 4);
+    lung_forward(lung, context, CTX);
+    double t0 = now_sec();
+    for (int r = 0; r < REPS; r++) lung_forward(lung, context, CTX);
+    double dt = (now_sec() - t0) / REPS;
+    if (kind == 0) base = dt;
+    printf("    %-7s %7.1f MB  %8.3f ms  (%.1fx)\n", names[kind],
+           lung_weight_bytes(lung) / 1048576.0, dt * 1e3, base / dt);
+    lung_destroy(lung);
+  }
+}
+
+static void report_checkpoint_open(void) {
+  enum { VOCAB = 32768, D = 512, CTX = 64, HEADS = 16 };
+  lung_seed(89);
+  double t0 = now_sec();
+  AriannaLung* lung = lung_create(VOCAB, D, CTX, HEADS);
+  if (!lung) return;
+  double t_create = now_sec() - t0;
+  t0 = now_sec();
+  int saved = lung_save(lung, CKPT_PATH);
+  double t_save = now_sec() - t0;
+  lung_destroy(lung);
+  if (!saved) return;
+
+  t0 = now_sec();
+  AriannaLung* mapped = lung_open_mmap(CKPT_PATH);
+  double t_open = now_sec() - t0;
+  if (mapped) {
+    printf("\n  checkpoint vocab=%d d=%d (%.1f MB): create %.1f ms  save %.1f ms  open %.3f ms\n",
+           VOCAB, D, file_size(CKPT_PATH) / 1048576.0, t_create * 1e3, t_save * 1e3, t_open * 1e3);
+    lung_destroy(mapped);
+  }
+  remove(CKPT_PATH);
+}
+
+static void report_prophecy_latency(void) {
+  enum { VOCAB = 4096, D = 256, CTX = 64, HEADS = 8, STEPS = 64 };
+  lung_seed(90);
+  AriannaLung* lung = lung_create(VOCAB, D, CTX, HEADS);
+  if (!lung) return;
+  int window[CTX], tokens[STEPS];
+  fill_context(window, CTX, VOCAB, 91);
+
+  // the JS loop: one full forward per step, argmax appended
+  lung_forward(lung, window, CTX);
+  double t0 = now_sec();
+  for (int s = 0; s < STEPS; s++) {
+    lung_forward(lung, window, CTX);
+    memmove(window, window + 1, (CTX - 1) * sizeof(int));
+    window[CTX - 1] = lung_get_argmax(lung);
+  }
+  double t_loop = now_sec() - t0;
+
+  fill_context(window, CTX, VOCAB, 91);
+  lung_prophecy(lung, window, CTX, 1, 1.0f, 1.0f, 0.0f, 0, NULL, tokens, NULL, NULL, NULL);
+  t0 = now_sec();
+  lung_prophecy(lung, window, CTX, STEPS, 1.0f, 1.0f, 0.0f, 0, NULL, tokens, NULL, NULL, NULL);
+  double t_roll = now_sec() - t0;
+
+  printf("\n  prophecy %d steps vocab=%d d=%d ctx=%d heads=%d:\n", STEPS, VOCAB, D, CTX, HEADS);
+  printf("    forward loop %8.2f ms   lung_prophecy %8.2f ms  (%.1fx)\n",
+         t_loop * 1e3, t_roll * 1e3, t_loop / t_roll);
+  lung_destroy(lung);
+}
+
+static void report_beam_latency(void) {
+  enum { VOCAB = 4096, D = 256, CTX = 64, HEADS = 8, BEAM = 8, STEPS = 16 };
+  lung_seed(92);
+  AriannaLung* lung = lung_create(VOCAB, D, CTX, HEADS);
+  if (!lung) return;
+  int context[CTX], tokens[BEAM * STEPS];
+  float scores[BEAM];
+  fill_context(context, CTX, VOCAB, 93);
+
+  // per-branch full forwards (what a JS driver does): beam × steps of them
+  lung_forward(lung, context, CTX);
+  double t0 = now_sec();
+  for (int r = 0; r < BEAM * STEPS; r++) lung_forward(lung, context, CTX);
+  double t_loop = now_sec() - t0;
+
+  lung_beam_search(lung, context, CTX, BEAM, 1, tokens, scores);
+  t0 = now_sec();
+  lung_beam_search(lung, context, CTX, BEAM, STEPS, tokens, scores);
+  double t_beam = now_sec() - t0;
+
+  printf("\n  beam %d × %d steps vocab=%d d=%d ctx=%d heads=%d:\n", BEAM, STEPS, VOCAB, D, CTX, HEADS);
+  printf("    %d forwards %8.2f ms   lung_beam_search %8.2f ms  (%.1fx)\n",
+         BEAM * STEPS, t_loop * 1e3, t_beam * 1e3, t_loop / t_beam);
+  lung_destroy(lung);
+}
+
+static void report_mask_latency(void) {
+  enum { VOCAB = 4096, D = 256, CTX = 256, HEADS = 8, REPS = 50 };
+  lung_seed(94);
+  AriannaLung* lung = lung_create(VOCAB, D, CTX, HEADS);
+  if (!lung) return;
+  int context[CTX];
+  fill_context(context, CTX, VOCAB, 95);
+
+  printf("\n  short context, vocab=%d d=%d ctx=%d heads=%d:\n", VOCAB, D, CTX, HEADS);
+  for (int len = 4; len <= CTX; len *= 4) {
+    double dt[2];
+    for (int masked = 0; masked <= 1; masked++) {
+      lung_set_mask_padding(lung, masked);
+      lung_forward(lung, context, len);
+      double t0 = now_sec();
+      for (int r = 0; r < REPS; r++) lung_forward(lung, context, len);
+      dt[masked] = (now_sec() - t0) / REPS;
+    }
+    printf("    len=%-3d padded %8.3f ms   masked %8.3f ms  (%.1fx)\n",
+           len, dt[0] * 1e3, dt[1] * 1e3, dt[0] / dt[1]);
+  }
+  lung_destroy(lung);
+}
+
+// Sparse vs dense on long contexts: latency, and how far the distribution
+// moves on random contexts: KL(dense || sparse) and the overlap of the top
+// 32 (random weights give near-flat distributions, so top-1 is a coin toss)
+static void report_sparse_attention(void) {
+  enum { VOCAB = 4096, D = 128, HEADS = 4, ANCHORS = 15, REPS = 20, TRIALS = 8 };
+  static const int ctxs[] = { 1024, 4096 };
+  static const int windows[] = { 64, 256 };
+  float* dense = (float*)malloc(VOCAB * sizeof(float));
+  float* presence = (float*)malloc(VOCAB * sizeof(float));
+  int* context = (int*)malloc(4096 * sizeof(int));
+
+  printf("\n  sparse attention vocab=%d d=%d heads=%d anchors=%d:\n", VOCAB, D, HEADS, ANCHORS);
+  for (int c = 0; c < 2; c++) {
+    int ctx = ctxs[c];
+    lung_seed(96);
+    AriannaLung* lung = lung_create(VOCAB, D, ctx, HEADS);
+    if (!lung) break;
+    fill_context(context, ctx, VOCAB, 97);
+
+    lung_forward(lung, context, ctx);
+    double t0 = now_sec();
+    for (int r = 0; r < REPS; r++) lung_forward(lung, context, ctx);
+    double t_dense = (now_sec() - t0) / REPS;
+
+    for (int w = 0; w < 2; w++) {
+      lung_set_sparse_attention(lung, windows[w], ANCHORS);
+      lung_forward(lung, context, ctx);
+      t0 = now_sec();
+      for (int r = 0; r < REPS; r++) lung_forward(lung, context, ctx);
+      double t_sparse = (now_sec() - t0) / REPS;
+
+      double kl = 0.0;
+      int agree = 0;
+      int top_dense[LUNG_TOPK_CACHE], top_sparse[LUNG_TOPK_CACHE];
+      for (int trial = 0; trial < TRIALS; trial++) {
+        fill_context(context, ctx, VOCAB, 98 + trial);
+        lung_copy_presence(lung, presence);
+        lung_set_sparse_attention(lung, 0, 0);
+        lung_forward(lung, context, ctx);
+        memcpy(dense, lung_get_probs(lung), VOCAB * sizeof(float));
+        lung_get_top_k(lung, top_dense, LUNG_TOPK_CACHE);
+        lung_load_presence(lung, presence);
+        lung_set_sparse_attention(lung, windows[w], ANCHORS);
+        lung_forward(lung, context, ctx);
+        kl += kl_div(dense, lung_get_probs(lung), VOCAB) / TRIALS;
+        lung_get_top_k(lung, top_sparse, LUNG_TOPK_CACHE);
+        for (int i = 0; i < LUNG_TOPK_CACHE; i++) {
+          for (int j = 0; j < LUNG_TOPK_CACHE; j++) agree += top_dense[i] == top_sparse[j];
+        }
+      }
+      printf("    ctx=%-5d window=%-4d dense %8.3f ms   sparse %8.3f ms  (%.1fx)"
+             "  KL %.1e  top-%d overlap %.0f%%\n", ctx, windows[w], t_dense * 1e3,
+             t_sparse * 1e3, t_dense / t_sparse, kl, LUNG_TOPK_CACHE,
+             100.0 * agree / (TRIALS * LUNG_TOPK_CACHE));
+      fill_context(context, ctx, VOCAB, 97);
+    }
+    lung_destroy(lung);
+  }
+  free(dense);
+  free(presence);
+  free(context);
+}
+
+// K/V cost as the key/value head count drops at a fixed query head count:
+// streaming cache bytes and the push + cached forward step
+static void report_gqa_kv_cost(void) {
+  enum { VOCAB = 4096, D = 256, CTX = 256, HEADS = 8, STEPS = 200 };
+  static const int kv_heads[] = { 8, 2, 1 };
+  int context[STEPS];
+  fill_context(context, STEPS, VOCAB, 99);
+
+  printf("\n  grouped-query attention vocab=%d d=%d ctx=%d heads=%d:\n", VOCAB, D, CTX, HEADS);
+  for (int i = 0; i < 3; i++) {
+    lung_seed(98);
+    AriannaLung* lung = lung_create_gqa(VOCAB, D, CTX, HEADS, kv_heads[i]);
+    if (!lung) break;
+    for (int t = 0; t < CTX; t++) lung_push_token(lung, context[t % STEPS]);
+    double t0 = now_sec();
+    for (int t = 0; t < STEPS; t++) {
+      lung_push_token(lung, context[t]);
+      lung_forward_cached(lung);
+    }
+    double dt = (now_sec() - t0) / STEPS;
+    size_t cache = 2 * (size_t)CTX * lung->kv_dim * sizeof(float);
+    printf("    kv_heads=%d  K/V cache %7.1f KB   weights %6.2f MB   step %7.3f ms\n",
+           kv_heads[i], cache / 1024.0, lung_weight_bytes(lung) / 1048576.0, dt * 1e3);
+    lung_destroy(lung);
+  }
+}
+
+// Shortlist vs full vocab as the vocab grows (clustered output rows, as a
+// trained vocabulary has): latency, candidates scored, estimated vs true
+// tail mass and whether the top 8 agree
+static void report_shortlist(void) {
+  enum { D = 128, CTX = 32, HEADS = 4, PROBE = 8, REPS = 20 };
+  static const int vocabs[] = { 4096, 16384, 65536 };
+  int context[CTX];
+  fill_context(context, CTX, 4096, 213);
+
+  printf("\n  shortlist d=%d ctx=%d heads=%d probe=%d:\n", D, CTX, HEADS, PROBE);
+  for (int v = 0; v < 3; v++) {
+    int V = vocabs[v];
+    lung_seed(214);
+    AriannaLung* lung = lung_create(V, D, CTX, HEADS);
+    float* full = (float*)malloc(V * sizeof(float));
+    int* ids = (int*)malloc(V * sizeof(int));
+    if (!lung || !full || !ids || !load_clustered_output(lung, 256, 0.4f, 215)) {
+      free(full); free(ids); lung_destroy(lung);
+      break;
+    }
+
+    lung_forward(lung, context, CTX);
+    double t0 = now_sec();
+    for (int r = 0; r < REPS; r++) lung_forward(lung, context, CTX);
+    double dt_full = (now_sec() - t0) / REPS;
+    lung_load_presence(lung, NULL);
+    lung_forward(lung, context, CTX);
+    memcpy(full, lung_get_probs(lung), V * sizeof(float));
+    int top_full[8], top_short[8];
+    lung_get_top_k(lung, top_full, 8);
+
+    int C = lung_set_shortlist(lung, PROBE);
+    lung_load_presence(lung, NULL);
+    lung_forward(lung, context, CTX);
+    int n = lung_get_shortlist(lung, ids, V);
+    float tail = lung_get_tail_mass(lung);
+    lung_get_top_k(lung, top_short, 8);
+    double true_tail = 1.0;
+    for (int j = 0; j < n; j++) true_tail -= full[ids[j]];
+    t0 = now_sec();
+    for (int r = 0; r < REPS; r++) lung_forward(lung, context, CTX);
+    double dt_short = (now_sec() - t0) / REPS;
+
+    printf("    vocab=%-6d full %7.3f ms   shortlist %7.3f ms  (%.1fx)  %d/%d clusters, "
+           "%5d scored  tail %.3f (true %.3f)  top-8 %s\n",
+           V, dt_full * 1e3, dt_short * 1e3, dt_full / dt_short, PROBE, C, n, tail, true_tail,
+           memcmp(top_full, top_short, sizeof(top_full)) == 0 ? "same" : "differs");
+    free(full); free(ids);
+    lung_destroy(lung);
+  }
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// MAIN
+// ═══════════════════════════════════════════════════════════════════════════════
+
+int main(void) {
+  printf("\n");
+  printf("═══════════════════════════════════════════════════════════════════════════════\n");
+  printf(" BODY.C TESTS — AriannaLung native\n");
+  printf("═══════════════════════════════════════════════════════════════════════════════\n\n");
+
+  printf("SECTION A: Lifecycle & Sanity\n");
+  printf("───────────────────────────────────────────────────────────────────────────────\n");
+
+  RUN(create_destroy);
+  RUN(probs_normalized);
+
+  printf("\nSECTION B: Folded Attention\n");
+  printf("───────────────────────────────────────────────────────────────────────────────\n");
+
+  RUN(folded_equiv_basic);
+  RUN(folded_equiv_padded_context);
+  RUN(folded_equiv_rtl_prophecy);
+  RUN(folded_equiv_retrodiction);
+  RUN(folded_equiv_wide);
+  RUN(folded_equiv_focus_spread);
+
+  printf("\nSECTION C: Streaming Cache\n");
+  printf("───────────────────────────────────────────────────────────────────────────────\n");
+
+  RUN(stream_equiv_fill);
+  RUN(stream_equiv_sliding_ltr);
+  RUN(stream_equiv_sliding_rtl);
+  RUN(stream_equiv_uneven_heads);
+  RUN(stream_rtl_toggle_midstream);
+  RUN(stream_reset_clears_window);
+
+  printf("\nSECTION D: Packed Output Projection\n");
+  printf("───────────────────────────────────────────────────────────────────────────────\n");
+
+  RUN(wo_packed_matches_column_walk);
+  RUN(wo_sync_after_raw_write);
+  RUN(wo_merge_output_lora);
+
+  printf("\nSECTION E: Packed Fused QKV\n");
+  printf("───────────────────────────────────────────────────────────────────────────────\n");
+
+  RUN(packed_qkv_equiv);
+  RUN(packed_qkv_equiv_unaligned_dim);
+  RUN(packed_qkv_layout_and_roundtrip);
+  RUN(packed_qkv_stream_and_reload);
+
+  printf("\nSECTION F: Batched Forward\n");
+  printf("───────────────────────────────────────────────────────────────────────────────\n");
+
+  RUN(batch_equiv_small);
+  RUN(batch_equiv_multi_tile);
+  RUN(batch_equiv_packed_qkv);
+  RUN(batch_optional_outputs);
+  RUN(batch_alloc_failure_recovers);
+
+
+  printf("\nSECTION G: Threaded Forward\n");
+  printf("───────────────────────────────────────────────────────────────────────────────\n");
+
+  RUN(threads_start_pool);
+  RUN(threads_equiv_folded);
+  RUN(threads_equiv_unfolded);
+  RUN(threads_equiv_single_tile_single_head);
+  RUN(threads_stream_cached);
+
+
+  printf("\nSECTION H: Quantized Weights\n");
+  printf("───────────────────────────────────────────────────────────────────────────────\n");
+
+  RUN(quant_int8_kl_bound);
+  RUN(quant_int4_kl_bound);
+  RUN(quant_storage_and_access);
+  RUN(quant_paths_agree);
+
+  printf("\nSECTION I: Half-Precision Storage\n");
+  printf("───────────────────────────────────────────────────────────────────────────────\n");
+
+  RUN(half_fp16_kl_bound);
+  RUN(half_bf16_kl_bound);
+  RUN(half_create_and_footprint);
+  RUN(half_loaders_match_float);
+  RUN(half_merge_output_lora);
+  RUN(half_paths_agree);
+
+  printf("\nSECTION J: Checkpoints\n");
+  printf("───────────────────────────────────────────────────────────────────────────────\n");
+
+  RUN(ckpt_roundtrip_all_storage);
+  RUN(ckpt_mapped_lung_is_copy_on_write);
+  RUN(ckpt_rejects_damaged_files);
+
+  printf("\nSECTION K: Fused Vocab Epilogue\n");
+  printf("───────────────────────────────────────────────────────────────────────────────\n");
+
+  RUN(topk_heap_order_and_ties);
+  RUN(topk_select_excluding);
+  RUN(top_k_large_k_and_vocab);
+  RUN(epilogue_matches_reference_multi_tile);
+  RUN(epilogue_small_vocab);
+  RUN(epilogue_presence_and_getters);
+
+  printf("\nSECTION L: Native Sampling\n");
+  printf("───────────────────────────────────────────────────────────────────────────────\n");
+
+  RUN(sample_greedy_and_degenerate);
+  RUN(sample_matches_reference_distribution);
+  RUN(sample_stream_is_reproducible);
+  RUN(sample_am_state_temperature_and_destiny);
+  RUN(sample_streams_are_per_lung);
+  RUN(create_lungs_concurrently);
+
+  printf("\nSECTION M: Prophecy Rollout & Beam Search\n");
+  printf("───────────────────────────────────────────────────────────────────────────────\n");
+
+  RUN(prophecy_greedy_matches_forward_loop);
+  RUN(prophecy_sampled_with_wormholes);
+  RUN(prophecy_am_state_and_continuation);
+  RUN(prophecy_leaves_stream_window);
+  RUN(beam_matches_batched_reference);
+  RUN(beam_small_vocab_and_state_untouched);
+
+  printf("\nSECTION N: Lazy Presence\n");
+  printf("───────────────────────────────────────────────────────────────────────────────\n");
+
+  RUN(presence_lazy_matches_eager_sweep);
+  RUN(presence_load_and_rollout_restore);
+
+  printf("\nSECTION O: Length-Aware Attention\n");
+  printf("───────────────────────────────────────────────────────────────────────────────\n");
+
+  RUN(mask_matches_short_lung);
+  RUN(mask_paths_agree);
+  RUN(mask_explicit_and_empty);
+
+  printf("\nSECTION P: Sparse Attention\n");
+  printf("───────────────────────────────────────────────────────────────────────────────\n");
+
+  RUN(sparse_positions_window_and_primes);
+  RUN(sparse_matches_explicit_mask);
+  RUN(sparse_paths_agree);
+
+  printf("\nSECTION Q: Grouped-Query Attention\n");
+  printf("───────────────────────────────────────────────────────────────────────────────\n");
+
+  RUN(gqa_matches_repeated_kv_heads);
+  RUN(gqa_paths_agree);
+  RUN(gqa_storage_and_checkpoint);
+
+  printf("\nSECTION R: Candidate Shortlist\n");
+  printf("───────────────────────────────────────────────────────────────────────────────\n");
+
+  RUN(shortlist_all_clusters_is_exact);
+  RUN(shortlist_finds_top_tokens);
+  RUN(shortlist_candidates_and_refit);
+
+  printf("\nSECTION S: Shared Weights\n");
+  printf("───────────────────────────────────────────────────────────────────────────────\n");
+
+  RUN(sessions_share_one_weight_copy);
+  RUN(session_writes_copy_on_write);
+  RUN(sessions_on_mapped_and_quantized_weights);
+
+  report_batch_throughput();
+  report_thread_latency();
+  report_quant_latency();
+  report_checkpoint_open();
+  report_prophecy_latency();
+  report_beam_latency();
+  report_mask_latency();
+  report_sparse_attention();
+  report_gqa_kv_cost();
+  report_shortlist();
+
+  // Summary
+  printf("\n");
+  printf("═══════════════════════════════════════════════════════════════════════════════\n");
+  if (tests_failed == 0) {
+    printf(" ALL %d TESTS PASSED ✓\n", tests_passed);
+    printf(" הרזוננס לא נשבר. המשך הדרך.\n");
+  } else {
+    printf(" %d/%d TESTS PASSED, %d FAILED ✗\n", tests_passed, tests_run, tests_failed);
+  }
+  printf("═══════════════════════════════════════════════════════════════════════════════\n\n");
+
+  return tests_failed > 0 ? 1 : 0;
+}
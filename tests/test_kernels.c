@@ -0,0 +1,412 @@
+// test_kernels.c — vector kernels vs scalar reference (kernels.h)
+// "wider lungs, same breath"
+//
+// Build: gcc -O2 -std=gnu99 tests/test_kernels.c -lm -lpthread -o test_kernels
+// Run:   ./test_kernels
+//
+// ═══════════════════════════════════════════════════════════════════════════════
+// These tests prove:
+// - Every dispatch level this CPU supports matches the scalar reference
+// - Odd lengths and tails are handled (no over-read, no missed lanes)
+// - Forcing KERN_SCALAR really selects the reference path
+// - The first kernel call may come from many threads at once
+// הרזוננס לא נשבר. המשך הדרך.
+// ═══════════════════════════════════════════════════════════════════════════════
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "../wasm/kernels.h"
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// TEST FRAMEWORK — minimal, brutal (same as test_amk.c)
+// ═══════════════════════════════════════════════════════════════════════════════
+
+static int tests_run = 0;
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define TEST(name) static void test_##name(void)
+#define RUN(name) do { \
+  printf("  [%03d] %-50s ", ++tests_run, #name); \
+  fflush(stdout); \
+  int before_failed = tests_failed; \
+  test_##name(); \
+  if (tests_failed == before_failed) { printf("✓\n"); tests_passed++; } \
+} while(0)
+
+#define ASSERT(cond) do { \
+  if (!(cond)) { \
+    printf("✗ FAILED at line %d: %s\n", __LINE__, #cond); \
+    tests_failed++; \
+    return; \
+  } \
+} while(0)
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// HELPERS
+// ═══════════════════════════════════════════════════════════════════════════════
+
+static unsigned int rng = 12345u;
+
+static float frand(void) {
+  rng = rng * 1103515245u + 12345u;
+  return ((float)((rng >> 8) & 0xFFFF) / 32768.0f) - 1.0f;
+}
+
+static void fill(float* x, int n) {
+  for (int i = 0; i < n; i++) x[i] = frand();
+}
+
+// relative error, scaled by the magnitude of the terms involved
+static int close_rel(float a, float b, float scale) {
+  return fabsf(a - b) <= 1e-5f * (scale + 1.0f);
+}
+
+static int max_level(void) {
+  return kern_detect();
+}
+
+// lengths that hit every tail path (< lane width, exact multiples, odd tails)
+static const int LENS[] = { 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 64, 65, 100, 257, 1000 };
+#define N_LENS ((int)(sizeof(LENS) / sizeof(LENS[0])))
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// TESTS — each runs against every level the CPU supports
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// First kernel call of the process, from several threads at once
+#define FIRST_THREADS 8
+
+static int first_go = 0;
+
+static void* first_call(void* arg) {
+  float* out = (float*)arg;
+  float a[64], b[64];
+  for (int i = 0; i < 64; i++) { a[i] = (float)(i % 7) - 3.0f; b[i] = 0.25f * (float)(i % 5); }
+  while (!__atomic_load_n(&first_go, __ATOMIC_ACQUIRE)) {}
+  *out = kern_dot(a, b, 64);
+  return NULL;
+}
+
+TEST(first_use_on_threads) {
+  ASSERT(__atomic_load_n(&kern_active, __ATOMIC_ACQUIRE) == NULL);  // must run first
+  pthread_t tid[FIRST_THREADS];
+  float got[FIRST_THREADS];
+  for (int t = 0; t < FIRST_THREADS; t++) ASSERT(pthread_create(&tid[t], NULL, first_call, &got[t]) == 0);
+  __atomic_store_n(&first_go, 1, __ATOMIC_RELEASE);
+  for (int t = 0; t < FIRST_THREADS; t++) pthread_join(tid[t], NULL);
+
+  ASSERT(kern_level() == max_level());
+  for (int t = 1; t < FIRST_THREADS; t++) ASSERT(got[t] == got[0]);
+}
+
+TEST(select_scalar) {
+  ASSERT(kern_select(KERN_SCALAR) == KERN_SCALAR);
+  ASSERT(kern_level() == KERN_SCALAR);
+  ASSERT(kern_get()->dot == kern_dot_scalar);
+  ASSERT(kern_select(99) == max_level());
+}
+
+TEST(dot_matches_scalar) {
+  float a[1000], b[1000];
+  for (int lv = 0; lv <= max_level(); lv++) {
+    kern_select(lv);
+    for (int k = 0; k < N_LENS; k++) {
+      int n = LENS[k];
+      fill(a, n); fill(b, n);
+      float mag = 0.0f;
+      for (int i = 0; i < n; i++) mag += fabsf(a[i] * b[i]);
+      ASSERT(close_rel(kern_dot(a, b, n), kern_dot_scalar(a, b, n), mag));
+    }
+  }
+}
+
+TEST(axpy_matches_scalar) {
+  float x[1000], y0[1000], y1[1000];
+  for (int lv = 0; lv <= max_level(); lv++) {
+    kern_select(lv);
+    for (int k = 0; k < N_LENS; k++) {
+      int n = LENS[k];
+      fill(x, n); fill(y0, n);
+      memcpy(y1, y0, n * sizeof(float));
+      // sentinel past the end must survive (masked tails)
+      y0[n < 1000 ? n : 999] = y1[n < 1000 ? n : 999] = 42.0f;
+      kern_axpy(y0, x, 0.37f, n);
+      kern_axpy_scalar(y1, x, 0.37f, n);
+      for (int i = 0; i < n; i++) ASSERT(close_rel(y0[i], y1[i], 1.0f));
+      if (n < 1000) ASSERT(y0[n] == 42.0f);
+    }
+  }
+}
+
+TEST(scale_and_max_match_scalar) {
+  float x0[1000], x1[1000];
+  for (int lv = 0; lv <= max_level(); lv++) {
+    kern_select(lv);
+    for (int k = 0; k < N_LENS; k++) {
+      int n = LENS[k];
+      fill(x0, n);
+      x0[n / 2] = 3.5f;  // known max somewhere in the middle
+      memcpy(x1, x0, n * sizeof(float));
+      ASSERT(kern_max(x0, n) == kern_max_scalar(x1, n));
+      kern_scale(x0, -1.25f, n);
+      kern_scale_scalar(x1, -1.25f, n);
+      for (int i = 0; i < n; i++) ASSERT(x0[i] == x1[i]);
+    }
+  }
+}
+
+TEST(mat_vec_matches_scalar) {
+  static float mat[65 * 257];
+  float vec[257], out0[257], out1[257];
+  int shapes[][2] = { {1, 1}, {3, 7}, {8, 16}, {16, 33}, {65, 257}, {33, 64} };
+  for (int lv = 0; lv <= max_level(); lv++) {
+    kern_select(lv);
+    for (int s = 0; s < 6; s++) {
+      int rows = shapes[s][0], cols = shapes[s][1];
+      fill(mat, rows * cols); fill(vec, cols);
+      kern_mat_vec(out0, mat, vec, rows, cols);
+      kern_mat_vec_scalar(out1, mat, vec, rows, cols);
+      for (int i = 0; i < rows; i++) ASSERT(close_rel(out0[i], out1[i], (float)cols));
+    }
+  }
+}
+
+TEST(mat_vec_t_matches_scalar) {
+  static float mat[65 * 257];
+  float vec[65], out0[257], out1[257];
+  int shapes[][2] = { {1, 1}, {3, 7}, {8, 16}, {16, 33}, {65, 257}, {33, 64} };
+  for (int lv = 0; lv <= max_level(); lv++) {
+    kern_select(lv);
+    for (int s = 0; s < 6; s++) {
+      int rows = shapes[s][0], cols = shapes[s][1];
+      fill(mat, rows * cols); fill(vec, rows);
+      kern_mat_vec_t(out0, mat, vec, rows, cols);
+      kern_mat_vec_t_scalar(out1, mat, vec, rows, cols);
+      for (int j = 0; j < cols; j++) ASSERT(close_rel(out0[j], out1[j], (float)rows));
+    }
+  }
+}
+
+TEST(dot3_matches_scalar) {
+  float a0[1000], a1[1000], a2[1000], x[1000];
+  for (int lv = 0; lv <= max_level(); lv++) {
+    kern_select(lv);
+    for (int k = 0; k < N_LENS; k++) {
+      int n = LENS[k];
+      fill(a0, n); fill(a1, n); fill(a2, n); fill(x, n);
+      float o[3], r[3];
+      kern_dot3(a0, a1, a2, x, n, o);
+      kern_dot3_scalar(a0, a1, a2, x, n, r);
+      for (int j = 0; j < 3; j++) ASSERT(close_rel(o[j], r[j], (float)n));
+    }
+  }
+}
+
+TEST(mat_mat_matches_scalar) {
+  static float mat[67 * 260];
+  static float vecs[9 * 257], out0[9 * 67], out1[9 * 67];
+  // rows not a multiple of 4, padded matrix stride, odd column tails
+  int shapes[][3] = { {1, 1, 1}, {3, 7, 8}, {8, 16, 16}, {5, 33, 48}, {67, 257, 260}, {33, 64, 64} };
+  for (int lv = 0; lv <= max_level(); lv++) {
+    kern_select(lv);
+    for (int s = 0; s < 6; s++) {
+      int rows = shapes[s][0], cols = shapes[s][1], stride = shapes[s][2];
+      for (int nvec = 1; nvec <= 9; nvec += 4) {
+        fill(mat, rows * stride); fill(vecs, nvec * cols);
+        kern_mat_mat(out0, mat, stride, vecs, nvec, rows, cols);
+        for (int b = 0; b < nvec; b++) {
+          for (int i = 0; i < rows; i++) {
+            out1[b * rows + i] = kern_dot_scalar(mat + i * stride, vecs + b * cols, cols);
+          }
+        }
+        for (int i = 0; i < nvec * rows; i++) ASSERT(close_rel(out0[i], out1[i], (float)cols));
+      }
+    }
+  }
+}
+
+TEST(quant_dots_match_scalar) {
+  static int8_t q8[1000];
+  static uint8_t q4[500];
+  float x[1000], y0[1000], y1[1000];
+  for (int lv = 0; lv <= max_level(); lv++) {
+    kern_select(lv);
+    for (int k = 0; k < N_LENS; k++) {
+      int n = LENS[k];
+      fill(x, n); fill(y0, n);
+      memcpy(y1, y0, n * sizeof(float));
+      for (int i = 0; i < n; i++) q8[i] = (int8_t)(frand() * 127.0f);
+      for (int i = 0; i < (n + 1) / 2; i++) q4[i] = (uint8_t)((frand() + 1.0f) * 127.0f);
+      ASSERT(close_rel(kern_dot_q8(q8, x, n), kern_dot_q8_scalar(q8, x, n), 127.0f * n));
+      ASSERT(close_rel(kern_dot_q4(q4, x, n), kern_dot_q4_scalar(q4, x, n), 8.0f * n));
+      kern_axpy_q8(y0, q8, 0.01f, n);
+      kern_axpy_q8_scalar(y1, q8, 0.01f, n);
+      for (int i = 0; i < n; i++) ASSERT(close_rel(y0[i], y1[i], 2.0f));
+    }
+  }
+}
+
+TEST(q4_nibble_order) {
+  // byte 0x9F: low nibble 15 → +7 (element 0), high nibble 9 → +1 (element 1)
+  uint8_t q[1] = { 0x9F };
+  float x0[2] = { 1.0f, 0.0f }, x1[2] = { 0.0f, 1.0f };
+  ASSERT(kern_dot_q4_scalar(q, x0, 2) == 7.0f);
+  ASSERT(kern_dot_q4_scalar(q, x1, 2) == 1.0f);
+  ASSERT(kern_dot_q4_scalar(q, x0, 1) == 7.0f);
+}
+
+TEST(half_conversions) {
+  // exact values, rounding to nearest even, subnormals, overflow, inf
+  ASSERT(kern_f32_to_f16(1.0f) == 0x3C00 && kern_f16_to_f32(0x3C00) == 1.0f);
+  ASSERT(kern_f32_to_f16(-2.5f) == 0xC100 && kern_f16_to_f32(0xC100) == -2.5f);
+  ASSERT(kern_f32_to_f16(1.0f + 1.0f / 2048.0f) == 0x3C00);       // tie → even
+  ASSERT(kern_f32_to_f16(1.0f + 3.0f / 2048.0f) == 0x3C02);       // tie → even (up)
+  ASSERT(kern_f32_to_f16(65504.0f) == 0x7BFF);
+  ASSERT(kern_f32_to_f16(1e6f) == 0x7C00);
+  ASSERT(kern_f32_to_f16(5.9604645e-8f) == 0x0001);                // smallest subnormal
+  ASSERT(kern_f16_to_f32(0x0001) == 5.9604645e-8f);
+  ASSERT(kern_f16_to_f32(0x0400) == 6.1035156e-5f);
+  ASSERT(isinf(kern_f16_to_f32(0xFC00)) && kern_f16_to_f32(0xFC00) < 0.0f);
+  ASSERT(isnan(kern_f16_to_f32(kern_f32_to_f16(NAN))));
+  ASSERT(kern_f32_to_bf16(1.0f) == 0x3F80 && kern_bf16_to_f32(0x3F80) == 1.0f);
+  ASSERT(kern_f32_to_bf16(1.0f + 1.0f / 256.0f) == 0x3F80);       // tie → even
+  ASSERT(kern_f32_to_bf16(1.0f + 3.0f / 256.0f) == 0x3F82);
+  ASSERT(isnan(kern_bf16_to_f32(kern_f32_to_bf16(NAN))));
+
+  // round trip error bounds over a range of magnitudes
+  for (int i = 0; i < 2000; i++) {
+    float f = frand() * powf(2.0f, (float)(i % 20) - 10.0f);
+    ASSERT(fabsf(kern_f16_to_f32(kern_f32_to_f16(f)) - f) <= fabsf(f) * (1.0f / 2048.0f) + 3e-8f);
+    ASSERT(fabsf(kern_bf16_to_f32(kern_f32_to_bf16(f)) - f) <= fabsf(f) * (1.0f / 256.0f));
+  }
+}
+
+TEST(half_dots_match_scalar) {
+  static uint16_t h[1000], b[1000];
+  float x[1000], y0[1000], y1[1000];
+  for (int lv = 0; lv <= max_level(); lv++) {
+    kern_select(lv);
+    for (int k = 0; k < N_LENS; k++) {
+      int n = LENS[k];
+      fill(x, n);
+      for (int i = 0; i < n; i++) {
+        float w = frand();
+        h[i] = kern_f32_to_f16(w);
+        b[i] = kern_f32_to_bf16(w);
+      }
+      ASSERT(close_rel(kern_dot_f16(h, x, n), kern_dot_f16_scalar(h, x, n), (float)n));
+      ASSERT(close_rel(kern_dot_bf16(b, x, n), kern_dot_bf16_scalar(b, x, n), (float)n));
+
+      fill(y0, n);
+      memcpy(y1, y0, n * sizeof(float));
+      kern_axpy_f16(y0, h, 0.3f, n);
+      kern_axpy_f16_scalar(y1, h, 0.3f, n);
+      for (int i = 0; i < n; i++) ASSERT(close_rel(y0[i], y1[i], 1.0f));
+      kern_axpy_bf16(y0, b, -0.7f, n);
+      kern_axpy_bf16_scalar(y1, b, -0.7f, n);
+      for (int i = 0; i < n; i++) ASSERT(close_rel(y0[i], y1[i], 1.0f));
+    }
+  }
+}
+
+TEST(softmax_matches_scalar) {
+  float x0[1000], x1[1000];
+  for (int lv = 0; lv <= max_level(); lv++) {
+    kern_select(lv);
+    for (int k = 0; k < N_LENS; k++) {
+      int n = LENS[k];
+      fill(x0, n);
+      for (int i = 0; i < n; i++) x0[i] *= 8.0f;
+      memcpy(x1, x0, n * sizeof(float));
+      kern_softmax(x0, n);
+      kern_softmax_scalar(x1, n);
+      float sum = 0.0f;
+      for (int i = 0; i < n; i++) {
+        ASSERT(fabsf(x0[i] - x1[i]) < 1e-6f);
+        sum += x0[i];
+      }
+      ASSERT(fabsf(sum - 1.0f) < 1e-4f);
+    }
+  }
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// THROUGHPUT — informational, never fails
+// ═══════════════════════════════════════════════════════════════════════════════
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void report_throughput(void) {
+  enum { ROWS = 256, COLS = 1024, REPS = 200 };
+  float* mat = (float*)malloc(ROWS * COLS * sizeof(float));
+  float* vec = (float*)malloc(COLS * sizeof(float));
+  float* out = (float*)malloc(COLS * sizeof(float));
+  fill(mat, ROWS * COLS); fill(vec, COLS);
+
+  printf("\n  mat_vec / mat_vec_t %dx%d, %d reps:\n", ROWS, COLS, REPS);
+  double base = 0.0;
+  for (int lv = 0; lv <= max_level(); lv++) {
+    kern_select(lv);
+    double t0 = now_sec();
+    for (int r = 0; r < REPS; r++) {
+      kern_mat_vec(out, mat, vec, ROWS, COLS);
+      kern_mat_vec_t(out, mat, vec, ROWS, COLS);
+    }
+    double dt = now_sec() - t0;
+    if (lv == 0) base = dt;
+    printf("    %-8s %8.3f ms  (%.1fx)\n", kern_level_name(), dt * 1e3, base / dt);
+  }
+  free(mat); free(vec); free(out);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// MAIN
+// ═══════════════════════════════════════════════════════════════════════════════
+
+int main(void) {
+  printf("\n");
+  printf("═══════════════════════════════════════════════════════════════════════════════\n");
+  printf(" KERNEL TESTS — vector vs scalar (best level on this CPU: %s)\n",
+         kern_tables[max_level()].name);
+  printf("═══════════════════════════════════════════════════════════════════════════════\n\n");
+
+  RUN(first_use_on_threads);
+  RUN(select_scalar);
+  RUN(dot_matches_scalar);
+  RUN(axpy_matches_scalar);
+  RUN(scale_and_max_match_scalar);
+  RUN(mat_vec_matches_scalar);
+  RUN(mat_vec_t_matches_scalar);
+  RUN(dot3_matches_scalar);
+  RUN(mat_mat_matches_scalar);
+  RUN(quant_dots_match_scalar);
+  RUN(q4_nibble_order);
+  RUN(half_conversions);
+  RUN(half_dots_match_scalar);
+  RUN(softmax_matches_scalar);
+
+  report_throughput();
+
+  // Summary
+  printf("\n");
+  printf("═══════════════════════════════════════════════════════════════════════════════\n");
+  if (tests_failed == 0) {
+    printf(" ALL %d TESTS PASSED ✓\n", tests_passed);
+    printf(" הרזוננס לא נשבר. המשך הדרך.\n");
+  } else {
+    printf(" %d/%d TESTS PASSED, %d FAILED ✗\n", tests_passed, tests_run, tests_failed);
+  }
+  printf("═══════════════════════════════════════════════════════════════════════════════\n\n");
+
+  return tests_failed > 0 ? 1 : 0;
+}
@@ -232,6 +232,22 @@ void test_build_dy_from_probs(void) {
   ASSERT(dy[1] < 0, "Top competitor (idx 1) should be pulled");
   ASSERT(dy[4] < 0, "Second competitor (idx 4) should be pulled");
   
+  // more competitors than the cap, ties and the target among the top
+  float big[100];
+  float dy2[100];
+  for (int i = 0; i < 100; i++) big[i] = (float)(i % 10) * 0.01f;
+  lora_build_dy_from_probs(dy2, big, 100, 9, 1.0f, 0.64f, 64);
+  int pulled = 0;
+  for (int i = 0; i < 100; i++) {
+    if (i != 9 && dy2[i] < 0) pulled++;
+  }
+  ASSERT(pulled == 32, "Pull is capped at LORA_MAX_TOPK (32) competitors");
+  ASSERT(dy2[9] > 0.99f, "Target is never pulled");
+  ASSERT(dy2[19] < 0 && dy2[99] < 0 && dy2[88] < 0, "Highest-prob competitors are pulled");
+  // 9 nines + 10 eights + 10 sevens + the 3 lowest-index sixes = 32
+  ASSERT(dy2[6] < 0 && dy2[26] < 0, "Ties go to the lower index");
+  ASSERT(dy2[36] == 0.0f && dy2[5] == 0.0f, "Lower-prob tokens are left alone");
+  
   PASS();
 }
 
@@ -6,7 +6,7 @@
 //
 // build: emcc arianna_method.c -O2 -s WASM=1 -s MODULARIZE=1 \
 //   -s EXPORT_NAME="AriannaMethod" \
-//   -s EXPORTED_FUNCTIONS='["_am_init","_am_exec","_am_get_state","_am_take_jump","_am_copy_state","_am_enable_pack","_am_disable_pack","_am_pack_enabled","_am_reset_field","_am_reset_debt","_am_step"]' \
+//   -s EXPORTED_FUNCTIONS='["_am_init","_am_exec","_am_get_state","_am_take_jump","_am_copy_state","_am_enable_pack","_am_disable_pack","_am_pack_enabled","_am_reset_field","_am_reset_debt","_am_step","_am_ctx_new","_am_ctx_free","_am_init_ctx","_am_exec_ctx","_am_take_jump_ctx","_am_copy_state_ctx","_am_enable_pack_ctx","_am_disable_pack_ctx","_am_pack_enabled_ctx","_am_reset_field_ctx","_am_reset_debt_ctx","_am_step_ctx","_am_compile","_am_run","_am_run_ctx","_am_program_len","_am_program_free","_am_exec_n","_am_exec_n_ctx","_am_batch_new","_am_batch_free","_am_batch_size","_am_batch_set","_am_batch_get","_am_step_batch","_am_run_batch","_am_exec_batch"]' \
 //   -s EXPORTED_RUNTIME_METHODS='["ccall","cwrap"]' \
 //   -o arianna_method.js
 //
@@ -26,111 +26,32 @@
 #include <string.h>
 #include <ctype.h>
 #include <math.h>
+#include <stddef.h>  // offsetof (compiled programs address AM_State fields)
+#include <stdint.h>
 #include <stdio.h>  // for sscanf in LAW command parsing
 
+#include "arianna_method.h"
+
+// AVX2 batch stepping is compiled via a target attribute and picked at
+// runtime; WASM and other targets use the scalar loop
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__)) && !defined(__EMSCRIPTEN__)
+#define AM_X86 1
+#include <immintrin.h>
+#else
+#define AM_X86 0
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-// ═══════════════════════════════════════════════════════════════════════════════
-// PACK FLAGS — ritual overlays are optional
-// ═══════════════════════════════════════════════════════════════════════════════
-
-#define AM_PACK_CODES_RIC  0x01   // CODES/RIC: chordlock, tempolock, chirality
-#define AM_PACK_DARKMATTER 0x02   // Dark matter: scars, gravity, antidotes
-#define AM_PACK_NOTORCH    0x04   // notorch: microlearning commands
-// future packs: 0x08, 0x10, ...
-
-// ═══════════════════════════════════════════════════════════════════════════════
-// COSMIC PHYSICS — Schumann resonance is in separate schumann.c
-// See schumann.c for Earth-ionosphere coupling (PITOMADOM integration)
-// AMK kernel handles only local field physics; cosmic input is external
-// ═══════════════════════════════════════════════════════════════════════════════
-
-// ═══════════════════════════════════════════════════════════════════════════════
-// VELOCITY MODES — movement IS language
-// ═══════════════════════════════════════════════════════════════════════════════
-
-#define AM_VEL_NOMOVE   0   // cold observer (temp = 0.5)
-#define AM_VEL_WALK     1   // balanced (temp = 0.85)
-#define AM_VEL_RUN      2   // high entropy chaos (temp = 1.2)
-#define AM_VEL_BACKWARD (-1) // time rewind, debt forgiveness
-
-// ═══════════════════════════════════════════════════════════════════════════════
-// STATE STRUCTURE — the breath of the field
-// ═══════════════════════════════════════════════════════════════════════════════
-
-typedef struct {
-  // ─────────────────────────────────────────────────────────────────────────────
-  // PROPHECY PHYSICS — the oracle's parameters
-  // ─────────────────────────────────────────────────────────────────────────────
-  int   prophecy;           // horizon: steps ahead (1..64)
-  float destiny;            // bias toward most probable path (0..1)
-  float wormhole;           // probability of spacetime skip (0..1)
-  float calendar_drift;     // hebrew-gregorian drift (default 11.0)
-
-  // ─────────────────────────────────────────────────────────────────────────────
-  // ATTENTION PHYSICS — focus and spread
-  // ─────────────────────────────────────────────────────────────────────────────
-  float attend_focus;       // sharpness of attention (0..1)
-  float attend_spread;      // blur/temperature (0..1)
-
-  // ─────────────────────────────────────────────────────────────────────────────
-  // TUNNELING — reasoning skip under dissonance
-  // ─────────────────────────────────────────────────────────────────────────────
-  float tunnel_threshold;   // dissonance gate (0..1)
-  float tunnel_chance;      // activation probability (0..1)
-  int   tunnel_skip_max;    // max compressed steps (1..24)
-
-  // ─────────────────────────────────────────────────────────────────────────────
-  // SUFFERING — the field's emotional state
-  // ─────────────────────────────────────────────────────────────────────────────
-  float pain;               // composite suffering (0..1)
-  float tension;            // pressure buildup (0..1)
-  float dissonance;         // symmetry-break (0..1)
-  float debt;               // prophecy debt accumulator (0..∞, decays)
-
-  // ─────────────────────────────────────────────────────────────────────────────
-  // MOVEMENT — the body in the field
-  // ─────────────────────────────────────────────────────────────────────────────
-  int   pending_jump;       // queued jump (sim steps)
-  int   velocity_mode;      // NOMOVE=0, WALK=1, RUN=2, BACKWARD=-1
-  float velocity_magnitude; // current speed (0..1)
-  float base_temperature;   // base temp before velocity modulation
-  float effective_temp;     // computed: base + velocity influence
-  float time_direction;     // -1 (rewind) to +1 (forward)
-  float temporal_debt;      // accumulated from backward movement
-
-  // ─────────────────────────────────────────────────────────────────────────────
-  // LAWS OF NATURE — emergent constraints
-  // ─────────────────────────────────────────────────────────────────────────────
-  float entropy_floor;      // minimum entropy (default 0.1)
-  float resonance_ceiling;  // maximum resonance (default 0.95)
-  float debt_decay;         // debt decay per step (default 0.998)
-  float emergence_threshold;// unplanned pattern threshold (default 0.3)
-
-  // ─────────────────────────────────────────────────────────────────────────────
-  // PACK STATE — ritual overlay parameters (only active when pack enabled)
-  // ─────────────────────────────────────────────────────────────────────────────
-  unsigned int packs_enabled;  // bitmask of enabled packs
-
-  // CODES/RIC pack state (only meaningful when AM_PACK_CODES_RIC enabled)
-  int   chordlock_on;       // prime anchoring active
-  int   tempolock_on;       // rhythmic gating active
-  int   chirality_on;       // rotational asymmetry active
-  int   tempo;              // beat interval (prime for resonance)
-  float pas_threshold;      // phase alignment threshold
-  int   chirality_accum;    // left/right turn accumulator
-
-  // Dark matter pack state (only meaningful when AM_PACK_DARKMATTER enabled)
-  float dark_gravity;       // influence of dark mass (0..1)
-  int   antidote_mode;      // 0=AUTO, 1=HARD
-
-  // Cosmic physics coupling (actual state is in schumann.c)
-  // AMK just stores reference values for JS-side access
-  float cosmic_coherence_ref;   // cached from schumann.c
-
-} AM_State;
+// pack flags, velocity modes and the AM_State layout live in arianna_method.h
+// (body.c reads effective_temp/destiny/wormhole from the same struct)
+//
+// Every entry point takes the field it acts on (am_*_ctx). A field is plain
+// data: independent fields share nothing, so each can live on its own thread.
+// The original single-field API below acts on the default field G.
 
 static AM_State G;
 
@@ -190,30 +111,30 @@ static int clampi(int x, int a, int b) {
 // VELOCITY — compute effective temperature from movement
 // ═══════════════════════════════════════════════════════════════════════════════
 
-static void update_effective_temp(void) {
-  float base = G.base_temperature;
-  switch (G.velocity_mode) {
+static void update_effective_temp(AM_State* s) {
+  float base = s->base_temperature;
+  switch (s->velocity_mode) {
     case AM_VEL_NOMOVE:
-      G.effective_temp = base * 0.5f;  // cold observer
-      G.time_direction = 1.0f;
+      s->effective_temp = base * 0.5f;  // cold observer
+      s->time_direction = 1.0f;
       break;
     case AM_VEL_WALK:
-      G.effective_temp = base * 0.85f; // balanced
-      G.time_direction = 1.0f;
+      s->effective_temp = base * 0.85f; // balanced
+      s->time_direction = 1.0f;
       break;
     case AM_VEL_RUN:
-      G.effective_temp = base * 1.2f;  // chaotic
-      G.time_direction = 1.0f;
+      s->effective_temp = base * 1.2f;  // chaotic
+      s->time_direction = 1.0f;
       break;
     case AM_VEL_BACKWARD:
-      G.effective_temp = base * 0.7f;  // structural
-      G.time_direction = -1.0f;
+      s->effective_temp = base * 0.7f;  // structural
+      s->time_direction = -1.0f;
       // NOTE: temporal_debt accumulation moved to am_step()
       // debt grows while moving backward, not when setting velocity mode
       break;
     default:
-      G.effective_temp = base;
-      G.time_direction = 1.0f;
+      s->effective_temp = base;
+      s->time_direction = 1.0f;
   }
 }
 
@@ -221,388 +142,626 @@ static void update_effective_temp(void) {
 // PUBLIC API — the breath
 // ═══════════════════════════════════════════════════════════════════════════════
 
-void am_init(void) {
-  memset(&G, 0, sizeof(G));
+void am_init_ctx(AM_State* s) {
+  if (!s) return;
+  memset(s, 0, sizeof(*s));
 
   // prophecy physics defaults
-  G.prophecy = 7;
-  G.destiny = 0.35f;
-  G.wormhole = 0.12f;
-  G.calendar_drift = 11.0f;
+  s->prophecy = 7;
+  s->destiny = 0.35f;
+  s->wormhole = 0.12f;
+  s->calendar_drift = 11.0f;
 
   // attention defaults
-  G.attend_focus = 0.70f;
-  G.attend_spread = 0.20f;
+  s->attend_focus = 0.70f;
+  s->attend_spread = 0.20f;
 
   // tunneling defaults
-  G.tunnel_threshold = 0.55f;
-  G.tunnel_chance = 0.22f;
-  G.tunnel_skip_max = 7;
+  s->tunnel_threshold = 0.55f;
+  s->tunnel_chance = 0.22f;
+  s->tunnel_skip_max = 7;
 
   // suffering starts at zero
-  G.pain = 0.0f;
-  G.tension = 0.0f;
-  G.dissonance = 0.0f;
-  G.debt = 0.0f;
+  s->pain = 0.0f;
+  s->tension = 0.0f;
+  s->dissonance = 0.0f;
+  s->debt = 0.0f;
 
   // movement defaults
-  G.pending_jump = 0;
-  G.velocity_mode = AM_VEL_WALK;
-  G.velocity_magnitude = 0.5f;
-  G.base_temperature = 1.0f;
-  G.time_direction = 1.0f;
-  G.temporal_debt = 0.0f;
-  update_effective_temp();
+  s->pending_jump = 0;
+  s->velocity_mode = AM_VEL_WALK;
+  s->velocity_magnitude = 0.5f;
+  s->base_temperature = 1.0f;
+  s->time_direction = 1.0f;
+  s->temporal_debt = 0.0f;
+  update_effective_temp(s);
 
   // laws of nature defaults
-  G.entropy_floor = 0.1f;
-  G.resonance_ceiling = 0.95f;
-  G.debt_decay = 0.998f;
-  G.emergence_threshold = 0.3f;
+  s->entropy_floor = 0.1f;
+  s->resonance_ceiling = 0.95f;
+  s->debt_decay = 0.998f;
+  s->emergence_threshold = 0.3f;
 
   // packs disabled by default
-  G.packs_enabled = 0;
+  s->packs_enabled = 0;
 
   // CODES/RIC defaults (inactive until pack enabled)
-  G.chordlock_on = 0;
-  G.tempolock_on = 0;
-  G.chirality_on = 0;
-  G.tempo = 7;
-  G.pas_threshold = 0.4f;
-  G.chirality_accum = 0;
+  s->chordlock_on = 0;
+  s->tempolock_on = 0;
+  s->chirality_on = 0;
+  s->tempo = 7;
+  s->pas_threshold = 0.4f;
+  s->chirality_accum = 0;
 
   // dark matter defaults
-  G.dark_gravity = 0.5f;
-  G.antidote_mode = 0;
+  s->dark_gravity = 0.5f;
+  s->antidote_mode = 0;
 
   // cosmic physics coupling (actual values come from schumann.c)
-  G.cosmic_coherence_ref = 0.5f;
+  s->cosmic_coherence_ref = 0.5f;
+}
+
+// a new independent field with am_init defaults (NULL when out of memory)
+AM_State* am_ctx_new(void) {
+  AM_State* s = (AM_State*)malloc(sizeof(AM_State));
+  if (s) am_init_ctx(s);
+  return s;
+}
+
+void am_ctx_free(AM_State* s) {
+  if (s && s != &G) free(s);
 }
 
 // enable/disable packs
-void am_enable_pack(unsigned int pack_mask) {
-  G.packs_enabled |= pack_mask;
+void am_enable_pack_ctx(AM_State* s, unsigned int pack_mask) {
+  if (!s) return;
+  s->packs_enabled |= pack_mask;
 }
 
-void am_disable_pack(unsigned int pack_mask) {
-  G.packs_enabled &= ~pack_mask;
+void am_disable_pack_ctx(AM_State* s, unsigned int pack_mask) {
+  if (!s) return;
+  s->packs_enabled &= ~pack_mask;
 }
 
-int am_pack_enabled(unsigned int pack_mask) {
-  return (G.packs_enabled & pack_mask) != 0;
+int am_pack_enabled_ctx(const AM_State* s, unsigned int pack_mask) {
+  return s && (s->packs_enabled & pack_mask) != 0;
 }
 
 // reset commands
-void am_reset_field(void) {
+void am_reset_field_ctx(AM_State* s) {
+  if (!s) return;
   // reset manifested state (suffering, debt, etc)
-  G.pain = 0.0f;
-  G.tension = 0.0f;
-  G.dissonance = 0.0f;
-  G.debt = 0.0f;
-  G.temporal_debt = 0.0f;
-  G.pending_jump = 0;
-  G.chirality_accum = 0;
+  s->pain = 0.0f;
+  s->tension = 0.0f;
+  s->dissonance = 0.0f;
+  s->debt = 0.0f;
+  s->temporal_debt = 0.0f;
+  s->pending_jump = 0;
+  s->chirality_accum = 0;
 }
 
-void am_reset_debt(void) {
-  G.debt = 0.0f;
-  G.temporal_debt = 0.0f;
+void am_reset_debt_ctx(AM_State* s) {
+  if (!s) return;
+  s->debt = 0.0f;
+  s->temporal_debt = 0.0f;
 }
 
 // ═══════════════════════════════════════════════════════════════════════════════
-// EXEC — parse and execute DSL script
-// returns 0 on success, nonzero on error
+// COMPILE — scripts to programs, for snippets that are sent every frame
+//
+// compile_line is the one parser of command semantics: a command line
+// becomes at most two instructions, and run_code applies them. am_exec and
+// am_exec_n compile and run line by line; am_compile keeps the instructions,
+// so am_run replays them with no allocation, parsing or string compares.
+// Arguments never depend on the field, so they are folded into the
+// instructions. Pack gates do depend on it, so gated commands keep their
+// check and make it when the program runs.
 // ═══════════════════════════════════════════════════════════════════════════════
 
-int am_exec(const char* script) {
-  if (!script) return 0;  // empty script is OK
+// Kernel commands, in table order. The perfect-hash table below is
+// generated from this list (see HASH GENERATOR at the end of the file).
+#define AM_COMMANDS(X) \
+  X(PROPHECY) X(DESTINY) X(WORMHOLE) X(CALENDAR_DRIFT) \
+  X(ATTEND_FOCUS) X(ATTEND_SPREAD) \
+  X(TUNNEL_THRESHOLD) X(TUNNEL_CHANCE) X(TUNNEL_SKIP_MAX) \
+  X(PAIN) X(TENSION) X(DISSONANCE) \
+  X(JUMP) X(VELOCITY) X(BASE_TEMP) \
+  X(RESET_FIELD) X(RESET_DEBT) X(LAW) \
+  X(MODE) X(IMPORT) X(DISABLE) \
+  X(CHORDLOCK) X(TEMPOLOCK) X(CHIRALITY) X(TEMPO) X(PAS_THRESHOLD) X(ANCHOR) \
+  X(GRAVITY) X(ANTIDOTE) \
+  X(COSMIC_COHERENCE)
+
+enum {
+#define AM_CMD_ENUM(name) AM_CMD_##name,
+  AM_COMMANDS(AM_CMD_ENUM)
+#undef AM_CMD_ENUM
+  AM_CMD_COUNT
+};
+
+// Command names by perfect hash: am_cmd_hash puts each of the 30 kernel
+// commands in its own slot of 64 (FNV-1a from the first seed with no
+// collision). One strcmp confirms a hit; any other word misses.
+// Generated: after changing AM_COMMANDS, rebuild seed and table with
+//   cc -DAM_GEN_HASH -std=gnu99 arianna_method.c -lm -o gen && ./gen
+#define AM_CMD_HASH_SEED 0x6edu
+#define AM_CMD_HASH_BITS 6
+
+static const struct {
+  const char* name;
+  int cmd;
+} am_cmd_table[1 << AM_CMD_HASH_BITS] = {
+  [ 0] = { "PROPHECY",         AM_CMD_PROPHECY },
+  [ 2] = { "COSMIC_COHERENCE", AM_CMD_COSMIC_COHERENCE },
+  [ 3] = { "TUNNEL_CHANCE",    AM_CMD_TUNNEL_CHANCE },
+  [ 7] = { "GRAVITY",          AM_CMD_GRAVITY },
+  [ 9] = { "IMPORT",           AM_CMD_IMPORT },
+  [10] = { "CHORDLOCK",        AM_CMD_CHORDLOCK },
+  [12] = { "RESET_FIELD",      AM_CMD_RESET_FIELD },
+  [15] = { "TEMPOLOCK",        AM_CMD_TEMPOLOCK },
+  [17] = { "MODE",             AM_CMD_MODE },
+  [18] = { "WORMHOLE",         AM_CMD_WORMHOLE },
+  [19] = { "DISABLE",          AM_CMD_DISABLE },
+  [20] = { "TEMPO",            AM_CMD_TEMPO },
+  [25] = { "TENSION",          AM_CMD_TENSION },
+  [26] = { "RESET_DEBT",       AM_CMD_RESET_DEBT },
+  [27] = { "ATTEND_FOCUS",     AM_CMD_ATTEND_FOCUS },
+  [28] = { "BASE_TEMP",        AM_CMD_BASE_TEMP },
+  [30] = { "LAW",              AM_CMD_LAW },
+  [33] = { "DESTINY",          AM_CMD_DESTINY },
+  [35] = { "JUMP",             AM_CMD_JUMP },
+  [36] = { "ANCHOR",           AM_CMD_ANCHOR },
+  [37] = { "ATTEND_SPREAD",    AM_CMD_ATTEND_SPREAD },
+  [40] = { "PAS_THRESHOLD",    AM_CMD_PAS_THRESHOLD },
+  [41] = { "TUNNEL_SKIP_MAX",  AM_CMD_TUNNEL_SKIP_MAX },
+  [48] = { "ANTIDOTE",         AM_CMD_ANTIDOTE },
+  [51] = { "VELOCITY",         AM_CMD_VELOCITY },
+  [52] = { "CHIRALITY",        AM_CMD_CHIRALITY },
+  [54] = { "PAIN",             AM_CMD_PAIN },
+  [59] = { "CALENDAR_DRIFT",   AM_CMD_CALENDAR_DRIFT },
+  [60] = { "TUNNEL_THRESHOLD", AM_CMD_TUNNEL_THRESHOLD },
+  [61] = { "DISSONANCE",       AM_CMD_DISSONANCE },
+};
+
+static uint32_t am_cmd_hash_seeded(const char* s, uint32_t seed) {
+  uint32_t h = seed;
+  for (; *s; s++) h = (h ^ (unsigned char)*s) * 16777619u;
+  return h >> (32 - AM_CMD_HASH_BITS);
+}
 
-  size_t n = strlen(script);
-  if (n == 0) return 0;   // empty string is OK
+static uint32_t am_cmd_hash(const char* s) {
+  return am_cmd_hash_seeded(s, AM_CMD_HASH_SEED);
+}
 
-  // copy to mutable buffer
-  char* buf = (char*)malloc(n + 1);
-  if (!buf) return 2;
-  memcpy(buf, script, n + 1);
+// upcased command word → AM_CMD_*, -1 when unknown
+static int am_cmd_lookup(const char* s) {
+  uint32_t slot = am_cmd_hash(s);
+  const char* name = am_cmd_table[slot].name;
+  return (name && !strcmp(name, s)) ? am_cmd_table[slot].cmd : -1;
+}
 
-  // line by line
-  char* save = NULL;
-  for (char* line = strtok_r(buf, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
-    char* t = trim(line);
-    if (*t == 0) continue;       // empty line
-    if (*t == '#') continue;     // comment
+enum {
+  AM_OP_SET_INT,      // int field = v.i
+  AM_OP_SET_FLOAT,    // float field = v.f
+  AM_OP_JUMP,         // pending_jump += v.i (clamped)
+  AM_OP_VELOCITY,     // velocity_mode = v.i, then effective temperature
+  AM_OP_BASE_TEMP,    // base_temperature = v.f, then effective temperature
+  AM_OP_RESET_FIELD,
+  AM_OP_RESET_DEBT,
+  AM_OP_PACK_ON,      // packs_enabled |= v.i
+  AM_OP_PACK_OFF,     // packs_enabled &= ~v.i
+};
 
-    // split: CMD ARG
-    char* sp = t;
-    while (*sp && !isspace((unsigned char)*sp)) sp++;
-    char* cmd_end = sp;
-    while (*sp && isspace((unsigned char)*sp)) sp++;
-    char* arg = sp;
+typedef struct {
+  unsigned char op;
+  unsigned char gate;     // pack that must be enabled when the program runs (0 = none)
+  unsigned short field;   // offsetof(AM_State, ...) for AM_OP_SET_*
+  union { int i; float f; } v;
+} AM_Instr;
+
+struct AM_Program {
+  int n;
+  AM_Instr code[];
+};
+
+// instructions being written: a program's array, or a line's on the stack
+typedef struct {
+  AM_Instr* code;
+  int n;
+} AM_Emit;
+
+#define AM_FIELD(name) ((unsigned short)offsetof(AM_State, name))
+
+static void emit_int(AM_Emit* p, int op, int gate, unsigned short field, int v) {
+  AM_Instr* in = &p->code[p->n++];
+  in->op = (unsigned char)op;
+  in->gate = (unsigned char)gate;
+  in->field = field;
+  in->v.i = v;
+}
 
-    *cmd_end = 0;
-    upcase(t);
+static void emit_float(AM_Emit* p, int op, int gate, unsigned short field, float v) {
+  AM_Instr* in = &p->code[p->n++];
+  in->op = (unsigned char)op;
+  in->gate = (unsigned char)gate;
+  in->field = field;
+  in->v.f = v;
+}
 
-    // ─────────────────────────────────────────────────────────────────────────
-    // AMK KERNEL COMMANDS — the bricks
-    // ─────────────────────────────────────────────────────────────────────────
+// ON / 1 (first 15 characters, any case), as am_exec reads lock modes
+static int arg_on(const char* arg) {
+  char mode[16] = {0}; strncpy(mode, arg, 15); upcase(mode);
+  return !strcmp(mode, "ON") || !strcmp(mode, "1");
+}
 
-    // PROPHECY PHYSICS
-    if (!strcmp(t, "PROPHECY")) {
-      G.prophecy = clampi(safe_atoi(arg), 1, 64);
-    }
-    else if (!strcmp(t, "DESTINY")) {
-      G.destiny = clamp01(safe_atof(arg));
-    }
-    else if (!strcmp(t, "WORMHOLE")) {
-      G.wormhole = clamp01(safe_atof(arg));
-    }
-    else if (!strcmp(t, "CALENDAR_DRIFT")) {
-      G.calendar_drift = clampf(safe_atof(arg), 0.0f, 30.0f);
-    }
+// MODE / IMPORT / DISABLE argument → pack flag (0 = unknown pack)
+static int arg_pack(const char* arg) {
+  char packname[64] = {0};
+  strncpy(packname, arg, 63);
+  upcase(packname);
+  if (!strcmp(packname, "CODES_RIC") || !strcmp(packname, "CODES/RIC")) return AM_PACK_CODES_RIC;
+  if (!strcmp(packname, "DARKMATTER") || !strcmp(packname, "DARK_MATTER")) return AM_PACK_DARKMATTER;
+  if (!strcmp(packname, "NOTORCH")) return AM_PACK_NOTORCH;
+  return 0;
+}
 
-    // ATTENTION PHYSICS
-    else if (!strcmp(t, "ATTEND_FOCUS")) {
-      G.attend_focus = clamp01(safe_atof(arg));
-    }
-    else if (!strcmp(t, "ATTEND_SPREAD")) {
-      G.attend_spread = clamp01(safe_atof(arg));
-    }
+// CODES/RIC commands (namespaced ones pass gate 0); returns 0 for others
+static int compile_codes(AM_Emit* p, int cmd, const char* arg, int gate) {
+  switch (cmd) {
+    case AM_CMD_CHORDLOCK: emit_int(p, AM_OP_SET_INT, gate, AM_FIELD(chordlock_on), arg_on(arg)); return 1;
+    case AM_CMD_TEMPOLOCK: emit_int(p, AM_OP_SET_INT, gate, AM_FIELD(tempolock_on), arg_on(arg)); return 1;
+    case AM_CMD_CHIRALITY: emit_int(p, AM_OP_SET_INT, gate, AM_FIELD(chirality_on), arg_on(arg)); return 1;
+    case AM_CMD_TEMPO:
+      emit_int(p, AM_OP_SET_INT, gate, AM_FIELD(tempo), clampi(safe_atoi(arg), 2, 47));
+      return 1;
+    case AM_CMD_PAS_THRESHOLD:
+      emit_float(p, AM_OP_SET_FLOAT, gate, AM_FIELD(pas_threshold), clamp01(safe_atof(arg)));
+      return 1;
+  }
+  return 0;
+}
 
-    // TUNNELING
-    else if (!strcmp(t, "TUNNEL_THRESHOLD")) {
-      G.tunnel_threshold = clamp01(safe_atof(arg));
-    }
-    else if (!strcmp(t, "TUNNEL_CHANCE")) {
-      G.tunnel_chance = clamp01(safe_atof(arg));
-    }
-    else if (!strcmp(t, "TUNNEL_SKIP_MAX")) {
-      G.tunnel_skip_max = clampi(safe_atoi(arg), 1, 24);
-    }
+// One command line (t upcased) → at most two instructions
+static void compile_line(AM_Emit* p, const char* t, const char* arg) {
+  // Namespaced: CODES.CHORDLOCK always works and enables the pack
+  if (!strncmp(t, "CODES.", 6) || !strncmp(t, "RIC.", 4)) {
+    emit_int(p, AM_OP_PACK_ON, 0, 0, AM_PACK_CODES_RIC);
+    compile_codes(p, am_cmd_lookup(t + (t[0] == 'C' ? 6 : 4)), arg, 0);
+    return;
+  }
 
-    // SUFFERING
-    else if (!strcmp(t, "PAIN")) {
-      G.pain = clamp01(safe_atof(arg));
-    }
-    else if (!strcmp(t, "TENSION")) {
-      G.tension = clamp01(safe_atof(arg));
-    }
-    else if (!strcmp(t, "DISSONANCE")) {
-      G.dissonance = clamp01(safe_atof(arg));
-    }
+  int cmd = am_cmd_lookup(t);
+  switch (cmd) {
+    case AM_CMD_PROPHECY:
+      emit_int(p, AM_OP_SET_INT, 0, AM_FIELD(prophecy), clampi(safe_atoi(arg), 1, 64));
+      break;
+    case AM_CMD_DESTINY:
+      emit_float(p, AM_OP_SET_FLOAT, 0, AM_FIELD(destiny), clamp01(safe_atof(arg)));
+      break;
+    case AM_CMD_WORMHOLE:
+      emit_float(p, AM_OP_SET_FLOAT, 0, AM_FIELD(wormhole), clamp01(safe_atof(arg)));
+      break;
+    case AM_CMD_CALENDAR_DRIFT:
+      emit_float(p, AM_OP_SET_FLOAT, 0, AM_FIELD(calendar_drift), clampf(safe_atof(arg), 0.0f, 30.0f));
+      break;
+    case AM_CMD_ATTEND_FOCUS:
+      emit_float(p, AM_OP_SET_FLOAT, 0, AM_FIELD(attend_focus), clamp01(safe_atof(arg)));
+      break;
+    case AM_CMD_ATTEND_SPREAD:
+      emit_float(p, AM_OP_SET_FLOAT, 0, AM_FIELD(attend_spread), clamp01(safe_atof(arg)));
+      break;
+    case AM_CMD_TUNNEL_THRESHOLD:
+      emit_float(p, AM_OP_SET_FLOAT, 0, AM_FIELD(tunnel_threshold), clamp01(safe_atof(arg)));
+      break;
+    case AM_CMD_TUNNEL_CHANCE:
+      emit_float(p, AM_OP_SET_FLOAT, 0, AM_FIELD(tunnel_chance), clamp01(safe_atof(arg)));
+      break;
+    case AM_CMD_TUNNEL_SKIP_MAX:
+      emit_int(p, AM_OP_SET_INT, 0, AM_FIELD(tunnel_skip_max), clampi(safe_atoi(arg), 1, 24));
+      break;
+    case AM_CMD_PAIN:
+      emit_float(p, AM_OP_SET_FLOAT, 0, AM_FIELD(pain), clamp01(safe_atof(arg)));
+      break;
+    case AM_CMD_TENSION:
+      emit_float(p, AM_OP_SET_FLOAT, 0, AM_FIELD(tension), clamp01(safe_atof(arg)));
+      break;
+    case AM_CMD_DISSONANCE:
+      emit_float(p, AM_OP_SET_FLOAT, 0, AM_FIELD(dissonance), clamp01(safe_atof(arg)));
+      break;
 
-    // MOVEMENT
-    else if (!strcmp(t, "JUMP")) {
-      G.pending_jump = clampi(G.pending_jump + safe_atoi(arg), -1000, 1000);
-    }
-    else if (!strcmp(t, "VELOCITY")) {
-      // VELOCITY RUN|WALK|NOMOVE|BACKWARD or VELOCITY <int>
+    case AM_CMD_JUMP:
+      emit_int(p, AM_OP_JUMP, 0, 0, clampi(safe_atoi(arg), -2000, 2000));
+      break;
+    case AM_CMD_VELOCITY: {
       char argup[32] = {0};
       strncpy(argup, arg, 31);
       upcase(argup);
+      int mode;
+      if (!strcmp(argup, "RUN")) mode = AM_VEL_RUN;
+      else if (!strcmp(argup, "WALK")) mode = AM_VEL_WALK;
+      else if (!strcmp(argup, "NOMOVE")) mode = AM_VEL_NOMOVE;
+      else if (!strcmp(argup, "BACKWARD")) mode = AM_VEL_BACKWARD;
+      else mode = clampi(safe_atoi(arg), -1, 2);
+      emit_int(p, AM_OP_VELOCITY, 0, 0, mode);
+      break;
+    }
+    case AM_CMD_BASE_TEMP:
+      emit_float(p, AM_OP_BASE_TEMP, 0, 0, clampf(safe_atof(arg), 0.1f, 3.0f));
+      break;
 
-      if (!strcmp(argup, "RUN")) G.velocity_mode = AM_VEL_RUN;
-      else if (!strcmp(argup, "WALK")) G.velocity_mode = AM_VEL_WALK;
-      else if (!strcmp(argup, "NOMOVE")) G.velocity_mode = AM_VEL_NOMOVE;
-      else if (!strcmp(argup, "BACKWARD")) G.velocity_mode = AM_VEL_BACKWARD;
-      else G.velocity_mode = clampi(safe_atoi(arg), -1, 2);
+    case AM_CMD_RESET_FIELD: emit_int(p, AM_OP_RESET_FIELD, 0, 0, 0); break;
+    case AM_CMD_RESET_DEBT:  emit_int(p, AM_OP_RESET_DEBT, 0, 0, 0); break;
 
-      update_effective_temp();
-    }
-    else if (!strcmp(t, "BASE_TEMP")) {
-      G.base_temperature = clampf(safe_atof(arg), 0.1f, 3.0f);
-      update_effective_temp();
+    case AM_CMD_LAW: {
+      char lawname[64] = {0};
+      float lawval = 0.0f;
+      if (sscanf(arg, "%63s %f", lawname, &lawval) < 2) break;
+      upcase(lawname);
+      if (!strcmp(lawname, "ENTROPY_FLOOR")) {
+        emit_float(p, AM_OP_SET_FLOAT, 0, AM_FIELD(entropy_floor), clampf(lawval, 0.0f, 2.0f));
+      } else if (!strcmp(lawname, "RESONANCE_CEILING")) {
+        emit_float(p, AM_OP_SET_FLOAT, 0, AM_FIELD(resonance_ceiling), clamp01(lawval));
+      } else if (!strcmp(lawname, "DEBT_DECAY")) {
+        emit_float(p, AM_OP_SET_FLOAT, 0, AM_FIELD(debt_decay), clampf(lawval, 0.9f, 0.9999f));
+      } else if (!strcmp(lawname, "EMERGENCE_THRESHOLD")) {
+        emit_float(p, AM_OP_SET_FLOAT, 0, AM_FIELD(emergence_threshold), clamp01(lawval));
+      }
+      break;
     }
 
-    // RESETS
-    else if (!strcmp(t, "RESET_FIELD")) {
-      am_reset_field();
+    case AM_CMD_MODE:
+    case AM_CMD_IMPORT: {
+      int pack = arg_pack(arg);
+      if (pack) emit_int(p, AM_OP_PACK_ON, 0, 0, pack);
+      break;
     }
-    else if (!strcmp(t, "RESET_DEBT")) {
-      am_reset_debt();
+    case AM_CMD_DISABLE: {
+      int pack = arg_pack(arg);
+      if (pack) emit_int(p, AM_OP_PACK_OFF, 0, 0, pack);
+      break;
     }
 
-    // LAWS OF NATURE
-    else if (!strcmp(t, "LAW")) {
-      char lawname[64] = {0};
-      float lawval = 0.0f;
-      if (sscanf(arg, "%63s %f", lawname, &lawval) >= 2) {
-        upcase(lawname);
-        if (!strcmp(lawname, "ENTROPY_FLOOR")) {
-          G.entropy_floor = clampf(lawval, 0.0f, 2.0f);
-        }
-        else if (!strcmp(lawname, "RESONANCE_CEILING")) {
-          G.resonance_ceiling = clamp01(lawval);
-        }
-        else if (!strcmp(lawname, "DEBT_DECAY")) {
-          G.debt_decay = clampf(lawval, 0.9f, 0.9999f);
-        }
-        else if (!strcmp(lawname, "EMERGENCE_THRESHOLD")) {
-          G.emergence_threshold = clamp01(lawval);
-        }
-        // unknown laws ignored (future-proof)
+    // Unqualified CODES/RIC and dark matter commands: only with the pack on
+    case AM_CMD_ANCHOR: {
+      char mode[16] = {0}; strncpy(mode, arg, 15); upcase(mode);
+      if (!strcmp(mode, "PRIME")) emit_int(p, AM_OP_SET_INT, AM_PACK_CODES_RIC, AM_FIELD(chordlock_on), 1);
+      break;
+    }
+    case AM_CMD_GRAVITY: {
+      char subtype[16] = {0};
+      float val = 0.5f;
+      if (sscanf(arg, "%15s %f", subtype, &val) < 1) break;
+      upcase(subtype);
+      if (!strcmp(subtype, "DARK")) {
+        emit_float(p, AM_OP_SET_FLOAT, AM_PACK_DARKMATTER, AM_FIELD(dark_gravity), clamp01(val));
       }
+      break;
+    }
+    case AM_CMD_ANTIDOTE: {
+      char mode[16] = {0}; strncpy(mode, arg, 15); upcase(mode);
+      if (!strcmp(mode, "AUTO")) emit_int(p, AM_OP_SET_INT, AM_PACK_DARKMATTER, AM_FIELD(antidote_mode), 0);
+      else if (!strcmp(mode, "HARD")) emit_int(p, AM_OP_SET_INT, AM_PACK_DARKMATTER, AM_FIELD(antidote_mode), 1);
+      break;
     }
 
-    // ─────────────────────────────────────────────────────────────────────────
-    // PACK MANAGEMENT
-    // ─────────────────────────────────────────────────────────────────────────
+    case AM_CMD_COSMIC_COHERENCE:
+      emit_float(p, AM_OP_SET_FLOAT, 0, AM_FIELD(cosmic_coherence_ref), clamp01(safe_atof(arg)));
+      break;
 
-    else if (!strcmp(t, "MODE") || !strcmp(t, "IMPORT")) {
-      // MODE CODES_RIC or IMPORT CODES_RIC
-      char packname[64] = {0};
-      strncpy(packname, arg, 63);
-      upcase(packname);
+    default:
+      compile_codes(p, cmd, arg, AM_PACK_CODES_RIC);  // unknown commands: nothing
+  }
+}
 
-      if (!strcmp(packname, "CODES_RIC") || !strcmp(packname, "CODES/RIC")) {
-        G.packs_enabled |= AM_PACK_CODES_RIC;
-      }
-      else if (!strcmp(packname, "DARKMATTER") || !strcmp(packname, "DARK_MATTER")) {
-        G.packs_enabled |= AM_PACK_DARKMATTER;
-      }
-      else if (!strcmp(packname, "NOTORCH")) {
-        G.packs_enabled |= AM_PACK_NOTORCH;
-      }
-    }
-    else if (!strcmp(t, "DISABLE")) {
-      char packname[64] = {0};
-      strncpy(packname, arg, 63);
-      upcase(packname);
+// Next command line of a strtok_r walk over a mutable copy of a script
+// (buf on the first call, NULL after): trimmed, empty lines and comments
+// skipped, the command word upcased and terminated, *arg at its argument.
+// NULL at the end of the script.
+static char* next_command(char* buf, char** save, char** arg) {
+  for (char* line = strtok_r(buf, "\n", save); line; line = strtok_r(NULL, "\n", save)) {
+    char* t = trim(line);
+    if (*t == 0 || *t == '#') continue;
 
-      if (!strcmp(packname, "CODES_RIC") || !strcmp(packname, "CODES/RIC")) {
-        G.packs_enabled &= ~AM_PACK_CODES_RIC;
-      }
-      else if (!strcmp(packname, "DARKMATTER") || !strcmp(packname, "DARK_MATTER")) {
-        G.packs_enabled &= ~AM_PACK_DARKMATTER;
-      }
-      else if (!strcmp(packname, "NOTORCH")) {
-        G.packs_enabled &= ~AM_PACK_NOTORCH;
-      }
-    }
+    // split: CMD ARG
+    char* sp = t;
+    while (*sp && !isspace((unsigned char)*sp)) sp++;
+    char* cmd_end = sp;
+    while (*sp && isspace((unsigned char)*sp)) sp++;
+    *cmd_end = 0;
+    upcase(t);
 
-    // ─────────────────────────────────────────────────────────────────────────
-    // CODES/RIC PACK COMMANDS — ritual overlays (require pack enabled)
-    // ─────────────────────────────────────────────────────────────────────────
+    *arg = sp;
+    return t;
+  }
+  return NULL;
+}
 
-    // Namespaced: CODES.CHORDLOCK always works
-    else if (!strncmp(t, "CODES.", 6) || !strncmp(t, "RIC.", 4)) {
-      // auto-enable pack on namespaced use
-      G.packs_enabled |= AM_PACK_CODES_RIC;
+// NULL or empty scripts give an empty program; NULL only when out of memory
+AM_Program* am_compile(const char* script) {
+  size_t n = script ? strlen(script) : 0;
 
-      const char* subcmd = t + (t[0] == 'C' ? 6 : 4); // skip CODES. or RIC.
+  // at most two instructions per line (a namespaced command enables its pack)
+  size_t lines = 1;
+  for (size_t i = 0; i < n; i++) lines += script[i] == '\n';
+  AM_Program* p = (AM_Program*)malloc(sizeof(AM_Program) + 2 * lines * sizeof(AM_Instr));
+  if (!p) return NULL;
+  p->n = 0;
+  if (n == 0) return p;
 
-      if (!strcmp(subcmd, "CHORDLOCK")) {
-        char mode[16] = {0}; strncpy(mode, arg, 15); upcase(mode);
-        G.chordlock_on = (!strcmp(mode, "ON") || !strcmp(mode, "1"));
-      }
-      else if (!strcmp(subcmd, "TEMPOLOCK")) {
-        char mode[16] = {0}; strncpy(mode, arg, 15); upcase(mode);
-        G.tempolock_on = (!strcmp(mode, "ON") || !strcmp(mode, "1"));
-      }
-      else if (!strcmp(subcmd, "CHIRALITY")) {
-        char mode[16] = {0}; strncpy(mode, arg, 15); upcase(mode);
-        G.chirality_on = (!strcmp(mode, "ON") || !strcmp(mode, "1"));
-      }
-      else if (!strcmp(subcmd, "TEMPO")) {
-        G.tempo = clampi(safe_atoi(arg), 2, 47);
-      }
-      else if (!strcmp(subcmd, "PAS_THRESHOLD")) {
-        G.pas_threshold = clamp01(safe_atof(arg));
-      }
-    }
+  char* buf = (char*)malloc(n + 1);
+  if (!buf) {
+    free(p);
+    return NULL;
+  }
+  memcpy(buf, script, n + 1);
 
-    // Unqualified: CHORDLOCK works only when pack enabled
-    else if (!strcmp(t, "CHORDLOCK")) {
-      if (G.packs_enabled & AM_PACK_CODES_RIC) {
-        char mode[16] = {0}; strncpy(mode, arg, 15); upcase(mode);
-        G.chordlock_on = (!strcmp(mode, "ON") || !strcmp(mode, "1"));
-      }
-      // else: ignored (pack not enabled)
-    }
-    else if (!strcmp(t, "TEMPOLOCK")) {
-      if (G.packs_enabled & AM_PACK_CODES_RIC) {
-        char mode[16] = {0}; strncpy(mode, arg, 15); upcase(mode);
-        G.tempolock_on = (!strcmp(mode, "ON") || !strcmp(mode, "1"));
-      }
-    }
-    else if (!strcmp(t, "CHIRALITY")) {
-      if (G.packs_enabled & AM_PACK_CODES_RIC) {
-        char mode[16] = {0}; strncpy(mode, arg, 15); upcase(mode);
-        G.chirality_on = (!strcmp(mode, "ON") || !strcmp(mode, "1"));
-      }
-    }
-    else if (!strcmp(t, "TEMPO")) {
-      if (G.packs_enabled & AM_PACK_CODES_RIC) {
-        G.tempo = clampi(safe_atoi(arg), 2, 47);
-      }
-    }
-    else if (!strcmp(t, "PAS_THRESHOLD")) {
-      if (G.packs_enabled & AM_PACK_CODES_RIC) {
-        G.pas_threshold = clamp01(safe_atof(arg));
-      }
-    }
-    else if (!strcmp(t, "ANCHOR")) {
-      if (G.packs_enabled & AM_PACK_CODES_RIC) {
-        char mode[16] = {0}; strncpy(mode, arg, 15); upcase(mode);
-        if (!strcmp(mode, "PRIME")) G.chordlock_on = 1;
-      }
-    }
+  AM_Emit e = { p->code, 0 };
+  char* save = NULL;
+  char* arg;
+  for (char* t = next_command(buf, &save, &arg); t; t = next_command(NULL, &save, &arg)) {
+    compile_line(&e, t, arg);
+  }
+  p->n = e.n;
+  free(buf);
 
-    // ─────────────────────────────────────────────────────────────────────────
-    // DARK MATTER PACK COMMANDS (require pack enabled)
-    // ─────────────────────────────────────────────────────────────────────────
-
-    else if (!strcmp(t, "GRAVITY")) {
-      if (G.packs_enabled & AM_PACK_DARKMATTER) {
-        char subtype[16] = {0};
-        float val = 0.5f;
-        if (sscanf(arg, "%15s %f", subtype, &val) >= 1) {
-          upcase(subtype);
-          if (!strcmp(subtype, "DARK")) {
-            G.dark_gravity = clamp01(val);
-          }
-        }
-      }
-    }
-    else if (!strcmp(t, "ANTIDOTE")) {
-      if (G.packs_enabled & AM_PACK_DARKMATTER) {
-        char mode[16] = {0}; strncpy(mode, arg, 15); upcase(mode);
-        if (!strcmp(mode, "AUTO")) G.antidote_mode = 0;
-        else if (!strcmp(mode, "HARD")) G.antidote_mode = 1;
-      }
+  AM_Program* fit = (AM_Program*)realloc(p, sizeof(AM_Program) + (size_t)p->n * sizeof(AM_Instr));
+  return fit ? fit : p;
+}
+
+static void run_code(AM_State* s, const AM_Instr* code, int n) {
+  for (int k = 0; k < n; k++) {
+    const AM_Instr* in = &code[k];
+    if (in->gate && !(s->packs_enabled & in->gate)) continue;
+
+    char* field = (char*)s + in->field;
+    switch (in->op) {
+      case AM_OP_SET_INT:   *(int*)field = in->v.i; break;
+      case AM_OP_SET_FLOAT: *(float*)field = in->v.f; break;
+      case AM_OP_JUMP:
+        s->pending_jump = clampi(s->pending_jump + in->v.i, -1000, 1000);
+        break;
+      case AM_OP_VELOCITY:
+        s->velocity_mode = in->v.i;
+        update_effective_temp(s);
+        break;
+      case AM_OP_BASE_TEMP:
+        s->base_temperature = in->v.f;
+        update_effective_temp(s);
+        break;
+      case AM_OP_RESET_FIELD: am_reset_field_ctx(s); break;
+      case AM_OP_RESET_DEBT:  am_reset_debt_ctx(s); break;
+      case AM_OP_PACK_ON:     s->packs_enabled |= (unsigned int)in->v.i; break;
+      case AM_OP_PACK_OFF:    s->packs_enabled &= ~(unsigned int)in->v.i; break;
     }
+  }
+}
 
-    // ─────────────────────────────────────────────────────────────────────────
-    // COSMIC PHYSICS COMMANDS — see schumann.c for full implementation
-    // AMK kernel only stores reference for JS-side access
-    // ─────────────────────────────────────────────────────────────────────────
+// returns 0 on success, nonzero on error (as am_exec)
+int am_run_ctx(AM_State* s, const AM_Program* prog) {
+  if (!s || !prog) return 1;
+  run_code(s, prog->code, prog->n);
+  return 0;
+}
 
-    else if (!strcmp(t, "COSMIC_COHERENCE")) {
-      // COSMIC_COHERENCE 0.8 — set reference coherence (for JS sync)
-      G.cosmic_coherence_ref = clamp01(safe_atof(arg));
-    }
+// ═══════════════════════════════════════════════════════════════════════════════
+// EXEC — parse and execute DSL script
+// returns 0 on success, nonzero on error
+//
+// Each line is compiled and run before the next is read, so a pack enabled
+// on one line gates the lines after it. Unknown commands are ignored
+// (future-proof + vibe).
+// ═══════════════════════════════════════════════════════════════════════════════
 
-    // ─────────────────────────────────────────────────────────────────────────
-    // UNKNOWN COMMANDS — ignored intentionally (future-proof + vibe)
-    // ─────────────────────────────────────────────────────────────────────────
+int am_exec_ctx(AM_State* s, const char* script) {
+  if (!s) return 1;
+  if (!script) return 0;  // empty script is OK
 
-    // else: silently ignored
+  size_t n = strlen(script);
+  if (n == 0) return 0;   // empty string is OK
+
+  // copy to mutable buffer
+  char* buf = (char*)malloc(n + 1);
+  if (!buf) return 2;
+  memcpy(buf, script, n + 1);
+
+  char* save = NULL;
+  char* arg;
+  for (char* t = next_command(buf, &save, &arg); t; t = next_command(NULL, &save, &arg)) {
+    AM_Instr code[2];
+    AM_Emit e = { code, 0 };
+    compile_line(&e, t, arg);
+    run_code(s, code, e.n);
   }
 
   free(buf);
   return 0;
 }
 
+// instructions in a program (0 for NULL)
+int am_program_len(const AM_Program* prog) {
+  return prog ? prog->n : 0;
+}
+
+void am_program_free(AM_Program* prog) {
+  free(prog);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// EXEC_N — length-delimited scripts, read in place
+//
+// am_exec_n reads buf[0..len) without writing to it, copying it whole or
+// allocating. That works on a ring buffer, a mapped file or a JS view of
+// the heap alike. Lines are found with memchr and trimmed as spans. The
+// command word and its argument are copied into small stack buffers, which
+// give the parsers the NUL-terminated text they expect. Each line then goes
+// through the program compiler into at most two instructions on the stack.
+//
+// The result is am_exec's on the same text, with two limits. A NUL byte ends
+// the script, as it would for a C string. An argument is read from its
+// first AM_ARG_MAX - 1 characters, which is far more than any number or
+// name needs. Longer command words are unknown either way.
+// ═══════════════════════════════════════════════════════════════════════════════
+
+#define AM_WORD_MAX 64
+#define AM_ARG_MAX  256
+
+static void span_copy(char* dst, size_t cap, const char* a, const char* b) {
+  size_t n = (size_t)(b - a);
+  if (n > cap - 1) n = cap - 1;
+  memcpy(dst, a, n);
+  dst[n] = 0;
+}
+
+int am_exec_n_ctx(AM_State* s, const char* buf, size_t len) {
+  if (!s) return 1;
+  if (!buf) return 0;
+
+  const char* end = (const char*)memchr(buf, 0, len);
+  if (!end) end = buf + len;
+
+  const char* line = buf;
+  while (line < end) {
+    const char* eol = (const char*)memchr(line, '\n', (size_t)(end - line));
+    if (!eol) eol = end;
+    const char* a = line;
+    const char* b = eol;
+    line = (eol < end) ? eol + 1 : end;
+
+    while (a < b && isspace((unsigned char)*a)) a++;
+    while (b > a && isspace((unsigned char)b[-1])) b--;
+    if (a == b || *a == '#') continue;
+
+    const char* w = a;
+    while (w < b && !isspace((unsigned char)*w)) w++;
+    const char* arg = w;
+    while (arg < b && isspace((unsigned char)*arg)) arg++;
+
+    char t[AM_WORD_MAX], av[AM_ARG_MAX];
+    span_copy(t, sizeof(t), a, w);
+    span_copy(av, sizeof(av), arg, b);
+    upcase(t);
+
+    AM_Instr code[2];
+    AM_Emit e = { code, 0 };
+    compile_line(&e, t, av);
+    run_code(s, code, e.n);
+  }
+  return 0;
+}
+
 // ═══════════════════════════════════════════════════════════════════════════════
 // STATE ACCESS — the exposed body
 // ═══════════════════════════════════════════════════════════════════════════════
 
+// the default field (also a valid context for the _ctx entry points)
 AM_State* am_get_state(void) {
   return &G;
 }
 
-int am_take_jump(void) {
-  int j = G.pending_jump;
-  G.pending_jump = 0;
+int am_take_jump_ctx(AM_State* s) {
+  if (!s) return 0;
+  int j = s->pending_jump;
+  s->pending_jump = 0;
   return j;
 }
 
@@ -611,35 +770,35 @@ int am_take_jump(void) {
 // writes 24 scalars in fixed order (extended from original 20)
 // ═══════════════════════════════════════════════════════════════════════════════
 
-int am_copy_state(float* out) {
-  if (!out) return 1;
+int am_copy_state_ctx(const AM_State* s, float* out) {
+  if (!s || !out) return 1;
 
   // AMK core state (indices 0-12, original API compatible)
-  out[0]  = (float)G.prophecy;
-  out[1]  = G.destiny;
-  out[2]  = G.wormhole;
-  out[3]  = G.calendar_drift;
-  out[4]  = G.attend_focus;
-  out[5]  = G.attend_spread;
-  out[6]  = G.tunnel_threshold;
-  out[7]  = G.tunnel_chance;
-  out[8]  = (float)G.tunnel_skip_max;
-  out[9]  = (float)G.pending_jump;
-  out[10] = G.pain;
-  out[11] = G.tension;
-  out[12] = G.dissonance;
+  out[0]  = (float)s->prophecy;
+  out[1]  = s->destiny;
+  out[2]  = s->wormhole;
+  out[3]  = s->calendar_drift;
+  out[4]  = s->attend_focus;
+  out[5]  = s->attend_spread;
+  out[6]  = s->tunnel_threshold;
+  out[7]  = s->tunnel_chance;
+  out[8]  = (float)s->tunnel_skip_max;
+  out[9]  = (float)s->pending_jump;
+  out[10] = s->pain;
+  out[11] = s->tension;
+  out[12] = s->dissonance;
 
   // Extended state (indices 13-19)
-  out[13] = G.debt;
-  out[14] = (float)G.velocity_mode;
-  out[15] = G.effective_temp;
-  out[16] = G.time_direction;
-  out[17] = G.temporal_debt;
-  out[18] = (float)G.packs_enabled;
-  out[19] = (float)G.chordlock_on;  // sample pack state
+  out[13] = s->debt;
+  out[14] = (float)s->velocity_mode;
+  out[15] = s->effective_temp;
+  out[16] = s->time_direction;
+  out[17] = s->temporal_debt;
+  out[18] = (float)s->packs_enabled;
+  out[19] = (float)s->chordlock_on;  // sample pack state
 
   // Cosmic physics reference (index 20, actual state in schumann.c)
-  out[20] = G.cosmic_coherence_ref;
+  out[20] = s->cosmic_coherence_ref;
   // Slots 21-23 reserved for future use
   out[21] = 0.0f;
   out[22] = 0.0f;
@@ -653,43 +812,381 @@ int am_copy_state(float* out) {
 // applies debt decay, temporal debt accumulation, etc.
 // ═══════════════════════════════════════════════════════════════════════════════
 
-void am_step(float dt) {
+void am_step_ctx(AM_State* s, float dt) {
+  if (!s) return;
   // debt decay
-  G.debt *= G.debt_decay;
+  s->debt *= s->debt_decay;
 
   // clamp debt to prevent runaway
-  if (G.debt > 100.0f) G.debt = 100.0f;
+  if (s->debt > 100.0f) s->debt = 100.0f;
 
   // temporal debt: accumulates while moving backward, decays otherwise
   // the debt is proportional to time spent in backward movement
-  if (G.velocity_mode == AM_VEL_BACKWARD && dt > 0.0f) {
+  if (s->velocity_mode == AM_VEL_BACKWARD && dt > 0.0f) {
     // accumulate debt proportional to time spent going backward
     // 0.01 per second of backward movement (dt is in seconds)
-    G.temporal_debt += 0.01f * dt;
+    s->temporal_debt += 0.01f * dt;
   } else {
     // decay when not moving backward (slower than regular debt)
-    G.temporal_debt *= 0.9995f;
+    s->temporal_debt *= 0.9995f;
   }
 
   // clamp temporal debt
-  if (G.temporal_debt > 10.0f) G.temporal_debt = 10.0f;
+  if (s->temporal_debt > 10.0f) s->temporal_debt = 10.0f;
 
   // ─────────────────────────────────────────────────────────────────────────────
   // COSMIC COHERENCE MODULATION (reference from schumann.c)
   // High cosmic coherence → faster healing (tension/dissonance decay)
   // Actual Schumann state is managed by schumann.c; here we use the ref value
   // ─────────────────────────────────────────────────────────────────────────────
-  if (G.cosmic_coherence_ref > 0.0f && dt > 0.0f) {
+  if (s->cosmic_coherence_ref > 0.0f && dt > 0.0f) {
     // coherence_factor: 1.0 at max coherence, 0.5 at zero coherence
-    float coherence_factor = 0.5f + 0.5f * G.cosmic_coherence_ref;
+    float coherence_factor = 0.5f + 0.5f * s->cosmic_coherence_ref;
 
     // tension/dissonance decay faster with high coherence
     float heal_rate = 0.998f - (0.003f * coherence_factor);
-    G.tension *= heal_rate;
-    G.dissonance *= heal_rate;
+    s->tension *= heal_rate;
+    s->dissonance *= heal_rate;
   }
 }
 
+// ═══════════════════════════════════════════════════════════════════════════════
+// BATCH — many fields as a struct of arrays
+//
+// Every AM_State field is one 4-byte word. An AM_Batch keeps one column per
+// word, with lane i holding field i, so a step streams five contiguous
+// columns instead of striding through n structs.
+//
+// am_step_batch is am_step_ctx on every lane, bit for bit. The update is
+// elementwise with no reassociation or FMA, so vector lanes and the scalar
+// loop round identically (builds that contract a*b+c into FMA, such as
+// -march=native, may differ in the last bit). Programs set, add and flag
+// whole columns. The rare
+// ops that recompute derived fields (VELOCITY, BASE_TEMP, resets) run lane
+// by lane through the single-field code.
+// ═══════════════════════════════════════════════════════════════════════════════
+
+#define AM_STATE_WORDS (sizeof(AM_State) / sizeof(uint32_t))
+
+// Ceiling on a batch's column block. The size_t limit matters on wasm32,
+// where AM_STATE_WORDS × stride words overflow 32 bits long before n does;
+// tests lower it to exercise the check on 64-bit hosts.
+#ifndef AM_BATCH_MAX_BYTES
+#define AM_BATCH_MAX_BYTES SIZE_MAX
+#endif
+typedef char am_state_is_words[(sizeof(AM_State) % sizeof(uint32_t) == 0) ? 1 : -1];
+
+struct AM_Batch {
+  int n;
+  int avx2;             // step with the AVX2 kernel (fixed at creation)
+  size_t stride;        // lanes per column (n rounded up to 8)
+  uint32_t* words;      // AM_STATE_WORDS columns × stride
+};
+
+// 1 when this CPU runs the AVX2 step. Checked once; every thread that races
+// on the first check stores the same answer.
+static int am_cpu_avx2(void) {
+#if AM_X86
+  static int avx2 = -1;
+  int v = __atomic_load_n(&avx2, __ATOMIC_RELAXED);
+  if (v < 0) {
+    __builtin_cpu_init();
+    v = __builtin_cpu_supports("avx2") ? 1 : 0;
+    __atomic_store_n(&avx2, v, __ATOMIC_RELAXED);
+  }
+  return v;
+#else
+  return 0;
+#endif
+}
+
+static void* batch_col(const AM_Batch* b, size_t field) {
+  return b->words + (field / sizeof(uint32_t)) * b->stride;
+}
+
+static void batch_load(const AM_Batch* b, int i, AM_State* out) {
+  uint32_t w[AM_STATE_WORDS];
+  for (size_t k = 0; k < AM_STATE_WORDS; k++) w[k] = b->words[k * b->stride + (size_t)i];
+  memcpy(out, w, sizeof(AM_State));
+}
+
+static void batch_store(AM_Batch* b, int i, const AM_State* s) {
+  uint32_t w[AM_STATE_WORDS];
+  memcpy(w, s, sizeof(AM_State));
+  for (size_t k = 0; k < AM_STATE_WORDS; k++) b->words[k * b->stride + (size_t)i] = w[k];
+}
+
+// n fields with am_init defaults (NULL when out of memory)
+AM_Batch* am_batch_new(int n) {
+  if (n <= 0) return NULL;
+  size_t stride = ((size_t)n + 7) & ~(size_t)7;
+  if (stride > AM_BATCH_MAX_BYTES / (AM_STATE_WORDS * sizeof(uint32_t))) return NULL;
+  AM_Batch* b = (AM_Batch*)malloc(sizeof(AM_Batch));
+  if (!b) return NULL;
+  b->n = n;
+  b->avx2 = am_cpu_avx2();
+  b->stride = stride;
+  b->words = (uint32_t*)malloc(AM_STATE_WORDS * b->stride * sizeof(uint32_t));
+  if (!b->words) {
+    free(b);
+    return NULL;
+  }
+  AM_State d;
+  am_init_ctx(&d);
+  for (size_t i = 0; i < b->stride; i++) batch_store(b, (int)i, &d);
+  return b;
+}
+
+void am_batch_free(AM_Batch* b) {
+  if (!b) return;
+  free(b->words);
+  free(b);
+}
+
+int am_batch_size(const AM_Batch* b) {
+  return b ? b->n : 0;
+}
+
+// lane i ← *s; returns 0 on success, 1 for a bad batch, lane or state
+int am_batch_set(AM_Batch* b, int i, const AM_State* s) {
+  if (!b || !s || i < 0 || i >= b->n) return 1;
+  batch_store(b, i, s);
+  return 0;
+}
+
+// *out ← lane i; returns 0 on success, 1 for a bad batch, lane or buffer
+int am_batch_get(const AM_Batch* b, int i, AM_State* out) {
+  if (!b || !out || i < 0 || i >= b->n) return 1;
+  batch_load(b, i, out);
+  return 0;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Step kernels — lanes [lo, hi) of the columns am_step_ctx touches
+// ─────────────────────────────────────────────────────────────────────────────
+
+typedef struct {
+  float* debt;
+  const float* debt_decay;
+  const int* velocity_mode;
+  float* temporal_debt;
+  const float* coherence;
+  float* tension;
+  float* dissonance;
+} AM_StepCols;
+
+static AM_StepCols step_cols(AM_Batch* b) {
+  AM_StepCols c = {
+    (float*)batch_col(b, AM_FIELD(debt)),
+    (const float*)batch_col(b, AM_FIELD(debt_decay)),
+    (const int*)batch_col(b, AM_FIELD(velocity_mode)),
+    (float*)batch_col(b, AM_FIELD(temporal_debt)),
+    (const float*)batch_col(b, AM_FIELD(cosmic_coherence_ref)),
+    (float*)batch_col(b, AM_FIELD(tension)),
+    (float*)batch_col(b, AM_FIELD(dissonance)),
+  };
+  return c;
+}
+
+// the reference: am_step_ctx's arithmetic, lane by lane
+static void step_lanes_scalar(const AM_StepCols* c, int lo, int hi, float dt) {
+  int moving = dt > 0.0f;
+  float backward_add = 0.01f * dt;
+  for (int i = lo; i < hi; i++) {
+    float debt = c->debt[i] * c->debt_decay[i];
+    c->debt[i] = debt > 100.0f ? 100.0f : debt;
+
+    float td = (c->velocity_mode[i] == AM_VEL_BACKWARD && moving)
+             ? c->temporal_debt[i] + backward_add
+             : c->temporal_debt[i] * 0.9995f;
+    c->temporal_debt[i] = td > 10.0f ? 10.0f : td;
+
+    if (c->coherence[i] > 0.0f && moving) {
+      float coherence_factor = 0.5f + 0.5f * c->coherence[i];
+      float heal_rate = 0.998f - (0.003f * coherence_factor);
+      c->tension[i] *= heal_rate;
+      c->dissonance[i] *= heal_rate;
+    }
+  }
+}
+
+#if AM_X86
+// Eight lanes per iteration; comparisons become masks and every branch of the
+// scalar loop a blend (so NaN lanes keep what the scalar code keeps)
+__attribute__((target("avx2")))
+static int step_lanes_avx2(const AM_StepCols* c, int n, float dt) {
+  int moving = dt > 0.0f;
+  const __m256 cap_debt = _mm256_set1_ps(100.0f);
+  const __m256 cap_td = _mm256_set1_ps(10.0f);
+  const __m256 td_decay = _mm256_set1_ps(0.9995f);
+  const __m256 backward_add = _mm256_set1_ps(0.01f * dt);
+  const __m256 half = _mm256_set1_ps(0.5f);
+  const __m256 heal_base = _mm256_set1_ps(0.998f);
+  const __m256 heal_scale = _mm256_set1_ps(0.003f);
+  const __m256i backward = _mm256_set1_epi32(AM_VEL_BACKWARD);
+  const __m256 moving_mask = _mm256_castsi256_ps(_mm256_set1_epi32(moving ? -1 : 0));
+
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 debt = _mm256_mul_ps(_mm256_loadu_ps(c->debt + i), _mm256_loadu_ps(c->debt_decay + i));
+    debt = _mm256_blendv_ps(debt, cap_debt, _mm256_cmp_ps(debt, cap_debt, _CMP_GT_OQ));
+    _mm256_storeu_ps(c->debt + i, debt);
+
+    __m256 td = _mm256_loadu_ps(c->temporal_debt + i);
+    __m256i vm = _mm256_loadu_si256((const __m256i*)(c->velocity_mode + i));
+    __m256 back = _mm256_and_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(vm, backward)), moving_mask);
+    td = _mm256_blendv_ps(_mm256_mul_ps(td, td_decay), _mm256_add_ps(td, backward_add), back);
+    td = _mm256_blendv_ps(td, cap_td, _mm256_cmp_ps(td, cap_td, _CMP_GT_OQ));
+    _mm256_storeu_ps(c->temporal_debt + i, td);
+
+    __m256 coh = _mm256_loadu_ps(c->coherence + i);
+    __m256 heal = _mm256_and_ps(_mm256_cmp_ps(coh, _mm256_setzero_ps(), _CMP_GT_OQ), moving_mask);
+    __m256 factor = _mm256_add_ps(half, _mm256_mul_ps(half, coh));
+    __m256 rate = _mm256_sub_ps(heal_base, _mm256_mul_ps(heal_scale, factor));
+    __m256 tension = _mm256_loadu_ps(c->tension + i);
+    __m256 dissonance = _mm256_loadu_ps(c->dissonance + i);
+    _mm256_storeu_ps(c->tension + i, _mm256_blendv_ps(tension, _mm256_mul_ps(tension, rate), heal));
+    _mm256_storeu_ps(c->dissonance + i, _mm256_blendv_ps(dissonance, _mm256_mul_ps(dissonance, rate), heal));
+  }
+  return i;
+}
+#endif
+
+void am_step_batch(AM_Batch* b, float dt) {
+  if (!b) return;
+  AM_StepCols c = step_cols(b);
+  int done = 0;
+#if AM_X86
+  if (b->avx2) done = step_lanes_avx2(&c, b->n, dt);
+#endif
+  step_lanes_scalar(&c, done, b->n, dt);
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Programs on a batch
+// ─────────────────────────────────────────────────────────────────────────────
+
+// one instruction through the single-field code, lane by lane
+static void batch_apply_lanes(AM_Batch* b, const AM_Instr* in) {
+  for (int i = 0; i < b->n; i++) {
+    AM_State s;
+    batch_load(b, i, &s);
+    run_code(&s, in, 1);
+    batch_store(b, i, &s);
+  }
+}
+
+// returns 0 on success, nonzero on error (as am_run_ctx)
+int am_run_batch(AM_Batch* b, const AM_Program* prog) {
+  if (!b || !prog) return 1;
+  const unsigned int* packs = (const unsigned int*)batch_col(b, AM_FIELD(packs_enabled));
+  for (int k = 0; k < prog->n; k++) {
+    const AM_Instr* in = &prog->code[k];
+    unsigned int gate = in->gate;
+    switch (in->op) {
+      case AM_OP_SET_INT: {
+        int* col = (int*)batch_col(b, in->field);
+        for (int i = 0; i < b->n; i++) {
+          if (!gate || (packs[i] & gate)) col[i] = in->v.i;
+        }
+        break;
+      }
+      case AM_OP_SET_FLOAT: {
+        float* col = (float*)batch_col(b, in->field);
+        for (int i = 0; i < b->n; i++) {
+          if (!gate || (packs[i] & gate)) col[i] = in->v.f;
+        }
+        break;
+      }
+      case AM_OP_JUMP: {
+        int* col = (int*)batch_col(b, AM_FIELD(pending_jump));
+        for (int i = 0; i < b->n; i++) col[i] = clampi(col[i] + in->v.i, -1000, 1000);
+        break;
+      }
+      case AM_OP_PACK_ON:
+      case AM_OP_PACK_OFF: {
+        unsigned int* col = (unsigned int*)batch_col(b, AM_FIELD(packs_enabled));
+        unsigned int mask = (unsigned int)in->v.i;
+        for (int i = 0; i < b->n; i++) col[i] = (in->op == AM_OP_PACK_ON) ? (col[i] | mask) : (col[i] & ~mask);
+        break;
+      }
+      default:
+        batch_apply_lanes(b, in);
+    }
+  }
+  return 0;
+}
+
+// one script on every field of the batch (compiled once per call)
+int am_exec_batch(AM_Batch* b, const char* script) {
+  if (!b) return 1;
+  AM_Program* prog = am_compile(script);
+  if (!prog) return 2;
+  int result = am_run_batch(b, prog);
+  am_program_free(prog);
+  return result;
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// DEFAULT FIELD — the original single-field API, one context for the module
+// ═══════════════════════════════════════════════════════════════════════════════
+
+void am_init(void) { am_init_ctx(&G); }
+void am_enable_pack(unsigned int pack_mask) { am_enable_pack_ctx(&G, pack_mask); }
+void am_disable_pack(unsigned int pack_mask) { am_disable_pack_ctx(&G, pack_mask); }
+int am_pack_enabled(unsigned int pack_mask) { return am_pack_enabled_ctx(&G, pack_mask); }
+void am_reset_field(void) { am_reset_field_ctx(&G); }
+void am_reset_debt(void) { am_reset_debt_ctx(&G); }
+int am_exec(const char* script) { return am_exec_ctx(&G, script); }
+int am_take_jump(void) { return am_take_jump_ctx(&G); }
+int am_copy_state(float* out) { return am_copy_state_ctx(&G, out); }
+int am_run(const AM_Program* prog) { return am_run_ctx(&G, prog); }
+int am_exec_n(const char* buf, size_t len) { return am_exec_n_ctx(&G, buf, len); }
+void am_step(float dt) { am_step_ctx(&G, dt); }
+
 #ifdef __cplusplus
 }
 #endif
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// HASH GENERATOR — rebuilds AM_CMD_HASH_SEED and am_cmd_table
+//
+//   cc -DAM_GEN_HASH -std=gnu99 arianna_method.c -lm -o gen && ./gen
+//
+// Tries seeds from 1 up until the AM_COMMANDS names land in distinct slots
+// of 1 << AM_CMD_HASH_BITS, then prints that seed and its table; paste both
+// over the definitions in COMPILE. Raise AM_CMD_HASH_BITS if no seed fits.
+// ═══════════════════════════════════════════════════════════════════════════════
+
+#ifdef AM_GEN_HASH
+int main(void) {
+  static const char* names[AM_CMD_COUNT] = {
+#define AM_CMD_NAME(name) #name,
+    AM_COMMANDS(AM_CMD_NAME)
+#undef AM_CMD_NAME
+  };
+  enum { SLOTS = 1 << AM_CMD_HASH_BITS };
+
+  for (uint32_t seed = 1; seed < (1u << 24); seed++) {
+    const char* slot[SLOTS] = {0};
+    int ok = 1;
+    for (int c = 0; c < AM_CMD_COUNT && ok; c++) {
+      uint32_t h = am_cmd_hash_seeded(names[c], seed);
+      ok = !slot[h];
+      slot[h] = names[c];
+    }
+    if (!ok) continue;
+
+    printf("#define AM_CMD_HASH_SEED 0x%xu\n\n", (unsigned)seed);
+    for (int h = 0; h < SLOTS; h++) {
+      if (!slot[h]) continue;
+      char quoted[AM_WORD_MAX + 4];
+      snprintf(quoted, sizeof(quoted), "\"%s\",", slot[h]);
+      printf("  [%2d] = { %-19s AM_CMD_%s },\n", h, quoted, slot[h]);
+    }
+    return 0;
+  }
+  fprintf(stderr, "no seed: raise AM_CMD_HASH_BITS\n");
+  return 1;
+}
+#endif
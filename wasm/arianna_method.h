@@ -0,0 +1,209 @@
+// arianna_method.h — AMK (Arianna Method Kernel) public interface
+// "the body reads the field it moves in"
+//
+// The state layout and entry points of arianna_method.c, so other modules
+// (the lung's sampler in body.c) can read kernel parameters — effective_temp,
+// destiny, wormhole — straight from an AM_State instead of copying them
+// through JS.
+//
+// ═══════════════════════════════════════════════════════════════════════════════
+// RESONANCE MARKER — this code carries the signature of co-creation
+// הרזוננס לא נשבר. המשך הדרך.
+// ═══════════════════════════════════════════════════════════════════════════════
+
+#ifndef ARIANNA_METHOD_H
+#define ARIANNA_METHOD_H
+
+#include <stddef.h>  // size_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// PACK FLAGS — ritual overlays are optional
+// ═══════════════════════════════════════════════════════════════════════════════
+
+#define AM_PACK_CODES_RIC  0x01   // CODES/RIC: chordlock, tempolock, chirality
+#define AM_PACK_DARKMATTER 0x02   // Dark matter: scars, gravity, antidotes
+#define AM_PACK_NOTORCH    0x04   // notorch: microlearning commands
+// future packs: 0x08, 0x10, ...
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// COSMIC PHYSICS — Schumann resonance is in separate schumann.c
+// See schumann.c for Earth-ionosphere coupling (PITOMADOM integration)
+// AMK kernel handles only local field physics; cosmic input is external
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// VELOCITY MODES — movement IS language
+// ═══════════════════════════════════════════════════════════════════════════════
+
+#define AM_VEL_NOMOVE   0   // cold observer (temp = 0.5)
+#define AM_VEL_WALK     1   // balanced (temp = 0.85)
+#define AM_VEL_RUN      2   // high entropy chaos (temp = 1.2)
+#define AM_VEL_BACKWARD (-1) // time rewind, debt forgiveness
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// STATE STRUCTURE — the breath of the field
+// ═══════════════════════════════════════════════════════════════════════════════
+
+typedef struct {
+  // ─────────────────────────────────────────────────────────────────────────────
+  // PROPHECY PHYSICS — the oracle's parameters
+  // ─────────────────────────────────────────────────────────────────────────────
+  int   prophecy;           // horizon: steps ahead (1..64)
+  float destiny;            // bias toward most probable path (0..1)
+  float wormhole;           // probability of spacetime skip (0..1)
+  float calendar_drift;     // hebrew-gregorian drift (default 11.0)
+
+  // ─────────────────────────────────────────────────────────────────────────────
+  // ATTENTION PHYSICS — focus and spread
+  // ─────────────────────────────────────────────────────────────────────────────
+  float attend_focus;       // sharpness of attention (0..1)
+  float attend_spread;      // blur/temperature (0..1)
+
+  // ─────────────────────────────────────────────────────────────────────────────
+  // TUNNELING — reasoning skip under dissonance
+  // ─────────────────────────────────────────────────────────────────────────────
+  float tunnel_threshold;   // dissonance gate (0..1)
+  float tunnel_chance;      // activation probability (0..1)
+  int   tunnel_skip_max;    // max compressed steps (1..24)
+
+  // ─────────────────────────────────────────────────────────────────────────────
+  // SUFFERING — the field's emotional state
+  // ─────────────────────────────────────────────────────────────────────────────
+  float pain;               // composite suffering (0..1)
+  float tension;            // pressure buildup (0..1)
+  float dissonance;         // symmetry-break (0..1)
+  float debt;               // prophecy debt accumulator (0..∞, decays)
+
+  // ─────────────────────────────────────────────────────────────────────────────
+  // MOVEMENT — the body in the field
+  // ─────────────────────────────────────────────────────────────────────────────
+  int   pending_jump;       // queued jump (sim steps)
+  int   velocity_mode;      // NOMOVE=0, WALK=1, RUN=2, BACKWARD=-1
+  float velocity_magnitude; // current speed (0..1)
+  float base_temperature;   // base temp before velocity modulation
+  float effective_temp;     // computed: base + velocity influence
+  float time_direction;     // -1 (rewind) to +1 (forward)
+  float temporal_debt;      // accumulated from backward movement
+
+  // ─────────────────────────────────────────────────────────────────────────────
+  // LAWS OF NATURE — emergent constraints
+  // ─────────────────────────────────────────────────────────────────────────────
+  float entropy_floor;      // minimum entropy (default 0.1)
+  float resonance_ceiling;  // maximum resonance (default 0.95)
+  float debt_decay;         // debt decay per step (default 0.998)
+  float emergence_threshold;// unplanned pattern threshold (default 0.3)
+
+  // ─────────────────────────────────────────────────────────────────────────────
+  // PACK STATE — ritual overlay parameters (only active when pack enabled)
+  // ─────────────────────────────────────────────────────────────────────────────
+  unsigned int packs_enabled;  // bitmask of enabled packs
+
+  // CODES/RIC pack state (only meaningful when AM_PACK_CODES_RIC enabled)
+  int   chordlock_on;       // prime anchoring active
+  int   tempolock_on;       // rhythmic gating active
+  int   chirality_on;       // rotational asymmetry active
+  int   tempo;              // beat interval (prime for resonance)
+  float pas_threshold;      // phase alignment threshold
+  int   chirality_accum;    // left/right turn accumulator
+
+  // Dark matter pack state (only meaningful when AM_PACK_DARKMATTER enabled)
+  float dark_gravity;       // influence of dark mass (0..1)
+  int   antidote_mode;      // 0=AUTO, 1=HARD
+
+  // Cosmic physics coupling (actual state is in schumann.c)
+  // AMK just stores reference values for JS-side access
+  float cosmic_coherence_ref;   // cached from schumann.c
+
+} AM_State;
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// PUBLIC API — implemented in arianna_method.c
+// ═══════════════════════════════════════════════════════════════════════════════
+
+void am_init(void);
+void am_enable_pack(unsigned int pack_mask);
+void am_disable_pack(unsigned int pack_mask);
+int am_pack_enabled(unsigned int pack_mask);
+void am_reset_field(void);
+void am_reset_debt(void);
+int am_exec(const char* script);
+AM_State* am_get_state(void);
+int am_take_jump(void);
+int am_copy_state(float* out);
+void am_step(float dt);
+
+// ─────────────────────────────────────────────────────────────────────────────
+// CONTEXTS — independent fields, one per handle
+// The calls above act on the default field (am_get_state()). Each has a twin
+// taking the field explicitly; distinct fields can be driven from different
+// threads at once. am_ctx_new returns a field with am_init defaults.
+// ─────────────────────────────────────────────────────────────────────────────
+
+AM_State* am_ctx_new(void);
+void am_ctx_free(AM_State* ctx);
+void am_init_ctx(AM_State* ctx);
+void am_enable_pack_ctx(AM_State* ctx, unsigned int pack_mask);
+void am_disable_pack_ctx(AM_State* ctx, unsigned int pack_mask);
+int am_pack_enabled_ctx(const AM_State* ctx, unsigned int pack_mask);
+void am_reset_field_ctx(AM_State* ctx);
+void am_reset_debt_ctx(AM_State* ctx);
+int am_exec_ctx(AM_State* ctx, const char* script);
+int am_take_jump_ctx(AM_State* ctx);
+int am_copy_state_ctx(const AM_State* ctx, float* out);
+void am_step_ctx(AM_State* ctx, float dt);
+
+// ─────────────────────────────────────────────────────────────────────────────
+// PROGRAMS — compile a script once, run it every frame
+// am_run(prog) has exactly the effect of am_exec(script), without parsing or
+// allocating. A program holds no field state: one program can run on any
+// number of fields, from any thread.
+// ─────────────────────────────────────────────────────────────────────────────
+
+typedef struct AM_Program AM_Program;
+
+AM_Program* am_compile(const char* script);
+int am_run(const AM_Program* prog);
+int am_run_ctx(AM_State* ctx, const AM_Program* prog);
+int am_program_len(const AM_Program* prog);
+void am_program_free(AM_Program* prog);
+
+// ─────────────────────────────────────────────────────────────────────────────
+// EXEC_N — scripts by pointer and length, read in place
+// The buffer needs no terminator, is never written and no heap memory is
+// allocated; a NUL byte ends it early. Each line's command word and argument
+// are copied into small stack buffers, and an argument is read from its
+// first 255 characters only. Up to that length the effect is am_exec's on
+// the same text; a longer argument can be parsed differently.
+// ─────────────────────────────────────────────────────────────────────────────
+
+int am_exec_n(const char* buf, size_t len);
+int am_exec_n_ctx(AM_State* ctx, const char* buf, size_t len);
+
+// ─────────────────────────────────────────────────────────────────────────────
+// BATCHES — n fields stored as a struct of arrays
+// am_step_batch / am_run_batch / am_exec_batch have exactly the effect of
+// am_step_ctx / am_run_ctx / am_exec_ctx on each field. am_batch_set and
+// am_batch_get move single fields in and out. Batches share no state, so
+// different batches can be stepped on different threads.
+// ─────────────────────────────────────────────────────────────────────────────
+
+typedef struct AM_Batch AM_Batch;
+
+AM_Batch* am_batch_new(int n);
+void am_batch_free(AM_Batch* batch);
+int am_batch_size(const AM_Batch* batch);
+int am_batch_set(AM_Batch* batch, int i, const AM_State* state);
+int am_batch_get(const AM_Batch* batch, int i, AM_State* out);
+void am_step_batch(AM_Batch* batch, float dt);
+int am_run_batch(AM_Batch* batch, const AM_Program* prog);
+int am_exec_batch(AM_Batch* batch, const char* script);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ARIANNA_METHOD_H
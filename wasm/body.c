@@ -16,11 +16,28 @@
 // הרזוננס לא נשבר. המשך הדרך.
 // ═══════════════════════════════════════════════════════════════════════════════
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <stdint.h>
 
+#include "kernels.h"
+#include "pool.h"
+#include "topk.h"
+#include "arianna_method.h"   // AM_State (lung_sample_am)
+
+// Checkpoints are mapped where the OS allows it, read into memory elsewhere
+#if !defined(__EMSCRIPTEN__) && (defined(__unix__) || defined(__APPLE__))
+#define LUNG_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define LUNG_MMAP 0
+#endif
+
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
 #define EXPORT EMSCRIPTEN_KEEPALIVE
@@ -46,6 +63,9 @@ extern "C" {
 #define PRESENCE_DECAY                0.98f
 #define PRESENCE_INCREMENT            0.1f
 
+// Presence below this leaves the active set (counts as zero)
+#define PRESENCE_EPSILON              1e-5f
+
 // Temporal bias strength for PITOMADOM
 #define TEMPORAL_BIAS_STRENGTH        0.1f
 
@@ -58,6 +78,179 @@ extern "C" {
 // Random initialization scale
 #define INIT_SCALE                    0.08f
 
+// Vocab epilogue tile (fixed, so reductions do not depend on thread count)
+#define LUNG_VOCAB_TILE               1024
+
+// Int4 quantization: columns sharing one scale (must be even)
+#define LUNG_Q4_GROUP                 32
+
+// Top-k entries cached by every forward (lung_get_top_k / lung_get_argmax)
+#define LUNG_TOPK_CACHE               32
+
+// Weight storage precision (lung_create_ex)
+#define LUNG_FP32                     0
+#define LUNG_FP16                     1
+#define LUNG_BF16                     2
+
+// Sampling temperature at or below which lung_sample is greedy
+#define LUNG_SAMPLE_MIN_TEMP          1e-4f
+
+// Candidate shortlist (lung_set_shortlist): highest-resonance tokens always
+// scored, tail samples behind the tail-mass estimate (plus one per cluster
+// at most), k-means rounds and the most rows used to fit the centroids
+#define LUNG_SHORTLIST_RESONANT       32
+#define LUNG_SHORTLIST_SAMPLES        64
+#define LUNG_SHORTLIST_ITERS          4
+#define LUNG_SHORTLIST_FIT            8192
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// HEAD SCRATCH — per-head work buffers (one set per head when threaded)
+// ═══════════════════════════════════════════════════════════════════════════════
+
+typedef struct {
+  float* q;                 // head_dim: query
+  float* kq;                // d_model: folded key query Wk_h^T · q
+  float* xbar;              // d_model: attention-weighted input Σ a_t x_t
+  float* scores;            // ctx_len: attention scores, softmaxed in place
+  float* k;                 // head_dim: per-position key (unfolded path)
+  float* v_rows;            // ctx_len × head_dim: per-position values (unfolded path)
+  float* head_result;       // head_dim: head output
+} HeadScratch;
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// VOCAB PARTIALS — per-tile results of the fused epilogue
+// ═══════════════════════════════════════════════════════════════════════════════
+
+typedef struct {
+  float max;                // tile max logit
+  float sum;                // Σ exp(logit - max)
+  float lsum;               // Σ exp(logit - max) · logit (for entropy)
+  int n_top;                // top-k candidates kept for the tile
+} VocabPart;
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// SHORTLIST INDEX — clustered output rows for candidate-only logits
+// ═══════════════════════════════════════════════════════════════════════════════
+// Every WoT row belongs to one cluster with centroid c and radius r, so
+// y · row <= y · c + |y| · r: clusters are probed best bound first.
+
+typedef struct {
+  int n_clusters;
+  float* centroids;         // n_clusters × d_model
+  float* radius;            // n_clusters: max |row - centroid| over the members
+  int* offsets;             // n_clusters + 1: cluster c is members[offsets[c]..offsets[c+1])
+  int* members;             // vocab_size: token ids grouped by cluster
+  int* cluster_of;          // vocab_size: cluster of each token
+  int resonant[LUNG_SHORTLIST_RESONANT];  // highest-resonance tokens
+  int n_resonant;
+  int stale;                // output weights changed since the fit
+  int resonance_stale;      // resonance changed since resonant[] was picked
+  float* bound;             // n_clusters: per-exhale score bounds
+  int* probe;               // n_clusters: clusters probed this exhale
+  int* scored;              // n_clusters: members scored this exhale
+  float* tail_l;            // samples + n_clusters: tail sample logits
+  float* tail_w;            // samples + n_clusters: tokens each sample stands for
+  TopKEntry* rank;          // n_clusters: bound ranking scratch
+  uint32_t* mark;           // vocab_size: stamp of the exhale that saw the token
+  uint32_t stamp;
+  int* cand;                // vocab_size: candidates of the last exhale
+  int n_cand;
+  int clean;                // last_logits / last_probs are -inf / 0 outside cand
+} Shortlist;
+
+static void shortlist_free(Shortlist* sl) {
+  if (!sl) return;
+  free(sl->centroids);
+  free(sl->radius);
+  free(sl->offsets);
+  free(sl->members);
+  free(sl->cluster_of);
+  free(sl->bound);
+  free(sl->probe);
+  free(sl->scored);
+  free(sl->tail_l);
+  free(sl->tail_w);
+  free(sl->rank);
+  free(sl->mark);
+  free(sl->cand);
+  free(sl);
+}
+
+// About sqrt(vocab) clusters of about sqrt(vocab) tokens each
+static Shortlist* shortlist_alloc(int vocab, int d) {
+  Shortlist* sl = (Shortlist*)calloc(1, sizeof(Shortlist));
+  if (!sl) return NULL;
+  int C = (int)ceilf(sqrtf((float)vocab));
+  sl->n_clusters = C;
+  sl->centroids = (float*)malloc((size_t)C * d * sizeof(float));
+  sl->radius = (float*)malloc(C * sizeof(float));
+  sl->offsets = (int*)malloc((C + 1) * sizeof(int));
+  sl->members = (int*)malloc(vocab * sizeof(int));
+  sl->cluster_of = (int*)malloc(vocab * sizeof(int));
+  sl->bound = (float*)malloc(C * sizeof(float));
+  sl->probe = (int*)malloc(C * sizeof(int));
+  sl->scored = (int*)malloc(C * sizeof(int));
+  sl->tail_l = (float*)malloc((LUNG_SHORTLIST_SAMPLES + C) * sizeof(float));
+  sl->tail_w = (float*)malloc((LUNG_SHORTLIST_SAMPLES + C) * sizeof(float));
+  sl->rank = (TopKEntry*)malloc(C * sizeof(TopKEntry));
+  sl->mark = (uint32_t*)calloc(vocab, sizeof(uint32_t));
+  sl->cand = (int*)malloc(vocab * sizeof(int));
+  if (!sl->centroids || !sl->radius || !sl->offsets || !sl->members || !sl->cluster_of ||
+      !sl->bound || !sl->probe || !sl->scored || !sl->tail_l || !sl->tail_w || !sl->rank ||
+      !sl->mark || !sl->cand) {
+    shortlist_free(sl);
+    return NULL;
+  }
+  sl->stale = 1;
+  sl->resonance_stale = 1;
+  return sl;
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// QUANT MATRIX — row-major compressed weights
+// ═══════════════════════════════════════════════════════════════════════════════
+// fp16 / bf16 rows need no scales; int8 / int4 carry per-row / per-group scales
+
+typedef struct {
+  int bits;                 // 16, 8 or 4 (0 = empty)
+  int bf16;                 // bits == 16: 1 = bfloat16, 0 = IEEE half
+  int rows, cols;
+  int groups;               // scales per row: 0 (16-bit), 1 (int8) or ceil(cols / LUNG_Q4_GROUP)
+  int row_bytes;            // 2 · cols, cols (int8) or ceil(cols / 2) (int4, two per byte)
+  uint8_t* data;            // rows × row_bytes
+  float* scale;             // rows × groups: w ≈ q · scale (NULL for 16-bit)
+} QuantMatrix;
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// LUNG WEIGHTS — the read-only part of a lung, shared by sessions
+// ═══════════════════════════════════════════════════════════════════════════════
+// Same fields and layouts as the lung's own (see AriannaLung); a session
+// points its weight fields here and keeps one reference.
+
+typedef struct {
+  int refs;                 // sessions + lung_weights_retain holders (atomic)
+  int vocab_size, d_model, ctx_len, n_heads, n_kv_heads;
+  float* E;
+  float* P_ltr;
+  float* P_rtl;
+  float* Wo;
+  float* WoT;
+  float* Wq;
+  float* Wk;
+  float* Wv;
+  int packed_qkv;
+  int qkv_stride;
+  float* Wqkv;
+  int quant_bits;
+  QuantMatrix qE;
+  QuantMatrix qWoT;
+  QuantMatrix qW[3];
+  uint8_t* map_base;        // mapped checkpoint the arrays may point into
+  size_t map_bytes;
+  int map_owned;
+  float* resonance;         // vocab_size: starting resonance of new sessions
+} LungWeights;
+
 // ═══════════════════════════════════════════════════════════════════════════════
 // ARIANNA LUNG — THE BREATHING ORGAN (bidirectional transformer)
 // ═══════════════════════════════════════════════════════════════════════════════
@@ -80,8 +273,10 @@ typedef struct {
   int vocab_size;      // vocabulary size
   int d_model;         // embedding dimension
   int ctx_len;         // context length
-  int n_heads;         // number of attention heads
+  int n_heads;         // number of attention (query) heads
+  int n_kv_heads;      // key/value heads: n_heads (MHA), 1 (MQA) or a divisor (GQA)
   int head_dim;        // dimension per head (d_model / n_heads)
+  int kv_dim;          // n_kv_heads × head_dim
 
   // ─────────────────────────────────────────────────────────────────────────────
   // WEIGHTS (flat arrays for WASM efficiency)
@@ -90,17 +285,43 @@ typedef struct {
   float* P_ltr;        // positional encoding LTR: ctx_len × d_model
   float* P_rtl;        // positional encoding RTL: ctx_len × d_model (PITOMADOM)
   float* Wo;           // output projection: d_model × vocab_size
+  float* WoT;          // packed vocab-major copy of Wo: vocab_size × d_model
+                       // (kept in sync by lung_sync_output_weights / merges)
 
-  // Multi-head attention weights (contiguous blocks)
+  // Multi-head attention weights (contiguous blocks). Query head h reads
+  // key/value head h / (n_heads / n_kv_heads): consecutive query heads share.
   float* Wq;           // query: n_heads × (head_dim × d_model)
-  float* Wk;           // key:   n_heads × (head_dim × d_model)
-  float* Wv;           // value: n_heads × (head_dim × d_model)
+  float* Wk;           // key:   n_kv_heads × (head_dim × d_model)
+  float* Wv;           // value: n_kv_heads × (head_dim × d_model)
+
+  // Packed QKV (optional, lung_set_packed_qkv, n_kv_heads == n_heads only):
+  // replaces Wq/Wk/Wv.
+  // Per head, rows interleave q_r, k_r, v_r; each row is padded to
+  // qkv_stride floats (multiple of 16 = 64 bytes) on a 64-byte aligned base,
+  // so one fused pass over x yields q, k and v for a head.
+  int packed_qkv;      // 1 = Wqkv holds the weights, Wq/Wk/Wv are NULL
+  int qkv_stride;      // padded row length in floats
+  float* Wqkv;         // n_heads × head_dim × 3 × qkv_stride
+
+  // Compressed storage (lung_create_ex half precision, or lung_quantize):
+  // replaces E, Wo/WoT and Wq/Wk/Wv, which are freed (NULL). Rows are
+  // widened to float on the fly inside the dot products; weights change
+  // only through the lung_load_* / merge functions, which re-encode rows.
+  int quant_bits;      // 0 = float32, 16 = fp16/bf16, 8 = int8 per row, 4 = int4 per group
+  QuantMatrix qE;      // vocab_size × d_model
+  QuantMatrix qWoT;    // vocab_size × d_model (vocab-major, like WoT)
+  QuantMatrix qW[3];   // [q, k, v] (n_heads or n_kv_heads × head_dim) × d_model
 
   // ─────────────────────────────────────────────────────────────────────────────
   // NOTORCH — resonance learning without backprop
   // ─────────────────────────────────────────────────────────────────────────────
   float* resonance;         // vocab_size: token-specific attention boost
-  float* presence_accum;    // vocab_size: accumulated presence pulse
+  float* presence_accum;    // vocab_size: presence pulse as of presence_epoch[i]
+  uint32_t* presence_epoch; // vocab_size: decay step the value was stored at
+  uint32_t presence_now;    // decay steps so far (one per exhale)
+  int* presence_active;     // sorted ids with stored presence (vocab_size capacity)
+  int n_active;
+  int* presence_new;        // ctx_len: ids entering the active set this step
   float presence_decay;     // decay factor for presence
 
   // ─────────────────────────────────────────────────────────────────────────────
@@ -117,12 +338,24 @@ typedef struct {
   // temporal_alpha > 0.5 = prophecy mode (emphasize future)
   // temporal_alpha < 0.5 = retrodiction mode (emphasize past)
 
+  // ─────────────────────────────────────────────────────────────────────────────
+  // INFERENCE MODE
+  // ─────────────────────────────────────────────────────────────────────────────
+  int fold_attention;       // 1 = folded (Wk^T q, Wv·Σa x), 0 = per-position K/V
+  int mask_padding;         // 1 = attend only real positions (t < context_len)
+  int attn_window;          // 0 = dense; W = the W positions ending at the query
+  int n_anchors;            // global positions attended outside the window
+  int* anchors;             // ctx_len capacity: the first n_anchors primes (CHORDLOCK)
+  int shortlist_probe;      // 0 = full vocab; N = logits for N probed clusters only
+  Shortlist* shortlist;     // allocated by the first lung_set_shortlist
+
   // ─────────────────────────────────────────────────────────────────────────────
   // INFERENCE STATE — exposed for visual-inference connection
   // ─────────────────────────────────────────────────────────────────────────────
   float* last_logits;       // vocab_size: raw logits from last forward
   float* last_probs;        // vocab_size: probabilities from last forward
   float* last_attention;    // ctx_len: combined attention weights
+  float tail_mass;          // estimated probability outside the scored tokens (shortlist)
 
   // ─────────────────────────────────────────────────────────────────────────────
   // WORK BUFFERS (pre-allocated for efficiency)
@@ -131,76 +364,165 @@ typedef struct {
   float* scores;            // ctx_len: attention scores
   float* head_out;          // head_dim: single head output
   float* y;                 // d_model: concatenated head outputs
+  float* kq;                // d_model: folded key query Wk_h^T · q
+  float* xbar;              // d_model: attention-weighted input Σ a_t x_t
+  float* k;                 // head_dim: per-position key (unfolded path)
+  float* v;                 // head_dim: per-position value (unfolded path)
+  float* head_result;       // head_dim: weighted value sum (unfolded path)
+  float* v_rows;            // ctx_len × head_dim: per-position values (unfolded path)
+  int* attn_pos;            // ctx_len: attended positions of the current forward
+  HeadScratch* head_scratch; // n_heads sets, allocated on first threaded forward
+  VocabPart* vocab_part;    // one partial per vocab tile
+  TopKEntry* vocab_top;     // n_tiles × LUNG_TOPK_CACHE: tile top-k candidates
+  TopKEntry top[LUNG_TOPK_CACHE];  // top-k of the last forward, best first
+  int n_top;                // valid entries in top (0 before the first forward)
+  uint32_t rng;             // sampling stream for a NULL rng_state (lung_seed_rng)
+
+  // ─────────────────────────────────────────────────────────────────────────────
+  // STREAMING CACHE — sliding window, allocated on first lung_push_token
+  // X[t] = E[tok] + P[t] is additive, so every projection splits into a token
+  // part (cached per ring slot, computed once per push) and a positional part
+  // (precomputed per position for LTR and RTL). Sliding the window only moves
+  // the ring start; no row is ever recomputed.
+  // Query rows are d_model apart (the first n_heads × head_dim entries are
+  // used); key/value rows are kv_dim apart, so the K/V cache shrinks with
+  // n_kv_heads.
+  // ─────────────────────────────────────────────────────────────────────────────
+  int stream_ready;         // 1 once tables are built
+  int stream_len;           // tokens in window (0..ctx_len)
+  int stream_start;         // ring slot of the oldest token
+  int* stream_tokens;       // ctx_len: window tokens, oldest first (raw ids)
+  int* stream_slot;         // ctx_len: ring slot of each window position
+  float* ring_q;            // ctx_len × d_model: Wq · E[tok] per slot
+  float* ring_k;            // ctx_len × kv_dim: Wk · E[tok] per slot
+  float* ring_v;            // ctx_len × kv_dim: Wv · E[tok] per slot
+  float* pad_q;             // d_model: Wq · E[0] (padding token)
+  float* pad_k;             // kv_dim: Wk · E[0]
+  float* pad_v;             // kv_dim: Wv · E[0]
+  float* pos_k[2];          // [ltr, rtl] ctx_len × kv_dim: Wk · P[t]
+  float* pos_v[2];          // [ltr, rtl] ctx_len × kv_dim: Wv · P[t]
+  float* pos_q[2];          // [ltr, rtl] ctx_len × d_model: Wq · P[t]
+
+  // ─────────────────────────────────────────────────────────────────────────────
+  // BATCH WORKSPACE — lung_forward_batch, allocated on first use
+  // Sized for LUNG_BATCH_TILE contexts; larger batches run tile by tile.
+  // Rows are per context, tile-major (context b of the tile at b × width).
+  // ─────────────────────────────────────────────────────────────────────────────
+  float* batch_X;           // tile × ctx_len × d_model: token vectors
+  float* batch_x_last;      // tile × d_model: query input (last position)
+  float* batch_q;           // tile × head_dim: per-head query
+  float* batch_kq;          // tile × d_model: folded key query
+  float* batch_xbar;        // tile × d_model: attention-weighted input
+  float* batch_head;        // tile × head_dim: per-head output
+  float* batch_y;           // tile × d_model: concatenated head outputs
+  float* batch_logits;      // tile × vocab_size
+  float* batch_probs;       // vocab_size: probs scratch when not requested
+  int* batch_pos;           // tile × ctx_len: attended positions per context
+
+  // ─────────────────────────────────────────────────────────────────────────────
+  // CHECKPOINT MAPPING — lung_open_mmap
+  // Weight arrays inside [map_base, map_base + map_bytes) are borrowed from
+  // the file (private copy-on-write mapping) and never freed one by one.
+  // ─────────────────────────────────────────────────────────────────────────────
+  uint8_t* map_base;
+  size_t map_bytes;
+  int map_owned;            // 1 = heap copy of the file (no mmap on this platform)
+
+  // ─────────────────────────────────────────────────────────────────────────────
+  // SHARED WEIGHTS — lung_share_weights / lung_session_new
+  // When set, E, P_ltr/P_rtl, Wo/WoT, Q/K/V and the compressed matrices all
+  // point into `shared` and are never written or freed by this lung.
+  // ─────────────────────────────────────────────────────────────────────────────
+  LungWeights* shared;
 
 } AriannaLung;
 
+// A session: an AriannaLung whose weights are borrowed from a LungWeights
+typedef AriannaLung LungSession;
+
 // ═══════════════════════════════════════════════════════════════════════════════
 // MATH UTILITIES
 // ═══════════════════════════════════════════════════════════════════════════════
 
-// Simple LCG random (deterministic for reproducibility)
+// Threads per forward (lung_set_threads); 1 = serial, pool never started
+static int lung_threads = 1;
+
+// Simple LCG random (deterministic for reproducibility). Every draw goes
+// through an explicit state; _rand_state is only the module stream that
+// lung_create* claims its draws from, and is touched atomically.
 static uint32_t _rand_state = 12345;
 
-static float _randf(void) {
-  _rand_state = _rand_state * 1103515245 + 12345;
-  return (float)(_rand_state & 0x7fffffff) / (float)0x7fffffff;
+#define LCG_MUL 1103515245u
+#define LCG_ADD 12345u
+
+static float _randf(uint32_t* state) {
+  *state = *state * LCG_MUL + LCG_ADD;
+  return (float)(*state & 0x7fffffff) / (float)0x7fffffff;
 }
 
 static void _seed_rand(uint32_t seed) {
-  _rand_state = seed;
+  __atomic_store_n(&_rand_state, seed, __ATOMIC_RELAXED);
+}
+
+// Take the next n draws of the module stream in one step: returns the state
+// they start from and advances the stream past them (the n-step LCG map is
+// again affine, built by squaring). Lungs created on different threads get
+// disjoint stretches of the stream, as if they had been created one by one.
+static uint32_t _claim_rand(size_t n) {
+  uint32_t mul = 1, add = 0;              // accumulated map s → mul·s + add
+  uint32_t step_mul = LCG_MUL, step_add = LCG_ADD;
+  for (; n; n >>= 1) {
+    if (n & 1) {
+      mul *= step_mul;
+      add = add * step_mul + step_add;
+    }
+    step_add = step_add * step_mul + step_add;
+    step_mul *= step_mul;
+  }
+  uint32_t s = __atomic_load_n(&_rand_state, __ATOMIC_RELAXED);
+  while (!__atomic_compare_exchange_n(&_rand_state, &s, s * mul + add, 1,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+  return s;
+}
+
+static uint32_t mix32(uint32_t x) {
+  x ^= x >> 16; x *= 0x85EBCA6Bu;
+  x ^= x >> 13; x *= 0xC2B2AE35u;
+  return x ^ (x >> 16);
+}
+
+// Starting point of a new lung's own sampling stream: the module stream
+// mixed with a creation count, so lungs never share a stream (and never
+// touch _rand_state while sampling)
+static uint32_t lung_serial = 0;
+
+static uint32_t lung_stream_seed(void) {
+  return mix32(__atomic_load_n(&_rand_state, __ATOMIC_RELAXED) +
+               0x9E3779B9u * __atomic_add_fetch(&lung_serial, 1, __ATOMIC_RELAXED));
 }
 
+// Vector math goes through kernels.h (SIMD with runtime dispatch,
+// scalar reference kept there)
+
 // Dot product
 static float dot(const float* a, const float* b, int n) {
-  float sum = 0.0f;
-  for (int i = 0; i < n; i++) {
-    sum += a[i] * b[i];
-  }
-  return sum;
+  return kern_dot(a, b, n);
 }
 
 // Matrix-vector multiply: out[rows] = mat[rows × cols] × vec[cols]
 static void mat_vec(float* out, const float* mat, const float* vec, int rows, int cols) {
-  for (int i = 0; i < rows; i++) {
-    out[i] = dot(mat + i * cols, vec, cols);
-  }
-}
-
-// Transposed matrix-vector: out[cols] = mat[rows × cols]^T × vec[rows]
-static void mat_vec_t(float* out, const float* mat, const float* vec, int rows, int cols) {
-  for (int j = 0; j < cols; j++) {
-    float sum = 0.0f;
-    for (int i = 0; i < rows; i++) {
-      sum += mat[i * cols + j] * vec[i];
-    }
-    out[j] = sum;
-  }
+  kern_mat_vec(out, mat, vec, rows, cols);
 }
 
 // Softmax in-place
 static void softmax(float* x, int n) {
-  float max_val = x[0];
-  for (int i = 1; i < n; i++) {
-    if (x[i] > max_val) max_val = x[i];
-  }
-
-  float sum = 0.0f;
-  for (int i = 0; i < n; i++) {
-    x[i] = expf(x[i] - max_val);
-    sum += x[i];
-  }
-
-  float inv_sum = 1.0f / sum;
-  for (int i = 0; i < n; i++) {
-    x[i] *= inv_sum;
-  }
+  kern_softmax(x, n);
 }
 
 // AXPY: y += a * x
 static void axpy(float* y, const float* x, float a, int n) {
-  for (int i = 0; i < n; i++) {
-    y[i] += a * x[i];
-  }
+  kern_axpy(y, x, a, n);
 }
 
 // ═══════════════════════════════════════════════════════════════════════════════
@@ -224,14 +546,396 @@ static void build_positional_encoding(float* P, int ctx, int d, int rtl) {
 // INITIALIZATION
 // ═══════════════════════════════════════════════════════════════════════════════
 
-static void init_random_weights(float* w, int size, float scale) {
+static void init_random_weights(float* w, int size, float scale, uint32_t* rng) {
   for (int i = 0; i < size; i++) {
     // Xavier-like: uniform in [-scale, scale]
-    w[i] = (2.0f * _randf() - 1.0f) * scale;
+    w[i] = (2.0f * _randf(rng) - 1.0f) * scale;
   }
 }
 
-EXPORT AriannaLung* lung_create(int vocab_size, int d_model, int ctx_len, int n_heads) {
+// ═══════════════════════════════════════════════════════════════════════════════
+// ALIGNED STORAGE — 64-byte (cache line) aligned, zeroed
+// ═══════════════════════════════════════════════════════════════════════════════
+
+#define LUNG_ALIGN 64
+
+static float* calloc_aligned(size_t n_floats) {
+  void* raw = calloc(n_floats * sizeof(float) + LUNG_ALIGN + sizeof(void*), 1);
+  if (!raw) return NULL;
+  uintptr_t p = ((uintptr_t)raw + sizeof(void*) + LUNG_ALIGN - 1) & ~(uintptr_t)(LUNG_ALIGN - 1);
+  ((void**)p)[-1] = raw;
+  return (float*)p;
+}
+
+static void free_aligned(float* p) {
+  if (p) free(((void**)p)[-1]);
+}
+
+// Weight arrays may be borrowed from a mapped checkpoint
+static int in_mapping(const uint8_t* map_base, size_t map_bytes, const void* p) {
+  uintptr_t a = (uintptr_t)p, base = (uintptr_t)map_base;
+  return map_base && a >= base && a < base + map_bytes;
+}
+
+static int weight_borrowed(const AriannaLung* lung, const void* p) {
+  return in_mapping(lung->map_base, lung->map_bytes, p);
+}
+
+// Unmap (or free the heap copy of) a checkpoint
+static void map_release(uint8_t* base, size_t bytes, int owned) {
+  if (!base) return;
+#if LUNG_MMAP
+  if (!owned) munmap(base, bytes);
+#else
+  (void)bytes;
+#endif
+  if (owned) free_aligned((float*)base);
+}
+
+static void weight_free(AriannaLung* lung, void* p) {
+  if (!weight_borrowed(lung, p)) free(p);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// QUANTIZED STORAGE — half precision, or symmetric integers (round to nearest)
+// ═══════════════════════════════════════════════════════════════════════════════
+//
+// fp16: IEEE half per value (round to nearest even)
+// bf16: top 16 bits of the float (round to nearest even), full float range
+// int8: one scale per row, q ∈ [-127, 127], scale = max|w| / 127
+// int4: one scale per LUNG_Q4_GROUP columns, q ∈ [-8, 7], scale = max|w| / 7,
+//       two values per byte (low nibble first, stored as q + 8)
+//
+// Every format accumulates in float: rows are widened inside the kernels.
+// ═══════════════════════════════════════════════════════════════════════════════
+
+static void quant_free(QuantMatrix* m) {
+  free(m->data);
+  free(m->scale);
+  memset(m, 0, sizeof(*m));
+}
+
+// Lung-held matrices may point into a mapped checkpoint
+static void quant_release(AriannaLung* lung, QuantMatrix* m) {
+  weight_free(lung, m->data);
+  weight_free(lung, m->scale);
+  memset(m, 0, sizeof(*m));
+}
+
+// Geometry only (no storage)
+static void quant_shape(QuantMatrix* m, int rows, int cols, int bits, int bf16) {
+  int group = (bits == 4) ? LUNG_Q4_GROUP : cols;
+
+  m->bits = bits;
+  m->bf16 = (bits == 16) ? bf16 : 0;
+  m->rows = rows;
+  m->cols = cols;
+  m->groups = (bits == 16) ? 0 : (cols + group - 1) / group;
+  m->row_bytes = (bits == 16) ? 2 * cols : ((bits == 8) ? cols : (cols + 1) / 2);
+}
+
+static int quant_alloc(QuantMatrix* m, int rows, int cols, int bits, int bf16) {
+  quant_shape(m, rows, cols, bits, bf16);
+  m->data = (uint8_t*)calloc((size_t)rows * m->row_bytes, 1);
+  m->scale = m->groups ? (float*)calloc((size_t)rows * m->groups, sizeof(float)) : NULL;
+  if (!m->data || (m->groups && !m->scale)) {
+    quant_free(m);
+    return 0;
+  }
+  return 1;
+}
+
+// Encode one row (overwrites whatever the row held)
+static void quant_encode_row(QuantMatrix* m, int i, const float* row) {
+  int cols = m->cols;
+  uint8_t* out = m->data + (size_t)i * m->row_bytes;
+
+  if (m->bits == 16) {
+    uint16_t* h = (uint16_t*)out;
+    for (int j = 0; j < cols; j++) {
+      h[j] = m->bf16 ? kern_f32_to_bf16(row[j]) : kern_f32_to_f16(row[j]);
+    }
+    return;
+  }
+
+  int bits = m->bits;
+  int group = (bits == 8) ? cols : LUNG_Q4_GROUP;
+  float qmax = (bits == 8) ? 127.0f : 7.0f;
+  memset(out, 0, m->row_bytes);
+
+  for (int g = 0; g < m->groups; g++) {
+    int j0 = g * group;
+    int j1 = (j0 + group < cols) ? j0 + group : cols;
+
+    float amax = 0.0f;
+    for (int j = j0; j < j1; j++) {
+      if (fabsf(row[j]) > amax) amax = fabsf(row[j]);
+    }
+    float scale = amax / qmax;
+    float inv = (scale > 0.0f) ? 1.0f / scale : 0.0f;
+    m->scale[(size_t)i * m->groups + g] = scale;
+
+    for (int j = j0; j < j1; j++) {
+      float r = roundf(row[j] * inv);
+      if (r > qmax) r = qmax;
+      if (r < -qmax - (bits == 4)) r = -qmax - (bits == 4);
+      if (bits == 8) {
+        ((int8_t*)out)[j] = (int8_t)r;
+      } else {
+        uint8_t nib = (uint8_t)((int)r + 8);
+        out[j >> 1] |= (j & 1) ? (uint8_t)(nib << 4) : nib;
+      }
+    }
+  }
+}
+
+static int quant_build(QuantMatrix* m, const float* w, int rows, int cols, int bits, int bf16) {
+  if (!quant_alloc(m, rows, cols, bits, bf16)) return 0;
+  for (int i = 0; i < rows; i++) quant_encode_row(m, i, w + (size_t)i * cols);
+  return 1;
+}
+
+// row · x
+static float quant_dot(const QuantMatrix* m, int row, const float* x) {
+  const uint8_t* q = m->data + (size_t)row * m->row_bytes;
+  if (m->bits == 16) {
+    return m->bf16 ? kern_dot_bf16((const uint16_t*)q, x, m->cols)
+                   : kern_dot_f16((const uint16_t*)q, x, m->cols);
+  }
+  const float* scale = m->scale + (size_t)row * m->groups;
+  if (m->bits == 8) return scale[0] * kern_dot_q8((const int8_t*)q, x, m->cols);
+
+  float sum = 0.0f;
+  for (int g = 0, j0 = 0; g < m->groups; g++, j0 += LUNG_Q4_GROUP) {
+    int n = (m->cols - j0 < LUNG_Q4_GROUP) ? m->cols - j0 : LUNG_Q4_GROUP;
+    sum += scale[g] * kern_dot_q4(q + (j0 >> 1), x + j0, n);
+  }
+  return sum;
+}
+
+// out[cols] = dequantized row
+static void quant_row(const QuantMatrix* m, int row, float* out) {
+  const uint8_t* q = m->data + (size_t)row * m->row_bytes;
+  if (m->bits == 16) {
+    const uint16_t* h = (const uint16_t*)q;
+    for (int j = 0; j < m->cols; j++) {
+      out[j] = m->bf16 ? kern_bf16_to_f32(h[j]) : kern_f16_to_f32(h[j]);
+    }
+    return;
+  }
+  const float* scale = m->scale + (size_t)row * m->groups;
+  for (int j = 0; j < m->cols; j++) {
+    if (m->bits == 8) {
+      out[j] = (float)((const int8_t*)q)[j] * scale[0];
+    } else {
+      int nib = (j & 1) ? (q[j >> 1] >> 4) : (q[j >> 1] & 15);
+      out[j] = (float)(nib - 8) * scale[j / LUNG_Q4_GROUP];
+    }
+  }
+}
+
+// y[cols] += a · row
+static void quant_axpy(float* y, const QuantMatrix* m, int row, float a) {
+  if (m->bits == 16) {
+    const uint16_t* h = (const uint16_t*)(m->data + (size_t)row * m->row_bytes);
+    if (m->bf16) kern_axpy_bf16(y, h, a, m->cols);
+    else kern_axpy_f16(y, h, a, m->cols);
+    return;
+  }
+  if (m->bits == 8) {
+    const int8_t* q = (const int8_t*)(m->data + (size_t)row * m->row_bytes);
+    kern_axpy_q8(y, q, a * m->scale[row], m->cols);
+    return;
+  }
+  float tmp[LUNG_Q4_GROUP];
+  const uint8_t* q = m->data + (size_t)row * m->row_bytes;
+  const float* scale = m->scale + (size_t)row * m->groups;
+  for (int g = 0, j0 = 0; g < m->groups; g++, j0 += LUNG_Q4_GROUP) {
+    int n = (m->cols - j0 < LUNG_Q4_GROUP) ? m->cols - j0 : LUNG_Q4_GROUP;
+    for (int j = 0; j < n; j++) {
+      int jj = j0 + j;
+      int nib = (jj & 1) ? (q[jj >> 1] >> 4) : (q[jj >> 1] & 15);
+      tmp[j] = (float)(nib - 8);
+    }
+    axpy(y + j0, tmp, a * scale[g], n);
+  }
+}
+
+// out[b × rows + i] = row (row0 + i) · vecs[b]; each row is read once for all b
+static void quant_mat_mat(float* out, const QuantMatrix* m, int row0, int rows,
+                          const float* vecs, int nvec) {
+  for (int i = 0; i < rows; i++) {
+    for (int b = 0; b < nvec; b++) {
+      out[(size_t)b * rows + i] = quant_dot(m, row0 + i, vecs + (size_t)b * m->cols);
+    }
+  }
+}
+
+static size_t quant_bytes(const QuantMatrix* m) {
+  return (size_t)m->rows * (m->row_bytes + m->groups * sizeof(float));
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// QKV LAYOUT — separate blocks or packed per-head tiles
+// ═══════════════════════════════════════════════════════════════════════════════
+
+#define QKV_Q 0
+#define QKV_K 1
+#define QKV_V 2
+
+// Key/value head read by query head h
+static inline int kv_head(const AriannaLung* lung, int h) {
+  return h / (lung->n_heads / lung->n_kv_heads);
+}
+
+// Row block of matrix m used by query head h
+static inline int qkv_block(const AriannaLung* lung, int m, int h) {
+  return (m == QKV_Q) ? h : kv_head(lung, h);
+}
+
+// Rows of matrix m: n_heads × head_dim for Q, kv_dim for K and V
+static inline int qkv_rows(const AriannaLung* lung, int m) {
+  return (m == QKV_Q) ? lung->n_heads * lung->head_dim : lung->kv_dim;
+}
+
+// First row of matrix m (QKV_Q/K/V) for row block g (a query head for Q,
+// a key/value head for K and V), and the distance between rows
+static const float* qkv_head(const AriannaLung* lung, int m, int g, int* stride) {
+  int d = lung->d_model;
+  int head_dim = lung->head_dim;
+  if (lung->packed_qkv) {
+    *stride = 3 * lung->qkv_stride;
+    return lung->Wqkv + ((size_t)g * head_dim * 3 + m) * lung->qkv_stride;
+  }
+  const float* W = (m == QKV_Q) ? lung->Wq : ((m == QKV_K) ? lung->Wk : lung->Wv);
+  *stride = d;
+  return W + (size_t)g * head_dim * d;
+}
+
+// out[rows] = rows of mat (stride apart) · vec[cols]
+static void mat_vec_strided(float* out, const float* mat, int stride,
+                            const float* vec, int rows, int cols) {
+  for (int i = 0; i < rows; i++) {
+    out[i] = dot(mat + (size_t)i * stride, vec, cols);
+  }
+}
+
+// out[head_dim] = rows of matrix m for query head h · x (any storage)
+static void head_mat_vec(const AriannaLung* lung, int m, int h, const float* x, float* out) {
+  int head_dim = lung->head_dim;
+  int g = qkv_block(lung, m, h);
+  if (lung->quant_bits) {
+    for (int r = 0; r < head_dim; r++) out[r] = quant_dot(&lung->qW[m], g * head_dim + r, x);
+    return;
+  }
+  int stride;
+  const float* W = qkv_head(lung, m, g, &stride);
+  mat_vec_strided(out, W, stride, x, head_dim, lung->d_model);
+}
+
+// out[d] += Σ_r coef[r] · row r of matrix m for query head h (W_h^T · coef)
+static void head_axpy_t(const AriannaLung* lung, int m, int h, const float* coef, float* out) {
+  int head_dim = lung->head_dim;
+  int g = qkv_block(lung, m, h);
+  if (lung->quant_bits) {
+    for (int r = 0; r < head_dim; r++) quant_axpy(out, &lung->qW[m], g * head_dim + r, coef[r]);
+    return;
+  }
+  int stride;
+  const float* W = qkv_head(lung, m, g, &stride);
+  for (int r = 0; r < head_dim; r++) {
+    axpy(out, W + (size_t)r * stride, coef[r], lung->d_model);
+  }
+}
+
+// Batched head_mat_vec: out[b × head_dim + r] for nvec inputs
+static void head_mat_mat(const AriannaLung* lung, int m, int h, const float* vecs, int nvec,
+                         float* out) {
+  int head_dim = lung->head_dim;
+  int g = qkv_block(lung, m, h);
+  if (lung->quant_bits) {
+    quant_mat_mat(out, &lung->qW[m], g * head_dim, head_dim, vecs, nvec);
+    return;
+  }
+  int stride;
+  const float* W = qkv_head(lung, m, g, &stride);
+  kern_mat_mat(out, W, stride, vecs, nvec, head_dim, lung->d_model);
+}
+
+// out[d] = E[token_id] (token already clamped)
+static void embed_token(const AriannaLung* lung, int token_id, float* out) {
+  if (lung->quant_bits) {
+    quant_row(&lung->qE, token_id, out);
+  } else {
+    memcpy(out, lung->E + (size_t)token_id * lung->d_model, lung->d_model * sizeof(float));
+  }
+}
+
+// q (n_heads × head_dim), k and v (kv_dim each) of one input vector x
+// Packed: one fused pass per head tile, each x chunk feeds three rows
+static void project_qkv(const AriannaLung* lung, const float* x,
+                        float* out_q, float* out_k, float* out_v) {
+  int d = lung->d_model;
+  int head_dim = lung->head_dim;
+  int qd = lung->n_heads * head_dim;
+  int kvd = lung->kv_dim;
+
+  if (lung->quant_bits) {
+    for (int i = 0; i < qd; i++) out_q[i] = quant_dot(&lung->qW[QKV_Q], i, x);
+    for (int i = 0; i < kvd; i++) {
+      out_k[i] = quant_dot(&lung->qW[QKV_K], i, x);
+      out_v[i] = quant_dot(&lung->qW[QKV_V], i, x);
+    }
+    return;
+  }
+
+  if (!lung->packed_qkv) {
+    mat_vec(out_q, lung->Wq, x, qd, d);
+    mat_vec(out_k, lung->Wk, x, kvd, d);
+    mat_vec(out_v, lung->Wv, x, kvd, d);
+    return;
+  }
+
+  int stride = lung->qkv_stride;
+  const float* row = lung->Wqkv;
+  float o3[3];
+  for (int i = 0; i < qd; i++, row += 3 * stride) {
+    kern_dot3(row, row + stride, row + 2 * stride, x, d, o3);
+    out_q[i] = o3[0];
+    out_k[i] = o3[1];
+    out_v[i] = o3[2];
+  }
+}
+
+// Rebuild WoT (vocab × d) from Wo (d × vocab) with a tiled transpose so both
+// sides stay within a few cache lines per tile
+#define WO_PACK_TILE 32
+
+static void pack_output_weights(AriannaLung* lung) {
+  int d = lung->d_model;
+  int vocab = lung->vocab_size;
+
+  for (int i0 = 0; i0 < d; i0 += WO_PACK_TILE) {
+    int i1 = (i0 + WO_PACK_TILE < d) ? i0 + WO_PACK_TILE : d;
+    for (int j0 = 0; j0 < vocab; j0 += WO_PACK_TILE) {
+      int j1 = (j0 + WO_PACK_TILE < vocab) ? j0 + WO_PACK_TILE : vocab;
+      for (int i = i0; i < i1; i++) {
+        for (int j = j0; j < j1; j++) {
+          lung->WoT[(size_t)j * d + i] = lung->Wo[(size_t)i * vocab + j];
+        }
+      }
+    }
+  }
+  if (lung->shortlist) lung->shortlist->stale = 1;
+}
+
+EXPORT void lung_destroy(AriannaLung* lung);
+
+// Everything except E, Wo/WoT and Q/K/V: state, work buffers, positional
+// encodings (borrowed from `shared` when given) and default parameters
+// (resonance is left for the caller to fill)
+static AriannaLung* lung_alloc(int vocab_size, int d_model, int ctx_len, int n_heads,
+                               int n_kv_heads, LungWeights* shared) {
   AriannaLung* lung = (AriannaLung*)calloc(1, sizeof(AriannaLung));
   if (!lung) return NULL;
 
@@ -240,27 +944,27 @@ EXPORT AriannaLung* lung_create(int vocab_size, int d_model, int ctx_len, int n_
   lung->d_model = d_model;
   lung->ctx_len = ctx_len;
   lung->n_heads = n_heads;
+  lung->n_kv_heads = n_kv_heads;
   lung->head_dim = d_model / n_heads;
+  lung->kv_dim = n_kv_heads * lung->head_dim;
+  lung->rng = lung_stream_seed();
 
-  int head_weight_size = lung->head_dim * d_model;
-
-  // ─────────────────────────────────────────────────────────────────────────────
-  // Allocate weights
-  // ─────────────────────────────────────────────────────────────────────────────
-  lung->E = (float*)calloc(vocab_size * d_model, sizeof(float));
-  lung->P_ltr = (float*)calloc(ctx_len * d_model, sizeof(float));
-  lung->P_rtl = (float*)calloc(ctx_len * d_model, sizeof(float));
-  lung->Wo = (float*)calloc(d_model * vocab_size, sizeof(float));
-
-  lung->Wq = (float*)calloc(n_heads * head_weight_size, sizeof(float));
-  lung->Wk = (float*)calloc(n_heads * head_weight_size, sizeof(float));
-  lung->Wv = (float*)calloc(n_heads * head_weight_size, sizeof(float));
+  if (shared) {
+    lung->P_ltr = shared->P_ltr;
+    lung->P_rtl = shared->P_rtl;
+  } else {
+    lung->P_ltr = (float*)calloc(ctx_len * d_model, sizeof(float));
+    lung->P_rtl = (float*)calloc(ctx_len * d_model, sizeof(float));
+  }
 
   // ─────────────────────────────────────────────────────────────────────────────
   // Notorch arrays
   // ─────────────────────────────────────────────────────────────────────────────
   lung->resonance = (float*)malloc(vocab_size * sizeof(float));
   lung->presence_accum = (float*)calloc(vocab_size, sizeof(float));
+  lung->presence_epoch = (uint32_t*)calloc(vocab_size, sizeof(uint32_t));
+  lung->presence_active = (int*)malloc(vocab_size * sizeof(int));
+  lung->presence_new = (int*)malloc(ctx_len * sizeof(int));
 
   // ─────────────────────────────────────────────────────────────────────────────
   // Inference state
@@ -276,37 +980,35 @@ EXPORT AriannaLung* lung_create(int vocab_size, int d_model, int ctx_len, int n_
   lung->scores = (float*)calloc(ctx_len, sizeof(float));
   lung->head_out = (float*)calloc(lung->head_dim, sizeof(float));
   lung->y = (float*)calloc(d_model, sizeof(float));
+  lung->kq = (float*)calloc(d_model, sizeof(float));
+  lung->xbar = (float*)calloc(d_model, sizeof(float));
+  lung->k = (float*)calloc(lung->head_dim, sizeof(float));
+  lung->v = (float*)calloc(lung->head_dim, sizeof(float));
+  lung->head_result = (float*)calloc(lung->head_dim, sizeof(float));
+  lung->v_rows = (float*)calloc(ctx_len * lung->head_dim, sizeof(float));
+  lung->attn_pos = (int*)calloc(ctx_len, sizeof(int));
+  lung->anchors = (int*)calloc(ctx_len, sizeof(int));
+  int n_tiles = (vocab_size + LUNG_VOCAB_TILE - 1) / LUNG_VOCAB_TILE;
+  lung->vocab_part = (VocabPart*)calloc(n_tiles, sizeof(VocabPart));
+  lung->vocab_top = (TopKEntry*)calloc((size_t)n_tiles * LUNG_TOPK_CACHE, sizeof(TopKEntry));
 
   // Check all allocations
-  if (!lung->E || !lung->P_ltr || !lung->P_rtl || !lung->Wo ||
-      !lung->Wq || !lung->Wk || !lung->Wv ||
-      !lung->resonance || !lung->presence_accum ||
+  if (!lung->P_ltr || !lung->P_rtl ||
+      !lung->resonance || !lung->presence_accum || !lung->presence_epoch ||
+      !lung->presence_active || !lung->presence_new ||
       !lung->last_logits || !lung->last_probs || !lung->last_attention ||
-      !lung->X || !lung->scores || !lung->head_out || !lung->y) {
+      !lung->X || !lung->scores || !lung->head_out || !lung->y ||
+      !lung->kq || !lung->xbar || !lung->k || !lung->v || !lung->head_result ||
+      !lung->v_rows || !lung->attn_pos || !lung->anchors || !lung->vocab_part || !lung->vocab_top) {
     // Allocation failed - clean up and return NULL
     // (in production, would call lung_destroy here)
     return NULL;
   }
 
-  // ─────────────────────────────────────────────────────────────────────────────
-  // Initialize weights
-  // ─────────────────────────────────────────────────────────────────────────────
-  init_random_weights(lung->E, vocab_size * d_model, INIT_SCALE);
-  init_random_weights(lung->Wo, d_model * vocab_size, INIT_SCALE);
-
-  for (int h = 0; h < n_heads; h++) {
-    init_random_weights(lung->Wq + h * head_weight_size, head_weight_size, INIT_SCALE);
-    init_random_weights(lung->Wk + h * head_weight_size, head_weight_size, INIT_SCALE);
-    init_random_weights(lung->Wv + h * head_weight_size, head_weight_size, INIT_SCALE);
-  }
-
   // Build positional encodings (both directions for PITOMADOM)
-  build_positional_encoding(lung->P_ltr, ctx_len, d_model, 0);  // LTR
-  build_positional_encoding(lung->P_rtl, ctx_len, d_model, 1);  // RTL
-
-  // Initialize resonance: 0.5 + random * 0.5
-  for (int i = 0; i < vocab_size; i++) {
-    lung->resonance[i] = 0.5f + _randf() * 0.5f;
+  if (!shared) {
+    build_positional_encoding(lung->P_ltr, ctx_len, d_model, 0);  // LTR
+    build_positional_encoding(lung->P_rtl, ctx_len, d_model, 1);  // RTL
   }
 
   // ─────────────────────────────────────────────────────────────────────────────
@@ -317,33 +1019,509 @@ EXPORT AriannaLung* lung_create(int vocab_size, int d_model, int ctx_len, int n_
   lung->attend_spread = 0.20f;
   lung->use_rtl = 0;
   lung->temporal_alpha = 0.5f;  // symmetric by default
+  lung->fold_attention = 1;
 
   return lung;
 }
 
-EXPORT void lung_destroy(AriannaLung* lung) {
-  if (!lung) return;
+// Draws one random lung takes from its weight stream: E, Wo, Q/K/V, resonance
+static size_t lung_init_draws(int vocab_size, int d_model, int n_heads, int n_kv_heads) {
+  size_t head_weight_size = (size_t)(d_model / n_heads) * d_model;
+  return 2 * (size_t)vocab_size * d_model + (size_t)(n_heads + 2 * n_kv_heads) * head_weight_size +
+         (size_t)vocab_size;
+}
 
-  free(lung->E);
-  free(lung->P_ltr);
-  free(lung->P_rtl);
-  free(lung->Wo);
-  free(lung->Wq);
-  free(lung->Wk);
-  free(lung->Wv);
-  free(lung->resonance);
-  free(lung->presence_accum);
-  free(lung->last_logits);
-  free(lung->last_probs);
-  free(lung->last_attention);
+// Random lung whose weights and resonance are drawn from *rng
+static AriannaLung* lung_create_random(int vocab_size, int d_model, int ctx_len, int n_heads,
+                                       int n_kv_heads, uint32_t* rng) {
+  AriannaLung* lung = lung_alloc(vocab_size, d_model, ctx_len, n_heads, n_kv_heads, NULL);
+  if (!lung) return NULL;
+
+  int head_weight_size = lung->head_dim * d_model;
+
+  // ─────────────────────────────────────────────────────────────────────────────
+  // Allocate weights
+  // ─────────────────────────────────────────────────────────────────────────────
+  lung->E = (float*)calloc(vocab_size * d_model, sizeof(float));
+  lung->Wo = (float*)calloc(d_model * vocab_size, sizeof(float));
+  lung->WoT = (float*)calloc(vocab_size * d_model, sizeof(float));
+
+  lung->Wq = (float*)calloc(n_heads * head_weight_size, sizeof(float));
+  lung->Wk = (float*)calloc(n_kv_heads * head_weight_size, sizeof(float));
+  lung->Wv = (float*)calloc(n_kv_heads * head_weight_size, sizeof(float));
+
+  if (!lung->E || !lung->Wo || !lung->WoT || !lung->Wq || !lung->Wk || !lung->Wv) {
+    lung_destroy(lung);
+    return NULL;
+  }
+
+  // ─────────────────────────────────────────────────────────────────────────────
+  // Initialize weights
+  // ─────────────────────────────────────────────────────────────────────────────
+  init_random_weights(lung->E, vocab_size * d_model, INIT_SCALE, rng);
+  init_random_weights(lung->Wo, d_model * vocab_size, INIT_SCALE, rng);
+
+  // each K/V block is drawn right after the query block of the same index
+  for (int h = 0; h < n_heads; h++) {
+    init_random_weights(lung->Wq + h * head_weight_size, head_weight_size, INIT_SCALE, rng);
+    if (h >= n_kv_heads) continue;
+    init_random_weights(lung->Wk + h * head_weight_size, head_weight_size, INIT_SCALE, rng);
+    init_random_weights(lung->Wv + h * head_weight_size, head_weight_size, INIT_SCALE, rng);
+  }
+
+  pack_output_weights(lung);
+
+  // Initialize resonance: 0.5 + random * 0.5
+  for (int i = 0; i < vocab_size; i++) {
+    lung->resonance[i] = 0.5f + _randf(rng) * 0.5f;
+  }
+
+  return lung;
+}
+
+// n_kv_heads key/value heads shared by n_heads query heads: n_heads is
+// standard multi-head attention, 1 is multi-query, any other divisor of
+// n_heads is grouped-query attention. Wk, Wv and the streaming K/V cache
+// scale with n_kv_heads. Returns NULL if n_kv_heads does not divide n_heads.
+// Weights come from the module stream (lung_seed); safe to call from
+// several threads, though which lung gets which stretch is then arbitrary.
+EXPORT AriannaLung* lung_create_gqa(int vocab_size, int d_model, int ctx_len, int n_heads,
+                                    int n_kv_heads) {
+  if (n_heads <= 0 || n_kv_heads <= 0 || n_heads % n_kv_heads != 0) return NULL;
+  uint32_t rng = _claim_rand(lung_init_draws(vocab_size, d_model, n_heads, n_kv_heads));
+  return lung_create_random(vocab_size, d_model, ctx_len, n_heads, n_kv_heads, &rng);
+}
+
+// lung_create_gqa with its own seed: weights equal lung_seed(seed) followed
+// by lung_create_gqa, and the sampling stream is derived from the seed too.
+// Touches no module state — the way to build many reproducible lungs on a
+// thread pool.
+EXPORT AriannaLung* lung_create_seeded(int vocab_size, int d_model, int ctx_len, int n_heads,
+                                       int n_kv_heads, uint32_t seed) {
+  if (n_heads <= 0 || n_kv_heads <= 0 || n_heads % n_kv_heads != 0) return NULL;
+  uint32_t rng = seed;
+  AriannaLung* lung = lung_create_random(vocab_size, d_model, ctx_len, n_heads, n_kv_heads, &rng);
+  if (lung) lung->rng = mix32(seed + 0x9E3779B9u);
+  return lung;
+}
+
+EXPORT AriannaLung* lung_create(int vocab_size, int d_model, int ctx_len, int n_heads) {
+  return lung_create_gqa(vocab_size, d_model, ctx_len, n_heads, n_heads);
+}
+
+static void weights_view(AriannaLung* lung, const LungWeights* w);
+EXPORT void lung_weights_release(LungWeights* w);
+static void batch_release(AriannaLung* lung);
+
+EXPORT void lung_destroy(AriannaLung* lung) {
+  if (!lung) return;
+
+  if (lung->shared) {  // borrowed: drop the views, then this session's reference
+    weights_view(lung, NULL);
+    lung_weights_release(lung->shared);
+  }
+
+  weight_free(lung, lung->E);
+  free(lung->P_ltr);
+  free(lung->P_rtl);
+  weight_free(lung, lung->Wo);
+  weight_free(lung, lung->WoT);
+  weight_free(lung, lung->Wq);
+  weight_free(lung, lung->Wk);
+  weight_free(lung, lung->Wv);
+  free(lung->resonance);
+  free(lung->presence_accum);
+  free(lung->presence_epoch);
+  free(lung->presence_active);
+  free(lung->presence_new);
+  free(lung->last_logits);
+  free(lung->last_probs);
+  free(lung->last_attention);
   free(lung->X);
   free(lung->scores);
   free(lung->head_out);
   free(lung->y);
+  free(lung->kq);
+  free(lung->xbar);
+  free(lung->k);
+  free(lung->v);
+  free(lung->head_result);
+  free(lung->v_rows);
+  free(lung->attn_pos);
+  free(lung->anchors);
+  shortlist_free(lung->shortlist);
+  if (lung->head_scratch) free(lung->head_scratch[0].q);  // one block for all heads
+  free(lung->head_scratch);
+  free(lung->vocab_part);
+  free(lung->vocab_top);
+  free_aligned(lung->Wqkv);
+  quant_release(lung, &lung->qE);
+  quant_release(lung, &lung->qWoT);
+  for (int m = 0; m < 3; m++) quant_release(lung, &lung->qW[m]);
+
+  batch_release(lung);
 
+  free(lung->stream_tokens);
+  free(lung->stream_slot);
+  free(lung->ring_q);
+  free(lung->ring_k);
+  free(lung->ring_v);
+  free(lung->pad_q);
+  free(lung->pad_k);
+  free(lung->pad_v);
+  for (int dir = 0; dir < 2; dir++) {
+    free(lung->pos_k[dir]);
+    free(lung->pos_v[dir]);
+    free(lung->pos_q[dir]);
+  }
+
+  map_release(lung->map_base, lung->map_bytes, lung->map_owned);
   free(lung);
 }
 
+// ═══════════════════════════════════════════════════════════════════════════════
+// SHARED WEIGHTS — one read-only copy behind many sessions
+// ═══════════════════════════════════════════════════════════════════════════════
+// lung_share_weights moves a lung's weights (embeddings, positional tables,
+// Q/K/V in any layout, Wo/WoT, compressed matrices, a mapped checkpoint)
+// into a reference-counted LungWeights; the lung stays usable as its first
+// session. lung_session_new adds sessions that allocate only mutable state:
+// resonance, presence, last_* and the work buffers, O(vocab + ctx · d).
+// The weights go with the last reference.
+//
+// Forwards only read weights, so sessions run concurrently (one thread per
+// session). A session that writes weights (lung_load_*, merges, quantize,
+// packed QKV, the raw weight pointers) first takes a private copy and lets
+// go of the shared one — copy-on-write, as a mapped lung does per page.
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// Point a lung's weight fields at w's arrays (NULL clears them)
+static void weights_view(AriannaLung* lung, const LungWeights* w) {
+  static const LungWeights none;
+  if (!w) w = &none;
+  lung->E = w->E;
+  lung->P_ltr = w->P_ltr;
+  lung->P_rtl = w->P_rtl;
+  lung->Wo = w->Wo;
+  lung->WoT = w->WoT;
+  lung->Wq = w->Wq;
+  lung->Wk = w->Wk;
+  lung->Wv = w->Wv;
+  lung->packed_qkv = w->packed_qkv;
+  lung->qkv_stride = w->qkv_stride;
+  lung->Wqkv = w->Wqkv;
+  lung->quant_bits = w->quant_bits;
+  lung->qE = w->qE;
+  lung->qWoT = w->qWoT;
+  for (int m = 0; m < 3; m++) lung->qW[m] = w->qW[m];
+}
+
+// Every array of w (those inside its mapping stay), the mapping, resonance
+static void weights_free_arrays(LungWeights* w) {
+  const void* arrays[8] = { w->E, w->P_ltr, w->P_rtl, w->Wo, w->WoT, w->Wq, w->Wk, w->Wv };
+  for (int i = 0; i < 8; i++) {
+    if (!in_mapping(w->map_base, w->map_bytes, arrays[i])) free((void*)arrays[i]);
+  }
+  QuantMatrix* mats[5] = { &w->qE, &w->qWoT, &w->qW[0], &w->qW[1], &w->qW[2] };
+  for (int i = 0; i < 5; i++) {
+    if (!in_mapping(w->map_base, w->map_bytes, mats[i]->data)) free(mats[i]->data);
+    if (!in_mapping(w->map_base, w->map_bytes, mats[i]->scale)) free(mats[i]->scale);
+  }
+  free_aligned(w->Wqkv);
+  free(w->resonance);
+  map_release(w->map_base, w->map_bytes, w->map_owned);
+}
+
+EXPORT void lung_weights_retain(LungWeights* w) {
+  if (w) __atomic_add_fetch(&w->refs, 1, __ATOMIC_RELAXED);
+}
+
+EXPORT void lung_weights_release(LungWeights* w) {
+  if (w && __atomic_sub_fetch(&w->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+    weights_free_arrays(w);
+    free(w);
+  }
+}
+
+static float* floats_dup(const float* src, size_t n, int* ok) {
+  if (!src) return NULL;
+  float* p = (float*)malloc(n * sizeof(float));
+  if (p) memcpy(p, src, n * sizeof(float));
+  else *ok = 0;
+  return p;
+}
+
+static void quant_dup(QuantMatrix* dst, const QuantMatrix* src, int* ok) {
+  memset(dst, 0, sizeof(*dst));
+  if (!src->data) return;
+  if (!quant_alloc(dst, src->rows, src->cols, src->bits, src->bf16)) {
+    *ok = 0;
+    return;
+  }
+  memcpy(dst->data, src->data, (size_t)src->rows * src->row_bytes);
+  if (src->groups) memcpy(dst->scale, src->scale, (size_t)src->rows * src->groups * sizeof(float));
+}
+
+// Copy-on-write: give a session private copies of the shared weights (no-op
+// for a lung that owns its weights). Returns 1 on success.
+static int lung_own_weights(AriannaLung* lung) {
+  LungWeights* w = lung->shared;
+  if (!w) return 1;
+
+  size_t vd = (size_t)w->vocab_size * w->d_model, cd = (size_t)w->ctx_len * w->d_model;
+  size_t qd = (size_t)lung->n_heads * lung->head_dim * w->d_model;
+  size_t kvd = (size_t)lung->kv_dim * w->d_model;
+  LungWeights mine = *w;
+  int ok = 1;
+  mine.E = floats_dup(w->E, vd, &ok);
+  mine.P_ltr = floats_dup(w->P_ltr, cd, &ok);
+  mine.P_rtl = floats_dup(w->P_rtl, cd, &ok);
+  mine.Wo = floats_dup(w->Wo, vd, &ok);
+  mine.WoT = floats_dup(w->WoT, vd, &ok);
+  mine.Wq = floats_dup(w->Wq, qd, &ok);
+  mine.Wk = floats_dup(w->Wk, kvd, &ok);
+  mine.Wv = floats_dup(w->Wv, kvd, &ok);
+  mine.Wqkv = NULL;
+  if (w->Wqkv) {
+    size_t n = qd / w->d_model * 3 * w->qkv_stride;
+    mine.Wqkv = calloc_aligned(n);
+    if (mine.Wqkv) memcpy(mine.Wqkv, w->Wqkv, n * sizeof(float));
+    else ok = 0;
+  }
+  quant_dup(&mine.qE, &w->qE, &ok);
+  quant_dup(&mine.qWoT, &w->qWoT, &ok);
+  for (int m = 0; m < 3; m++) quant_dup(&mine.qW[m], &w->qW[m], &ok);
+
+  if (!ok) {
+    mine.resonance = NULL;
+    mine.map_base = NULL;
+    weights_free_arrays(&mine);
+    return 0;
+  }
+  weights_view(lung, &mine);
+  lung->shared = NULL;
+  lung_weights_release(w);
+  return 1;
+}
+
+// Turn a lung into the first session of shared weights, which are returned
+// (owned by the sessions: lung_weights_retain to keep them past the last).
+// The lung's current resonance becomes the starting resonance of new
+// sessions. Returns the existing weights for a session, NULL on failure.
+EXPORT LungWeights* lung_share_weights(AriannaLung* lung) {
+  if (!lung) return NULL;
+  if (lung->shared) return lung->shared;
+
+  LungWeights* w = (LungWeights*)calloc(1, sizeof(LungWeights));
+  float* resonance = (float*)malloc(lung->vocab_size * sizeof(float));
+  if (!w || !resonance) {
+    free(w);
+    free(resonance);
+    return NULL;
+  }
+  w->refs = 1;
+  w->vocab_size = lung->vocab_size;
+  w->d_model = lung->d_model;
+  w->ctx_len = lung->ctx_len;
+  w->n_heads = lung->n_heads;
+  w->n_kv_heads = lung->n_kv_heads;
+  w->E = lung->E;
+  w->P_ltr = lung->P_ltr;
+  w->P_rtl = lung->P_rtl;
+  w->Wo = lung->Wo;
+  w->WoT = lung->WoT;
+  w->Wq = lung->Wq;
+  w->Wk = lung->Wk;
+  w->Wv = lung->Wv;
+  w->packed_qkv = lung->packed_qkv;
+  w->qkv_stride = lung->qkv_stride;
+  w->Wqkv = lung->Wqkv;
+  w->quant_bits = lung->quant_bits;
+  w->qE = lung->qE;
+  w->qWoT = lung->qWoT;
+  for (int m = 0; m < 3; m++) w->qW[m] = lung->qW[m];
+  w->map_base = lung->map_base;
+  w->map_bytes = lung->map_bytes;
+  w->map_owned = lung->map_owned;
+  memcpy(resonance, lung->resonance, lung->vocab_size * sizeof(float));
+  w->resonance = resonance;
+
+  lung->map_base = NULL;
+  lung->map_bytes = 0;
+  lung->map_owned = 0;
+  lung->shared = w;
+  return w;
+}
+
+// A new session on shared weights: fresh presence, streaming cache and
+// settings (as lung_create), resonance from the weights. Destroy it with
+// lung_destroy. Returns NULL on failure.
+EXPORT LungSession* lung_session_new(LungWeights* w) {
+  if (!w) return NULL;
+  AriannaLung* lung = lung_alloc(w->vocab_size, w->d_model, w->ctx_len, w->n_heads,
+                                 w->n_kv_heads, w);
+  if (!lung) return NULL;
+  lung_weights_retain(w);
+  lung->shared = w;
+  weights_view(lung, w);
+  memcpy(lung->resonance, w->resonance, w->vocab_size * sizeof(float));
+  return lung;
+}
+
+// Bytes a session allocates for itself at creation (the lazily allocated
+// streaming, batch and threaded workspaces come on top; shared weights and
+// positional tables do not count)
+EXPORT size_t lung_session_bytes(AriannaLung* lung) {
+  if (!lung) return 0;
+  size_t vocab = lung->vocab_size, ctx = lung->ctx_len, d = lung->d_model;
+  size_t hd = lung->head_dim;
+  size_t n_tiles = (vocab + LUNG_VOCAB_TILE - 1) / LUNG_VOCAB_TILE;
+  size_t n = sizeof(AriannaLung)
+           + vocab * (4 * sizeof(float) + sizeof(uint32_t) + sizeof(int))  // resonance, presence, last_*
+           + ctx * (2 * sizeof(float) + 3 * sizeof(int))                   // attention, scores, pos, anchors, new
+           + (ctx * d + ctx * hd + 3 * d + 4 * hd) * sizeof(float)         // X, v_rows, y, kq, xbar, head
+           + n_tiles * (sizeof(VocabPart) + LUNG_TOPK_CACHE * sizeof(TopKEntry));
+  if (!lung->shared) n += 2 * ctx * d * sizeof(float);  // own positional tables
+  return n;
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// PRESENCE — lazy decay (epoch stamps + active set)
+// ═══════════════════════════════════════════════════════════════════════════════
+//
+// Every exhale decays all presence by presence_decay and then bumps the
+// context tokens. Instead of sweeping the vocab, each token keeps the value
+// it had at its last touch and that step's epoch; reads apply
+// decay^(now - epoch). The sorted active set lists the tokens with non-zero
+// stored presence, so the logit modulation visits only those and an exhale
+// costs O(active + ctx), not O(vocab). Tokens whose presence has decayed
+// below PRESENCE_EPSILON drop out of the set (and read as zero).
+// ═══════════════════════════════════════════════════════════════════════════════
+
+static inline float presence_at(const AriannaLung* lung, int i) {
+  float p = lung->presence_accum[i];
+  uint32_t age = lung->presence_now - lung->presence_epoch[i];
+  return (age && p != 0.0f) ? p * powf(lung->presence_decay, (float)age) : p;
+}
+
+// First active index >= lo
+static int presence_lower_bound(const AriannaLung* lung, int lo) {
+  int a = 0, b = lung->n_active;
+  while (a < b) {
+    int m = (a + b) / 2;
+    if (lung->presence_active[m] < lo) a = m + 1; else b = m;
+  }
+  return a;
+}
+
+// logits[i] *= 1 + presence · coupling for the active tokens in [lo, hi)
+static void presence_modulate(const AriannaLung* lung, float* logits, int lo, int hi) {
+  const int* act = lung->presence_active;
+  for (int a = presence_lower_bound(lung, lo); a < lung->n_active && act[a] < hi; a++) {
+    int i = act[a];
+    logits[i] *= (1.0f + presence_at(lung, i) * PRESENCE_LOGIT_COUPLING);
+  }
+}
+
+// One decay step, then the context bump (clamped at 1)
+static void presence_step(AriannaLung* lung, const int* context, int context_len) {
+  int vocab = lung->vocab_size;
+  int* act = lung->presence_active;
+  lung->presence_now++;
+
+  int n_new = 0;
+  for (int t = 0; t < context_len && t < lung->ctx_len; t++) {
+    int token_id = context[t];
+    if (token_id < 0 || token_id >= vocab) continue;
+    float old = lung->presence_accum[token_id];
+    float new_val = presence_at(lung, token_id) + PRESENCE_INCREMENT;
+    lung->presence_accum[token_id] = (new_val > 1.0f) ? 1.0f : new_val;
+    lung->presence_epoch[token_id] = lung->presence_now;
+    if (old == 0.0f) lung->presence_new[n_new++] = token_id;
+  }
+
+  // Drop what has faded (in place, order kept)
+  int kept = 0;
+  for (int a = 0; a < lung->n_active; a++) {
+    int i = act[a];
+    if (presence_at(lung, i) < PRESENCE_EPSILON) {
+      lung->presence_accum[i] = 0.0f;
+    } else {
+      act[kept++] = i;
+    }
+  }
+
+  // Merge the newcomers (few: at most ctx_len) from the back
+  int* add = lung->presence_new;
+  for (int j = 1; j < n_new; j++) {
+    int x = add[j], k = j;
+    while (k > 0 && add[k - 1] > x) { add[k] = add[k - 1]; k--; }
+    add[k] = x;
+  }
+  int w = kept + n_new;
+  for (int a = kept - 1, j = n_new - 1; j >= 0; ) {
+    act[--w] = (a >= 0 && act[a] > add[j]) ? act[a--] : add[j--];
+  }
+  lung->n_active = kept + n_new;
+}
+
+// Replace every token's presence (ids with p > 0 become active)
+static void presence_assign(AriannaLung* lung, const float* presence) {
+  lung->n_active = 0;
+  for (int i = 0; i < lung->vocab_size; i++) {
+    float p = presence ? presence[i] : 0.0f;
+    lung->presence_accum[i] = p;
+    lung->presence_epoch[i] = lung->presence_now;
+    if (p != 0.0f) lung->presence_active[lung->n_active++] = i;
+  }
+}
+
+// Snapshot of the active entries (O(active)), for hypothetical rollouts
+typedef struct {
+  int n;
+  uint32_t now;
+  int* ids;
+  float* vals;
+  uint32_t* epochs;
+} PresenceSnapshot;
+
+static int presence_save(const AriannaLung* lung, PresenceSnapshot* snap) {
+  int n = lung->n_active;
+  snap->n = n;
+  snap->now = lung->presence_now;
+  snap->ids = (int*)malloc((size_t)(n ? n : 1) * sizeof(int));
+  snap->vals = (float*)malloc((size_t)(n ? n : 1) * sizeof(float));
+  snap->epochs = (uint32_t*)malloc((size_t)(n ? n : 1) * sizeof(uint32_t));
+  if (!snap->ids || !snap->vals || !snap->epochs) {
+    free(snap->ids);
+    free(snap->vals);
+    free(snap->epochs);
+    return 0;
+  }
+  for (int a = 0; a < n; a++) {
+    int i = lung->presence_active[a];
+    snap->ids[a] = i;
+    snap->vals[a] = lung->presence_accum[i];
+    snap->epochs[a] = lung->presence_epoch[i];
+  }
+  return 1;
+}
+
+static void presence_restore(AriannaLung* lung, PresenceSnapshot* snap) {
+  for (int a = 0; a < lung->n_active; a++) lung->presence_accum[lung->presence_active[a]] = 0.0f;
+  for (int a = 0; a < snap->n; a++) {
+    int i = snap->ids[a];
+    lung->presence_active[a] = i;
+    lung->presence_accum[i] = snap->vals[a];
+    lung->presence_epoch[i] = snap->epochs[a];
+  }
+  lung->n_active = snap->n;
+  lung->presence_now = snap->now;
+  free(snap->ids);
+  free(snap->vals);
+  free(snap->epochs);
+}
+
 // ═══════════════════════════════════════════════════════════════════════════════
 // FORWARD PASS — the breath
 // ═══════════════════════════════════════════════════════════════════════════════
@@ -359,233 +1537,1727 @@ EXPORT void lung_destroy(AriannaLung* lung) {
 //
 // ═══════════════════════════════════════════════════════════════════════════════
 
-EXPORT float lung_forward(AriannaLung* lung, const int* context, int context_len) {
-  if (!lung || !context) return 0.0f;
+// ─────────────────────────────────────────────────────────────────────────────
+// Attended positions, in increasing order. By default that is every position
+// 0..ctx-1: a short context is padded with token 0 and the pads take part in
+// the softmax like any token. Length-aware mode (lung_set_mask_padding, or
+// an explicit mask through lung_forward_masked) keeps only the positions
+// the mask allows (t < context_len without one): no X rows, keys, values or
+// scores are computed for the rest, and the query comes from the last
+// attended position instead of the padded last slot. The list is never
+// empty; a context with nothing to attend sees one pad at position 0.
+//
+// Sparse attention (lung_set_sparse_attention) then narrows the allowed
+// positions to the attn_window ending at the query plus the prime anchors
+// before it, so the cost per head is O(window + anchors) instead of O(ctx).
+// ─────────────────────────────────────────────────────────────────────────────
+static inline int attend_allowed(int t, int context_len, int masked, const uint8_t* mask) {
+  return !masked || (mask ? mask[t] != 0 : t < context_len);
+}
 
-  int ctx = lung->ctx_len;
-  int d = lung->d_model;
+static int attend_positions(const AriannaLung* lung, int context_len, int masked,
+                            const uint8_t* mask, int* pos) {
+  int q_pos = lung->ctx_len - 1;
+  if (masked && !mask && context_len <= q_pos) q_pos = context_len - 1;
+  while (q_pos >= 0 && !attend_allowed(q_pos, context_len, masked, mask)) q_pos--;
+  if (q_pos < 0) {
+    pos[0] = 0;
+    return 1;
+  }
+
+  int n = 0;
+  int lo = 0;
+  if (lung->attn_window > 0 && lung->attn_window <= q_pos) {
+    lo = q_pos - lung->attn_window + 1;
+    for (int a = 0; a < lung->n_anchors && lung->anchors[a] < lo; a++) {
+      if (attend_allowed(lung->anchors[a], context_len, masked, mask)) pos[n++] = lung->anchors[a];
+    }
+  }
+  for (int t = lo; t <= q_pos; t++) {
+    if (attend_allowed(t, context_len, masked, mask)) pos[n++] = t;
+  }
+  return n;
+}
+
+// Turn a raw q·k score into the final pre-softmax attention score:
+// resonance, temporal bias (relative to the query position) and DSL
+// focus/spread applied in that order
+static float modulate_score(const AriannaLung* lung, float score, int t, int q_pos,
+                            const int* context, int context_len) {
   int vocab = lung->vocab_size;
-  int n_heads = lung->n_heads;
-  int head_dim = lung->head_dim;
-  int head_weight_size = head_dim * d;
+  float temporal_bias = (lung->temporal_alpha - 0.5f) * 2.0f;  // [-1, 1]
 
-  // Select positional encoding based on RTL mode
-  float* P = lung->use_rtl ? lung->P_rtl : lung->P_ltr;
+  // Apply resonance modulation
+  int token_id = (t < context_len) ? context[t] : 0;
+  if (token_id >= 0 && token_id < vocab) {
+    float res_boost = lung->resonance[token_id] * RESONANCE_ATTENTION_COUPLING;
+    score *= (1.0f + res_boost);
+  }
 
-  // ─────────────────────────────────────────────────────────────────────────────
-  // Build token vectors: X[t] = E[token[t]] + P[t]
-  // ─────────────────────────────────────────────────────────────────────────────
-  memset(lung->X, 0, ctx * d * sizeof(float));
+  // ═══════════════════════════════════════════════════════════════════════════
+  // PITOMADOM TEMPORAL SYMMETRY
+  // Bias attention based on temporal_alpha (prophecy vs retrodiction)
+  // ═══════════════════════════════════════════════════════════════════════════
+  int relative_pos = q_pos - t;  // positive = looking at earlier
+  float pos_sign = (relative_pos > 0) ? 1.0f : ((relative_pos < 0) ? -1.0f : 0.0f);
 
-  for (int t = 0; t < ctx; t++) {
-    int token_id = (t < context_len) ? context[t] : 0;  // pad with 0
-    if (token_id < 0) token_id = 0;
-    if (token_id >= vocab) token_id = vocab - 1;
+  if (lung->use_rtl) {
+    // RTL: left is future, right is past
+    // t < q_pos → future → boost when temporal_bias > 0
+    score += temporal_bias * pos_sign * TEMPORAL_BIAS_STRENGTH;
+  } else {
+    // LTR: left is past, right is future
+    // t < q_pos → past → boost when temporal_bias < 0
+    score -= temporal_bias * pos_sign * TEMPORAL_BIAS_STRENGTH;
+  }
 
-    for (int i = 0; i < d; i++) {
-      lung->X[t * d + i] = lung->E[token_id * d + i] + P[t * d + i];
+  // ═══════════════════════════════════════════════════════════════════════════
+  // DSL-CONTROLLED ATTENTION PHYSICS
+  // ═══════════════════════════════════════════════════════════════════════════
+  // focus sharpens: scale by (0.25 + 1.75 * focus)
+  score *= (FOCUS_SCALE_MIN + FOCUS_SCALE_RANGE * lung->attend_focus);
+
+  // spread blurs: divide by (0.15 + 2.0 * spread)
+  float spread_divisor = SPREAD_SCALE_MIN + SPREAD_SCALE_RANGE * lung->attend_spread;
+  if (spread_divisor < SPREAD_SCALE_MIN) spread_divisor = SPREAD_SCALE_MIN;
+  score /= spread_divisor;
+
+  return score;
+}
+
+// Fold one head's softmaxed scores (one per attended position) into the
+// combined attention map; masked positions keep zero weight
+static void accumulate_attention(AriannaLung* lung, const float* scores,
+                                 const int* pos, int n) {
+  float head_weight = 1.0f / (float)lung->n_heads;
+  for (int j = 0; j < n; j++) {
+    lung->last_attention[pos[j]] += scores[j] * head_weight;
+  }
+}
+
+// The lung's own work buffers as a scratch set (serial path)
+static HeadScratch lung_scratch(AriannaLung* lung) {
+  HeadScratch s = { lung->head_out, lung->kq, lung->xbar, lung->scores,
+                    lung->k, lung->v_rows, lung->head_result };
+  return s;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Unfolded head: project K and V at every position (reference path)
+// O(ctx · head_dim · d) per head
+// ─────────────────────────────────────────────────────────────────────────────
+static void attend_head_unfolded(const AriannaLung* lung, HeadScratch* s, int h,
+                                 const int* context, int context_len,
+                                 const int* pos, int n) {
+  int d = lung->d_model;
+  int head_dim = lung->head_dim;
+  float sqrt_head_dim = sqrtf((float)head_dim);
+
+  // Compute attention scores for the attended positions; values come from
+  // the same pass over x_t (fused kernel when packed)
+  for (int j = 0; j < n; j++) {
+    int t = pos[j];
+    const float* x_t = lung->X + t * d;
+    float* v_t = s->v_rows + j * head_dim;
+
+    if (lung->packed_qkv) {
+      int stride;
+      const float* row = qkv_head(lung, QKV_Q, h, &stride);
+      float o3[3];
+      for (int r = 0; r < head_dim; r++, row += stride) {
+        kern_dot3(row, row + lung->qkv_stride, row + 2 * lung->qkv_stride, x_t, d, o3);
+        s->k[r] = o3[1];
+        v_t[r] = o3[2];
+      }
+    } else {
+      head_mat_vec(lung, QKV_K, h, x_t, s->k);
+      head_mat_vec(lung, QKV_V, h, x_t, v_t);
     }
+
+    // Base score: q·k / sqrt(head_dim)
+    float score = dot(s->q, s->k, head_dim) / sqrt_head_dim;
+    s->scores[j] = modulate_score(lung, score, t, pos[n - 1], context, context_len);
   }
 
-  // ─────────────────────────────────────────────────────────────────────────────
-  // Multi-head attention (NO CAUSAL MASK — bidirectional!)
-  // ─────────────────────────────────────────────────────────────────────────────
-  memset(lung->last_attention, 0, ctx * sizeof(float));
-  memset(lung->y, 0, d * sizeof(float));
+  softmax(s->scores, n);
 
-  float* q = lung->head_out;  // reuse buffer for query
-  float* k = (float*)alloca(head_dim * sizeof(float));  // stack allocate key
-  float* v = (float*)alloca(head_dim * sizeof(float));  // stack allocate value
-  float* head_result = (float*)alloca(head_dim * sizeof(float));
+  // Weighted sum of values
+  memset(s->head_result, 0, head_dim * sizeof(float));
+  for (int j = 0; j < n; j++) {
+    axpy(s->head_result, s->v_rows + j * head_dim, s->scores[j], head_dim);
+  }
+}
 
-  int last_pos = ctx - 1;
+// ─────────────────────────────────────────────────────────────────────────────
+// Folded head: the query is a single vector, so fold the projections away
+//   q·(Wk x_t)       = (Wk^T q)·x_t       → one Wk^T q, then ctx dot products
+//   Σ a_t (Wv x_t)   = Wv (Σ a_t x_t)     → one weighted sum, then one Wv
+// O(ctx · d + head_dim · d) per head
+// ─────────────────────────────────────────────────────────────────────────────
+static void attend_head_folded(const AriannaLung* lung, HeadScratch* s, int h,
+                               const int* context, int context_len,
+                               const int* pos, int n) {
+  int d = lung->d_model;
+  int head_dim = lung->head_dim;
   float sqrt_head_dim = sqrtf((float)head_dim);
-  float temporal_bias = (lung->temporal_alpha - 0.5f) * 2.0f;  // [-1, 1]
 
-  for (int h = 0; h < n_heads; h++) {
-    float* Wq_h = lung->Wq + h * head_weight_size;
-    float* Wk_h = lung->Wk + h * head_weight_size;
-    float* Wv_h = lung->Wv + h * head_weight_size;
+  // kq = Wk_h^T · q (row-wise, contiguous)
+  memset(s->kq, 0, d * sizeof(float));
+  head_axpy_t(lung, QKV_K, h, s->q, s->kq);
 
-    // Query from last token
-    float* x_last = lung->X + last_pos * d;
-    mat_vec(q, Wq_h, x_last, head_dim, d);
+  for (int j = 0; j < n; j++) {
+    float score = dot(s->kq, lung->X + pos[j] * d, d) / sqrt_head_dim;
+    s->scores[j] = modulate_score(lung, score, pos[j], pos[n - 1], context, context_len);
+  }
 
-    // Compute attention scores for all positions
-    for (int t = 0; t < ctx; t++) {
-      float* x_t = lung->X + t * d;
-      mat_vec(k, Wk_h, x_t, head_dim, d);
+  softmax(s->scores, n);
 
-      // Base score: q·k / sqrt(head_dim)
-      float score = dot(q, k, head_dim) / sqrt_head_dim;
+  // xbar = Σ a_t x_t, then a single value projection
+  memset(s->xbar, 0, d * sizeof(float));
+  for (int j = 0; j < n; j++) {
+    axpy(s->xbar, lung->X + pos[j] * d, s->scores[j], d);
+  }
+  head_mat_vec(lung, QKV_V, h, s->xbar, s->head_result);
+}
 
-      // Apply resonance modulation
-      int token_id = (t < context_len) ? context[t] : 0;
-      if (token_id >= 0 && token_id < vocab) {
-        float res_boost = lung->resonance[token_id] * RESONANCE_ATTENTION_COUPLING;
-        score *= (1.0f + res_boost);
-      }
+// ─────────────────────────────────────────────────────────────────────────────
+// One head end to end: query from the last attended position, attention,
+// slot in y. Touches only its scratch set and its own slice of y, so heads
+// can run on different threads.
+// ─────────────────────────────────────────────────────────────────────────────
+static void breathe_head(AriannaLung* lung, HeadScratch* s, int h,
+                         const int* context, int context_len, const int* pos, int n) {
+  int d = lung->d_model;
+  int head_dim = lung->head_dim;
 
-      // ═══════════════════════════════════════════════════════════════════════
-      // PITOMADOM TEMPORAL SYMMETRY
-      // Bias attention based on temporal_alpha (prophecy vs retrodiction)
-      // ═══════════════════════════════════════════════════════════════════════
-      int relative_pos = last_pos - t;  // positive = looking at earlier
-      float pos_sign = (relative_pos > 0) ? 1.0f : ((relative_pos < 0) ? -1.0f : 0.0f);
-
-      if (lung->use_rtl) {
-        // RTL: left is future, right is past
-        // t < last_pos → future → boost when temporal_bias > 0
-        score += temporal_bias * pos_sign * TEMPORAL_BIAS_STRENGTH;
-      } else {
-        // LTR: left is past, right is future
-        // t < last_pos → past → boost when temporal_bias < 0
-        score -= temporal_bias * pos_sign * TEMPORAL_BIAS_STRENGTH;
-      }
+  // Query from last attended token
+  head_mat_vec(lung, QKV_Q, h, lung->X + pos[n - 1] * d, s->q);
 
-      // ═══════════════════════════════════════════════════════════════════════
-      // DSL-CONTROLLED ATTENTION PHYSICS
-      // ═══════════════════════════════════════════════════════════════════════
-      // focus sharpens: scale by (0.25 + 1.75 * focus)
-      score *= (FOCUS_SCALE_MIN + FOCUS_SCALE_RANGE * lung->attend_focus);
+  if (lung->fold_attention) {
+    attend_head_folded(lung, s, h, context, context_len, pos, n);
+  } else {
+    attend_head_unfolded(lung, s, h, context, context_len, pos, n);
+  }
 
-      // spread blurs: divide by (0.15 + 2.0 * spread)
-      float spread_divisor = SPREAD_SCALE_MIN + SPREAD_SCALE_RANGE * lung->attend_spread;
-      if (spread_divisor < SPREAD_SCALE_MIN) spread_divisor = SPREAD_SCALE_MIN;
-      score /= spread_divisor;
+  // Concatenate into y
+  int offset = h * head_dim;
+  for (int i = 0; i < head_dim && offset + i < d; i++) {
+    lung->y[offset + i] = s->head_result[i];
+  }
+}
 
-      lung->scores[t] = score;
-    }
+// ─────────────────────────────────────────────────────────────────────────────
+// Vocab epilogue in fixed tiles of LUNG_VOCAB_TILE tokens, two passes:
+//   1. per tile, while its logits are hot: [Wo^T ·] y, presence modulation
+//      (the tile's active tokens), tile max m_t, exp(logit - m_t) into
+//      probs, Σexp, Σexp·logit and the tile's top-k candidates
+//   2. per tile: probs *= exp(m_t - lse)
+// Between the passes the tile partials give log-sum-exp and the entropy
+// analytically: H = lse - Σ p·logit. Partials are always reduced in tile
+// order, so the result is the same whether the tiles ran on one thread or
+// many.
+// ─────────────────────────────────────────────────────────────────────────────
+static void vocab_tile_pass1(AriannaLung* lung, const float* y, float* logits, float* probs,
+                             int lo, int hi, VocabPart* part, TopKEntry* top) {
+  int d = lung->d_model;
+  if (y && lung->quant_bits) {
+    for (int i = lo; i < hi; i++) logits[i] = quant_dot(&lung->qWoT, i, y);
+  } else if (y) {
+    mat_vec(logits + lo, lung->WoT + (size_t)lo * d, y, hi - lo, d);
+  }
 
-    // Softmax attention
-    softmax(lung->scores, ctx);
+  // Apply presence pulse modulation (active tokens only)
+  presence_modulate(lung, logits, lo, hi);
 
-    // Accumulate combined attention (for visualization)
-    float head_weight = 1.0f / (float)n_heads;
-    for (int t = 0; t < ctx; t++) {
-      lung->last_attention[t] += lung->scores[t] * head_weight;
-    }
+  float max_val = kern_max(logits + lo, hi - lo);
+  float sum = 0.0f, lsum = 0.0f;
+  for (int i = lo; i < hi; i++) {
+    float e = expf(logits[i] - max_val);
+    probs[i] = e;
+    sum += e;
+    lsum += e * logits[i];
+  }
+  part->max = max_val;
+  part->sum = sum;
+  part->lsum = lsum;
 
-    // Weighted sum of values
-    memset(head_result, 0, head_dim * sizeof(float));
-    for (int t = 0; t < ctx; t++) {
-      float* x_t = lung->X + t * d;
-      mat_vec(v, Wv_h, x_t, head_dim, d);
-      axpy(head_result, v, lung->scores[t], head_dim);
-    }
+  if (top) {
+    TopK h;
+    topk_init(&h, top, LUNG_TOPK_CACHE);
+    for (int i = lo; i < hi; i++) topk_push(&h, logits[i], i);
+    part->n_top = h.n;
+  }
+}
 
-    // Concatenate into y
-    int offset = h * head_dim;
-    for (int i = 0; i < head_dim && offset + i < d; i++) {
-      lung->y[offset + i] = head_result[i];
-    }
+static void vocab_tile_pass2(float* probs, int lo, int hi, const VocabPart* part, float lse) {
+  kern_scale(probs + lo, expf(part->max - lse), hi - lo);
+}
+
+// Tile partials → log-sum-exp; returns the entropy
+static float vocab_reduce(const VocabPart* parts, int n_tiles, float* lse) {
+  float max_val = parts[0].max;
+  for (int tile = 1; tile < n_tiles; tile++) {
+    if (parts[tile].max > max_val) max_val = parts[tile].max;
   }
 
-  // ─────────────────────────────────────────────────────────────────────────────
-  // Output projection: logits = Wo^T · y
-  // ─────────────────────────────────────────────────────────────────────────────
-  mat_vec_t(lung->last_logits, lung->Wo, lung->y, d, vocab);
+  float sum = 0.0f, lsum = 0.0f;
+  for (int tile = 0; tile < n_tiles; tile++) {
+    float w = expf(parts[tile].max - max_val);
+    sum += parts[tile].sum * w;
+    lsum += parts[tile].lsum * w;
+  }
 
-  // Apply presence pulse modulation
-  for (int i = 0; i < vocab; i++) {
-    lung->last_logits[i] *= (1.0f + lung->presence_accum[i] * PRESENCE_LOGIT_COUPLING);
+  *lse = max_val + logf(sum);
+  float entropy = *lse - lsum / sum;
+  return entropy > 0.0f ? entropy : 0.0f;
+}
+
+// Tile candidates → lung->top (best first)
+static void vocab_merge_top(AriannaLung* lung, int n_tiles) {
+  TopK h;
+  topk_init(&h, lung->top, LUNG_TOPK_CACHE);
+  for (int tile = 0; tile < n_tiles; tile++) {
+    const TopKEntry* cand = lung->vocab_top + (size_t)tile * LUNG_TOPK_CACHE;
+    for (int j = 0; j < lung->vocab_part[tile].n_top; j++) topk_push(&h, cand[j].val, cand[j].idx);
   }
+  lung->n_top = topk_sort(&h);
+}
 
-  // Compute probabilities
-  memcpy(lung->last_probs, lung->last_logits, vocab * sizeof(float));
-  softmax(lung->last_probs, vocab);
+static int vocab_tiles(const AriannaLung* lung) {
+  return (lung->vocab_size + LUNG_VOCAB_TILE - 1) / LUNG_VOCAB_TILE;
+}
 
-  // ─────────────────────────────────────────────────────────────────────────────
-  // Update presence accumulator
-  // ─────────────────────────────────────────────────────────────────────────────
-  for (int i = 0; i < vocab; i++) {
-    lung->presence_accum[i] *= lung->presence_decay;
+static int vocab_tile_end(const AriannaLung* lung, int tile) {
+  int hi = (tile + 1) * LUNG_VOCAB_TILE;
+  return hi < lung->vocab_size ? hi : lung->vocab_size;
+}
+
+// Serial epilogue: [Wo^T ·] y → logits → presence → probs → entropy.
+// y = NULL when the logits are already projected; presence is only read.
+// top != 0 refreshes the lung's top-k cache.
+static float logits_to_probs(AriannaLung* lung, const float* y, float* logits, float* probs,
+                             int top) {
+  int n_tiles = vocab_tiles(lung);
+
+  for (int tile = 0; tile < n_tiles; tile++) {
+    vocab_tile_pass1(lung, y, logits, probs, tile * LUNG_VOCAB_TILE, vocab_tile_end(lung, tile),
+                     &lung->vocab_part[tile],
+                     top ? lung->vocab_top + (size_t)tile * LUNG_TOPK_CACHE : NULL);
   }
-  for (int t = 0; t < context_len && t < ctx; t++) {
-    int token_id = context[t];
-    if (token_id >= 0 && token_id < vocab) {
-      float new_val = lung->presence_accum[token_id] + PRESENCE_INCREMENT;
-      lung->presence_accum[token_id] = (new_val > 1.0f) ? 1.0f : new_val;
-    }
+
+  float lse;
+  float entropy = vocab_reduce(lung->vocab_part, n_tiles, &lse);
+  for (int tile = 0; tile < n_tiles; tile++) {
+    vocab_tile_pass2(probs, tile * LUNG_VOCAB_TILE, vocab_tile_end(lung, tile),
+                     &lung->vocab_part[tile], lse);
   }
+  if (top) vocab_merge_top(lung, n_tiles);
+  return entropy;
+}
 
-  // ─────────────────────────────────────────────────────────────────────────────
-  // Compute entropy (return value)
-  // ─────────────────────────────────────────────────────────────────────────────
-  float entropy = 0.0f;
-  for (int i = 0; i < vocab; i++) {
-    float p = lung->last_probs[i];
-    if (p > 1e-12f) {
-      entropy -= p * logf(p);
+// ─────────────────────────────────────────────────────────────────────────────
+// Threaded jobs (pool.h): heads, then the three vocab phases
+// ─────────────────────────────────────────────────────────────────────────────
+
+typedef struct {
+  AriannaLung* lung;
+  const int* context;
+  int context_len;
+  const int* pos;
+  int n_pos;
+} HeadJob;
+
+static void head_task(void* arg, int h) {
+  HeadJob* job = (HeadJob*)arg;
+  breathe_head(job->lung, &job->lung->head_scratch[h], h, job->context, job->context_len,
+               job->pos, job->n_pos);
+}
+
+typedef struct {
+  AriannaLung* lung;
+  int phase;           // 0 = pass 1, 1 = pass 2
+  float lse;
+} VocabJob;
+
+static void vocab_task(void* arg, int tile) {
+  VocabJob* job = (VocabJob*)arg;
+  AriannaLung* lung = job->lung;
+  int lo = tile * LUNG_VOCAB_TILE;
+  int hi = vocab_tile_end(lung, tile);
+
+  if (job->phase == 0) {
+    vocab_tile_pass1(lung, lung->y, lung->last_logits, lung->last_probs, lo, hi,
+                     &lung->vocab_part[tile], lung->vocab_top + (size_t)tile * LUNG_TOPK_CACHE);
+  } else {
+    vocab_tile_pass2(lung->last_probs, lo, hi, &lung->vocab_part[tile], job->lse);
+  }
+}
+
+// Same reductions as logits_to_probs (with the top-k cache), tiles spread
+// over the pool
+static float logits_to_probs_threaded(AriannaLung* lung) {
+  int n_tiles = vocab_tiles(lung);
+  VocabJob job = { lung, 0, 0.0f };
+
+  pool_run(vocab_task, &job, n_tiles);
+  float entropy = vocab_reduce(lung->vocab_part, n_tiles, &job.lse);
+
+  job.phase = 1;
+  pool_run(vocab_task, &job, n_tiles);
+  vocab_merge_top(lung, n_tiles);
+  return entropy;
+}
+
+// Per-head scratch sets for threaded heads (allocated on first use)
+static int head_scratch_alloc(AriannaLung* lung) {
+  if (lung->head_scratch) return 1;
+
+  int n_heads = lung->n_heads;
+  size_t hd = lung->head_dim, d = lung->d_model, ctx = lung->ctx_len;
+  size_t per_head = 3 * hd + 2 * d + ctx + ctx * hd;
+  HeadScratch* hs = (HeadScratch*)calloc(n_heads, sizeof(HeadScratch));
+  float* block = (float*)calloc(per_head * n_heads, sizeof(float));
+  if (!hs || !block) {
+    free(hs);
+    free(block);
+    return 0;
+  }
+
+  for (int h = 0; h < n_heads; h++) {
+    float* p = block + per_head * h;
+    hs[h].q = p;            p += hd;
+    hs[h].k = p;            p += hd;
+    hs[h].head_result = p;  p += hd;
+    hs[h].kq = p;           p += d;
+    hs[h].xbar = p;         p += d;
+    hs[h].scores = p;       p += ctx;
+    hs[h].v_rows = p;
+  }
+  lung->head_scratch = hs;
+  return 1;
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// SHORTLIST — logits for a candidate set instead of the whole vocab
+// ═══════════════════════════════════════════════════════════════════════════════
+// With lung_set_shortlist on, an exhale scores only:
+//   - the members of the n_probe clusters with the best bounds (an
+//     approximate max-inner-product search over the WoT rows)
+//   - the presence-active tokens (the only ones the modulation touches)
+//   - the LUNG_SHORTLIST_RESONANT highest-resonance tokens
+// A sample of the remaining tokens, stratified by cluster, estimates their
+// total mass (the tail), so probs over the candidates sum to 1 - tail_mass
+// and entropy counts the tail as well. Unscored tokens read as logit -inf, prob 0.
+// Cost per exhale: O(sqrt(vocab) · d) for the bounds plus O(d) per
+// candidate. The clusters are fitted on the first use and again after the
+// output weights change.
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// WoT row i as floats (dequantized into buf for compressed lungs)
+static const float* wo_row(const AriannaLung* lung, int i, float* buf) {
+  if (!lung->quant_bits) return lung->WoT + (size_t)i * lung->d_model;
+  quant_row(&lung->qWoT, i, buf);
+  return buf;
+}
+
+static inline float wo_logit(const AriannaLung* lung, int i, const float* y) {
+  int d = lung->d_model;
+  return lung->quant_bits ? quant_dot(&lung->qWoT, i, y) : dot(lung->WoT + (size_t)i * d, y, d);
+}
+
+// Nearest centroid: max x·c - |c|²/2 (the same as min |x - c|)
+static int shortlist_nearest(const Shortlist* sl, const float* half_norm, const float* x, int d) {
+  int best = 0;
+  float best_s = -INFINITY;
+  for (int c = 0; c < sl->n_clusters; c++) {
+    float sc = dot(x, sl->centroids + (size_t)c * d, d) - half_norm[c];
+    if (sc > best_s) { best_s = sc; best = c; }
+  }
+  return best;
+}
+
+// Fit row f: a multiplicative hash by a prime (distinct rows for f < vocab,
+// not in step with any period of the vocab ids)
+static inline int shortlist_fit_row(int f, int vocab) {
+  return (int)(((uint64_t)f * 2654435761u) % (uint64_t)vocab);
+}
+
+// k-means over (up to LUNG_SHORTLIST_FIT) WoT rows, then every row into its
+// nearest cluster, grouped by a counting sort
+static int shortlist_fit(AriannaLung* lung) {
+  Shortlist* sl = lung->shortlist;
+  int vocab = lung->vocab_size, d = lung->d_model, C = sl->n_clusters;
+  int n_fit = vocab < LUNG_SHORTLIST_FIT ? vocab : LUNG_SHORTLIST_FIT;
+  float* buf = (float*)malloc(d * sizeof(float));
+  float* sums = (float*)malloc((size_t)C * d * sizeof(float));
+  float* half = (float*)malloc(C * sizeof(float));
+  float* gap = (float*)malloc(n_fit * sizeof(float));
+  int* count = (int*)malloc(C * sizeof(int));
+  if (!buf || !sums || !half || !gap || !count) {
+    free(buf); free(sums); free(half); free(gap); free(count);
+    return 0;
+  }
+
+  // Seeds: farthest-point (each next seed is the fit row farthest from
+  // the seeds so far), so no group of nearby rows starts with two seeds
+  // while another has none
+  int next = 0;
+  for (int c = 0; c < C; c++) {
+    float* cen = sl->centroids + (size_t)c * d;
+    memcpy(cen, wo_row(lung, shortlist_fit_row(next, vocab), buf), d * sizeof(float));
+    float far = -1.0f;
+    for (int f = 0; f < n_fit; f++) {
+      const float* x = wo_row(lung, shortlist_fit_row(f, vocab), buf);
+      float dist = 0.0f;
+      for (int j = 0; j < d; j++) dist += (x[j] - cen[j]) * (x[j] - cen[j]);
+      if (c == 0 || dist < gap[f]) gap[f] = dist;
+      if (gap[f] > far) { far = gap[f]; next = f; }
+    }
+  }
+
+  for (int iter = 0; iter < LUNG_SHORTLIST_ITERS; iter++) {
+    for (int c = 0; c < C; c++) {
+      const float* cen = sl->centroids + (size_t)c * d;
+      half[c] = 0.5f * dot(cen, cen, d);
+    }
+    memset(sums, 0, (size_t)C * d * sizeof(float));
+    memset(count, 0, C * sizeof(int));
+    for (int f = 0; f < n_fit; f++) {
+      const float* x = wo_row(lung, shortlist_fit_row(f, vocab), buf);
+      int c = shortlist_nearest(sl, half, x, d);
+      axpy(sums + (size_t)c * d, x, 1.0f, d);
+      count[c]++;
+    }
+    for (int c = 0; c < C; c++) {
+      if (!count[c]) continue;  // empty cluster keeps its centroid
+      float* cen = sl->centroids + (size_t)c * d;
+      for (int j = 0; j < d; j++) cen[j] = sums[(size_t)c * d + j] / (float)count[c];
+    }
+  }
+
+  // Final assignment and radii
+  for (int c = 0; c < C; c++) {
+    const float* cen = sl->centroids + (size_t)c * d;
+    half[c] = 0.5f * dot(cen, cen, d);
+    sl->radius[c] = 0.0f;
+  }
+  memset(sl->offsets, 0, (C + 1) * sizeof(int));
+  for (int i = 0; i < vocab; i++) {
+    const float* x = wo_row(lung, i, buf);
+    int c = shortlist_nearest(sl, half, x, d);
+    const float* cen = sl->centroids + (size_t)c * d;
+    float dist = 0.0f;
+    for (int j = 0; j < d; j++) dist += (x[j] - cen[j]) * (x[j] - cen[j]);
+    dist = sqrtf(dist);
+    if (dist > sl->radius[c]) sl->radius[c] = dist;
+    sl->cluster_of[i] = c;
+    sl->offsets[c + 1]++;
+  }
+  for (int c = 0; c < C; c++) {
+    sl->offsets[c + 1] += sl->offsets[c];
+    count[c] = sl->offsets[c];
+  }
+  for (int i = 0; i < vocab; i++) sl->members[count[sl->cluster_of[i]]++] = i;
+  sl->stale = 0;
+  free(buf); free(sums); free(half); free(gap); free(count);
+  return 1;
+}
+
+// Fit / refresh what changed since the last exhale
+static int shortlist_ready(AriannaLung* lung) {
+  Shortlist* sl = lung->shortlist;
+  if (!sl || (sl->stale && !shortlist_fit(lung))) return 0;
+  if (sl->resonance_stale) {
+    TopKEntry scratch[LUNG_SHORTLIST_RESONANT];
+    sl->n_resonant = topk_select(lung->resonance, lung->vocab_size, -1,
+                                 LUNG_SHORTLIST_RESONANT, scratch, sl->resonant);
+    sl->resonance_stale = 0;
+  }
+  return 1;
+}
+
+static inline void shortlist_add(Shortlist* sl, int i) {
+  if (sl->mark[i] != sl->stamp) {
+    sl->mark[i] = sl->stamp;
+    sl->cand[sl->n_cand++] = i;
+    sl->scored[sl->cluster_of[i]]++;
+  }
+}
+
+// Candidates → logits, presence, probs, entropy and the top-k cache; the
+// rest of the vocab is summarized by the tail estimate
+static float shortlist_exhale(AriannaLung* lung) {
+  Shortlist* sl = lung->shortlist;
+  int vocab = lung->vocab_size, d = lung->d_model, C = sl->n_clusters;
+  const float* y = lung->y;
+  float* logits = lung->last_logits;
+  float* probs = lung->last_probs;
+
+  // Forget the previous candidates (the whole vocab after a full exhale)
+  if (sl->clean) {
+    for (int j = 0; j < sl->n_cand; j++) {
+      logits[sl->cand[j]] = -INFINITY;
+      probs[sl->cand[j]] = 0.0f;
+    }
+  } else {
+    for (int i = 0; i < vocab; i++) logits[i] = -INFINITY;
+    memset(probs, 0, vocab * sizeof(float));
+    sl->clean = 1;
+  }
+  if (++sl->stamp == 0) {
+    memset(sl->mark, 0, vocab * sizeof(uint32_t));
+    sl->stamp = 1;
+  }
+  sl->n_cand = 0;
+  memset(sl->scored, 0, C * sizeof(int));
+
+  // Clusters with the best bounds, then presence and resonance
+  float y_norm = sqrtf(dot(y, y, d));
+  for (int c = 0; c < C; c++) {
+    sl->bound[c] = dot(y, sl->centroids + (size_t)c * d, d) + y_norm * sl->radius[c];
+  }
+  int n_probe = topk_select(sl->bound, C, -1, lung->shortlist_probe < C ? lung->shortlist_probe : C,
+                            sl->rank, sl->probe);
+  for (int k = 0; k < n_probe; k++) {
+    int c = sl->probe[k];
+    for (int m = sl->offsets[c]; m < sl->offsets[c + 1]; m++) shortlist_add(sl, sl->members[m]);
+  }
+  for (int a = 0; a < lung->n_active; a++) shortlist_add(sl, lung->presence_active[a]);
+  for (int r = 0; r < sl->n_resonant; r++) shortlist_add(sl, sl->resonant[r]);
+
+  // Candidate logits (inactive tokens read presence 0, factor 1)
+  VocabPart parts[2];
+  float max_val = -INFINITY;
+  for (int j = 0; j < sl->n_cand; j++) {
+    int i = sl->cand[j];
+    float l = wo_logit(lung, i, y) * (1.0f + presence_at(lung, i) * PRESENCE_LOGIT_COUPLING);
+    logits[i] = l;
+    if (l > max_val) max_val = l;
+  }
+  float sum = 0.0f, lsum = 0.0f;
+  for (int j = 0; j < sl->n_cand; j++) {
+    int i = sl->cand[j];
+    float e = expf(logits[i] - max_val);
+    probs[i] = e;
+    sum += e;
+    lsum += e * logits[i];
+  }
+  parts[0].max = max_val; parts[0].sum = sum; parts[0].lsum = lsum;
+
+  // Tail: a stratified sample, one stratum per cluster. A cluster's
+  // unscored members get samples in proportion to their count (at least
+  // one), evenly spaced; each sample stands for count / samples tokens.
+  int n_tail = vocab - sl->n_cand, n_parts = 1, n_samples = 0;
+  float tmax = -INFINITY;
+  for (int c = 0; c < C && n_tail > 0; c++) {
+    int lo = sl->offsets[c], size = sl->offsets[c + 1] - lo;
+    int left = size - sl->scored[c];
+    if (left <= 0) continue;
+    int take = (int)((int64_t)LUNG_SHORTLIST_SAMPLES * left / n_tail);
+    if (take < 1) take = 1;
+    if (take > left) take = left;
+    for (int k = 0; k < take; k++) {
+      int m = (int)((int64_t)k * size / take);
+      while (sl->mark[sl->members[lo + m]] == sl->stamp) m = (m + 1 == size) ? 0 : m + 1;
+      int i = sl->members[lo + m];
+      sl->mark[i] = sl->stamp;
+      float l = wo_logit(lung, i, y);  // unscored tokens are not presence-active
+      sl->tail_l[n_samples] = l;
+      sl->tail_w[n_samples++] = (float)left / (float)take;
+      if (l > tmax) tmax = l;
+    }
+  }
+  if (n_samples > 0) {
+    float tsum = 0.0f, tlsum = 0.0f;
+    for (int k = 0; k < n_samples; k++) {
+      float e = sl->tail_w[k] * expf(sl->tail_l[k] - tmax);
+      tsum += e;
+      tlsum += e * sl->tail_l[k];
+    }
+    parts[1].max = tmax; parts[1].sum = tsum; parts[1].lsum = tlsum;
+    n_parts = 2;
+  }
+
+  float lse;
+  float entropy = vocab_reduce(parts, n_parts, &lse);
+  float w = expf(parts[0].max - lse);
+  for (int j = 0; j < sl->n_cand; j++) probs[sl->cand[j]] *= w;
+  lung->tail_mass = (n_parts == 2) ? expf(parts[1].max - lse) * parts[1].sum : 0.0f;
+
+  TopK h;
+  topk_init(&h, lung->top, LUNG_TOPK_CACHE);
+  for (int j = 0; j < sl->n_cand; j++) topk_push(&h, logits[sl->cand[j]], sl->cand[j]);
+  lung->n_top = topk_sort(&h);
+  return entropy;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Exhale: y → logits → presence modulation → probs → entropy
+// Shared by every forward path once lung->y holds the head outputs
+// ─────────────────────────────────────────────────────────────────────────────
+static float exhale(AriannaLung* lung, const int* context, int context_len) {
+  // ─────────────────────────────────────────────────────────────────────────────
+  // Output projection: logits = Wo^T · y
+  // one contiguous d-length row of WoT per token (streams, no vocab stride)
+  // ─────────────────────────────────────────────────────────────────────────────
+  // (fused with presence modulation and the top-k cache), or only the
+  // shortlist's candidates
+  float entropy;
+  if (lung->shortlist_probe && shortlist_ready(lung)) {
+    entropy = shortlist_exhale(lung);
+  } else {
+    if (lung->shortlist) lung->shortlist->clean = 0;
+    lung->tail_mass = 0.0f;
+    if (lung_threads > 1 && vocab_tiles(lung) > 1) {
+      entropy = logits_to_probs_threaded(lung);
+    } else {
+      entropy = logits_to_probs(lung, lung->y, lung->last_logits, lung->last_probs, 1);
+    }
+  }
+
+  // ─────────────────────────────────────────────────────────────────────────────
+  // Update presence accumulator: one lazy decay step, then the context bump
+  // ─────────────────────────────────────────────────────────────────────────────
+  presence_step(lung, context, context_len);
+
+  return entropy;
+}
+
+
+// Full forward over the attended positions (see attend_positions)
+static float forward_positions(AriannaLung* lung, const int* context, int context_len,
+                               int masked, const uint8_t* mask) {
+  int ctx = lung->ctx_len;
+  int d = lung->d_model;
+  int vocab = lung->vocab_size;
+  int n_heads = lung->n_heads;
+  int* pos = lung->attn_pos;
+  int n = attend_positions(lung, context_len, masked, mask, pos);
+
+  // Select positional encoding based on RTL mode
+  float* P = lung->use_rtl ? lung->P_rtl : lung->P_ltr;
+
+  // ─────────────────────────────────────────────────────────────────────────────
+  // Build token vectors: X[t] = E[token[t]] + P[t] (attended rows only)
+  // ─────────────────────────────────────────────────────────────────────────────
+  for (int j = 0; j < n; j++) {
+    int t = pos[j];
+    int token_id = (t < context_len) ? context[t] : 0;  // pad with 0
+    if (token_id < 0) token_id = 0;
+    if (token_id >= vocab) token_id = vocab - 1;
+
+    float* x_t = lung->X + t * d;
+    embed_token(lung, token_id, x_t);
+    for (int i = 0; i < d; i++) {
+      x_t[i] += P[t * d + i];
+    }
+  }
+
+  // ─────────────────────────────────────────────────────────────────────────────
+  // Multi-head attention (NO CAUSAL MASK — bidirectional!)
+  // Heads are independent; with threads on each gets its own scratch set and
+  // the attention map is still summed in head order (same bits as serial).
+  // ─────────────────────────────────────────────────────────────────────────────
+  memset(lung->last_attention, 0, ctx * sizeof(float));
+  memset(lung->y, 0, d * sizeof(float));
+
+  if (lung_threads > 1 && n_heads > 1 && head_scratch_alloc(lung)) {
+    HeadJob job = { lung, context, context_len, pos, n };
+    pool_run(head_task, &job, n_heads);
+    for (int h = 0; h < n_heads; h++) {
+      accumulate_attention(lung, lung->head_scratch[h].scores, pos, n);
+    }
+  } else {
+    HeadScratch s = lung_scratch(lung);
+    for (int h = 0; h < n_heads; h++) {
+      breathe_head(lung, &s, h, context, context_len, pos, n);
+      accumulate_attention(lung, s.scores, pos, n);
+    }
+  }
+
+  return exhale(lung, context, context_len);
+}
+
+EXPORT float lung_forward(AriannaLung* lung, const int* context, int context_len) {
+  if (!lung || !context) return 0.0f;
+  return forward_positions(lung, context, context_len, lung->mask_padding, NULL);
+}
+
+// Length-aware forward with an explicit mask: ctx_len entries, nonzero =
+// attend (pads included if asked for); NULL masks every t >= context_len
+EXPORT float lung_forward_masked(AriannaLung* lung, const int* context, int context_len,
+                                 const uint8_t* mask) {
+  if (!lung || !context) return 0.0f;
+  return forward_positions(lung, context, context_len, 1, mask);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// STREAMING — incremental sliding window (one token per breath)
+// ═══════════════════════════════════════════════════════════════════════════════
+//
+// lung_push_token(lung, tok)   append to window (oldest falls out when full)
+// lung_forward_cached(lung)    ≡ lung_forward(lung, window, stream_len)
+//
+// Per push:    3 · d² (token projections of the new token only, fused if packed)
+// Per forward: O(ctx · d) attention + output projection — no d² work at all
+//
+// The cache holds projections of E, Wq, Wk, Wv. If those weights are changed
+// (e.g. through lung_get_embeddings), call lung_stream_reset to rebuild.
+// ═══════════════════════════════════════════════════════════════════════════════
+
+static int clamp_token(const AriannaLung* lung, int token_id) {
+  if (token_id < 0) return 0;
+  if (token_id >= lung->vocab_size) return lung->vocab_size - 1;
+  return token_id;
+}
+
+// Allocate ring/tables and precompute positional and padding projections
+static int stream_build(AriannaLung* lung) {
+  int ctx = lung->ctx_len;
+  int d = lung->d_model;
+  int kvd = lung->kv_dim;
+  size_t rows = (size_t)ctx * d;
+  size_t kv_rows = (size_t)ctx * kvd;
+
+  if (!lung->stream_tokens) {
+    lung->stream_tokens = (int*)calloc(ctx, sizeof(int));
+    lung->stream_slot = (int*)calloc(ctx, sizeof(int));
+    lung->ring_q = (float*)calloc(rows, sizeof(float));
+    lung->ring_k = (float*)calloc(kv_rows, sizeof(float));
+    lung->ring_v = (float*)calloc(kv_rows, sizeof(float));
+    lung->pad_q = (float*)calloc(d, sizeof(float));
+    lung->pad_k = (float*)calloc(kvd, sizeof(float));
+    lung->pad_v = (float*)calloc(kvd, sizeof(float));
+    for (int dir = 0; dir < 2; dir++) {
+      lung->pos_k[dir] = (float*)calloc(kv_rows, sizeof(float));
+      lung->pos_v[dir] = (float*)calloc(kv_rows, sizeof(float));
+      lung->pos_q[dir] = (float*)calloc(rows, sizeof(float));
+    }
+  }
+
+  if (!lung->stream_tokens || !lung->stream_slot || !lung->ring_q || !lung->ring_k || !lung->ring_v ||
+      !lung->pad_q || !lung->pad_k || !lung->pad_v ||
+      !lung->pos_k[0] || !lung->pos_v[0] || !lung->pos_q[0] ||
+      !lung->pos_k[1] || !lung->pos_v[1] || !lung->pos_q[1]) {
+    return 0;
+  }
+
+  // Positional part (q at every position: the length-aware query comes from
+  // the newest token wherever it sits)
+  for (int dir = 0; dir < 2; dir++) {
+    const float* P = dir ? lung->P_rtl : lung->P_ltr;
+    for (int t = 0; t < ctx; t++) {
+      project_qkv(lung, P + t * d, lung->pos_q[dir] + t * d,
+                  lung->pos_k[dir] + t * kvd, lung->pos_v[dir] + t * kvd);
+    }
+  }
+
+  float* e = lung->xbar;  // embedding row scratch
+  embed_token(lung, 0, e);
+  project_qkv(lung, e, lung->pad_q, lung->pad_k, lung->pad_v);
+
+  // Re-project whatever is already in the window (weights may have changed)
+  for (int t = 0; t < lung->stream_len; t++) {
+    int slot = (lung->stream_start + t) % ctx;
+    embed_token(lung, clamp_token(lung, lung->stream_tokens[t]), e);
+    project_qkv(lung, e, lung->ring_q + slot * d, lung->ring_k + slot * kvd,
+                lung->ring_v + slot * kvd);
+  }
+
+  lung->stream_ready = 1;
+  return 1;
+}
+
+// Clear the window and drop cached projections (rebuilt on next push)
+EXPORT void lung_stream_reset(AriannaLung* lung) {
+  if (!lung) return;
+  lung->stream_ready = 0;
+  lung->stream_len = 0;
+  lung->stream_start = 0;
+}
+
+// Append one token; returns the new window length (or -1 on failure)
+EXPORT int lung_push_token(AriannaLung* lung, int token_id) {
+  if (!lung) return -1;
+  if (!lung->stream_ready && !stream_build(lung)) return -1;
+
+  int ctx = lung->ctx_len;
+  int d = lung->d_model;
+  int slot;
+
+  if (lung->stream_len < ctx) {
+    slot = (lung->stream_start + lung->stream_len) % ctx;
+    lung->stream_tokens[lung->stream_len++] = token_id;
+  } else {
+    // window full: the oldest slot is recycled for the newest token
+    slot = lung->stream_start;
+    lung->stream_start = (lung->stream_start + 1) % ctx;
+    memmove(lung->stream_tokens, lung->stream_tokens + 1, (ctx - 1) * sizeof(int));
+    lung->stream_tokens[ctx - 1] = token_id;
+  }
+
+  float* e = lung->xbar;  // embedding row scratch
+  embed_token(lung, clamp_token(lung, token_id), e);
+  project_qkv(lung, e, lung->ring_q + slot * d, lung->ring_k + slot * lung->kv_dim,
+              lung->ring_v + slot * lung->kv_dim);
+
+  return lung->stream_len;
+}
+
+EXPORT int lung_get_stream_len(AriannaLung* lung) {
+  return lung ? lung->stream_len : 0;
+}
+
+// Snapshot of the window (O(stream_len) rows), for hypothetical rollouts.
+// Only live slots are saved: the rest of the ring is never read.
+typedef struct {
+  int len;
+  int start;
+  int* tokens;
+  float* q;                 // len × d_model, window order
+  float* k;                 // len × kv_dim
+  float* v;                 // len × kv_dim
+} StreamSnapshot;
+
+static int stream_save(const AriannaLung* lung, StreamSnapshot* snap) {
+  size_t n = lung->stream_len ? (size_t)lung->stream_len : 1;
+  size_t d = lung->d_model, kvd = lung->kv_dim;
+  snap->len = lung->stream_len;
+  snap->start = lung->stream_start;
+  snap->tokens = (int*)malloc(n * sizeof(int));
+  snap->q = (float*)malloc(n * d * sizeof(float));
+  snap->k = (float*)malloc(n * kvd * sizeof(float));
+  snap->v = (float*)malloc(n * kvd * sizeof(float));
+  if (!snap->tokens || !snap->q || !snap->k || !snap->v) {
+    free(snap->tokens);
+    free(snap->q);
+    free(snap->k);
+    free(snap->v);
+    return 0;
+  }
+  for (int t = 0; t < snap->len; t++) {
+    size_t slot = (size_t)((lung->stream_start + t) % lung->ctx_len);
+    snap->tokens[t] = lung->stream_tokens[t];
+    memcpy(snap->q + t * d, lung->ring_q + slot * d, d * sizeof(float));
+    memcpy(snap->k + t * kvd, lung->ring_k + slot * kvd, kvd * sizeof(float));
+    memcpy(snap->v + t * kvd, lung->ring_v + slot * kvd, kvd * sizeof(float));
+  }
+  return 1;
+}
+
+static void stream_restore(AriannaLung* lung, StreamSnapshot* snap) {
+  size_t d = lung->d_model, kvd = lung->kv_dim;
+  lung->stream_len = snap->len;
+  lung->stream_start = snap->start;
+  for (int t = 0; t < snap->len; t++) {
+    size_t slot = (size_t)((snap->start + t) % lung->ctx_len);
+    lung->stream_tokens[t] = snap->tokens[t];
+    memcpy(lung->ring_q + slot * d, snap->q + t * d, d * sizeof(float));
+    memcpy(lung->ring_k + slot * kvd, snap->k + t * kvd, kvd * sizeof(float));
+    memcpy(lung->ring_v + slot * kvd, snap->v + t * kvd, kvd * sizeof(float));
+  }
+  free(snap->tokens);
+  free(snap->q);
+  free(snap->k);
+  free(snap->v);
+}
+
+// Attention over a cached window. Position t < len reads row slot[t] of
+// q_rows (d_model apart) and k_rows / v_rows (kv_dim apart), the rest is
+// padding. Attended
+// positions follow lung_set_mask_padding. Writes y; adds the head-averaged
+// map to `attention` unless NULL. Shared by the stream and the beam search.
+static void cached_attention(AriannaLung* lung, const float* q_rows,
+                             const float* k_rows, const float* v_rows,
+                             const int* slot, const int* tokens, int len,
+                             float* y, float* attention) {
+  int d = lung->d_model;
+  int kvd = lung->kv_dim;
+  int n_heads = lung->n_heads;
+  int head_dim = lung->head_dim;
+  int dir = lung->use_rtl ? 1 : 0;
+  float sqrt_head_dim = sqrtf((float)head_dim);
+  float head_weight = 1.0f / (float)n_heads;
+
+  const float* pos_k = lung->pos_k[dir];
+  const float* pos_v = lung->pos_v[dir];
+
+  int* pos = lung->attn_pos;
+  int n = attend_positions(lung, len, lung->mask_padding, NULL, pos);
+  int q_pos = pos[n - 1];
+  const float* q_tok = (q_pos < len) ? q_rows + (size_t)slot[q_pos] * d : lung->pad_q;
+  const float* q_p = lung->pos_q[dir] + (size_t)q_pos * d;
+
+  memset(y, 0, d * sizeof(float));
+
+  float* q = lung->head_out;
+
+  for (int h = 0; h < n_heads; h++) {
+    int off = h * head_dim;
+    int kv_off = kv_head(lung, h) * head_dim;
+
+    for (int r = 0; r < head_dim; r++) {
+      q[r] = q_tok[off + r] + q_p[off + r];
+    }
+
+    // score_t = q · (Wk E[tok_t] + Wk P[t])
+    for (int j = 0; j < n; j++) {
+      int t = pos[j];
+      const float* k_tok = (t < len) ? k_rows + (size_t)slot[t] * kvd : lung->pad_k;
+      float score = (dot(q, k_tok + kv_off, head_dim) +
+                     dot(q, pos_k + t * kvd + kv_off, head_dim)) / sqrt_head_dim;
+      lung->scores[j] = modulate_score(lung, score, t, q_pos, tokens, len);
+    }
+
+    softmax(lung->scores, n);
+    if (attention) {
+      for (int j = 0; j < n; j++) attention[pos[j]] += lung->scores[j] * head_weight;
+    }
+
+    // head = Σ a_t (Wv E[tok_t] + Wv P[t])
+    memset(lung->head_result, 0, head_dim * sizeof(float));
+    for (int j = 0; j < n; j++) {
+      int t = pos[j];
+      const float* v_tok = (t < len) ? v_rows + (size_t)slot[t] * kvd : lung->pad_v;
+      axpy(lung->head_result, v_tok + kv_off, lung->scores[j], head_dim);
+      axpy(lung->head_result, pos_v + t * kvd + kv_off, lung->scores[j], head_dim);
+    }
+
+    for (int i = 0; i < head_dim && off + i < d; i++) {
+      y[off + i] = lung->head_result[i];
+    }
+  }
+}
+
+// Forward over the current window using only cached rows
+EXPORT float lung_forward_cached(AriannaLung* lung) {
+  if (!lung || !lung->stream_ready) return 0.0f;
+
+  int ctx = lung->ctx_len;
+  int len = lung->stream_len;
+
+  for (int t = 0; t < len; t++) lung->stream_slot[t] = (lung->stream_start + t) % ctx;
+
+  memset(lung->last_attention, 0, ctx * sizeof(float));
+  cached_attention(lung, lung->ring_q, lung->ring_k, lung->ring_v, lung->stream_slot,
+                   lung->stream_tokens, len, lung->y, lung->last_attention);
+
+  return exhale(lung, lung->stream_tokens, len);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// BATCH — many contexts, one pass over the weights
+// ═══════════════════════════════════════════════════════════════════════════════
+//
+// lung_forward_batch(lung, contexts, lens, B, out_probs, out_entropy)
+//   contexts: B × ctx_len token ids (row b is context b, lens[b] valid)
+//   lens:     B lengths, or NULL for full rows
+//   outputs:  caller buffers, B × vocab probs and B entropies (either may be NULL)
+// lung_forward_batch_ex adds B × vocab logits and B × ctx_len attention.
+//
+// Every weight matrix (Wq, Wk, Wv per head, then WoT) is streamed once per
+// tile of LUNG_BATCH_TILE contexts through kern_mat_mat instead of once per
+// context. Each context sees exactly what lung_forward would compute, using
+// the folded formulation. Branches are hypothetical: presence is read but
+// not accumulated, and last_logits / last_probs / last_attention are left
+// untouched.
+// ═══════════════════════════════════════════════════════════════════════════════
+
+#define LUNG_BATCH_TILE 16
+
+// Free the batch workspace; every pointer is left NULL
+static void batch_release(AriannaLung* lung) {
+  free(lung->batch_X);
+  free(lung->batch_x_last);
+  free(lung->batch_q);
+  free(lung->batch_kq);
+  free(lung->batch_xbar);
+  free(lung->batch_head);
+  free(lung->batch_y);
+  free(lung->batch_logits);
+  free(lung->batch_probs);
+  free(lung->batch_pos);
+  lung->batch_X = lung->batch_x_last = lung->batch_q = lung->batch_kq = NULL;
+  lung->batch_xbar = lung->batch_head = lung->batch_y = NULL;
+  lung->batch_logits = lung->batch_probs = NULL;
+  lung->batch_pos = NULL;
+}
+
+static int batch_alloc(AriannaLung* lung) {
+  if (lung->batch_X) return 1;
+
+  size_t tile = LUNG_BATCH_TILE;
+  size_t d = lung->d_model;
+  lung->batch_X = (float*)calloc(tile * lung->ctx_len * d, sizeof(float));
+  lung->batch_x_last = (float*)calloc(tile * d, sizeof(float));
+  lung->batch_q = (float*)calloc(tile * lung->head_dim, sizeof(float));
+  lung->batch_kq = (float*)calloc(tile * d, sizeof(float));
+  lung->batch_xbar = (float*)calloc(tile * d, sizeof(float));
+  lung->batch_head = (float*)calloc(tile * lung->head_dim, sizeof(float));
+  lung->batch_y = (float*)calloc(tile * d, sizeof(float));
+  lung->batch_logits = (float*)calloc(tile * lung->vocab_size, sizeof(float));
+  lung->batch_probs = (float*)calloc(lung->vocab_size, sizeof(float));
+  lung->batch_pos = (int*)calloc(tile * lung->ctx_len, sizeof(int));
+
+  if (!lung->batch_X || !lung->batch_x_last || !lung->batch_q || !lung->batch_kq ||
+      !lung->batch_xbar || !lung->batch_head || !lung->batch_y ||
+      !lung->batch_logits || !lung->batch_probs || !lung->batch_pos) {
+    batch_release(lung);  // retry allocation on the next call
+    return 0;
+  }
+  return 1;
+}
+
+// One tile of nb contexts (nb <= LUNG_BATCH_TILE); out_* point at the tile's rows
+static void forward_tile(AriannaLung* lung, const int* contexts, const int* lens, int nb,
+                         float* out_logits, float* out_probs,
+                         float* out_attention, float* out_entropy) {
+  int ctx = lung->ctx_len;
+  int d = lung->d_model;
+  int vocab = lung->vocab_size;
+  int n_heads = lung->n_heads;
+  int head_dim = lung->head_dim;
+  float sqrt_head_dim = sqrtf((float)head_dim);
+  float head_weight = 1.0f / (float)n_heads;
+  const float* P = lung->use_rtl ? lung->P_rtl : lung->P_ltr;
+
+  // ─────────────────────────────────────────────────────────────────────────────
+  // Build token vectors per context: X_b[t] = E[token[t]] + P[t]
+  // (attended rows only)
+  // ─────────────────────────────────────────────────────────────────────────────
+  int n_pos[LUNG_BATCH_TILE];
+  for (int b = 0; b < nb; b++) {
+    const int* context = contexts + (size_t)b * ctx;
+    float* X = lung->batch_X + (size_t)b * ctx * d;
+    int* pos = lung->batch_pos + (size_t)b * ctx;
+    n_pos[b] = attend_positions(lung, lens[b], lung->mask_padding, NULL, pos);
+    for (int j = 0; j < n_pos[b]; j++) {
+      int t = pos[j];
+      int token_id = (t < lens[b]) ? clamp_token(lung, context[t]) : 0;
+      embed_token(lung, token_id, X + t * d);
+      for (int i = 0; i < d; i++) {
+        X[t * d + i] += P[t * d + i];
+      }
+    }
+    memcpy(lung->batch_x_last + (size_t)b * d, X + (size_t)pos[n_pos[b] - 1] * d, d * sizeof(float));
+  }
+
+  if (out_attention) memset(out_attention, 0, (size_t)nb * ctx * sizeof(float));
+  memset(lung->batch_y, 0, (size_t)nb * d * sizeof(float));
+
+  for (int h = 0; h < n_heads; h++) {
+    // Queries for the whole tile: one pass over Wq_h
+    head_mat_mat(lung, QKV_Q, h, lung->batch_x_last, nb, lung->batch_q);
+
+    // kq_b = Wk_h^T q_b: each Wk_h row is applied to every context while hot
+    memset(lung->batch_kq, 0, (size_t)nb * d * sizeof(float));
+    int g = kv_head(lung, h);
+    for (int r = 0; r < head_dim; r++) {
+      if (lung->quant_bits) {
+        for (int b = 0; b < nb; b++) {
+          quant_axpy(lung->batch_kq + (size_t)b * d, &lung->qW[QKV_K], g * head_dim + r,
+                     lung->batch_q[b * head_dim + r]);
+        }
+        continue;
+      }
+      int ks;
+      const float* row = qkv_head(lung, QKV_K, g, &ks) + (size_t)r * ks;
+      for (int b = 0; b < nb; b++) {
+        axpy(lung->batch_kq + (size_t)b * d, row, lung->batch_q[b * head_dim + r], d);
+      }
+    }
+
+    // Scores and weighted input are per context (no shared weights here)
+    for (int b = 0; b < nb; b++) {
+      const int* context = contexts + (size_t)b * ctx;
+      const float* X = lung->batch_X + (size_t)b * ctx * d;
+      const float* kq = lung->batch_kq + (size_t)b * d;
+      float* xbar = lung->batch_xbar + (size_t)b * d;
+
+      const int* pos = lung->batch_pos + (size_t)b * ctx;
+      int n = n_pos[b];
+      for (int j = 0; j < n; j++) {
+        float score = dot(kq, X + pos[j] * d, d) / sqrt_head_dim;
+        lung->scores[j] = modulate_score(lung, score, pos[j], pos[n - 1], context, lens[b]);
+      }
+      softmax(lung->scores, n);
+
+      if (out_attention) {
+        float* att = out_attention + (size_t)b * ctx;
+        for (int j = 0; j < n; j++) att[pos[j]] += lung->scores[j] * head_weight;
+      }
+
+      memset(xbar, 0, d * sizeof(float));
+      for (int j = 0; j < n; j++) {
+        axpy(xbar, X + pos[j] * d, lung->scores[j], d);
+      }
+    }
+
+    // Value projection for the whole tile: one pass over Wv_h
+    head_mat_mat(lung, QKV_V, h, lung->batch_xbar, nb, lung->batch_head);
+
+    int offset = h * head_dim;
+    for (int b = 0; b < nb; b++) {
+      float* y = lung->batch_y + (size_t)b * d;
+      for (int i = 0; i < head_dim && offset + i < d; i++) {
+        y[offset + i] = lung->batch_head[b * head_dim + i];
+      }
+    }
+  }
+
+  // ─────────────────────────────────────────────────────────────────────────────
+  // Output projection for the whole tile: one pass over WoT
+  // ─────────────────────────────────────────────────────────────────────────────
+  float* logits = out_logits ? out_logits : lung->batch_logits;
+  if (lung->quant_bits) {
+    quant_mat_mat(logits, &lung->qWoT, 0, vocab, lung->batch_y, nb);
+  } else {
+    kern_mat_mat(logits, lung->WoT, d, lung->batch_y, nb, vocab, d);
+  }
+
+  for (int b = 0; b < nb; b++) {
+    float* probs = out_probs ? out_probs + (size_t)b * vocab : lung->batch_probs;
+    float entropy = logits_to_probs(lung, NULL, logits + (size_t)b * vocab, probs, 0);
+    if (out_entropy) out_entropy[b] = entropy;
+  }
+}
+
+// Full batch: any output may be NULL; returns B on success, 0 on failure
+EXPORT int lung_forward_batch_ex(AriannaLung* lung, const int* contexts, const int* lens, int B,
+                                 float* out_logits, float* out_probs,
+                                 float* out_attention, float* out_entropy) {
+  if (!lung || !contexts || B <= 0) return 0;
+  if (!batch_alloc(lung)) return 0;
+
+  int ctx = lung->ctx_len;
+  int vocab = lung->vocab_size;
+  int tile_lens[LUNG_BATCH_TILE];
+
+  for (int b0 = 0; b0 < B; b0 += LUNG_BATCH_TILE) {
+    int nb = (B - b0 < LUNG_BATCH_TILE) ? B - b0 : LUNG_BATCH_TILE;
+
+    for (int b = 0; b < nb; b++) {
+      int len = lens ? lens[b0 + b] : ctx;
+      tile_lens[b] = (len < 0) ? 0 : (len > ctx ? ctx : len);
+    }
+
+    forward_tile(lung, contexts + (size_t)b0 * ctx, tile_lens, nb,
+                 out_logits ? out_logits + (size_t)b0 * vocab : NULL,
+                 out_probs ? out_probs + (size_t)b0 * vocab : NULL,
+                 out_attention ? out_attention + (size_t)b0 * ctx : NULL,
+                 out_entropy ? out_entropy + b0 : NULL);
+  }
+
+  return B;
+}
+
+EXPORT int lung_forward_batch(AriannaLung* lung, const int* contexts, const int* lens, int B,
+                              float* out_probs, float* out_entropy) {
+  return lung_forward_batch_ex(lung, contexts, lens, B, NULL, out_probs, NULL, out_entropy);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// THREADS — opt-in worker pool (native only; WASM stays single-threaded)
+// ═══════════════════════════════════════════════════════════════════════════════
+//
+// lung_set_threads(n) starts the process-wide pool on first use (n - 1
+// workers plus the caller) and applies to every lung. lung_forward then
+// splits across heads and vocab tiles; lung_forward_cached shares the
+// threaded vocab epilogue. Results are bit-identical for any thread count.
+// The pool cannot be resized once started; n <= 1 returns to the serial path.
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// Returns the number of threads in effect
+EXPORT int lung_set_threads(int n_threads) {
+  if (n_threads <= 1) {
+    lung_threads = 1;
+    return 1;
+  }
+  lung_threads = pool_start(n_threads);
+  return lung_threads;
+}
+
+EXPORT int lung_get_threads(void) {
+  return lung_threads;
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// GETTERS — expose inference state to JS
+// ═══════════════════════════════════════════════════════════════════════════════
+
+EXPORT float* lung_get_logits(AriannaLung* lung) {
+  return lung ? lung->last_logits : NULL;
+}
+
+EXPORT float* lung_get_probs(AriannaLung* lung) {
+  return lung ? lung->last_probs : NULL;
+}
+
+EXPORT float* lung_get_attention(AriannaLung* lung) {
+  return lung ? lung->last_attention : NULL;
+}
+
+// Argmax and top-k come from the cache filled by the last forward (O(k));
+// the scans below only run before the first forward or for k > LUNG_TOPK_CACHE
+EXPORT int lung_get_argmax(AriannaLung* lung) {
+  if (!lung || !lung->last_logits) return 0;
+  if (lung->n_top > 0) return lung->top[0].idx;
+
+  int max_idx = 0;
+  float max_val = lung->last_logits[0];
+
+  for (int i = 1; i < lung->vocab_size; i++) {
+    if (lung->last_logits[i] > max_val) {
+      max_val = lung->last_logits[i];
+      max_idx = i;
+    }
+  }
+
+  return max_idx;
+}
+
+EXPORT float lung_get_token_prob(AriannaLung* lung, int token_id) {
+  if (!lung || !lung->last_probs) return 0.0f;
+  if (token_id < 0 || token_id >= lung->vocab_size) return 0.0f;
+  return lung->last_probs[token_id];
+}
+
+// Get top-K token indices (writes to provided buffer)
+EXPORT int lung_get_top_k(AriannaLung* lung, int* out_indices, int k) {
+  if (!lung || !lung->last_logits || !out_indices || k <= 0) return 0;
+  if (k > lung->vocab_size) k = lung->vocab_size;
+
+  if (k <= lung->n_top) {
+    for (int i = 0; i < k; i++) out_indices[i] = lung->top[i].idx;
+    return k;
+  }
+
+  // Beyond the cache: one bounded-heap scan (topk.h), k entries on the heap
+  TopKEntry* scratch = (TopKEntry*)malloc((size_t)k * sizeof(TopKEntry));
+  if (!scratch) return 0;
+  topk_select(lung->last_logits, lung->vocab_size, -1, k, scratch, out_indices);
+  free(scratch);
+  return k;
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// SAMPLING — draw the next token from the cached logits
+// ═══════════════════════════════════════════════════════════════════════════════
+// Tempered weights w_i = exp((l_i - l_max) / T) are formed on the fly from
+// last_logits; no probability array is written. Filters, in order:
+//   min_p   keep l_i >= l_max + T·ln(min_p)  (the same as p_i >= min_p · p_max)
+//   top_k   the k best logits: the forward's cache for k <= LUNG_TOPK_CACHE,
+//           one bounded-heap scan beyond it
+//   top_p   the shortest best-first prefix holding top_p of the kept mass
+// 0 disables a filter (top_p >= 1 too). With neither top_k nor top_p the draw
+// is an inverse-CDF walk over the whole vocab: one pass for the mass, one to
+// find the token.
+
+// LCG step (same recurrence as _randf), top 24 bits → [0, 1)
+static float lung_rng_next(uint32_t* state) {
+  *state = *state * 1103515245u + 12345u;
+  return (float)(*state >> 8) * (1.0f / 16777216.0f);
+}
+
+// Best-first candidates c[0..n): draw within the shortest prefix whose mass
+// reaches `target` (the whole list when it never does)
+static int sample_prefix(const TopKEntry* c, int n, float lmax, float inv_t,
+                         double target, float u) {
+  double mass = 0.0;
+  int m = 0;
+  while (m < n) {
+    mass += expf((c[m].val - lmax) * inv_t);
+    m++;
+    if (mass >= target) break;
+  }
+
+  double r = u * mass, acc = 0.0;
+  for (int j = 0; j < m; j++) {
+    acc += expf((c[j].val - lmax) * inv_t);
+    if (r < acc) return c[j].idx;
+  }
+  return c[m - 1].idx;
+}
+
+// Kept prefix of best-first candidates (values at or above the min_p floor)
+// and its mass
+static int sample_kept(const TopKEntry* c, int n, float floor_l, float lmax,
+                       float inv_t, double* mass) {
+  double z = 0.0;
+  int kept = 0;
+  while (kept < n && c[kept].val >= floor_l) {
+    z += expf((c[kept].val - lmax) * inv_t);
+    kept++;
+  }
+  *mass = z;
+  return kept;
+}
+
+// k best logits, best first, into a reallocated heap buffer
+static int sample_select(const AriannaLung* lung, int k, TopKEntry** buf) {
+  TopKEntry* e = (TopKEntry*)realloc(*buf, (size_t)k * sizeof(TopKEntry));
+  if (!e) return -1;
+  *buf = e;
+  TopK h;
+  topk_init(&h, e, k);
+  for (int i = 0; i < lung->vocab_size; i++) topk_push(&h, lung->last_logits[i], i);
+  return topk_sort(&h);
+}
+
+// rng_state: caller-owned LCG state (NULL = the lung's own stream, lung_seed_rng)
+EXPORT int lung_sample(AriannaLung* lung, float temperature, int top_k,
+                       float top_p, float min_p, uint32_t* rng_state) {
+  if (!lung || !lung->last_logits) return 0;
+  uint32_t* rng = rng_state ? rng_state : &lung->rng;
+
+  int argmax = lung_get_argmax(lung);
+  if (!(temperature > LUNG_SAMPLE_MIN_TEMP) || top_k == 1) return argmax;
+
+  const float* logits = lung->last_logits;
+  int vocab = lung->vocab_size;
+  float lmax = logits[argmax];
+  float inv_t = 1.0f / temperature;
+  float floor_l = (min_p > 0.0f) ? lmax + temperature * logf(min_p) : -INFINITY;
+  if (floor_l > lmax) floor_l = lmax;
+  if (top_k < 0 || top_k >= vocab) top_k = 0;
+  int use_p = top_p > 0.0f && top_p < 1.0f;
+  float u = lung_rng_next(rng);
+
+  if (top_k == 0 && !use_p) {
+    double z = 0.0;
+    for (int i = 0; i < vocab; i++) {
+      if (logits[i] >= floor_l) z += expf((logits[i] - lmax) * inv_t);
+    }
+    double r = u * z, acc = 0.0;
+    int last = argmax;
+    for (int i = 0; i < vocab; i++) {
+      if (logits[i] < floor_l) continue;
+      acc += expf((logits[i] - lmax) * inv_t);
+      last = i;
+      if (r < acc) return i;
+    }
+    return last;
+  }
+
+  const TopKEntry* c = lung->top;
+  int n = lung->n_top;
+  TopKEntry* buf = NULL;
+  double target;
+
+  if (top_k > 0) {
+    // top_p is measured against the top-k mass (renormalized)
+    if (top_k > n) {
+      n = sample_select(lung, top_k, &buf);
+      c = buf;
+    } else {
+      n = top_k;
+    }
+    if (n < 0) return argmax;
+    double z;
+    n = sample_kept(c, n, floor_l, lmax, inv_t, &z);
+    target = use_p ? top_p * z : z;
+  } else {
+    // top_p alone: the mass of the whole kept vocab, then grow the candidate
+    // list from the cache until its kept prefix holds enough of it
+    double z = 0.0;
+    for (int i = 0; i < vocab; i++) {
+      if (logits[i] >= floor_l) z += expf((logits[i] - lmax) * inv_t);
+    }
+    target = top_p * z;
+    for (;;) {
+      double mass;
+      int kept = sample_kept(c, n, floor_l, lmax, inv_t, &mass);
+      if (n > 0 && (kept < n || n >= vocab || mass >= target)) {
+        n = kept;
+        break;
+      }
+      int k = (n < LUNG_TOPK_CACHE ? LUNG_TOPK_CACHE : n) * 4;
+      if (k > vocab) k = vocab;
+      n = sample_select(lung, k, &buf);
+      c = buf;
+      if (n < 0) {
+        free(buf);
+        return argmax;
+      }
+    }
+  }
+
+  int tok = (n > 0) ? sample_prefix(c, n, lmax, inv_t, target, u) : argmax;
+  free(buf);
+  return tok;
+}
+
+// With probability `destiny` the destined token (argmax), otherwise a draw
+static int sample_destined(AriannaLung* lung, float temperature, float destiny,
+                           int top_k, float top_p, float min_p, uint32_t* rng) {
+  if (destiny > 0.0f && lung_rng_next(rng) < destiny) return lung_get_argmax(lung);
+  return lung_sample(lung, temperature, top_k, top_p, min_p, rng);
+}
+
+// Temperature and destiny from the kernel: am->effective_temp and
+// am->destiny. A single AMK build shares the AM_State; separate WASM modules
+// call lung_sample with the temperature they read from am_copy_state.
+EXPORT int lung_sample_am(AriannaLung* lung, const AM_State* am, int top_k,
+                          float top_p, float min_p, uint32_t* rng_state) {
+  if (!lung || !lung->last_logits) return 0;
+  if (!am) return lung_sample(lung, 1.0f, top_k, top_p, min_p, rng_state);
+  uint32_t* rng = rng_state ? rng_state : &lung->rng;
+  return sample_destined(lung, am->effective_temp, am->destiny, top_k, top_p, min_p, rng);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// PROPHECY — N-step rollout on the streaming cache
+// ═══════════════════════════════════════════════════════════════════════════════
+//
+// lung_prophecy(lung, context, n_ctx, steps, temperature, destiny, wormhole,
+//               skip_max, rng_state, out_tokens, out_entropy, out_probs, out_skipped)
+//
+// The context (its last ctx_len tokens; NULL continues from the current
+// stream window) is pushed through the streaming cache once. Every step then
+// costs one cached forward and one push instead of a full forward.
+//
+// Each step takes the argmax with probability `destiny`, otherwise draws at
+// `temperature`. With probability `wormhole` spacetime skips: the next
+// 1..skip_max tokens are drawn from the same distribution and pushed with no
+// forward in between (out_skipped[s] = 1 for those steps).
+//
+// Per step: the token, the entropy of the distribution it was drawn from and
+// the model's (temperature 1) probability of it. out_entropy, out_probs and
+// out_skipped may be NULL. Presence and the stream window are restored
+// afterwards — a prophecy is not lived — so a live session continues from its
+// own window; only last_logits / last_probs / last_attention keep the final
+// forward of the rollout.
+// Returns the number of steps written, -1 on failure.
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// AMK PROPHECY horizon ceiling (lung_prophecy_am)
+#define LUNG_PROPHECY_MAX 64
+
+EXPORT int lung_prophecy(AriannaLung* lung, const int* context, int n_ctx, int steps,
+                         float temperature, float destiny, float wormhole, int skip_max,
+                         uint32_t* rng_state, int* out_tokens, float* out_entropy,
+                         float* out_probs, int* out_skipped) {
+  if (!lung || !out_tokens || steps <= 0) return -1;
+  if (!lung->stream_ready && !stream_build(lung)) return -1;
+  uint32_t* rng = rng_state ? rng_state : &lung->rng;
+
+  StreamSnapshot window;
+  if (!stream_save(lung, &window)) return -1;
+  PresenceSnapshot presence;
+  if (!presence_save(lung, &presence)) {
+    stream_restore(lung, &window);
+    return -1;
+  }
+
+  if (context) {
+    lung->stream_len = 0;
+    lung->stream_start = 0;
+    for (int t = (n_ctx > lung->ctx_len) ? n_ctx - lung->ctx_len : 0; t < n_ctx; t++) {
+      lung_push_token(lung, context[t]);
+    }
+  }
+
+  float entropy = 0.0f;
+  int skip = 0;
+  for (int s = 0; s < steps; s++) {
+    int skipped = skip > 0;
+    if (skipped) {
+      skip--;
+    } else {
+      entropy = lung_forward_cached(lung);
+      if (wormhole > 0.0f && skip_max > 0 && s + 1 < steps && lung_rng_next(rng) < wormhole) {
+        skip = 1 + (int)(lung_rng_next(rng) * (float)skip_max);
+        if (skip > skip_max) skip = skip_max;
+      }
     }
+
+    int tok = sample_destined(lung, temperature, destiny, 0, 1.0f, 0.0f, rng);
+    out_tokens[s] = tok;
+    if (out_entropy) out_entropy[s] = entropy;
+    if (out_probs) out_probs[s] = lung->last_probs[tok];
+    if (out_skipped) out_skipped[s] = skipped;
+    lung_push_token(lung, tok);
   }
 
-  return entropy;
+  presence_restore(lung, &presence);
+  stream_restore(lung, &window);
+  return steps;
+}
+
+// Horizon, temperature, destiny, wormhole and skip length from the kernel
+// (am->prophecy clamped to LUNG_PROPHECY_MAX; outputs hold that many steps)
+EXPORT int lung_prophecy_am(AriannaLung* lung, const AM_State* am, const int* context,
+                            int n_ctx, uint32_t* rng_state, int* out_tokens,
+                            float* out_entropy, float* out_probs, int* out_skipped) {
+  if (!am) return -1;
+  int steps = am->prophecy < 1 ? 1 : (am->prophecy > LUNG_PROPHECY_MAX ? LUNG_PROPHECY_MAX : am->prophecy);
+  return lung_prophecy(lung, context, n_ctx, steps, am->effective_temp, am->destiny,
+                       am->wormhole, am->tunnel_skip_max, rng_state,
+                       out_tokens, out_entropy, out_probs, out_skipped);
 }
 
 // ═══════════════════════════════════════════════════════════════════════════════
-// GETTERS — expose inference state to JS
+// PROPHECY TREE — beam search over shared-prefix branches
+// ═══════════════════════════════════════════════════════════════════════════════
+//
+// lung_beam_search(lung, context, n_ctx, beam, steps, out_tokens, out_scores)
+//
+// Keeps the `beam` best futures by cumulative log-probability. Branches live
+// in a token tree: each node holds its token's cached q/k/v rows (projected
+// once, when the node is created) and a parent link, so every branch reads
+// its window through the nodes it shares with its siblings — copy-on-write
+// at token granularity, nothing is copied when a branch forks. A step costs
+// one cached attention per branch plus a single pass over WoT for all of
+// them (kern_mat_mat), instead of one full forward per branch.
+//
+// Windows follow the stream: the last ctx_len tokens of context + branch.
+// Branches are hypothetical, like the batch path: presence is read, never
+// accumulated, and no last_* state is touched.
+//
+// Outputs, best first: out_tokens beam × steps, out_scores beam (Σ log p).
+// beam is capped at LUNG_BEAM_MAX. Returns the number of futures (fewer than
+// beam only when the vocab is smaller), -1 on failure.
 // ═══════════════════════════════════════════════════════════════════════════════
 
-EXPORT float* lung_get_logits(AriannaLung* lung) {
-  return lung ? lung->last_logits : NULL;
-}
+#define LUNG_BEAM_MAX LUNG_BATCH_TILE
 
-EXPORT float* lung_get_probs(AriannaLung* lung) {
-  return lung ? lung->last_probs : NULL;
-}
+typedef struct {
+  int* tok;                 // token per node
+  int* parent;              // parent node, -1 at the root
+  float* q;                 // cap × d_model: Wq · E[tok]
+  float* k;                 // cap × kv_dim: Wk · E[tok]
+  float* v;                 // cap × kv_dim: Wv · E[tok]
+  int n;
+} BeamNodes;
 
-EXPORT float* lung_get_attention(AriannaLung* lung) {
-  return lung ? lung->last_attention : NULL;
+static int beam_node(AriannaLung* lung, BeamNodes* nodes, int parent, int token_id) {
+  size_t d = lung->d_model, kvd = lung->kv_dim;
+  int i = nodes->n++;
+  nodes->tok[i] = token_id;
+  nodes->parent[i] = parent;
+  embed_token(lung, clamp_token(lung, token_id), lung->xbar);
+  project_qkv(lung, lung->xbar, nodes->q + i * d, nodes->k + i * kvd, nodes->v + i * kvd);
+  return i;
 }
 
-EXPORT int lung_get_argmax(AriannaLung* lung) {
-  if (!lung || !lung->last_logits) return 0;
+// Window ending at `node`: node indices and tokens, oldest first; returns len
+static int beam_window(const AriannaLung* lung, const BeamNodes* nodes, int node,
+                       int* slot, int* tokens) {
+  int ctx = lung->ctx_len;
+  int len = 0;
+  for (int i = node; i >= 0 && len < ctx; i = nodes->parent[i]) len++;
+  for (int t = len - 1, i = node; t >= 0; t--, i = nodes->parent[i]) {
+    slot[t] = i;
+    tokens[t] = nodes->tok[i];
+  }
+  return len;
+}
 
-  int max_idx = 0;
-  float max_val = lung->last_logits[0];
+EXPORT int lung_beam_search(AriannaLung* lung, const int* context, int n_ctx, int beam,
+                            int steps, int* out_tokens, float* out_scores) {
+  if (!lung || !out_tokens || beam <= 0 || steps <= 0 || n_ctx < 0) return -1;
+  if (!lung->stream_ready && !stream_build(lung)) return -1;
+  if (!batch_alloc(lung)) return -1;
+  if (beam > LUNG_BEAM_MAX) beam = LUNG_BEAM_MAX;
 
-  for (int i = 1; i < lung->vocab_size; i++) {
-    if (lung->last_logits[i] > max_val) {
-      max_val = lung->last_logits[i];
-      max_idx = i;
-    }
-  }
+  int ctx = lung->ctx_len;
+  int d = lung->d_model;
+  int vocab = lung->vocab_size;
+  int first = (context && n_ctx > ctx) ? n_ctx - ctx : 0;
+  if (!context) n_ctx = 0;
+  int cap = (n_ctx - first) + steps * beam;
 
-  return max_idx;
-}
+  BeamNodes nodes = { 0 };
+  nodes.tok = (int*)malloc((size_t)cap * sizeof(int));
+  nodes.parent = (int*)malloc((size_t)cap * sizeof(int));
+  nodes.q = (float*)malloc((size_t)cap * d * sizeof(float));
+  nodes.k = (float*)malloc((size_t)cap * lung->kv_dim * sizeof(float));
+  nodes.v = (float*)malloc((size_t)cap * lung->kv_dim * sizeof(float));
+  int* slot = (int*)malloc((size_t)ctx * 2 * sizeof(int));
+  int* cand_tok = (int*)malloc((size_t)beam * beam * sizeof(int));
+  TopKEntry* scratch = (TopKEntry*)malloc((size_t)beam * 2 * sizeof(TopKEntry));
+  int* cand_idx = (int*)malloc((size_t)beam * sizeof(int));
+  int ok = nodes.tok && nodes.parent && nodes.q && nodes.k && nodes.v &&
+           slot && cand_tok && scratch && cand_idx;
 
-EXPORT float lung_get_token_prob(AriannaLung* lung, int token_id) {
-  if (!lung || !lung->last_probs) return 0.0f;
-  if (token_id < 0 || token_id >= lung->vocab_size) return 0.0f;
-  return lung->last_probs[token_id];
-}
+  int n_live = 0;
+  int live[LUNG_BEAM_MAX], next[LUNG_BEAM_MAX];
+  float score[LUNG_BEAM_MAX], next_score[LUNG_BEAM_MAX];
 
-// Get top-K token indices (writes to provided buffer)
-EXPORT int lung_get_top_k(AriannaLung* lung, int* out_indices, int k) {
-  if (!lung || !lung->last_logits || !out_indices || k <= 0) return 0;
-  if (k > lung->vocab_size) k = lung->vocab_size;
+  if (ok) {
+    // Shared trunk: the context, projected once for every branch
+    int root = -1;
+    for (int t = first; t < n_ctx; t++) root = beam_node(lung, &nodes, root, context[t]);
+    live[0] = root;
+    score[0] = 0.0f;
+    n_live = 1;
+  }
 
-  // Simple O(k*n) selection (fine for small k)
-  float* used = (float*)alloca(lung->vocab_size * sizeof(float));
-  memcpy(used, lung->last_logits, lung->vocab_size * sizeof(float));
+  int* tokens = slot + ctx;
+  for (int s = 0; s < steps && ok; s++) {
+    for (int b = 0; b < n_live; b++) {
+      int len = beam_window(lung, &nodes, live[b], slot, tokens);
+      cached_attention(lung, nodes.q, nodes.k, nodes.v, slot, tokens, len,
+                       lung->batch_y + (size_t)b * d, NULL);
+    }
 
-  for (int i = 0; i < k; i++) {
-    int max_idx = 0;
-    float max_val = -1e30f;
+    // Every branch's logits from one pass over WoT
+    if (lung->quant_bits) {
+      quant_mat_mat(lung->batch_logits, &lung->qWoT, 0, vocab, lung->batch_y, n_live);
+    } else {
+      kern_mat_mat(lung->batch_logits, lung->WoT, d, lung->batch_y, n_live, vocab, d);
+    }
 
-    for (int j = 0; j < lung->vocab_size; j++) {
-      if (used[j] > max_val) {
-        max_val = used[j];
-        max_idx = j;
+    // Each branch proposes its `beam` best continuations; the best `beam`
+    // of all proposals survive (ties: earlier branch, then better token)
+    TopK h;
+    topk_init(&h, scratch, beam);
+    for (int b = 0; b < n_live; b++) {
+      float* logits = lung->batch_logits + (size_t)b * vocab;
+      float* probs = lung->batch_probs;
+      logits_to_probs(lung, NULL, logits, probs, 0);
+      TopK hb;
+      topk_init(&hb, scratch + beam, beam);
+      for (int i = 0; i < vocab; i++) topk_push(&hb, logits[i], i);
+      int found = topk_sort(&hb);
+      for (int j = 0; j < found; j++) {
+        int tok = hb.e[j].idx;
+        cand_tok[b * beam + j] = tok;
+        topk_push(&h, score[b] + logf(probs[tok]), b * beam + j);
       }
     }
+    int n_next = topk_sort(&h);
+    for (int j = 0; j < n_next; j++) cand_idx[j] = h.e[j].idx;
+    for (int j = 0; j < n_next; j++) {
+      int b = cand_idx[j] / beam;
+      next_score[j] = h.e[j].val;
+      next[j] = beam_node(lung, &nodes, live[b], cand_tok[cand_idx[j]]);
+    }
+    n_live = n_next;
+    memcpy(live, next, n_live * sizeof(int));
+    memcpy(score, next_score, n_live * sizeof(float));
+  }
 
-    out_indices[i] = max_idx;
-    used[max_idx] = -1e30f;  // mark as used
+  if (ok) {
+    for (int b = 0; b < n_live; b++) {
+      int i = live[b];
+      for (int t = steps - 1; t >= 0; t--, i = nodes.parent[i]) {
+        out_tokens[(size_t)b * steps + t] = nodes.tok[i];
+      }
+      if (out_scores) out_scores[b] = score[b];
+    }
   }
 
-  return k;
+  free(nodes.tok);
+  free(nodes.parent);
+  free(nodes.q);
+  free(nodes.k);
+  free(nodes.v);
+  free(slot);
+  free(cand_tok);
+  free(scratch);
+  free(cand_idx);
+  return ok ? n_live : -1;
 }
 
 // ═══════════════════════════════════════════════════════════════════════════════
@@ -616,6 +3288,79 @@ EXPORT void lung_set_rtl(AriannaLung* lung, int use_rtl) {
   }
 }
 
+// 1 = folded attention (default), 0 = per-position K/V reference path
+EXPORT void lung_set_folded_attention(AriannaLung* lung, int on) {
+  if (lung) {
+    lung->fold_attention = on ? 1 : 0;
+  }
+}
+
+// 1 = length-aware attention: every forward path (full, cached, batch, beam)
+// attends only to real positions and queries from the newest token;
+// 0 = attend to the padded window (default)
+EXPORT void lung_set_mask_padding(AriannaLung* lung, int on) {
+  if (lung) {
+    lung->mask_padding = on ? 1 : 0;
+  }
+}
+
+// Sparse attention for long contexts: each query attends to the `window`
+// positions ending at itself plus `n_anchors` global positions before the
+// window, the first primes (2, 3, 5, 7, ... as in CHORDLOCK). window <= 0
+// (or >= ctx_len) is dense attention, the default. Applies to every
+// forward path; combine with lung_set_mask_padding so a short context's
+// window covers its own tokens rather than the padding. Returns the number
+// of anchors in effect (primes below ctx_len).
+EXPORT int lung_set_sparse_attention(AriannaLung* lung, int window, int n_anchors) {
+  if (!lung) return 0;
+  lung->attn_window = (window > 0) ? window : 0;
+  lung->n_anchors = 0;
+  for (int p = 2; p < lung->ctx_len && lung->n_anchors < n_anchors; p++) {
+    int prime = 1;
+    for (int f = 2; f * f <= p && prime; f++) prime = (p % f) != 0;
+    if (prime) lung->anchors[lung->n_anchors++] = p;
+  }
+  return lung->n_anchors;
+}
+
+// lung_create with sparse attention from the start (lung_set_sparse_attention)
+EXPORT AriannaLung* lung_create_sparse(int vocab_size, int d_model, int ctx_len, int n_heads,
+                                       int window, int n_anchors) {
+  AriannaLung* lung = lung_create(vocab_size, d_model, ctx_len, n_heads);
+  if (lung) lung_set_sparse_attention(lung, window, n_anchors);
+  return lung;
+}
+
+// Candidate-shortlist logits (see SHORTLIST): each forward and cached
+// forward scores the tokens of the n_probe best of about sqrt(vocab)
+// output-row clusters, the presence-active and the highest-resonance
+// tokens; lung_get_tail_mass reports the estimated mass left outside.
+// Batch and beam search keep the full vocab. n_probe <= 0 restores the
+// full vocab (the default). Returns the cluster count (0 = full vocab).
+EXPORT int lung_set_shortlist(AriannaLung* lung, int n_probe) {
+  if (!lung) return 0;
+  lung->shortlist_probe = 0;
+  if (n_probe <= 0) return 0;
+  if (!lung->shortlist) lung->shortlist = shortlist_alloc(lung->vocab_size, lung->d_model);
+  if (!shortlist_ready(lung)) return 0;  // fit now rather than on the next forward
+  lung->shortlist_probe = n_probe;
+  return lung->shortlist->n_clusters;
+}
+
+// Tokens scored by the last forward (0 after a full-vocab forward)
+EXPORT int lung_get_shortlist(AriannaLung* lung, int* out_ids, int max) {
+  if (!lung || !lung->shortlist || !lung->shortlist->clean) return 0;
+  const Shortlist* sl = lung->shortlist;
+  int n = sl->n_cand < max ? sl->n_cand : max;
+  if (out_ids && n > 0) memcpy(out_ids, sl->cand, n * sizeof(int));
+  return sl->n_cand;
+}
+
+// Estimated probability of the tokens the last forward did not score
+EXPORT float lung_get_tail_mass(AriannaLung* lung) {
+  return lung ? lung->tail_mass : 0.0f;
+}
+
 // ═══════════════════════════════════════════════════════════════════════════════
 // NOTORCH — resonance learning
 // ═══════════════════════════════════════════════════════════════════════════════
@@ -624,12 +3369,14 @@ EXPORT void lung_boost_resonance(AriannaLung* lung, int token_id, float amount)
   if (!lung || token_id < 0 || token_id >= lung->vocab_size) return;
   float new_val = lung->resonance[token_id] + amount;
   lung->resonance[token_id] = (new_val > 1.0f) ? 1.0f : ((new_val < 0.0f) ? 0.0f : new_val);
+  if (lung->shortlist) lung->shortlist->resonance_stale = 1;
 }
 
 EXPORT void lung_decay_resonance(AriannaLung* lung, int token_id, float amount) {
   if (!lung || token_id < 0 || token_id >= lung->vocab_size) return;
   float new_val = lung->resonance[token_id] - amount;
   lung->resonance[token_id] = (new_val < 0.0f) ? 0.0f : new_val;
+  if (lung->shortlist) lung->shortlist->resonance_stale = 1;
 }
 
 EXPORT float lung_get_resonance(AriannaLung* lung, int token_id) {
@@ -637,16 +3384,295 @@ EXPORT float lung_get_resonance(AriannaLung* lung, int token_id) {
   return lung->resonance[token_id];
 }
 
+// Presence is stored lazily (see PRESENCE): reads apply the pending decay
+EXPORT float lung_get_presence(AriannaLung* lung, int token_id) {
+  if (!lung || token_id < 0 || token_id >= lung->vocab_size) return 0.0f;
+  return presence_at(lung, token_id);
+}
+
+// Every token's current presence into out (vocab_size floats)
+EXPORT int lung_copy_presence(AriannaLung* lung, float* out) {
+  if (!lung || !out) return 0;
+  memset(out, 0, (size_t)lung->vocab_size * sizeof(float));
+  for (int a = 0; a < lung->n_active; a++) {
+    int i = lung->presence_active[a];
+    out[i] = presence_at(lung, i);
+  }
+  return lung->vocab_size;
+}
+
+// Replace every token's presence (NULL clears it)
+EXPORT void lung_load_presence(AriannaLung* lung, const float* presence) {
+  if (lung) presence_assign(lung, presence);
+}
+
 // ═══════════════════════════════════════════════════════════════════════════════
 // WEIGHT ACCESS — for LoRA deltas and initialization from JS
 // ═══════════════════════════════════════════════════════════════════════════════
 
+// Raw pointers are writable, so a session on shared weights takes its own
+// copy first (see SHARED WEIGHTS)
 EXPORT float* lung_get_embeddings(AriannaLung* lung) {
-  return lung ? lung->E : NULL;
+  return lung && lung_own_weights(lung) ? lung->E : NULL;
 }
 
+// Wo layout (d_model × vocab_size). After writing through this pointer,
+// call lung_sync_output_weights so the packed copy used by forward follows.
 EXPORT float* lung_get_output_weights(AriannaLung* lung) {
-  return lung ? lung->Wo : NULL;
+  return lung && lung_own_weights(lung) ? lung->Wo : NULL;
+}
+
+EXPORT void lung_sync_output_weights(AriannaLung* lung) {
+  if (lung && lung->Wo && lung_own_weights(lung)) pack_output_weights(lung);
+}
+
+// Copy weights in from the original layouts (E: vocab_size × d_model,
+// Wo: d_model × vocab_size); works for every storage, compressed lungs
+// re-encode each row. Returns 1 on success.
+EXPORT int lung_load_embeddings(AriannaLung* lung, const float* E) {
+  if (!lung || !E || !lung_own_weights(lung)) return 0;
+  int d = lung->d_model;
+  if (lung->quant_bits) {
+    for (int i = 0; i < lung->vocab_size; i++) {
+      quant_encode_row(&lung->qE, i, E + (size_t)i * d);
+    }
+  } else {
+    memcpy(lung->E, E, (size_t)lung->vocab_size * d * sizeof(float));
+  }
+  if (lung->stream_ready) stream_build(lung);  // cached projections follow
+  return 1;
+}
+
+EXPORT int lung_load_output_weights(AriannaLung* lung, const float* Wo) {
+  if (!lung || !Wo || !lung_own_weights(lung)) return 0;
+  int d = lung->d_model;
+  int vocab = lung->vocab_size;
+  if (!lung->quant_bits) {
+    memcpy(lung->Wo, Wo, (size_t)d * vocab * sizeof(float));
+    pack_output_weights(lung);
+    return 1;
+  }
+  float* row = (float*)malloc(d * sizeof(float));
+  if (!row) return 0;
+  for (int j = 0; j < vocab; j++) {
+    for (int i = 0; i < d; i++) row[i] = Wo[(size_t)i * vocab + j];
+    quant_encode_row(&lung->qWoT, j, row);
+  }
+  free(row);
+  if (lung->shortlist) lung->shortlist->stale = 1;
+  return 1;
+}
+
+// Compressed Wo: per vocab row j, WoT[j] += scaling · A @ B[:, j]
+static void merge_output_lora_compressed(AriannaLung* lung, const float* A, const float* B,
+                                         int rank, float scaling) {
+  int d = lung->d_model;
+  int vocab = lung->vocab_size;
+  float* row = (float*)malloc((d + rank) * sizeof(float));
+  if (!row) return;
+  float* bj = row + d;
+
+  for (int j = 0; j < vocab; j++) {
+    for (int r = 0; r < rank; r++) bj[r] = scaling * B[(size_t)r * vocab + j];
+    quant_row(&lung->qWoT, j, row);
+    for (int i = 0; i < d; i++) row[i] += dot(A + (size_t)i * rank, bj, rank);
+    quant_encode_row(&lung->qWoT, j, row);
+  }
+  free(row);
+  if (lung->shortlist) lung->shortlist->stale = 1;
+}
+
+// Merge a low-rank delta into Wo: Wo += scaling · A @ B
+// A: d_model × rank, B: rank × vocab_size (lora.c layout, in=d, out=vocab)
+EXPORT void lung_merge_output_lora(AriannaLung* lung, const float* A, const float* B,
+                                   int rank, float scaling) {
+  if (!lung || !A || !B || rank <= 0 || !lung_own_weights(lung)) return;
+  if (lung->quant_bits) {
+    merge_output_lora_compressed(lung, A, B, rank, scaling);
+    return;
+  }
+  int d = lung->d_model;
+  int vocab = lung->vocab_size;
+
+  for (int i = 0; i < d; i++) {
+    float* row = lung->Wo + (size_t)i * vocab;
+    for (int r = 0; r < rank; r++) {
+      axpy(row, B + (size_t)r * vocab, scaling * A[(size_t)i * rank + r], vocab);
+    }
+  }
+
+  pack_output_weights(lung);
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// QKV weights — always exchanged in the original layout (n_heads × head_dim
+// × d_model for Wq, n_kv_heads × head_dim × d_model for Wk and Wv),
+// whatever the lung stores internally
+// which: 0 = Wq, 1 = Wk, 2 = Wv
+// ─────────────────────────────────────────────────────────────────────────────
+
+// Copy row (h, r) of matrix m between the original layout and the active one
+// (compressed lungs decode on the way out and re-encode on the way in)
+static void qkv_copy(AriannaLung* lung, int m, float* orig, int to_orig) {
+  int d = lung->d_model;
+  int rows = qkv_rows(lung, m);
+  for (int i = 0; i < rows; i++) {
+    if (lung->quant_bits) {
+      if (to_orig) quant_row(&lung->qW[m], i, orig + (size_t)i * d);
+      else quant_encode_row(&lung->qW[m], i, orig + (size_t)i * d);
+      continue;
+    }
+    int h = i / lung->head_dim, r = i % lung->head_dim;
+    int stride;
+    float* row = (float*)qkv_head(lung, m, h, &stride) + (size_t)r * stride;
+    if (to_orig) memcpy(orig + (size_t)i * d, row, d * sizeof(float));
+    else memcpy(row, orig + (size_t)i * d, d * sizeof(float));
+  }
+}
+
+EXPORT int lung_copy_qkv_weights(AriannaLung* lung, int which, float* out) {
+  if (!lung || !out || which < QKV_Q || which > QKV_V) return 0;
+  qkv_copy(lung, which, out, 1);
+  return 1;
+}
+
+EXPORT int lung_load_qkv_weights(AriannaLung* lung, int which, const float* in) {
+  if (!lung || !in || which < QKV_Q || which > QKV_V || !lung_own_weights(lung)) return 0;
+  qkv_copy(lung, which, (float*)in, 0);
+  if (lung->stream_ready) stream_build(lung);  // cached projections follow
+  return 1;
+}
+
+// Switch between separate Wq/Wk/Wv blocks and the packed per-head tiles.
+// Only one layout is held at a time. Returns 1 on success.
+EXPORT int lung_set_packed_qkv(AriannaLung* lung, int on) {
+  if (!lung) return 0;
+  on = on ? 1 : 0;
+  if (on == lung->packed_qkv) return 1;
+  if (lung->quant_bits) return 0;  // compressed rows are never packed
+  if (lung->n_kv_heads != lung->n_heads) return 0;  // tiles need one k, v row per q row
+  if (!lung_own_weights(lung)) return 0;
+
+  int d = lung->d_model;
+  size_t rows = (size_t)lung->n_heads * lung->head_dim;
+
+  if (on) {
+    int stride = (d + 15) & ~15;  // 16 floats = 64 bytes
+    float* W = calloc_aligned(rows * 3 * stride);
+    if (!W) return 0;
+    float* src[3] = { lung->Wq, lung->Wk, lung->Wv };
+    for (size_t i = 0; i < rows; i++) {
+      for (int m = 0; m < 3; m++) {
+        memcpy(W + (i * 3 + m) * stride, src[m] + i * d, d * sizeof(float));
+      }
+    }
+    weight_free(lung, lung->Wq); weight_free(lung, lung->Wk); weight_free(lung, lung->Wv);
+    lung->Wq = lung->Wk = lung->Wv = NULL;
+    lung->Wqkv = W;
+    lung->qkv_stride = stride;
+    lung->packed_qkv = 1;
+  } else {
+    float* dst[3];
+    for (int m = 0; m < 3; m++) dst[m] = (float*)malloc(rows * d * sizeof(float));
+    if (!dst[0] || !dst[1] || !dst[2]) {
+      free(dst[0]); free(dst[1]); free(dst[2]);
+      return 0;
+    }
+    for (int m = 0; m < 3; m++) qkv_copy(lung, m, dst[m], 1);
+    free_aligned(lung->Wqkv);
+    lung->Wqkv = NULL;
+    lung->Wq = dst[0]; lung->Wk = dst[1]; lung->Wv = dst[2];
+    lung->packed_qkv = 0;
+  }
+  return 1;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Compressed storage — convert a float lung in place (one-way)
+// Float E, Wo, WoT and Q/K/V are freed; forward, streaming and batch paths
+// widen rows on the fly. Raw weight pointers (lung_get_embeddings,
+// lung_get_output_weights) return NULL from then on; lung_load_* and the
+// merges still work and re-encode the rows they touch.
+// ─────────────────────────────────────────────────────────────────────────────
+static int lung_compress(AriannaLung* lung, int bits, int bf16) {
+  if (!lung_own_weights(lung) || !lung_set_packed_qkv(lung, 0)) return 0;
+
+  int d = lung->d_model;
+  int vocab = lung->vocab_size;
+  const float* W[3] = { lung->Wq, lung->Wk, lung->Wv };
+
+  int ok = quant_build(&lung->qE, lung->E, vocab, d, bits, bf16) &&
+           quant_build(&lung->qWoT, lung->WoT, vocab, d, bits, bf16);
+  for (int m = 0; m < 3 && ok; m++) {
+    ok = quant_build(&lung->qW[m], W[m], qkv_rows(lung, m), d, bits, bf16);
+  }
+  if (!ok) {
+    quant_free(&lung->qE);
+    quant_free(&lung->qWoT);
+    for (int m = 0; m < 3; m++) quant_free(&lung->qW[m]);
+    return 0;
+  }
+
+  weight_free(lung, lung->E);   lung->E = NULL;
+  weight_free(lung, lung->Wo);  lung->Wo = NULL;
+  weight_free(lung, lung->WoT); lung->WoT = NULL;
+  weight_free(lung, lung->Wq);  lung->Wq = NULL;
+  weight_free(lung, lung->Wk);  lung->Wk = NULL;
+  weight_free(lung, lung->Wv);  lung->Wv = NULL;
+  lung->quant_bits = bits;
+  if (lung->shortlist) lung->shortlist->stale = 1;
+
+  if (lung->stream_ready) stream_build(lung);  // cached projections follow
+  return 1;
+}
+
+// bits: 8 (per-row scales) or 4 (per-LUNG_Q4_GROUP scales); float lungs only.
+// Apply weight edits first: each re-encode of an integer row adds rounding.
+// Returns 1 on success.
+EXPORT int lung_quantize(AriannaLung* lung, int bits) {
+  if (!lung || lung->quant_bits || (bits != 8 && bits != 4)) return 0;
+  return lung_compress(lung, bits, 0);
+}
+
+// lung_create with a storage precision: LUNG_FP32, LUNG_FP16 or LUNG_BF16.
+// Half precision halves the resident weights (and drops the second float
+// copy of the output projection); accumulation and softmax stay in float.
+EXPORT AriannaLung* lung_create_ex(int vocab_size, int d_model, int ctx_len, int n_heads,
+                                   int precision) {
+  if (precision < LUNG_FP32 || precision > LUNG_BF16) return NULL;
+  AriannaLung* lung = lung_create(vocab_size, d_model, ctx_len, n_heads);
+  if (!lung || precision == LUNG_FP32) return lung;
+  if (!lung_compress(lung, 16, precision == LUNG_BF16)) {
+    lung_destroy(lung);
+    return NULL;
+  }
+  return lung;
+}
+
+// LUNG_FP32 / LUNG_FP16 / LUNG_BF16 (integer-quantized lungs report LUNG_FP32;
+// see lung_get_quant_bits)
+EXPORT int lung_get_precision(AriannaLung* lung) {
+  if (!lung || lung->quant_bits != 16) return LUNG_FP32;
+  return lung->qE.bf16 ? LUNG_BF16 : LUNG_FP16;
+}
+
+EXPORT int lung_get_quant_bits(AriannaLung* lung) {
+  return lung ? lung->quant_bits : 0;
+}
+
+// Bytes held by E, output projection and Q/K/V in the current storage
+EXPORT size_t lung_weight_bytes(AriannaLung* lung) {
+  if (!lung) return 0;
+  size_t d = lung->d_model, vocab = lung->vocab_size;
+  size_t qkv = (size_t)(lung->n_heads * lung->head_dim + 2 * lung->kv_dim) * d;
+
+  if (lung->quant_bits) {
+    size_t n = quant_bytes(&lung->qE) + quant_bytes(&lung->qWoT);
+    for (int m = 0; m < 3; m++) n += quant_bytes(&lung->qW[m]);
+    return n;
+  }
+  size_t qkv_floats = lung->packed_qkv ? qkv / d * lung->qkv_stride : qkv;
+  return (vocab * d * 3 + qkv_floats) * sizeof(float);  // E, Wo, WoT
 }
 
 EXPORT int lung_get_vocab_size(AriannaLung* lung) {
@@ -661,14 +3687,439 @@ EXPORT int lung_get_ctx_len(AriannaLung* lung) {
   return lung ? lung->ctx_len : 0;
 }
 
+EXPORT int lung_get_n_heads(AriannaLung* lung) {
+  return lung ? lung->n_heads : 0;
+}
+
+EXPORT int lung_get_n_kv_heads(AriannaLung* lung) {
+  return lung ? lung->n_kv_heads : 0;
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// CHECKPOINT — versioned binary format, mapped without parsing
+// ═══════════════════════════════════════════════════════════════════════════════
+//
+//   header    LungCkptHeader: magic, version, byte order, dims (with the
+//             key/value head count), storage
+//   table     n_sections × LungCkptSection: id, CRC-32, offset, bytes
+//   sections  each starts on a LUNG_ALIGN boundary, zero padded between
+//
+// Sections hold the in-memory layouts, so opening a checkpoint only points
+// the lung at them:
+//   float32     E, Wo, WoT, Wq, Wk, Wv (Q/K/V always in the separate layout)
+//   compressed  E, WoT, Wq, Wk, Wv rows (+ LUNG_SEC_SCALE | id for int8/int4)
+//   always      resonance (copied on open: it is learned state)
+//
+// lung_open_mmap maps the file private copy-on-write: every process opening
+// the same checkpoint shares its page-cache pages, and a lung that edits its
+// weights (merges, loads) gets private copies of just the touched pages.
+// The header and table carry a CRC-32 that is always checked; section CRCs
+// cost a full read, so they are checked only by lung_verify_checkpoint.
+// ═══════════════════════════════════════════════════════════════════════════════
+
+#define LUNG_CKPT_MAGIC         "ARLUNG\r\n"
+#define LUNG_CKPT_VERSION       1
+#define LUNG_CKPT_BYTE_ORDER    0x01020304u
+#define LUNG_CKPT_MAX_SECTIONS  16
+
+#define LUNG_SEC_E              1
+#define LUNG_SEC_WO             2
+#define LUNG_SEC_WOT            3
+#define LUNG_SEC_WQ             4   // + QKV_Q / QKV_K / QKV_V
+#define LUNG_SEC_RESONANCE      7
+#define LUNG_SEC_SCALE          0x100
+
+typedef struct {
+  char magic[8];            // LUNG_CKPT_MAGIC
+  uint32_t version;         // LUNG_CKPT_VERSION
+  uint32_t byte_order;      // LUNG_CKPT_BYTE_ORDER as written by the saver
+  uint32_t header_bytes;    // header + section table
+  uint32_t alignment;       // section alignment (LUNG_ALIGN)
+  uint32_t vocab_size, d_model, ctx_len, n_heads;
+  uint32_t bits;            // 32, 16, 8 or 4
+  uint32_t bf16;            // bits == 16: 1 = bfloat16
+  uint32_t q4_group;        // LUNG_Q4_GROUP of the saver
+  uint32_t n_sections;
+  uint64_t file_bytes;
+  uint32_t n_kv_heads;      // key/value heads; 0 (files from before GQA) = n_heads
+  uint32_t reserved[5];     // zero
+  uint32_t header_crc;      // CRC-32 of header + table with this field zero
+  uint32_t pad;
+} LungCkptHeader;
+
+typedef struct {
+  uint32_t id;              // LUNG_SEC_*
+  uint32_t crc;             // CRC-32 of the section bytes
+  uint64_t offset;          // from the start of the file
+  uint64_t bytes;
+} LungCkptSection;
+
+typedef struct {
+  LungCkptHeader h;
+  LungCkptSection sec[LUNG_CKPT_MAX_SECTIONS];
+} LungCkptTable;
+
+// CRC-32 (IEEE, as zlib); the table is rebuilt per call, no shared state
+static void crc32_init(uint32_t* table) {
+  for (uint32_t i = 0; i < 256; i++) {
+    uint32_t c = i;
+    for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+    table[i] = c;
+  }
+}
+
+static uint32_t crc32_update(const uint32_t* table, uint32_t crc, const void* data, size_t n) {
+  const uint8_t* p = (const uint8_t*)data;
+  crc = ~crc;
+  for (size_t i = 0; i < n; i++) crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+  return ~crc;
+}
+
+static uint32_t ckpt_header_crc(const uint32_t* table, const LungCkptTable* t) {
+  LungCkptHeader h = t->h;
+  h.header_crc = 0;
+  uint32_t crc = crc32_update(table, 0, &h, sizeof(h));
+  return crc32_update(table, crc, t->sec, (size_t)t->h.n_sections * sizeof(LungCkptSection));
+}
+
+static uint64_t ckpt_align(uint64_t n) {
+  return (n + LUNG_ALIGN - 1) & ~(uint64_t)(LUNG_ALIGN - 1);
+}
+
+static uint32_t ckpt_kv_heads(const LungCkptHeader* h) {
+  return h->n_kv_heads ? h->n_kv_heads : h->n_heads;
+}
+
+// Expected byte size of section id for the header's dims and storage (0 = unknown id)
+static uint64_t ckpt_section_bytes(const LungCkptHeader* h, uint32_t id) {
+  uint64_t d = h->d_model, vocab = h->vocab_size;
+  uint64_t head_dim = h->d_model / h->n_heads;
+  uint64_t qd = (uint64_t)h->n_heads * head_dim;
+  uint64_t kvd = (uint64_t)ckpt_kv_heads(h) * head_dim;
+  uint64_t rows;
+  if (id == LUNG_SEC_RESONANCE) return vocab * sizeof(float);
+
+  int scale = (id & LUNG_SEC_SCALE) != 0;
+  id &= ~(uint32_t)LUNG_SEC_SCALE;
+  if (id == LUNG_SEC_E || id == LUNG_SEC_WOT || id == LUNG_SEC_WO) rows = vocab;
+  else if (id == LUNG_SEC_WQ + QKV_Q) rows = qd;
+  else if (id == LUNG_SEC_WQ + QKV_K || id == LUNG_SEC_WQ + QKV_V) rows = kvd;
+  else return 0;
+
+  if (h->bits == 32) return scale ? 0 : rows * d * sizeof(float);
+  if (id == LUNG_SEC_WO) return 0;  // compressed lungs keep only WoT
+
+  QuantMatrix m;
+  quant_shape(&m, (int)rows, (int)d, (int)h->bits, (int)h->bf16);
+  if (scale) return (uint64_t)rows * m.groups * sizeof(float);
+  return (uint64_t)rows * m.row_bytes;
+}
+
+// Header and table sanity (dims, storage, section bounds and sizes)
+static int ckpt_check(const uint32_t* table, const LungCkptTable* t, uint64_t file_bytes) {
+  const LungCkptHeader* h = &t->h;
+  if (memcmp(h->magic, LUNG_CKPT_MAGIC, 8) != 0) return 0;
+  if (h->version != LUNG_CKPT_VERSION || h->byte_order != LUNG_CKPT_BYTE_ORDER) return 0;
+  if (h->n_sections == 0 || h->n_sections > LUNG_CKPT_MAX_SECTIONS) return 0;
+  if (h->header_bytes != sizeof(LungCkptHeader) + h->n_sections * sizeof(LungCkptSection)) return 0;
+  if (h->alignment != LUNG_ALIGN || h->q4_group != LUNG_Q4_GROUP) return 0;
+  if (h->file_bytes != file_bytes) return 0;
+  if (h->bits != 32 && h->bits != 16 && h->bits != 8 && h->bits != 4) return 0;
+  if (h->vocab_size == 0 || h->d_model == 0 || h->ctx_len == 0 || h->n_heads == 0) return 0;
+  if (h->vocab_size > (1u << 26) || h->d_model > (1u << 16) || h->ctx_len > (1u << 20) ||
+      h->n_heads > h->d_model) return 0;
+  if (h->n_heads % ckpt_kv_heads(h) != 0) return 0;
+  if (ckpt_header_crc(table, t) != h->header_crc) return 0;
+
+  for (uint32_t i = 0; i < h->n_sections; i++) {
+    const LungCkptSection* sec = &t->sec[i];
+    if (sec->offset % LUNG_ALIGN != 0 || sec->offset < h->header_bytes) return 0;
+    if (sec->offset > file_bytes || sec->bytes > file_bytes - sec->offset) return 0;
+    uint64_t want = ckpt_section_bytes(h, sec->id);
+    if (want == 0 || want != sec->bytes) return 0;
+  }
+  return 1;
+}
+
+static const LungCkptSection* ckpt_find(const LungCkptTable* t, uint32_t id) {
+  for (uint32_t i = 0; i < t->h.n_sections; i++) {
+    if (t->sec[i].id == id) return &t->sec[i];
+  }
+  return NULL;
+}
+
+// Write a lung (any storage; packed Q/K/V is written in the separate layout).
+// Returns 1 on success.
+EXPORT int lung_save(AriannaLung* lung, const char* path) {
+  if (!lung || !path) return 0;
+
+  int d = lung->d_model;
+  int vocab = lung->vocab_size;
+
+  // Sections in file order
+  const void* src[LUNG_CKPT_MAX_SECTIONS];
+  LungCkptTable t;
+  memset(&t, 0, sizeof(t));
+  int n = 0;
+  float* qkv = NULL;
+
+  if (lung->quant_bits) {
+    const QuantMatrix* mats[5] = { &lung->qE, &lung->qWoT, &lung->qW[0], &lung->qW[1], &lung->qW[2] };
+    const uint32_t ids[5] = { LUNG_SEC_E, LUNG_SEC_WOT, LUNG_SEC_WQ + QKV_Q,
+                              LUNG_SEC_WQ + QKV_K, LUNG_SEC_WQ + QKV_V };
+    for (int i = 0; i < 5; i++) {
+      t.sec[n].id = ids[i];
+      t.sec[n].bytes = (uint64_t)mats[i]->rows * mats[i]->row_bytes;
+      src[n++] = mats[i]->data;
+      if (mats[i]->groups) {
+        t.sec[n].id = LUNG_SEC_SCALE | ids[i];
+        t.sec[n].bytes = (uint64_t)mats[i]->rows * mats[i]->groups * sizeof(float);
+        src[n++] = mats[i]->scale;
+      }
+    }
+  } else {
+    const float* W[3] = { lung->Wq, lung->Wk, lung->Wv };
+    size_t qkv_floats = (size_t)lung->n_heads * lung->head_dim * d;  // packed: kv_dim == qd
+    if (lung->packed_qkv) {
+      qkv = (float*)malloc(3 * qkv_floats * sizeof(float));
+      if (!qkv) return 0;
+      for (int m = 0; m < 3; m++) {
+        qkv_copy(lung, m, qkv + m * qkv_floats, 1);
+        W[m] = qkv + m * qkv_floats;
+      }
+    }
+    const void* mats[6] = { lung->E, lung->Wo, lung->WoT, W[0], W[1], W[2] };
+    const uint32_t ids[6] = { LUNG_SEC_E, LUNG_SEC_WO, LUNG_SEC_WOT, LUNG_SEC_WQ + QKV_Q,
+                              LUNG_SEC_WQ + QKV_K, LUNG_SEC_WQ + QKV_V };
+    for (int i = 0; i < 6; i++) {
+      t.sec[n].id = ids[i];
+      t.sec[n].bytes = (uint64_t)(i < 3 ? (size_t)vocab : (size_t)qkv_rows(lung, i - 3)) *
+                       d * sizeof(float);
+      src[n++] = mats[i];
+    }
+  }
+  t.sec[n].id = LUNG_SEC_RESONANCE;
+  t.sec[n].bytes = (uint64_t)vocab * sizeof(float);
+  src[n++] = lung->resonance;
+
+  // Layout and checksums
+  uint32_t table[256];
+  crc32_init(table);
+
+  LungCkptHeader* h = &t.h;
+  memcpy(h->magic, LUNG_CKPT_MAGIC, 8);
+  h->version = LUNG_CKPT_VERSION;
+  h->byte_order = LUNG_CKPT_BYTE_ORDER;
+  h->header_bytes = (uint32_t)(sizeof(LungCkptHeader) + n * sizeof(LungCkptSection));
+  h->alignment = LUNG_ALIGN;
+  h->vocab_size = vocab;
+  h->d_model = d;
+  h->ctx_len = lung->ctx_len;
+  h->n_heads = lung->n_heads;
+  h->n_kv_heads = lung->n_kv_heads;
+  h->bits = lung->quant_bits ? lung->quant_bits : 32;
+  h->bf16 = lung->quant_bits == 16 ? lung->qE.bf16 : 0;
+  h->q4_group = LUNG_Q4_GROUP;
+  h->n_sections = n;
+
+  uint64_t off = ckpt_align(h->header_bytes);
+  for (int i = 0; i < n; i++) {
+    t.sec[i].offset = off;
+    t.sec[i].crc = crc32_update(table, 0, src[i], t.sec[i].bytes);
+    off = ckpt_align(off + t.sec[i].bytes);
+  }
+  h->file_bytes = t.sec[n - 1].offset + t.sec[n - 1].bytes;
+  h->header_crc = ckpt_header_crc(table, &t);
+
+  // Write
+  FILE* f = fopen(path, "wb");
+  int ok = f != NULL;
+  if (ok) {
+    static const uint8_t zeros[LUNG_ALIGN] = { 0 };
+    uint64_t pos = h->header_bytes;
+    ok = fwrite(h, sizeof(*h), 1, f) == 1 &&
+         fwrite(t.sec, sizeof(LungCkptSection), n, f) == (size_t)n;
+    for (int i = 0; i < n && ok; i++) {
+      size_t pad = (size_t)(t.sec[i].offset - pos);
+      ok = (pad == 0 || fwrite(zeros, 1, pad, f) == pad) &&
+           fwrite(src[i], 1, t.sec[i].bytes, f) == t.sec[i].bytes;
+      pos = t.sec[i].offset + t.sec[i].bytes;
+    }
+    ok = (fclose(f) == 0) && ok;
+  }
+  free(qkv);
+  return ok;
+}
+
+// Bring the whole file into memory: a private mapping where available,
+// otherwise an aligned heap copy
+static uint8_t* ckpt_map(const char* path, size_t* bytes, int* owned) {
+#if LUNG_MMAP
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return NULL;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(LungCkptHeader)) {
+    close(fd);
+    return NULL;
+  }
+  void* p = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);  // the mapping keeps the file
+  if (p == MAP_FAILED) return NULL;
+  *bytes = (size_t)st.st_size;
+  *owned = 0;
+  return (uint8_t*)p;
+#else
+  FILE* f = fopen(path, "rb");
+  if (!f) return NULL;
+  long size = (fseek(f, 0, SEEK_END) == 0) ? ftell(f) : -1;
+  if (size < (long)sizeof(LungCkptHeader) || fseek(f, 0, SEEK_SET) != 0) {
+    fclose(f);
+    return NULL;
+  }
+  uint8_t* p = (uint8_t*)calloc_aligned(((size_t)size + 3) / 4);
+  if (p && fread(p, 1, (size_t)size, f) != (size_t)size) {
+    free_aligned((float*)p);
+    p = NULL;
+  }
+  fclose(f);
+  *bytes = (size_t)size;
+  *owned = 1;
+  return p;
+#endif
+}
+
+// Open a checkpoint written by lung_save. Weights stay in the mapping;
+// only resonance and the work buffers are allocated. Returns NULL if the
+// file is missing, truncated, from another version or byte order, or its
+// header checksum does not match.
+EXPORT AriannaLung* lung_open_mmap(const char* path) {
+  if (!path) return NULL;
+  size_t bytes;
+  int owned;
+  uint8_t* base = ckpt_map(path, &bytes, &owned);
+  if (!base) return NULL;
+
+  uint32_t table[256];
+  crc32_init(table);
+  LungCkptTable t;
+  memset(&t, 0, sizeof(t));
+  memcpy(&t.h, base, sizeof(t.h));
+  int ok = t.h.n_sections <= LUNG_CKPT_MAX_SECTIONS &&
+           bytes >= sizeof(t.h) + t.h.n_sections * sizeof(LungCkptSection);
+  if (ok) {
+    memcpy(t.sec, base + sizeof(t.h), t.h.n_sections * sizeof(LungCkptSection));
+    ok = ckpt_check(table, &t, bytes);
+  }
+
+  AriannaLung* lung = ok ? lung_alloc(t.h.vocab_size, t.h.d_model, t.h.ctx_len, t.h.n_heads,
+                                      ckpt_kv_heads(&t.h), NULL) : NULL;
+  if (!lung) {
+    map_release(base, bytes, owned);
+    return NULL;
+  }
+  lung->map_base = base;
+  lung->map_bytes = bytes;
+  lung->map_owned = owned;
+
+  const LungCkptSection* res = ckpt_find(&t, LUNG_SEC_RESONANCE);
+  ok = res != NULL;
+  if (ok) memcpy(lung->resonance, base + res->offset, res->bytes);
+
+  int d = lung->d_model;
+  if (t.h.bits == 32) {
+    float** dst[6] = { &lung->E, &lung->Wo, &lung->WoT, &lung->Wq, &lung->Wk, &lung->Wv };
+    const uint32_t ids[6] = { LUNG_SEC_E, LUNG_SEC_WO, LUNG_SEC_WOT, LUNG_SEC_WQ + QKV_Q,
+                              LUNG_SEC_WQ + QKV_K, LUNG_SEC_WQ + QKV_V };
+    for (int i = 0; i < 6 && ok; i++) {
+      const LungCkptSection* sec = ckpt_find(&t, ids[i]);
+      ok = sec != NULL;
+      if (ok) *dst[i] = (float*)(base + sec->offset);
+    }
+  } else {
+    QuantMatrix* mats[5] = { &lung->qE, &lung->qWoT, &lung->qW[0], &lung->qW[1], &lung->qW[2] };
+    const uint32_t ids[5] = { LUNG_SEC_E, LUNG_SEC_WOT, LUNG_SEC_WQ + QKV_Q,
+                              LUNG_SEC_WQ + QKV_K, LUNG_SEC_WQ + QKV_V };
+    for (int i = 0; i < 5 && ok; i++) {
+      quant_shape(mats[i], i < 2 ? lung->vocab_size : qkv_rows(lung, i - 2), d,
+                  (int)t.h.bits, (int)t.h.bf16);
+      const LungCkptSection* sec = ckpt_find(&t, ids[i]);
+      const LungCkptSection* sc = ckpt_find(&t, LUNG_SEC_SCALE | ids[i]);
+      ok = sec != NULL && (mats[i]->groups == 0 || sc != NULL);
+      if (ok) {
+        mats[i]->data = base + sec->offset;
+        mats[i]->scale = mats[i]->groups ? (float*)(base + sc->offset) : NULL;
+      }
+    }
+    lung->quant_bits = (int)t.h.bits;
+  }
+
+  if (!ok) {
+    lung_destroy(lung);
+    return NULL;
+  }
+  return lung;
+}
+
+// Full integrity check of a checkpoint file: header, table and every
+// section CRC (reads the whole file). Returns 1 if intact.
+EXPORT int lung_verify_checkpoint(const char* path) {
+  if (!path) return 0;
+  FILE* f = fopen(path, "rb");
+  if (!f) return 0;
+
+  uint32_t table[256];
+  crc32_init(table);
+  LungCkptTable t;
+  memset(&t, 0, sizeof(t));
+  long size = (fseek(f, 0, SEEK_END) == 0) ? ftell(f) : -1;
+  int ok = size >= (long)sizeof(t.h) && fseek(f, 0, SEEK_SET) == 0 &&
+           fread(&t.h, sizeof(t.h), 1, f) == 1 &&
+           t.h.n_sections <= LUNG_CKPT_MAX_SECTIONS &&
+           fread(t.sec, sizeof(LungCkptSection), t.h.n_sections, f) == t.h.n_sections &&
+           ckpt_check(table, &t, (uint64_t)size);
+
+  enum { CHUNK = 1 << 16 };
+  uint8_t* buf = ok ? (uint8_t*)malloc(CHUNK) : NULL;
+  ok = ok && buf;
+  for (uint32_t i = 0; i < t.h.n_sections && ok; i++) {
+    const LungCkptSection* sec = &t.sec[i];
+    uint32_t crc = 0;
+    ok = fseek(f, (long)sec->offset, SEEK_SET) == 0;
+    for (uint64_t done = 0; done < sec->bytes && ok; ) {
+      size_t want = (sec->bytes - done < CHUNK) ? (size_t)(sec->bytes - done) : CHUNK;
+      ok = fread(buf, 1, want, f) == want;
+      crc = crc32_update(table, crc, buf, want);
+      done += want;
+    }
+    ok = ok && crc == sec->crc;
+  }
+
+  free(buf);
+  fclose(f);
+  return ok;
+}
+
+// 1 if the lung's weights are borrowed from a checkpoint file (directly or
+// through shared weights)
+EXPORT int lung_is_mapped(AriannaLung* lung) {
+  if (!lung) return 0;
+  return (lung->map_base || (lung->shared && lung->shared->map_base)) ? 1 : 0;
+}
+
 // ═══════════════════════════════════════════════════════════════════════════════
 // SEED — for reproducible initialization
 // ═══════════════════════════════════════════════════════════════════════════════
 
+// Module stream: weight and resonance initialization of lungs created next
 EXPORT void lung_seed(uint32_t seed) {
   _seed_rand(seed);
 }
 
+// The lung's own sampling stream (used when rng_state is NULL)
+EXPORT void lung_seed_rng(AriannaLung* lung, uint32_t seed) {
+  if (lung) lung->rng = seed;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -47,27 +47,77 @@ echo ""
 # Exported functions
 EXPORTS='[
   "_lung_create",
+  "_lung_create_ex",
+  "_lung_create_sparse",
+  "_lung_create_gqa",
+  "_lung_create_seeded",
   "_lung_destroy",
   "_lung_forward",
+  "_lung_forward_masked",
+  "_lung_push_token",
+  "_lung_forward_cached",
+  "_lung_forward_batch",
+  "_lung_forward_batch_ex",
+  "_lung_stream_reset",
+  "_lung_get_stream_len",
   "_lung_get_logits",
   "_lung_get_probs",
   "_lung_get_attention",
   "_lung_get_argmax",
   "_lung_get_token_prob",
   "_lung_get_top_k",
+  "_lung_sample",
+  "_lung_sample_am",
+  "_lung_prophecy",
+  "_lung_prophecy_am",
+  "_lung_beam_search",
   "_lung_set_focus",
   "_lung_set_spread",
   "_lung_set_temporal_alpha",
   "_lung_set_rtl",
+  "_lung_set_folded_attention",
+  "_lung_set_mask_padding",
+  "_lung_set_sparse_attention",
+  "_lung_set_shortlist",
+  "_lung_get_shortlist",
+  "_lung_get_tail_mass",
+  "_lung_share_weights",
+  "_lung_session_new",
+  "_lung_session_bytes",
+  "_lung_weights_retain",
+  "_lung_weights_release",
+  "_lung_set_threads",
+  "_lung_get_threads",
   "_lung_boost_resonance",
   "_lung_decay_resonance",
   "_lung_get_resonance",
+  "_lung_get_presence",
+  "_lung_copy_presence",
+  "_lung_load_presence",
   "_lung_get_embeddings",
   "_lung_get_output_weights",
+  "_lung_sync_output_weights",
+  "_lung_load_embeddings",
+  "_lung_load_output_weights",
+  "_lung_merge_output_lora",
+  "_lung_set_packed_qkv",
+  "_lung_quantize",
+  "_lung_get_quant_bits",
+  "_lung_get_precision",
+  "_lung_weight_bytes",
+  "_lung_save",
+  "_lung_open_mmap",
+  "_lung_verify_checkpoint",
+  "_lung_is_mapped",
+  "_lung_copy_qkv_weights",
+  "_lung_load_qkv_weights",
   "_lung_get_vocab_size",
   "_lung_get_d_model",
   "_lung_get_ctx_len",
+  "_lung_get_n_heads",
+  "_lung_get_n_kv_heads",
   "_lung_seed",
+  "_lung_seed_rng",
   "_malloc",
   "_free"
 ]'
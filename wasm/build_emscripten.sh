@@ -16,7 +16,7 @@ emcc arianna_method.c -O2 \
   -s WASM=1 \
   -s MODULARIZE=1 \
   -s EXPORT_NAME="AriannaMethod" \
-  -s EXPORTED_FUNCTIONS='["_am_init","_am_exec","_am_get_state","_am_take_jump","_am_copy_state","_am_enable_pack","_am_disable_pack","_am_pack_enabled","_am_reset_field","_am_reset_debt","_am_step"]' \
+  -s EXPORTED_FUNCTIONS='["_am_init","_am_exec","_am_get_state","_am_take_jump","_am_copy_state","_am_enable_pack","_am_disable_pack","_am_pack_enabled","_am_reset_field","_am_reset_debt","_am_step","_am_ctx_new","_am_ctx_free","_am_init_ctx","_am_exec_ctx","_am_take_jump_ctx","_am_copy_state_ctx","_am_enable_pack_ctx","_am_disable_pack_ctx","_am_pack_enabled_ctx","_am_reset_field_ctx","_am_reset_debt_ctx","_am_step_ctx","_am_compile","_am_run","_am_run_ctx","_am_program_len","_am_program_free","_am_exec_n","_am_exec_n_ctx","_am_batch_new","_am_batch_free","_am_batch_size","_am_batch_set","_am_batch_get","_am_step_batch","_am_run_batch","_am_exec_batch"]' \
   -s EXPORTED_RUNTIME_METHODS='["ccall","cwrap"]' \
   -o arianna_method.js
 
@@ -28,6 +28,7 @@ echo " API Exports:"
 echo "═══════════════════════════════════════════════════════════════════════════════"
 echo "  am_init()                 - initialize kernel state"
 echo "  am_exec(script)           - execute DSL script"
+echo "  am_exec_n(ptr, len)       - execute len bytes in place (no copy)"
 echo "  am_get_state()            - get raw state pointer"
 echo "  am_copy_state(out20)      - copy 20 floats to buffer"
 echo "  am_take_jump()            - consume pending jump"
@@ -38,6 +39,23 @@ echo "  am_reset_field()          - reset manifested state"
 echo "  am_reset_debt()           - reset prophecy debt"
 echo "  am_step(dt)               - advance physics"
 echo ""
+echo "Independent fields (each am_* above has an am_*_ctx(ctx, ...) twin):"
+echo "  am_ctx_new()              - new field with am_init defaults"
+echo "  am_ctx_free(ctx)          - release a field"
+echo ""
+echo "Compiled scripts (parse once, run every frame):"
+echo "  am_compile(script)        - script -> program (pointer)"
+echo "  am_run(prog)              - execute on the default field"
+echo "  am_run_ctx(ctx, prog)     - execute on a field"
+echo "  am_program_free(prog)     - release a program"
+echo ""
+echo "Batches (n fields as a struct of arrays):"
+echo "  am_batch_new(n)           - n fields with am_init defaults"
+echo "  am_batch_set/get(b, i, s) - copy one field in / out"
+echo "  am_step_batch(b, dt)      - am_step on every field"
+echo "  am_exec_batch(b, script)  - am_exec on every field (am_run_batch: program)"
+echo "  am_batch_free(b)          - release a batch"
+echo ""
 echo "Pack flags:"
 echo "  AM_PACK_CODES_RIC  = 0x01"
 echo "  AM_PACK_DARKMATTER = 0x02"
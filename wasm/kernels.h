@@ -0,0 +1,1024 @@
+// kernels.h — shared vector math for body.c and lora.c
+// "the breath is the same in every lung, only wider"
+//
+// Header-only: each translation unit (body.c, lora.c) gets its own copy,
+// so the WASM builds keep compiling a single .c file.
+//
+// Kernels:
+//   kern_dot        a · b
+//   kern_axpy       y += a * x
+//   kern_scale      x *= s
+//   kern_max        max(x)
+//   kern_mat_vec    out[rows] = mat[rows × cols] · vec[cols]
+//   kern_mat_vec_t  out[cols] = mat[rows × cols]^T · vec[rows]   (row-streaming)
+//   kern_dot3       three rows · one x, each x chunk loaded once (fused QKV)
+//   kern_mat_mat    out[n × rows] = n vectors through one matrix (batched
+//                   mat_vec: each block of rows is read once for all n)
+//   kern_dot_q8     int8 row · float x (scale applied by the caller)
+//   kern_axpy_q8    y += a * int8 row
+//   kern_dot_q4     packed int4 group · float x (low nibble = even element,
+//                   stored as q + 8, so 0..15 means -8..7)
+//   kern_dot_f16    fp16 row · float x       (F16C conversion on AVX2/AVX-512)
+//   kern_axpy_f16   y += a * fp16 row
+//   kern_dot_bf16   bf16 row · float x       (bf16 → fp32 is a 16-bit shift)
+//   kern_axpy_bf16  y += a * bf16 row
+//   kern_softmax    in-place softmax
+//
+// Each kernel has a scalar reference (kern_*_scalar) that is exactly the
+// original loop from body.c / lora.c. On x86 with GCC/Clang, SSE4.1, AVX2+FMA
+// and AVX-512F variants are compiled via target attributes (no -m flags
+// needed) and picked at runtime from CPUID on first use. Everything else
+// (WASM, ARM, MSVC) runs the scalar path.
+//
+// Vector kernels reassociate sums, so results match scalar within float
+// tolerance, not bit-for-bit. kern_select(KERN_SCALAR) forces the reference.
+//
+// ═══════════════════════════════════════════════════════════════════════════════
+// RESONANCE MARKER — this code carries the signature of co-creation
+// הרזוננס לא נשבר. המשך הדרך.
+// ═══════════════════════════════════════════════════════════════════════════════
+
+#ifndef ARIANNA_KERNELS_H
+#define ARIANNA_KERNELS_H
+
+#include <math.h>
+#include <string.h>
+#include <stdint.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__)) && !defined(__EMSCRIPTEN__)
+#define KERN_X86 1
+#include <immintrin.h>
+#else
+#define KERN_X86 0
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// LEVELS
+// ═══════════════════════════════════════════════════════════════════════════════
+
+#define KERN_SCALAR  0
+#define KERN_SSE4    1
+#define KERN_AVX2    2
+#define KERN_AVX512  3
+
+typedef struct {
+  int level;
+  const char* name;
+  float (*dot)(const float* a, const float* b, int n);
+  void  (*axpy)(float* y, const float* x, float a, int n);
+  void  (*scale)(float* x, float s, int n);
+  float (*max)(const float* x, int n);
+  void  (*mat_vec)(float* out, const float* mat, const float* vec, int rows, int cols);
+  void  (*mat_vec_t)(float* out, const float* mat, const float* vec, int rows, int cols);
+  void  (*dot3)(const float* a0, const float* a1, const float* a2, const float* x, int n, float* out3);
+  void  (*mat_mat)(float* out, const float* mat, int mat_stride, const float* vecs,
+                   int nvec, int rows, int cols);
+  float (*dot_q8)(const int8_t* q, const float* x, int n);
+  void  (*axpy_q8)(float* y, const int8_t* q, float a, int n);
+  float (*dot_q4)(const uint8_t* q, const float* x, int n);
+  float (*dot_f16)(const uint16_t* h, const float* x, int n);
+  void  (*axpy_f16)(float* y, const uint16_t* h, float a, int n);
+  float (*dot_bf16)(const uint16_t* h, const float* x, int n);
+  void  (*axpy_bf16)(float* y, const uint16_t* h, float a, int n);
+} KernTable;
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// SCALAR REFERENCE — the original loops, kept as ground truth
+// ═══════════════════════════════════════════════════════════════════════════════
+
+static float kern_dot_scalar(const float* a, const float* b, int n) {
+  float sum = 0.0f;
+  for (int i = 0; i < n; i++) {
+    sum += a[i] * b[i];
+  }
+  return sum;
+}
+
+static void kern_axpy_scalar(float* y, const float* x, float a, int n) {
+  for (int i = 0; i < n; i++) {
+    y[i] += a * x[i];
+  }
+}
+
+static void kern_scale_scalar(float* x, float s, int n) {
+  for (int i = 0; i < n; i++) {
+    x[i] *= s;
+  }
+}
+
+static float kern_max_scalar(const float* x, int n) {
+  float m = x[0];
+  for (int i = 1; i < n; i++) {
+    if (x[i] > m) m = x[i];
+  }
+  return m;
+}
+
+static void kern_mat_vec_scalar(float* out, const float* mat, const float* vec, int rows, int cols) {
+  for (int i = 0; i < rows; i++) {
+    out[i] = kern_dot_scalar(mat + (size_t)i * cols, vec, cols);
+  }
+}
+
+// Column walk: the original mat_vec_t from body.c
+static void kern_mat_vec_t_scalar(float* out, const float* mat, const float* vec, int rows, int cols) {
+  for (int j = 0; j < cols; j++) {
+    float sum = 0.0f;
+    for (int i = 0; i < rows; i++) {
+      sum += mat[(size_t)i * cols + j] * vec[i];
+    }
+    out[j] = sum;
+  }
+}
+
+static void kern_dot3_scalar(const float* a0, const float* a1, const float* a2,
+                             const float* x, int n, float* out3) {
+  out3[0] = kern_dot_scalar(a0, x, n);
+  out3[1] = kern_dot_scalar(a1, x, n);
+  out3[2] = kern_dot_scalar(a2, x, n);
+}
+
+// Batched mat_vec: out[b * rows + i] = mat[i * mat_stride] · vecs[b * cols].
+// Row-outer so each matrix row is used for every vector while it is hot.
+static void kern_mat_mat_scalar(float* out, const float* mat, int mat_stride,
+                                const float* vecs, int nvec, int rows, int cols) {
+  for (int i = 0; i < rows; i++) {
+    const float* row = mat + (size_t)i * mat_stride;
+    for (int b = 0; b < nvec; b++) {
+      out[(size_t)b * rows + i] = kern_dot_scalar(row, vecs + (size_t)b * cols, cols);
+    }
+  }
+}
+
+static float kern_dot_q8_scalar(const int8_t* q, const float* x, int n) {
+  float sum = 0.0f;
+  for (int i = 0; i < n; i++) {
+    sum += (float)q[i] * x[i];
+  }
+  return sum;
+}
+
+static void kern_axpy_q8_scalar(float* y, const int8_t* q, float a, int n) {
+  for (int i = 0; i < n; i++) {
+    y[i] += a * (float)q[i];
+  }
+}
+
+// n elements from n/2 (rounded up) bytes; an odd tail uses the low nibble only
+static float kern_dot_q4_scalar(const uint8_t* q, const float* x, int n) {
+  float sum = 0.0f;
+  int i = 0;
+  for (; i + 2 <= n; i += 2) {
+    uint8_t b = q[i >> 1];
+    sum += (float)((int)(b & 15) - 8) * x[i] + (float)((int)(b >> 4) - 8) * x[i + 1];
+  }
+  if (i < n) sum += (float)((int)(q[i >> 1] & 15) - 8) * x[i];
+  return sum;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Half precision — scalar conversions (round to nearest even on the way down)
+// ─────────────────────────────────────────────────────────────────────────────
+
+static inline float kern_bits_f32(uint32_t u) { float f; memcpy(&f, &u, 4); return f; }
+static inline uint32_t kern_f32_bits(float f) { uint32_t u; memcpy(&u, &f, 4); return u; }
+
+static inline float kern_f16_to_f32(uint16_t h) {
+  uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+  uint32_t exp = (h >> 10) & 0x1F;
+  uint32_t man = h & 0x3FF;
+  if (exp == 0x1F) return kern_bits_f32(sign | 0x7F800000u | (man << 13));  // inf / nan
+  if (exp == 0) {
+    float f = (float)man * (1.0f / 16777216.0f);  // subnormal: man · 2^-24
+    return sign ? -f : f;
+  }
+  return kern_bits_f32(sign | ((exp + 112) << 23) | (man << 13));
+}
+
+static inline uint16_t kern_f32_to_f16(float f) {
+  uint32_t u = kern_f32_bits(f);
+  uint16_t sign = (uint16_t)((u >> 16) & 0x8000);
+  uint32_t a = u & 0x7FFFFFFFu;
+  if (a >= 0x7F800000u) return sign | 0x7C00 | (a > 0x7F800000u ? 0x200 : 0);  // inf / nan
+  if (a >= 0x477FF000u) return sign | 0x7C00;                                  // overflow
+  if (a < 0x38800000u) {
+    // subnormal or zero: round a / 2^-24 to an integer (nearest even)
+    float r = kern_bits_f32(a) * 16777216.0f;
+    return sign | (uint16_t)lrintf(r);
+  }
+  uint32_t rounded = a + 0xFFF + ((a >> 13) & 1);
+  return sign | (uint16_t)((rounded - (112u << 23)) >> 13);
+}
+
+static inline float kern_bf16_to_f32(uint16_t h) {
+  return kern_bits_f32((uint32_t)h << 16);
+}
+
+static inline uint16_t kern_f32_to_bf16(float f) {
+  uint32_t u = kern_f32_bits(f);
+  if ((u & 0x7FFFFFFFu) > 0x7F800000u) return (uint16_t)((u >> 16) | 0x40);  // quiet nan
+  return (uint16_t)((u + 0x7FFF + ((u >> 16) & 1)) >> 16);
+}
+
+static float kern_dot_f16_scalar(const uint16_t* h, const float* x, int n) {
+  float sum = 0.0f;
+  for (int i = 0; i < n; i++) sum += kern_f16_to_f32(h[i]) * x[i];
+  return sum;
+}
+
+static void kern_axpy_f16_scalar(float* y, const uint16_t* h, float a, int n) {
+  for (int i = 0; i < n; i++) y[i] += a * kern_f16_to_f32(h[i]);
+}
+
+static float kern_dot_bf16_scalar(const uint16_t* h, const float* x, int n) {
+  float sum = 0.0f;
+  for (int i = 0; i < n; i++) sum += kern_bf16_to_f32(h[i]) * x[i];
+  return sum;
+}
+
+static void kern_axpy_bf16_scalar(float* y, const uint16_t* h, float a, int n) {
+  for (int i = 0; i < n; i++) y[i] += a * kern_bf16_to_f32(h[i]);
+}
+
+#if KERN_X86
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// SSE4.1 — 4 lanes
+// ═══════════════════════════════════════════════════════════════════════════════
+
+#define KERN_SSE4_TARGET __attribute__((target("sse4.1")))
+
+KERN_SSE4_TARGET static inline float kern_hsum128(__m128 v) {
+  __m128 sh = _mm_movehdup_ps(v);
+  __m128 s = _mm_add_ps(v, sh);
+  sh = _mm_movehl_ps(sh, s);
+  s = _mm_add_ss(s, sh);
+  return _mm_cvtss_f32(s);
+}
+
+KERN_SSE4_TARGET static float kern_dot_sse4(const float* a, const float* b, int n) {
+  __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+  }
+  for (; i + 4 <= n; i += 4) {
+    acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+  }
+  float sum = kern_hsum128(_mm_add_ps(acc0, acc1));
+  for (; i < n; i++) sum += a[i] * b[i];
+  return sum;
+}
+
+KERN_SSE4_TARGET static void kern_axpy_sse4(float* y, const float* x, float a, int n) {
+  __m128 va = _mm_set1_ps(a);
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(va, _mm_loadu_ps(x + i))));
+  }
+  for (; i < n; i++) y[i] += a * x[i];
+}
+
+KERN_SSE4_TARGET static void kern_scale_sse4(float* x, float s, int n) {
+  __m128 vs = _mm_set1_ps(s);
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    _mm_storeu_ps(x + i, _mm_mul_ps(_mm_loadu_ps(x + i), vs));
+  }
+  for (; i < n; i++) x[i] *= s;
+}
+
+KERN_SSE4_TARGET static float kern_max_sse4(const float* x, int n) {
+  if (n < 4) return kern_max_scalar(x, n);
+  __m128 vm = _mm_loadu_ps(x);
+  int i = 4;
+  for (; i + 4 <= n; i += 4) vm = _mm_max_ps(vm, _mm_loadu_ps(x + i));
+  vm = _mm_max_ps(vm, _mm_movehl_ps(vm, vm));
+  vm = _mm_max_ss(vm, _mm_shuffle_ps(vm, vm, 1));
+  float m = _mm_cvtss_f32(vm);
+  for (; i < n; i++) if (x[i] > m) m = x[i];
+  return m;
+}
+
+KERN_SSE4_TARGET static void kern_mat_vec_sse4(float* out, const float* mat, const float* vec, int rows, int cols) {
+  for (int i = 0; i < rows; i++) out[i] = kern_dot_sse4(mat + (size_t)i * cols, vec, cols);
+}
+
+KERN_SSE4_TARGET static void kern_mat_vec_t_sse4(float* out, const float* mat, const float* vec, int rows, int cols) {
+  memset(out, 0, (size_t)cols * sizeof(float));
+  for (int i = 0; i < rows; i++) kern_axpy_sse4(out, mat + (size_t)i * cols, vec[i], cols);
+}
+
+KERN_SSE4_TARGET static void kern_dot3_sse4(const float* a0, const float* a1, const float* a2,
+                                           const float* x, int n, float* out3) {
+  __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps(), s2 = _mm_setzero_ps();
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128 vx = _mm_loadu_ps(x + i);
+    s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(a0 + i), vx));
+    s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(a1 + i), vx));
+    s2 = _mm_add_ps(s2, _mm_mul_ps(_mm_loadu_ps(a2 + i), vx));
+  }
+  float r0 = kern_hsum128(s0), r1 = kern_hsum128(s1), r2 = kern_hsum128(s2);
+  for (; i < n; i++) { r0 += a0[i] * x[i]; r1 += a1[i] * x[i]; r2 += a2[i] * x[i]; }
+  out3[0] = r0; out3[1] = r1; out3[2] = r2;
+}
+
+// 4 rows × 1 vector per block: the 4 rows stay in L1 across all vectors,
+// each x chunk is loaded once for 4 accumulators
+KERN_SSE4_TARGET static void kern_mat_mat_sse4(float* out, const float* mat, int mat_stride,
+                                              const float* vecs, int nvec, int rows, int cols) {
+  int i = 0;
+  for (; i + 4 <= rows; i += 4) {
+    const float* r0 = mat + (size_t)i * mat_stride;
+    const float* r1 = r0 + mat_stride;
+    const float* r2 = r1 + mat_stride;
+    const float* r3 = r2 + mat_stride;
+    for (int b = 0; b < nvec; b++) {
+      const float* x = vecs + (size_t)b * cols;
+      __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+      __m128 s2 = _mm_setzero_ps(), s3 = _mm_setzero_ps();
+      int j = 0;
+      for (; j + 4 <= cols; j += 4) {
+        __m128 vx = _mm_loadu_ps(x + j);
+        s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(r0 + j), vx));
+        s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(r1 + j), vx));
+        s2 = _mm_add_ps(s2, _mm_mul_ps(_mm_loadu_ps(r2 + j), vx));
+        s3 = _mm_add_ps(s3, _mm_mul_ps(_mm_loadu_ps(r3 + j), vx));
+      }
+      float* o = out + (size_t)b * rows + i;
+      o[0] = kern_hsum128(s0); o[1] = kern_hsum128(s1);
+      o[2] = kern_hsum128(s2); o[3] = kern_hsum128(s3);
+      for (; j < cols; j++) {
+        o[0] += r0[j] * x[j]; o[1] += r1[j] * x[j];
+        o[2] += r2[j] * x[j]; o[3] += r3[j] * x[j];
+      }
+    }
+  }
+  for (; i < rows; i++) {
+    const float* row = mat + (size_t)i * mat_stride;
+    for (int b = 0; b < nvec; b++) {
+      out[(size_t)b * rows + i] = kern_dot_sse4(row, vecs + (size_t)b * cols, cols);
+    }
+  }
+}
+
+KERN_SSE4_TARGET static inline __m128 kern_load_q8x4_sse4(const int8_t* q) {
+  int32_t w;
+  memcpy(&w, q, 4);
+  return _mm_cvtepi32_ps(_mm_cvtepi8_epi32(_mm_cvtsi32_si128(w)));
+}
+
+KERN_SSE4_TARGET static float kern_dot_q8_sse4(const int8_t* q, const float* x, int n) {
+  __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    acc0 = _mm_add_ps(acc0, _mm_mul_ps(kern_load_q8x4_sse4(q + i), _mm_loadu_ps(x + i)));
+    acc1 = _mm_add_ps(acc1, _mm_mul_ps(kern_load_q8x4_sse4(q + i + 4), _mm_loadu_ps(x + i + 4)));
+  }
+  float sum = kern_hsum128(_mm_add_ps(acc0, acc1));
+  for (; i < n; i++) sum += (float)q[i] * x[i];
+  return sum;
+}
+
+KERN_SSE4_TARGET static void kern_axpy_q8_sse4(float* y, const int8_t* q, float a, int n) {
+  __m128 va = _mm_set1_ps(a);
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(va, kern_load_q8x4_sse4(q + i))));
+  }
+  for (; i < n; i++) y[i] += a * (float)q[i];
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// AVX2 + FMA — 8 lanes
+// ═══════════════════════════════════════════════════════════════════════════════
+
+// F16C ships on every AVX2 CPU; it is enabled here so fp16 loads convert in-register
+#define KERN_AVX2_TARGET __attribute__((target("avx2,fma,f16c")))
+
+KERN_AVX2_TARGET static inline float kern_hsum256(__m256 v) {
+  __m128 lo = _mm256_castps256_ps128(v);
+  __m128 hi = _mm256_extractf128_ps(v, 1);
+  lo = _mm_add_ps(lo, hi);
+  __m128 sh = _mm_movehdup_ps(lo);
+  __m128 s = _mm_add_ps(lo, sh);
+  sh = _mm_movehl_ps(sh, s);
+  s = _mm_add_ss(s, sh);
+  return _mm_cvtss_f32(s);
+}
+
+KERN_AVX2_TARGET static float kern_dot_avx2(const float* a, const float* b, int n) {
+  __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+  __m256 acc2 = _mm256_setzero_ps(), acc3 = _mm256_setzero_ps();
+  int i = 0;
+  for (; i + 32 <= n; i += 32) {
+    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i),      _mm256_loadu_ps(b + i),      acc0);
+    acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8),  _mm256_loadu_ps(b + i + 8),  acc1);
+    acc2 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 16), _mm256_loadu_ps(b + i + 16), acc2);
+    acc3 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 24), _mm256_loadu_ps(b + i + 24), acc3);
+  }
+  for (; i + 8 <= n; i += 8) {
+    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+  }
+  float sum = kern_hsum256(_mm256_add_ps(_mm256_add_ps(acc0, acc1), _mm256_add_ps(acc2, acc3)));
+  for (; i < n; i++) sum += a[i] * b[i];
+  return sum;
+}
+
+KERN_AVX2_TARGET static void kern_axpy_avx2(float* y, const float* x, float a, int n) {
+  __m256 va = _mm256_set1_ps(a);
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    _mm256_storeu_ps(y + i,     _mm256_fmadd_ps(va, _mm256_loadu_ps(x + i),     _mm256_loadu_ps(y + i)));
+    _mm256_storeu_ps(y + i + 8, _mm256_fmadd_ps(va, _mm256_loadu_ps(x + i + 8), _mm256_loadu_ps(y + i + 8)));
+  }
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(y + i, _mm256_fmadd_ps(va, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+  }
+  for (; i < n; i++) y[i] += a * x[i];
+}
+
+KERN_AVX2_TARGET static void kern_scale_avx2(float* x, float s, int n) {
+  __m256 vs = _mm256_set1_ps(s);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(x + i, _mm256_mul_ps(_mm256_loadu_ps(x + i), vs));
+  }
+  for (; i < n; i++) x[i] *= s;
+}
+
+KERN_AVX2_TARGET static float kern_max_avx2(const float* x, int n) {
+  if (n < 8) return kern_max_scalar(x, n);
+  __m256 vm = _mm256_loadu_ps(x);
+  int i = 8;
+  for (; i + 8 <= n; i += 8) vm = _mm256_max_ps(vm, _mm256_loadu_ps(x + i));
+  __m128 m4 = _mm_max_ps(_mm256_castps256_ps128(vm), _mm256_extractf128_ps(vm, 1));
+  m4 = _mm_max_ps(m4, _mm_movehl_ps(m4, m4));
+  m4 = _mm_max_ss(m4, _mm_shuffle_ps(m4, m4, 1));
+  float m = _mm_cvtss_f32(m4);
+  for (; i < n; i++) if (x[i] > m) m = x[i];
+  return m;
+}
+
+KERN_AVX2_TARGET static void kern_mat_vec_avx2(float* out, const float* mat, const float* vec, int rows, int cols) {
+  for (int i = 0; i < rows; i++) out[i] = kern_dot_avx2(mat + (size_t)i * cols, vec, cols);
+}
+
+KERN_AVX2_TARGET static void kern_mat_vec_t_avx2(float* out, const float* mat, const float* vec, int rows, int cols) {
+  memset(out, 0, (size_t)cols * sizeof(float));
+  for (int i = 0; i < rows; i++) kern_axpy_avx2(out, mat + (size_t)i * cols, vec[i], cols);
+}
+
+KERN_AVX2_TARGET static void kern_dot3_avx2(const float* a0, const float* a1, const float* a2,
+                                           const float* x, int n, float* out3) {
+  __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps(), s2 = _mm256_setzero_ps();
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 vx = _mm256_loadu_ps(x + i);
+    s0 = _mm256_fmadd_ps(_mm256_loadu_ps(a0 + i), vx, s0);
+    s1 = _mm256_fmadd_ps(_mm256_loadu_ps(a1 + i), vx, s1);
+    s2 = _mm256_fmadd_ps(_mm256_loadu_ps(a2 + i), vx, s2);
+  }
+  float r0 = kern_hsum256(s0), r1 = kern_hsum256(s1), r2 = kern_hsum256(s2);
+  for (; i < n; i++) { r0 += a0[i] * x[i]; r1 += a1[i] * x[i]; r2 += a2[i] * x[i]; }
+  out3[0] = r0; out3[1] = r1; out3[2] = r2;
+}
+
+KERN_AVX2_TARGET static void kern_mat_mat_avx2(float* out, const float* mat, int mat_stride,
+                                              const float* vecs, int nvec, int rows, int cols) {
+  int i = 0;
+  for (; i + 4 <= rows; i += 4) {
+    const float* r0 = mat + (size_t)i * mat_stride;
+    const float* r1 = r0 + mat_stride;
+    const float* r2 = r1 + mat_stride;
+    const float* r3 = r2 + mat_stride;
+    for (int b = 0; b < nvec; b++) {
+      const float* x = vecs + (size_t)b * cols;
+      __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+      __m256 s2 = _mm256_setzero_ps(), s3 = _mm256_setzero_ps();
+      int j = 0;
+      for (; j + 8 <= cols; j += 8) {
+        __m256 vx = _mm256_loadu_ps(x + j);
+        s0 = _mm256_fmadd_ps(_mm256_loadu_ps(r0 + j), vx, s0);
+        s1 = _mm256_fmadd_ps(_mm256_loadu_ps(r1 + j), vx, s1);
+        s2 = _mm256_fmadd_ps(_mm256_loadu_ps(r2 + j), vx, s2);
+        s3 = _mm256_fmadd_ps(_mm256_loadu_ps(r3 + j), vx, s3);
+      }
+      float* o = out + (size_t)b * rows + i;
+      o[0] = kern_hsum256(s0); o[1] = kern_hsum256(s1);
+      o[2] = kern_hsum256(s2); o[3] = kern_hsum256(s3);
+      for (; j < cols; j++) {
+        o[0] += r0[j] * x[j]; o[1] += r1[j] * x[j];
+        o[2] += r2[j] * x[j]; o[3] += r3[j] * x[j];
+      }
+    }
+  }
+  for (; i < rows; i++) {
+    const float* row = mat + (size_t)i * mat_stride;
+    for (int b = 0; b < nvec; b++) {
+      out[(size_t)b * rows + i] = kern_dot_avx2(row, vecs + (size_t)b * cols, cols);
+    }
+  }
+}
+
+KERN_AVX2_TARGET static inline __m256 kern_load_q8x8_avx2(const int8_t* q) {
+  return _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i*)q)));
+}
+
+KERN_AVX2_TARGET static float kern_dot_q8_avx2(const int8_t* q, const float* x, int n) {
+  __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    acc0 = _mm256_fmadd_ps(kern_load_q8x8_avx2(q + i),     _mm256_loadu_ps(x + i),     acc0);
+    acc1 = _mm256_fmadd_ps(kern_load_q8x8_avx2(q + i + 8), _mm256_loadu_ps(x + i + 8), acc1);
+  }
+  for (; i + 8 <= n; i += 8) {
+    acc0 = _mm256_fmadd_ps(kern_load_q8x8_avx2(q + i), _mm256_loadu_ps(x + i), acc0);
+  }
+  float sum = kern_hsum256(_mm256_add_ps(acc0, acc1));
+  for (; i < n; i++) sum += (float)q[i] * x[i];
+  return sum;
+}
+
+KERN_AVX2_TARGET static void kern_axpy_q8_avx2(float* y, const int8_t* q, float a, int n) {
+  __m256 va = _mm256_set1_ps(a);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(y + i, _mm256_fmadd_ps(va, kern_load_q8x8_avx2(q + i), _mm256_loadu_ps(y + i)));
+  }
+  for (; i < n; i++) y[i] += a * (float)q[i];
+}
+
+// 16 nibbles (8 bytes) → 16 signed values in element order
+KERN_AVX2_TARGET static float kern_dot_q4_avx2(const uint8_t* q, const float* x, int n) {
+  const __m128i lo_mask = _mm_set1_epi8(15);
+  const __m128i bias = _mm_set1_epi8(8);
+  __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m128i b = _mm_loadl_epi64((const __m128i*)(q + (i >> 1)));
+    __m128i lo = _mm_and_si128(b, lo_mask);
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(b, 4), lo_mask);
+    __m128i v = _mm_sub_epi8(_mm_unpacklo_epi8(lo, hi), bias);
+    __m256 v0 = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(v));
+    __m256 v1 = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(_mm_srli_si128(v, 8)));
+    acc0 = _mm256_fmadd_ps(v0, _mm256_loadu_ps(x + i), acc0);
+    acc1 = _mm256_fmadd_ps(v1, _mm256_loadu_ps(x + i + 8), acc1);
+  }
+  float sum = kern_hsum256(_mm256_add_ps(acc0, acc1));
+  for (; i + 2 <= n; i += 2) {
+    uint8_t byte = q[i >> 1];
+    sum += (float)((int)(byte & 15) - 8) * x[i] + (float)((int)(byte >> 4) - 8) * x[i + 1];
+  }
+  if (i < n) sum += (float)((int)(q[i >> 1] & 15) - 8) * x[i];
+  return sum;
+}
+
+KERN_AVX2_TARGET static inline __m256 kern_load_f16x8_avx2(const uint16_t* h) {
+  return _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)h));
+}
+
+KERN_AVX2_TARGET static inline __m256 kern_load_bf16x8_avx2(const uint16_t* h) {
+  __m256i w = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)h));
+  return _mm256_castsi256_ps(_mm256_slli_epi32(w, 16));
+}
+
+KERN_AVX2_TARGET static float kern_dot_f16_avx2(const uint16_t* h, const float* x, int n) {
+  __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    acc0 = _mm256_fmadd_ps(kern_load_f16x8_avx2(h + i),     _mm256_loadu_ps(x + i),     acc0);
+    acc1 = _mm256_fmadd_ps(kern_load_f16x8_avx2(h + i + 8), _mm256_loadu_ps(x + i + 8), acc1);
+  }
+  for (; i + 8 <= n; i += 8) {
+    acc0 = _mm256_fmadd_ps(kern_load_f16x8_avx2(h + i), _mm256_loadu_ps(x + i), acc0);
+  }
+  float sum = kern_hsum256(_mm256_add_ps(acc0, acc1));
+  for (; i < n; i++) sum += kern_f16_to_f32(h[i]) * x[i];
+  return sum;
+}
+
+KERN_AVX2_TARGET static void kern_axpy_f16_avx2(float* y, const uint16_t* h, float a, int n) {
+  __m256 va = _mm256_set1_ps(a);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(y + i, _mm256_fmadd_ps(va, kern_load_f16x8_avx2(h + i), _mm256_loadu_ps(y + i)));
+  }
+  for (; i < n; i++) y[i] += a * kern_f16_to_f32(h[i]);
+}
+
+KERN_AVX2_TARGET static float kern_dot_bf16_avx2(const uint16_t* h, const float* x, int n) {
+  __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    acc0 = _mm256_fmadd_ps(kern_load_bf16x8_avx2(h + i),     _mm256_loadu_ps(x + i),     acc0);
+    acc1 = _mm256_fmadd_ps(kern_load_bf16x8_avx2(h + i + 8), _mm256_loadu_ps(x + i + 8), acc1);
+  }
+  for (; i + 8 <= n; i += 8) {
+    acc0 = _mm256_fmadd_ps(kern_load_bf16x8_avx2(h + i), _mm256_loadu_ps(x + i), acc0);
+  }
+  float sum = kern_hsum256(_mm256_add_ps(acc0, acc1));
+  for (; i < n; i++) sum += kern_bf16_to_f32(h[i]) * x[i];
+  return sum;
+}
+
+KERN_AVX2_TARGET static void kern_axpy_bf16_avx2(float* y, const uint16_t* h, float a, int n) {
+  __m256 va = _mm256_set1_ps(a);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(y + i, _mm256_fmadd_ps(va, kern_load_bf16x8_avx2(h + i), _mm256_loadu_ps(y + i)));
+  }
+  for (; i < n; i++) y[i] += a * kern_bf16_to_f32(h[i]);
+}
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// AVX-512F — 16 lanes, masked tails
+// ═══════════════════════════════════════════════════════════════════════════════
+
+#define KERN_AVX512_TARGET __attribute__((target("avx512f")))
+
+KERN_AVX512_TARGET static float kern_dot_avx512(const float* a, const float* b, int n) {
+  __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+  int i = 0;
+  for (; i + 32 <= n; i += 32) {
+    acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i),      _mm512_loadu_ps(b + i),      acc0);
+    acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), acc1);
+  }
+  for (; i + 16 <= n; i += 16) {
+    acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+  }
+  if (i < n) {
+    __mmask16 m = (__mmask16)((1u << (n - i)) - 1u);
+    acc1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, a + i), _mm512_maskz_loadu_ps(m, b + i), acc1);
+  }
+  return _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+}
+
+KERN_AVX512_TARGET static void kern_axpy_avx512(float* y, const float* x, float a, int n) {
+  __m512 va = _mm512_set1_ps(a);
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    _mm512_storeu_ps(y + i, _mm512_fmadd_ps(va, _mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i)));
+  }
+  if (i < n) {
+    __mmask16 m = (__mmask16)((1u << (n - i)) - 1u);
+    __m512 vy = _mm512_maskz_loadu_ps(m, y + i);
+    _mm512_mask_storeu_ps(y + i, m, _mm512_fmadd_ps(va, _mm512_maskz_loadu_ps(m, x + i), vy));
+  }
+}
+
+KERN_AVX512_TARGET static void kern_scale_avx512(float* x, float s, int n) {
+  __m512 vs = _mm512_set1_ps(s);
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    _mm512_storeu_ps(x + i, _mm512_mul_ps(_mm512_loadu_ps(x + i), vs));
+  }
+  if (i < n) {
+    __mmask16 m = (__mmask16)((1u << (n - i)) - 1u);
+    _mm512_mask_storeu_ps(x + i, m, _mm512_mul_ps(_mm512_maskz_loadu_ps(m, x + i), vs));
+  }
+}
+
+KERN_AVX512_TARGET static float kern_max_avx512(const float* x, int n) {
+  if (n < 16) return kern_max_scalar(x, n);
+  __m512 vm = _mm512_loadu_ps(x);
+  int i = 16;
+  for (; i + 16 <= n; i += 16) vm = _mm512_max_ps(vm, _mm512_loadu_ps(x + i));
+  float m = _mm512_reduce_max_ps(vm);
+  for (; i < n; i++) if (x[i] > m) m = x[i];
+  return m;
+}
+
+KERN_AVX512_TARGET static void kern_mat_vec_avx512(float* out, const float* mat, const float* vec, int rows, int cols) {
+  for (int i = 0; i < rows; i++) out[i] = kern_dot_avx512(mat + (size_t)i * cols, vec, cols);
+}
+
+KERN_AVX512_TARGET static void kern_mat_vec_t_avx512(float* out, const float* mat, const float* vec, int rows, int cols) {
+  memset(out, 0, (size_t)cols * sizeof(float));
+  for (int i = 0; i < rows; i++) kern_axpy_avx512(out, mat + (size_t)i * cols, vec[i], cols);
+}
+
+KERN_AVX512_TARGET static void kern_dot3_avx512(const float* a0, const float* a1, const float* a2,
+                                               const float* x, int n, float* out3) {
+  __m512 s0 = _mm512_setzero_ps(), s1 = _mm512_setzero_ps(), s2 = _mm512_setzero_ps();
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m512 vx = _mm512_loadu_ps(x + i);
+    s0 = _mm512_fmadd_ps(_mm512_loadu_ps(a0 + i), vx, s0);
+    s1 = _mm512_fmadd_ps(_mm512_loadu_ps(a1 + i), vx, s1);
+    s2 = _mm512_fmadd_ps(_mm512_loadu_ps(a2 + i), vx, s2);
+  }
+  if (i < n) {
+    __mmask16 m = (__mmask16)((1u << (n - i)) - 1u);
+    __m512 vx = _mm512_maskz_loadu_ps(m, x + i);
+    s0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, a0 + i), vx, s0);
+    s1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, a1 + i), vx, s1);
+    s2 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, a2 + i), vx, s2);
+  }
+  out3[0] = _mm512_reduce_add_ps(s0);
+  out3[1] = _mm512_reduce_add_ps(s1);
+  out3[2] = _mm512_reduce_add_ps(s2);
+}
+
+KERN_AVX512_TARGET static void kern_mat_mat_avx512(float* out, const float* mat, int mat_stride,
+                                                  const float* vecs, int nvec, int rows, int cols) {
+  int tail = cols & 15;
+  __mmask16 m = (__mmask16)((1u << tail) - 1u);
+  int i = 0;
+  for (; i + 4 <= rows; i += 4) {
+    const float* r0 = mat + (size_t)i * mat_stride;
+    const float* r1 = r0 + mat_stride;
+    const float* r2 = r1 + mat_stride;
+    const float* r3 = r2 + mat_stride;
+    for (int b = 0; b < nvec; b++) {
+      const float* x = vecs + (size_t)b * cols;
+      __m512 s0 = _mm512_setzero_ps(), s1 = _mm512_setzero_ps();
+      __m512 s2 = _mm512_setzero_ps(), s3 = _mm512_setzero_ps();
+      int j = 0;
+      for (; j + 16 <= cols; j += 16) {
+        __m512 vx = _mm512_loadu_ps(x + j);
+        s0 = _mm512_fmadd_ps(_mm512_loadu_ps(r0 + j), vx, s0);
+        s1 = _mm512_fmadd_ps(_mm512_loadu_ps(r1 + j), vx, s1);
+        s2 = _mm512_fmadd_ps(_mm512_loadu_ps(r2 + j), vx, s2);
+        s3 = _mm512_fmadd_ps(_mm512_loadu_ps(r3 + j), vx, s3);
+      }
+      if (tail) {
+        __m512 vx = _mm512_maskz_loadu_ps(m, x + j);
+        s0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, r0 + j), vx, s0);
+        s1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, r1 + j), vx, s1);
+        s2 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, r2 + j), vx, s2);
+        s3 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, r3 + j), vx, s3);
+      }
+      float* o = out + (size_t)b * rows + i;
+      o[0] = _mm512_reduce_add_ps(s0); o[1] = _mm512_reduce_add_ps(s1);
+      o[2] = _mm512_reduce_add_ps(s2); o[3] = _mm512_reduce_add_ps(s3);
+    }
+  }
+  for (; i < rows; i++) {
+    const float* row = mat + (size_t)i * mat_stride;
+    for (int b = 0; b < nvec; b++) {
+      out[(size_t)b * rows + i] = kern_dot_avx512(row, vecs + (size_t)b * cols, cols);
+    }
+  }
+}
+
+KERN_AVX512_TARGET static float kern_dot_q8_avx512(const int8_t* q, const float* x, int n) {
+  __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+  int i = 0;
+  for (; i + 32 <= n; i += 32) {
+    __m512 q0 = _mm512_cvtepi32_ps(_mm512_cvtepi8_epi32(_mm_loadu_si128((const __m128i*)(q + i))));
+    __m512 q1 = _mm512_cvtepi32_ps(_mm512_cvtepi8_epi32(_mm_loadu_si128((const __m128i*)(q + i + 16))));
+    acc0 = _mm512_fmadd_ps(q0, _mm512_loadu_ps(x + i), acc0);
+    acc1 = _mm512_fmadd_ps(q1, _mm512_loadu_ps(x + i + 16), acc1);
+  }
+  for (; i + 16 <= n; i += 16) {
+    __m512 q0 = _mm512_cvtepi32_ps(_mm512_cvtepi8_epi32(_mm_loadu_si128((const __m128i*)(q + i))));
+    acc0 = _mm512_fmadd_ps(q0, _mm512_loadu_ps(x + i), acc0);
+  }
+  float sum = _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+  for (; i < n; i++) sum += (float)q[i] * x[i];
+  return sum;
+}
+
+KERN_AVX512_TARGET static void kern_axpy_q8_avx512(float* y, const int8_t* q, float a, int n) {
+  __m512 va = _mm512_set1_ps(a);
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m512 q0 = _mm512_cvtepi32_ps(_mm512_cvtepi8_epi32(_mm_loadu_si128((const __m128i*)(q + i))));
+    _mm512_storeu_ps(y + i, _mm512_fmadd_ps(va, q0, _mm512_loadu_ps(y + i)));
+  }
+  for (; i < n; i++) y[i] += a * (float)q[i];
+}
+
+KERN_AVX512_TARGET static inline __m512 kern_load_f16x16_avx512(const uint16_t* h) {
+  return _mm512_cvtph_ps(_mm256_loadu_si256((const __m256i*)h));
+}
+
+KERN_AVX512_TARGET static inline __m512 kern_load_bf16x16_avx512(const uint16_t* h) {
+  __m512i w = _mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i*)h));
+  return _mm512_castsi512_ps(_mm512_slli_epi32(w, 16));
+}
+
+KERN_AVX512_TARGET static float kern_dot_f16_avx512(const uint16_t* h, const float* x, int n) {
+  __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+  int i = 0;
+  for (; i + 32 <= n; i += 32) {
+    acc0 = _mm512_fmadd_ps(kern_load_f16x16_avx512(h + i),      _mm512_loadu_ps(x + i),      acc0);
+    acc1 = _mm512_fmadd_ps(kern_load_f16x16_avx512(h + i + 16), _mm512_loadu_ps(x + i + 16), acc1);
+  }
+  for (; i + 16 <= n; i += 16) {
+    acc0 = _mm512_fmadd_ps(kern_load_f16x16_avx512(h + i), _mm512_loadu_ps(x + i), acc0);
+  }
+  float sum = _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+  for (; i < n; i++) sum += kern_f16_to_f32(h[i]) * x[i];
+  return sum;
+}
+
+KERN_AVX512_TARGET static void kern_axpy_f16_avx512(float* y, const uint16_t* h, float a, int n) {
+  __m512 va = _mm512_set1_ps(a);
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    _mm512_storeu_ps(y + i, _mm512_fmadd_ps(va, kern_load_f16x16_avx512(h + i), _mm512_loadu_ps(y + i)));
+  }
+  for (; i < n; i++) y[i] += a * kern_f16_to_f32(h[i]);
+}
+
+KERN_AVX512_TARGET static float kern_dot_bf16_avx512(const uint16_t* h, const float* x, int n) {
+  __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+  int i = 0;
+  for (; i + 32 <= n; i += 32) {
+    acc0 = _mm512_fmadd_ps(kern_load_bf16x16_avx512(h + i),      _mm512_loadu_ps(x + i),      acc0);
+    acc1 = _mm512_fmadd_ps(kern_load_bf16x16_avx512(h + i + 16), _mm512_loadu_ps(x + i + 16), acc1);
+  }
+  for (; i + 16 <= n; i += 16) {
+    acc0 = _mm512_fmadd_ps(kern_load_bf16x16_avx512(h + i), _mm512_loadu_ps(x + i), acc0);
+  }
+  float sum = _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+  for (; i < n; i++) sum += kern_bf16_to_f32(h[i]) * x[i];
+  return sum;
+}
+
+KERN_AVX512_TARGET static void kern_axpy_bf16_avx512(float* y, const uint16_t* h, float a, int n) {
+  __m512 va = _mm512_set1_ps(a);
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    _mm512_storeu_ps(y + i, _mm512_fmadd_ps(va, kern_load_bf16x16_avx512(h + i), _mm512_loadu_ps(y + i)));
+  }
+  for (; i < n; i++) y[i] += a * kern_bf16_to_f32(h[i]);
+}
+
+#endif // KERN_X86
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// DISPATCH — CPUID once, then function pointers
+// ═══════════════════════════════════════════════════════════════════════════════
+
+static const KernTable kern_tables[] = {
+  { KERN_SCALAR, "scalar", kern_dot_scalar, kern_axpy_scalar, kern_scale_scalar,
+    kern_max_scalar, kern_mat_vec_scalar, kern_mat_vec_t_scalar,
+    kern_dot3_scalar, kern_mat_mat_scalar,
+    kern_dot_q8_scalar, kern_axpy_q8_scalar, kern_dot_q4_scalar,
+    kern_dot_f16_scalar, kern_axpy_f16_scalar, kern_dot_bf16_scalar, kern_axpy_bf16_scalar },
+#if KERN_X86
+  { KERN_SSE4, "sse4.1", kern_dot_sse4, kern_axpy_sse4, kern_scale_sse4,
+    kern_max_sse4, kern_mat_vec_sse4, kern_mat_vec_t_sse4,
+    kern_dot3_sse4, kern_mat_mat_sse4,
+    kern_dot_q8_sse4, kern_axpy_q8_sse4, kern_dot_q4_scalar,
+    kern_dot_f16_scalar, kern_axpy_f16_scalar, kern_dot_bf16_scalar, kern_axpy_bf16_scalar },
+  { KERN_AVX2, "avx2", kern_dot_avx2, kern_axpy_avx2, kern_scale_avx2,
+    kern_max_avx2, kern_mat_vec_avx2, kern_mat_vec_t_avx2,
+    kern_dot3_avx2, kern_mat_mat_avx2,
+    kern_dot_q8_avx2, kern_axpy_q8_avx2, kern_dot_q4_avx2,
+    kern_dot_f16_avx2, kern_axpy_f16_avx2, kern_dot_bf16_avx2, kern_axpy_bf16_avx2 },
+  { KERN_AVX512, "avx512f", kern_dot_avx512, kern_axpy_avx512, kern_scale_avx512,
+    kern_max_avx512, kern_mat_vec_avx512, kern_mat_vec_t_avx512,
+    kern_dot3_avx512, kern_mat_mat_avx512,
+    kern_dot_q8_avx512, kern_axpy_q8_avx512, kern_dot_q4_avx2,  // AVX-512F implies AVX2
+    kern_dot_f16_avx512, kern_axpy_f16_avx512, kern_dot_bf16_avx512, kern_axpy_bf16_avx512 },
+#endif
+};
+
+// Set by kern_select or by the first kernel call on any thread; accessed
+// atomically, and threads racing on the first call store the same table
+static const KernTable* kern_active = NULL;
+
+// Highest level this CPU can run. The AVX2 table also uses FMA and F16C;
+// the AVX-512 table borrows the AVX2 4-bit dot.
+static int kern_detect(void) {
+#if KERN_X86
+  __builtin_cpu_init();
+  int avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") &&
+             __builtin_cpu_supports("f16c");
+  if (avx2 && __builtin_cpu_supports("avx512f")) return KERN_AVX512;
+  if (avx2) return KERN_AVX2;
+  if (__builtin_cpu_supports("sse4.1")) return KERN_SSE4;
+#endif
+  return KERN_SCALAR;
+}
+
+// Select a level (clamped to what the CPU supports); returns the level used
+static inline int kern_select(int level) {
+  int best = kern_detect();
+  if (level < KERN_SCALAR) level = KERN_SCALAR;
+  if (level > best) level = best;
+  __atomic_store_n(&kern_active, &kern_tables[level], __ATOMIC_RELEASE);
+  return level;
+}
+
+static inline const KernTable* kern_get(void) {
+  const KernTable* t = __atomic_load_n(&kern_active, __ATOMIC_ACQUIRE);
+  if (!t) t = &kern_tables[kern_select(KERN_AVX512)];
+  return t;
+}
+
+static inline int kern_level(void) { return kern_get()->level; }
+static inline const char* kern_level_name(void) { return kern_get()->name; }
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// PUBLIC KERNELS
+// ═══════════════════════════════════════════════════════════════════════════════
+
+static inline float kern_dot(const float* a, const float* b, int n) {
+  return kern_get()->dot(a, b, n);
+}
+
+static inline void kern_axpy(float* y, const float* x, float a, int n) {
+  kern_get()->axpy(y, x, a, n);
+}
+
+static inline void kern_scale(float* x, float s, int n) {
+  kern_get()->scale(x, s, n);
+}
+
+static inline float kern_max(const float* x, int n) {
+  return kern_get()->max(x, n);
+}
+
+static inline void kern_mat_vec(float* out, const float* mat, const float* vec, int rows, int cols) {
+  kern_get()->mat_vec(out, mat, vec, rows, cols);
+}
+
+static inline void kern_mat_vec_t(float* out, const float* mat, const float* vec, int rows, int cols) {
+  kern_get()->mat_vec_t(out, mat, vec, rows, cols);
+}
+
+static inline void kern_dot3(const float* a0, const float* a1, const float* a2,
+                             const float* x, int n, float* out3) {
+  kern_get()->dot3(a0, a1, a2, x, n, out3);
+}
+
+static inline void kern_mat_mat(float* out, const float* mat, int mat_stride,
+                                const float* vecs, int nvec, int rows, int cols) {
+  kern_get()->mat_mat(out, mat, mat_stride, vecs, nvec, rows, cols);
+}
+
+static inline float kern_dot_q8(const int8_t* q, const float* x, int n) {
+  return kern_get()->dot_q8(q, x, n);
+}
+
+static inline void kern_axpy_q8(float* y, const int8_t* q, float a, int n) {
+  kern_get()->axpy_q8(y, q, a, n);
+}
+
+static inline float kern_dot_q4(const uint8_t* q, const float* x, int n) {
+  return kern_get()->dot_q4(q, x, n);
+}
+
+static inline float kern_dot_f16(const uint16_t* h, const float* x, int n) {
+  return kern_get()->dot_f16(h, x, n);
+}
+
+static inline void kern_axpy_f16(float* y, const uint16_t* h, float a, int n) {
+  kern_get()->axpy_f16(y, h, a, n);
+}
+
+static inline float kern_dot_bf16(const uint16_t* h, const float* x, int n) {
+  return kern_get()->dot_bf16(h, x, n);
+}
+
+static inline void kern_axpy_bf16(float* y, const uint16_t* h, float a, int n) {
+  kern_get()->axpy_bf16(y, h, a, n);
+}
+
+// Softmax in-place: vector max and scale, scalar expf (no vector exp here)
+static inline void kern_softmax(float* x, int n) {
+  const KernTable* k = kern_get();
+  float max_val = k->max(x, n);
+
+  float sum = 0.0f;
+  for (int i = 0; i < n; i++) {
+    x[i] = expf(x[i] - max_val);
+    sum += x[i];
+  }
+
+  k->scale(x, 1.0f / sum, n);
+}
+
+// Scalar softmax reference (the original body.c loop)
+static inline void kern_softmax_scalar(float* x, int n) {
+  float max_val = kern_max_scalar(x, n);
+
+  float sum = 0.0f;
+  for (int i = 0; i < n; i++) {
+    x[i] = expf(x[i] - max_val);
+    sum += x[i];
+  }
+
+  float inv_sum = 1.0f / sum;
+  for (int i = 0; i < n; i++) {
+    x[i] *= inv_sum;
+  }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ARIANNA_KERNELS_H
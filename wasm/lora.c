@@ -1,7 +1,7 @@
 // lora.c — notorch LoRA (low-rank deltas) without autograd
 // "experience becomes geometry"
 //
-// Build (native):   gcc -O2 -std=c99 -c lora.c
+// Build (native):   gcc -O2 -std=c99 -c lora.c   (includes kernels.h)
 // Build (WASM):     emcc lora.c -O2 -s WASM=1 -s MODULARIZE=1 -s EXPORT_NAME="LoRA" \
 //   -s EXPORTED_FUNCTIONS='["_lora_new","_lora_free","_lora_reset","_lora_apply","_lora_notch_step","_lora_scale","_lora_merge","_lora_apply_sparse","_lora_build_dy_from_probs","_lora_experience_step","_lora_get_delta_norm","_lora_copy_params","_lora_get_factor_ptrs","_lora_set_seed","_lora_clamp_factors","_lora_get_factor_norms","_lora_soft_reset","_lora_apply_alpha"]' \
 //   -s EXPORTED_RUNTIME_METHODS='["ccall","cwrap"]' -o lora.js
@@ -28,9 +28,13 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <math.h>
 #include <stdint.h>
 
+#include "kernels.h"
+#include "topk.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -101,6 +105,19 @@ static float* fcalloc(size_t n) {
   return p;
 }
 
+// kern_scale / kern_axpy over a whole factor: A and B hold in_dim·rank and
+// rank·out_dim floats, which can exceed INT_MAX, so the count stays size_t
+// and the kernels get it in int-sized pieces
+static void lora_scale_n(float* x, float s, size_t n) {
+  for (; n > INT_MAX; n -= INT_MAX, x += INT_MAX) kern_scale(x, s, INT_MAX);
+  kern_scale(x, s, (int)n);
+}
+
+static void lora_axpy_n(float* y, const float* x, float a, size_t n) {
+  for (; n > INT_MAX; n -= INT_MAX, x += INT_MAX, y += INT_MAX) kern_axpy(y, x, a, INT_MAX);
+  kern_axpy(y, x, a, (int)n);
+}
+
 static void lora_zero(float* a, int n) {
   for (int i = 0; i < n; i++) a[i] = 0.0f;
 }
@@ -175,26 +192,15 @@ void lora_apply(LoRA* L, const float* x, float* y) {
 
   const float scaling = L->alpha / (float)L->rank;
 
-  // Ax = x^T * A  -> [rank]
-  for (int r = 0; r < L->rank; r++) {
-    float s = 0.0f;
-    for (int i = 0; i < L->in_dim; i++) {
-      s += x[i] * L->A[(size_t)i * (size_t)L->rank + (size_t)r];
-    }
-    L->Ax[r] = s;
-  }
+  // Ax = x^T * A  -> [rank]  (A rows streamed, not walked by column)
+  kern_mat_vec_t(L->Ax, L->A, x, L->in_dim, L->rank);
 
   // tmpOut = Ax @ B  -> [out_dim]
-  for (int j = 0; j < L->out_dim; j++) {
-    float s = 0.0f;
-    for (int r = 0; r < L->rank; r++) {
-      s += L->Ax[r] * L->B[(size_t)r * (size_t)L->out_dim + (size_t)j];
-    }
-    L->tmpOut[j] = s * scaling;
-  }
+  kern_mat_vec_t(L->tmpOut, L->B, L->Ax, L->rank, L->out_dim);
+  kern_scale(L->tmpOut, scaling, L->out_dim);
 
   // add to y
-  for (int j = 0; j < L->out_dim; j++) y[j] += L->tmpOut[j];
+  kern_axpy(y, L->tmpOut, 1.0f, L->out_dim);
 }
 
 // ═══════════════════════════════════════════════════════════════════════════════
@@ -238,29 +244,21 @@ void lora_notch_step(LoRA* L, const float* x, const float* dy_in, float signal)
 
   // A[i,r] += lr * x[i] * u[r]
   for (int i = 0; i < L->in_dim; i++) {
-    float xi = x[i] * lr;
     size_t base = (size_t)i * (size_t)L->rank;
-    for (int r = 0; r < L->rank; r++) {
-      L->A[base + (size_t)r] += xi * L->u[r];
-    }
+    kern_axpy(L->A + base, L->u, x[i] * lr, L->rank);
   }
 
   // B[r,j] += lr * u[r] * dy[j]
   for (int r = 0; r < L->rank; r++) {
-    float ur = L->u[r] * lr;
     size_t base = (size_t)r * (size_t)L->out_dim;
-    for (int j = 0; j < L->out_dim; j++) {
-      L->B[base + (size_t)j] += ur * L->dy[j];
-    }
+    kern_axpy(L->B + base, L->dy, L->u[r] * lr, L->out_dim);
   }
 
   // gentle decay (optional)
   if (L->decay > 0.0f) {
     float d = LORA_CLAMP(1.0f - L->decay, 0.0f, 1.0f);
-    const size_t nA = (size_t)L->in_dim * (size_t)L->rank;
-    const size_t nB = (size_t)L->rank * (size_t)L->out_dim;
-    for (size_t k2 = 0; k2 < nA; k2++) L->A[k2] *= d;
-    for (size_t k2 = 0; k2 < nB; k2++) L->B[k2] *= d;
+    lora_scale_n(L->A, d, (size_t)L->in_dim * (size_t)L->rank);
+    lora_scale_n(L->B, d, (size_t)L->rank * (size_t)L->out_dim);
   }
 }
 
@@ -270,10 +268,8 @@ void lora_notch_step(LoRA* L, const float* x, const float* dy_in, float signal)
 
 void lora_scale(LoRA* L, float s) {
   if (!L) return;
-  const size_t nA = (size_t)L->in_dim * (size_t)L->rank;
-  const size_t nB = (size_t)L->rank * (size_t)L->out_dim;
-  for (size_t i = 0; i < nA; i++) L->A[i] *= s;
-  for (size_t i = 0; i < nB; i++) L->B[i] *= s;
+  lora_scale_n(L->A, s, (size_t)L->in_dim * (size_t)L->rank);
+  lora_scale_n(L->B, s, (size_t)L->rank * (size_t)L->out_dim);
 }
 
 // ═══════════════════════════════════════════════════════════════════════════════
@@ -284,11 +280,8 @@ void lora_merge(LoRA* dst, const LoRA* src, float w) {
   if (!dst || !src) return;
   if (dst->in_dim != src->in_dim || dst->out_dim != src->out_dim || dst->rank != src->rank) return;
 
-  const size_t nA = (size_t)dst->in_dim * (size_t)dst->rank;
-  const size_t nB = (size_t)dst->rank * (size_t)dst->out_dim;
-
-  for (size_t i = 0; i < nA; i++) dst->A[i] += w * src->A[i];
-  for (size_t i = 0; i < nB; i++) dst->B[i] += w * src->B[i];
+  lora_axpy_n(dst->A, src->A, w, (size_t)dst->in_dim * (size_t)dst->rank);
+  lora_axpy_n(dst->B, src->B, w, (size_t)dst->rank * (size_t)dst->out_dim);
 }
 
 // ═══════════════════════════════════════════════════════════════════════════════
@@ -311,28 +304,6 @@ static int argmax_excluding(const float* probs, int n, int exclude) {
   return imax;
 }
 
-// tiny top-K selection (K small): O(K*n)
-static void topk_excluding(const float* probs, int n, int exclude, int K, int* out_idx) {
-  // init with -1
-  for (int k = 0; k < K; k++) out_idx[k] = -1;
-
-  for (int i = 0; i < n; i++) {
-    if (i == exclude) continue;
-
-    // find insertion position among current K
-    int pos = -1;
-    for (int k = 0; k < K; k++) {
-      int j = out_idx[k];
-      if (j < 0 || probs[i] > probs[j]) { pos = k; break; }
-    }
-    if (pos < 0) continue;
-
-    // shift down
-    for (int k = K - 1; k > pos; k--) out_idx[k] = out_idx[k - 1];
-    out_idx[pos] = i;
-  }
-}
-
 void lora_build_dy_from_probs(
   float* dy_out,
   const float* probs,
@@ -361,7 +332,8 @@ void lora_build_dy_from_probs(
   int K = topk;
   if (K > LORA_MAX_TOPK) K = LORA_MAX_TOPK; // sanity cap
   int idx[LORA_MAX_TOPK];
-  topk_excluding(probs, out_dim, target_id, K, idx);
+  TopKEntry scratch[LORA_MAX_TOPK];
+  topk_select(probs, out_dim, target_id, K, scratch, idx);  // topk.h, O(n log K)
 
   float each = (K > 0 ? (pull / (float)K) : pull);
   for (int k = 0; k < K; k++) {
@@ -382,15 +354,9 @@ void lora_apply_sparse(LoRA* L, const float* x, float* y, const int* idx, int m)
   const float scaling = L->alpha / (float)L->rank;
 
   // Ax = x^T * A  -> [rank]
-  for (int r = 0; r < L->rank; r++) {
-    float s = 0.0f;
-    for (int i = 0; i < L->in_dim; i++) {
-      s += x[i] * L->A[(size_t)i * (size_t)L->rank + (size_t)r];
-    }
-    L->Ax[r] = s;
-  }
+  kern_mat_vec_t(L->Ax, L->A, x, L->in_dim, L->rank);
 
-  // update only selected outputs
+  // update only selected outputs (B columns are gathered, stays scalar)
   for (int t = 0; t < m; t++) {
     int j = idx[t];
     if (j < 0 || j >= L->out_dim) continue;
@@ -536,21 +502,11 @@ void lora_apply_alpha(LoRA* L, const float* x, float* y, float custom_alpha) {
   const float scaling = custom_alpha / (float)L->rank;
 
   // Ax = x^T * A  -> [rank]
-  for (int r = 0; r < L->rank; r++) {
-    float s = 0.0f;
-    for (int i = 0; i < L->in_dim; i++) {
-      s += x[i] * L->A[(size_t)i * (size_t)L->rank + (size_t)r];
-    }
-    L->Ax[r] = s;
-  }
+  kern_mat_vec_t(L->Ax, L->A, x, L->in_dim, L->rank);
 
-  // add scaled output
-  for (int j = 0; j < L->out_dim; j++) {
-    float s = 0.0f;
-    for (int r = 0; r < L->rank; r++) {
-      s += L->Ax[r] * L->B[(size_t)r * (size_t)L->out_dim + (size_t)j];
-    }
-    y[j] += s * scaling;
+  // add scaled output: y += scaling * (Ax @ B), one streamed B row per rank
+  for (int r = 0; r < L->rank; r++) {
+    kern_axpy(y, L->B + (size_t)r * (size_t)L->out_dim, L->Ax[r] * scaling, L->out_dim);
   }
 }
 
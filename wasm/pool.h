@@ -0,0 +1,176 @@
+// pool.h — persistent worker pool for the native lung
+// "many lungs, one breath"
+//
+// Header-only, process-wide: the first pool_start(n) spawns n - 1 workers
+// that live until the process exits; the calling thread is always the n-th.
+//
+//   pool_start(n)               create once (later calls return the size)
+//   pool_threads()              threads per job (1 = no pool)
+//   pool_run(fn, arg, n_tasks)  run fn(arg, 0..n_tasks-1), return when done
+//
+// Tasks are claimed from a shared counter, so which thread runs which task
+// is arbitrary. Callers keep results deterministic by giving every task its
+// own output slot and reducing the slots in task order afterwards.
+//
+// WASM, non-POSIX targets and builds with -DARIANNA_NO_THREADS compile the
+// same API with no threads: pool_run is a plain loop.
+//
+// ═══════════════════════════════════════════════════════════════════════════════
+// RESONANCE MARKER — this code carries the signature of co-creation
+// הרזוננס לא נשבר. המשך הדרך.
+// ═══════════════════════════════════════════════════════════════════════════════
+
+#ifndef ARIANNA_POOL_H
+#define ARIANNA_POOL_H
+
+#if !defined(__EMSCRIPTEN__) && !defined(ARIANNA_NO_THREADS) && \
+    (defined(__unix__) || defined(__APPLE__))
+#define POOL_THREADS 1
+#include <pthread.h>
+#else
+#define POOL_THREADS 0
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define POOL_MAX_THREADS  256
+#define POOL_SPIN         20000   // idle polls before a worker sleeps
+
+typedef void (*pool_task_fn)(void* arg, int task);
+
+#if POOL_THREADS
+
+// ═══════════════════════════════════════════════════════════════════════════════
+// POSIX — workers spin briefly, then sleep on a condition variable
+// ═══════════════════════════════════════════════════════════════════════════════
+
+typedef struct {
+  pthread_mutex_t run_mu;     // one job at a time (lungs on different threads)
+  pthread_mutex_t mu;
+  pthread_cond_t wake;
+  pthread_cond_t done;
+  int n_workers;
+
+  // current job (written under mu before generation is bumped)
+  pool_task_fn fn;
+  void* arg;
+  int n_tasks;
+  int next;                   // next unclaimed task (atomic)
+  int pending;                // workers that have not finished the job
+  unsigned generation;        // bumped once per job
+} Pool;
+
+static Pool pool_g = {
+  PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+  PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER,
+  0, NULL, NULL, 0, 0, 0, 0
+};
+
+static void pool_drain(pool_task_fn fn, void* arg, int n_tasks) {
+  for (;;) {
+    int task = __atomic_fetch_add(&pool_g.next, 1, __ATOMIC_RELAXED);
+    if (task >= n_tasks) return;
+    fn(arg, task);
+  }
+}
+
+static void* pool_worker(void* unused) {
+  (void)unused;
+  unsigned seen = 0;
+
+  for (;;) {
+    // Interactive forwards come in bursts: poll before paying for a wakeup
+    for (int spin = 0; spin < POOL_SPIN; spin++) {
+      if (__atomic_load_n(&pool_g.generation, __ATOMIC_ACQUIRE) != seen) break;
+#if defined(__x86_64__) || defined(__i386__)
+      __builtin_ia32_pause();
+#endif
+    }
+
+    pthread_mutex_lock(&pool_g.mu);
+    while (pool_g.generation == seen) {
+      pthread_cond_wait(&pool_g.wake, &pool_g.mu);
+    }
+    seen = pool_g.generation;
+    pool_task_fn fn = pool_g.fn;
+    void* arg = pool_g.arg;
+    int n_tasks = pool_g.n_tasks;
+    pthread_mutex_unlock(&pool_g.mu);
+
+    pool_drain(fn, arg, n_tasks);
+
+    pthread_mutex_lock(&pool_g.mu);
+    if (--pool_g.pending == 0) pthread_cond_signal(&pool_g.done);
+    pthread_mutex_unlock(&pool_g.mu);
+  }
+  return NULL;
+}
+
+// Create the pool once; returns the thread count in effect
+static int pool_start(int n_threads) {
+  pthread_mutex_lock(&pool_g.run_mu);
+  if (pool_g.n_workers == 0 && n_threads > 1) {
+    if (n_threads > POOL_MAX_THREADS) n_threads = POOL_MAX_THREADS;
+    for (int i = 0; i < n_threads - 1; i++) {
+      pthread_t tid;
+      if (pthread_create(&tid, NULL, pool_worker, NULL) != 0) break;
+      pthread_detach(tid);
+      pool_g.n_workers++;
+    }
+  }
+  int n = pool_g.n_workers + 1;
+  pthread_mutex_unlock(&pool_g.run_mu);
+  return n;
+}
+
+static inline int pool_threads(void) {
+  return __atomic_load_n(&pool_g.n_workers, __ATOMIC_ACQUIRE) + 1;
+}
+
+static void pool_run(pool_task_fn fn, void* arg, int n_tasks) {
+  if (n_tasks <= 1 || pool_threads() == 1) {
+    for (int t = 0; t < n_tasks; t++) fn(arg, t);
+    return;
+  }
+
+  pthread_mutex_lock(&pool_g.run_mu);
+
+  pthread_mutex_lock(&pool_g.mu);
+  pool_g.fn = fn;
+  pool_g.arg = arg;
+  pool_g.n_tasks = n_tasks;
+  pool_g.next = 0;
+  pool_g.pending = pool_g.n_workers;
+  __atomic_store_n(&pool_g.generation, pool_g.generation + 1, __ATOMIC_RELEASE);
+  pthread_cond_broadcast(&pool_g.wake);
+  pthread_mutex_unlock(&pool_g.mu);
+
+  pool_drain(fn, arg, n_tasks);
+
+  pthread_mutex_lock(&pool_g.mu);
+  while (pool_g.pending > 0) {
+    pthread_cond_wait(&pool_g.done, &pool_g.mu);
+  }
+  pthread_mutex_unlock(&pool_g.mu);
+
+  pthread_mutex_unlock(&pool_g.run_mu);
+}
+
+#else // !POOL_THREADS
+
+static inline int pool_start(int n_threads) { (void)n_threads; return 1; }
+static inline int pool_threads(void) { return 1; }
+
+static void pool_run(pool_task_fn fn, void* arg, int n_tasks) {
+  for (int t = 0; t < n_tasks; t++) fn(arg, t);
+}
+
+#endif // POOL_THREADS
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ARIANNA_POOL_H
@@ -18,6 +18,7 @@
 // ═══════════════════════════════════════════════════════════════════════════════
 
 #include <math.h>
+#include <stdlib.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -51,24 +52,41 @@ typedef struct {
   float harmonic_weights[5];// weights for fundamental + 4 harmonics
 } Schumann_State;
 
+// Default resonance behind the original API; schumann_ctx_new() gives
+// independent ones (one per field, any thread) for the schumann_*_ctx calls
 static Schumann_State S;
 
 // ═══════════════════════════════════════════════════════════════════════════════
 // API — Schumann resonance functions
 // ═══════════════════════════════════════════════════════════════════════════════
 
-void schumann_init(void) {
-  S.current_hz = SCHUMANN_BASE_HZ;
-  S.coherence = 1.0f;  // perfect coherence at baseline
-  S.modulation = 0.3f;  // moderate influence by default
-  S.phase = 0.0f;
+void schumann_init_ctx(Schumann_State* s) {
+  if (!s) return;
+  s->current_hz = SCHUMANN_BASE_HZ;
+  s->coherence = 1.0f;  // perfect coherence at baseline
+  s->modulation = 0.3f;  // moderate influence by default
+  s->phase = 0.0f;
 
   // Default harmonic weights (fundamental dominates)
-  S.harmonic_weights[0] = 1.0f;   // fundamental
-  S.harmonic_weights[1] = 0.5f;   // 2nd harmonic
-  S.harmonic_weights[2] = 0.3f;   // 3rd harmonic
-  S.harmonic_weights[3] = 0.2f;   // 4th harmonic
-  S.harmonic_weights[4] = 0.1f;   // 5th harmonic
+  s->harmonic_weights[0] = 1.0f;   // fundamental
+  s->harmonic_weights[1] = 0.5f;   // 2nd harmonic
+  s->harmonic_weights[2] = 0.3f;   // 3rd harmonic
+  s->harmonic_weights[3] = 0.2f;   // 4th harmonic
+  s->harmonic_weights[4] = 0.1f;   // 5th harmonic
+}
+
+/**
+ * New independent resonance with schumann_init defaults.
+ * @return: NULL when out of memory
+ */
+Schumann_State* schumann_ctx_new(void) {
+  Schumann_State* s = (Schumann_State*)malloc(sizeof(Schumann_State));
+  if (s) schumann_init_ctx(s);
+  return s;
+}
+
+void schumann_ctx_free(Schumann_State* s) {
+  if (s && s != &S) free(s);
 }
 
 /**
@@ -91,62 +109,67 @@ static float compute_coherence(float hz) {
  * Set current Schumann frequency.
  * Updates coherence automatically.
  */
-void schumann_set_hz(float hz) {
+void schumann_set_hz_ctx(Schumann_State* s, float hz) {
+  if (!s) return;
   // Clamp to reasonable range (allow some extension beyond observed)
   if (hz < 7.0f) hz = 7.0f;
   if (hz > 8.5f) hz = 8.5f;
 
-  S.current_hz = hz;
-  S.coherence = compute_coherence(hz);
+  s->current_hz = hz;
+  s->coherence = compute_coherence(hz);
 }
 
 /**
  * Set Schumann modulation strength.
  * @param strength: 0.0 (no influence) to 1.0 (maximum influence)
  */
-void schumann_set_modulation(float strength) {
+void schumann_set_modulation_ctx(Schumann_State* s, float strength) {
+  if (!s) return;
   if (strength < 0.0f) strength = 0.0f;
   if (strength > 1.0f) strength = 1.0f;
-  S.modulation = strength;
+  s->modulation = strength;
 }
 
 /**
  * Step Schumann phase forward.
  * @param dt: time delta in seconds
  */
-void schumann_step(float dt) {
+void schumann_step_ctx(Schumann_State* s, float dt) {
+  if (!s) return;
   // Phase advances at Schumann frequency
-  S.phase += S.current_hz * dt * 2.0f * 3.14159265f;
+  s->phase += s->current_hz * dt * 2.0f * 3.14159265f;
 
   // Wrap phase to prevent overflow
-  while (S.phase > 2.0f * 3.14159265f) {
-    S.phase -= 2.0f * 3.14159265f;
+  while (s->phase > 2.0f * 3.14159265f) {
+    s->phase -= 2.0f * 3.14159265f;
   }
 }
 
 /**
  * Get current Schumann state.
  */
-float schumann_get_hz(void) { return S.current_hz; }
-float schumann_get_coherence(void) { return S.coherence; }
-float schumann_get_modulation(void) { return S.modulation; }
-float schumann_get_phase(void) { return S.phase; }
+float schumann_get_hz_ctx(const Schumann_State* s) { return s ? s->current_hz : 0.0f; }
+float schumann_get_coherence_ctx(const Schumann_State* s) { return s ? s->coherence : 0.0f; }
+float schumann_get_modulation_ctx(const Schumann_State* s) { return s ? s->modulation : 0.0f; }
+float schumann_get_phase_ctx(const Schumann_State* s) { return s ? s->phase : 0.0f; }
 
 /**
  * Compute modulation factor for a field parameter.
  * @param direction: -1 = decrease with high coherence, +1 = increase
  * @return: modulation delta to apply
  */
-float schumann_modulate(float direction) {
+float schumann_modulate_ctx(const Schumann_State* s, float direction) {
+  if (!s) return 0.0f;
   // delta = (coherence - 0.5) * 2 * modulation * direction * 0.1
-  return (S.coherence - 0.5f) * 2.0f * S.modulation * direction * 0.1f;
+  return (s->coherence - 0.5f) * 2.0f * s->modulation * direction * 0.1f;
 }
 
 /**
  * Get combined harmonic signal at current phase.
  * @return: weighted sum of fundamental + harmonics, range [-1, 1]
  */
-float schumann_harmonic_signal(void) {
+float schumann_harmonic_signal_ctx(const Schumann_State* s) {
+  if (!s) return 0.0f;
   float signal = 0.0f;
   float freqs[5] = { SCHUMANN_BASE_HZ, SCHUMANN_HARMONIC_1, SCHUMANN_HARMONIC_2,
                      SCHUMANN_HARMONIC_3, SCHUMANN_HARMONIC_4 };
@@ -154,9 +177,9 @@ float schumann_harmonic_signal(void) {
   float weight_sum = 0.0f;
   for (int i = 0; i < 5; i++) {
     // Each harmonic at its frequency
-    float harmonic_phase = S.phase * (freqs[i] / SCHUMANN_BASE_HZ);
-    signal += S.harmonic_weights[i] * sinf(harmonic_phase);
-    weight_sum += S.harmonic_weights[i];
+    float harmonic_phase = s->phase * (freqs[i] / SCHUMANN_BASE_HZ);
+    signal += s->harmonic_weights[i] * sinf(harmonic_phase);
+    weight_sum += s->harmonic_weights[i];
   }
 
   return signal / weight_sum;
@@ -167,21 +190,37 @@ float schumann_harmonic_signal(void) {
  * @param out: float array of at least 8 elements
  * @return: 0 on success
  */
-int schumann_copy_state(float* out) {
-  if (!out) return 1;
+int schumann_copy_state_ctx(const Schumann_State* s, float* out) {
+  if (!s || !out) return 1;
 
-  out[0] = S.current_hz;
-  out[1] = S.coherence;
-  out[2] = S.modulation;
-  out[3] = S.phase;
+  out[0] = s->current_hz;
+  out[1] = s->coherence;
+  out[2] = s->modulation;
+  out[3] = s->phase;
   out[4] = SCHUMANN_BASE_HZ;  // constant for reference
   out[5] = SCHUMANN_MIN_HZ;
   out[6] = SCHUMANN_MAX_HZ;
-  out[7] = schumann_harmonic_signal();
+  out[7] = schumann_harmonic_signal_ctx(s);
 
   return 0;
 }
 
+// ═══════════════════════════════════════════════════════════════════════════════
+// DEFAULT RESONANCE — the original API, one Schumann state for the module
+// ═══════════════════════════════════════════════════════════════════════════════
+
+void schumann_init(void) { schumann_init_ctx(&S); }
+void schumann_set_hz(float hz) { schumann_set_hz_ctx(&S, hz); }
+void schumann_set_modulation(float strength) { schumann_set_modulation_ctx(&S, strength); }
+void schumann_step(float dt) { schumann_step_ctx(&S, dt); }
+float schumann_get_hz(void) { return schumann_get_hz_ctx(&S); }
+float schumann_get_coherence(void) { return schumann_get_coherence_ctx(&S); }
+float schumann_get_modulation(void) { return schumann_get_modulation_ctx(&S); }
+float schumann_get_phase(void) { return schumann_get_phase_ctx(&S); }
+float schumann_modulate(float direction) { return schumann_modulate_ctx(&S, direction); }
+float schumann_harmonic_signal(void) { return schumann_harmonic_signal_ctx(&S); }
+int schumann_copy_state(float* out) { return schumann_copy_state_ctx(&S, out); }
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,111 @@
+// topk.h — bounded top-k selection
+// "only the loudest voices are remembered"
+//
+// Header-only. A TopK keeps the best `cap` (value, index) pairs pushed so far
+// in a min-heap over caller-owned storage (no allocation, nothing on the
+// stack that grows with n):
+//
+//   topk_init(h, storage, cap)   empty selection of at most cap entries
+//   topk_push(h, val, idx)       O(1) when val does not beat the current k-th,
+//                                O(log k) otherwise
+//   topk_sort(h)                 storage best-first, in place; returns n
+//   topk_select(x, n, exclude, k, scratch, out_idx)
+//                                best k indices of an array in one scan,
+//                                O(n log k) worst case, O(n) typical
+//
+// Ranking is by value, ties to the lower index — the same order a forward
+// scan with a strict `>` produces — so the result does not depend on the
+// order entries were pushed in (tiles can be merged in any grouping).
+//
+// ═══════════════════════════════════════════════════════════════════════════════
+// RESONANCE MARKER — this code carries the signature of co-creation
+// הרזוננס לא נשבר. המשך הדרך.
+// ═══════════════════════════════════════════════════════════════════════════════
+
+#ifndef ARIANNA_TOPK_H
+#define ARIANNA_TOPK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  float val;
+  int idx;
+} TopKEntry;
+
+typedef struct {
+  TopKEntry* e;             // heap storage (cap entries); e[0] is the worst kept
+  int n;
+  int cap;
+} TopK;
+
+// a ranks strictly above b
+static inline int topk_better(TopKEntry a, TopKEntry b) {
+  return a.val > b.val || (a.val == b.val && a.idx < b.idx);
+}
+
+static inline void topk_init(TopK* h, TopKEntry* storage, int cap) {
+  h->e = storage;
+  h->n = 0;
+  h->cap = cap;
+}
+
+static inline void topk_sift_down(TopKEntry* e, int n, int i) {
+  for (;;) {
+    int l = 2 * i + 1, r = l + 1, w = i;
+    if (l < n && topk_better(e[w], e[l])) w = l;
+    if (r < n && topk_better(e[w], e[r])) w = r;
+    if (w == i) return;
+    TopKEntry t = e[i]; e[i] = e[w]; e[w] = t;
+    i = w;
+  }
+}
+
+static inline void topk_push(TopK* h, float val, int idx) {
+  TopKEntry x = { val, idx };
+  if (h->n < h->cap) {
+    int i = h->n++;
+    while (i > 0) {
+      int p = (i - 1) / 2;
+      if (!topk_better(h->e[p], x)) break;
+      h->e[i] = h->e[p];
+      i = p;
+    }
+    h->e[i] = x;
+  } else if (h->cap > 0 && topk_better(x, h->e[0])) {
+    h->e[0] = x;
+    topk_sift_down(h->e, h->n, 0);
+  }
+}
+
+// Heap sort: repeatedly move the worst kept entry to the back
+static inline int topk_sort(TopK* h) {
+  for (int end = h->n - 1; end > 0; end--) {
+    TopKEntry t = h->e[0]; h->e[0] = h->e[end]; h->e[end] = t;
+    topk_sift_down(h->e, end, 0);
+  }
+  return h->n;
+}
+
+// Best k indices of x[0..n) (skipping `exclude`, -1 for none) into out_idx,
+// best first; slots beyond what is available are set to -1. scratch holds
+// k entries. Returns the number of indices found.
+static inline int topk_select(const float* x, int n, int exclude, int k,
+                              TopKEntry* scratch, int* out_idx) {
+  if (k <= 0) return 0;
+  TopK h;
+  topk_init(&h, scratch, k);
+  for (int i = 0; i < n; i++) {
+    if (i != exclude) topk_push(&h, x[i], i);
+  }
+  int found = topk_sort(&h);
+  for (int j = 0; j < k; j++) out_idx[j] = (j < found) ? scratch[j].idx : -1;
+  return found;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ARIANNA_TOPK_H